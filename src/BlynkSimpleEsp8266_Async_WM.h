@@ -123,7 +123,7 @@
   #endif
 
   // EEPROM Memory Address for the MultiResetDetector to use
-  #ifndef MRD_TIMEOUT
+  #ifndef MRD_ADDRESS
     #define MRD_ADDRESS 0
   #endif
   
@@ -167,7 +167,9 @@
   #define DRD_TIMEOUT 10
 
   // RTC Memory Address for the DoubleResetDetector to use
-  #define DRD_ADDRESS 0
+  #ifndef DRD_ADDRESS
+    #define DRD_ADDRESS 0
+  #endif
   
   #include <ESP_DoubleResetDetector.h>      //https://github.com/khoih-prog/ESP_DoubleResetDetector
 
@@ -190,6 +192,9 @@ typedef struct
   uint8_t maxlen;
 } MenuItem;
 
+// Called by forEachMenuItem() for each Dynamic Param. valueLength is the length of item.pdata
+typedef void (*BlynkWM_MenuItemVisitor)(const MenuItem& item, size_t valueLength, void* userData);
+
 #if USE_DYNAMIC_PARAMETERS
   extern uint16_t NUM_MENU_ITEMS;
   extern MenuItem myMenuItems [];
@@ -241,6 +246,566 @@ uint16_t CONFIG_DATA_SIZE = sizeof(Blynk_WM_Configuration);
 extern bool LOAD_DEFAULT_CONFIG_DATA;
 extern Blynk_WM_Configuration defaultConfig;
 
+// Cache the WiFi and Blynk Credentials of the last connection and the Dynamic Params in RTC memory, so that waking up
+// from deep sleep won't need to read them from LittleFS / SPIFFS / EEPROM / NVS, and won't run DRD/MRD
+#ifndef USE_RTC_CONFIG_CACHE
+  #define USE_RTC_CONFIG_CACHE      false
+#endif
+
+// RTC memory is used to keep small data across software resets and deep sleep, without any flash write.
+// For ESP8266, RTC user memory is 512 bytes (128 4-byte blocks). BLYNK_WM_RTC_OFFSET is in 4-byte blocks,
+// and the first 32 blocks are left for the sketch.
+#ifndef BLYNK_WM_RTC_OFFSET
+  #define BLYNK_WM_RTC_OFFSET       32
+#endif
+
+#ifndef BLYNK_WM_RTC_SIZE
+  #define BLYNK_WM_RTC_SIZE         ( 512 - ( BLYNK_WM_RTC_OFFSET * 4 ) )
+#endif
+
+#if ( ( BLYNK_WM_RTC_OFFSET * 4 ) + BLYNK_WM_RTC_SIZE > 512 )
+  #error BLYNK_WM_RTC_OFFSET and BLYNK_WM_RTC_SIZE exceed ESP8266 RTC user memory
+#endif
+
+// Count flash writes / erases of Config Data, Dynamic Params and forced CP flag. DRD/MRD flag writes, done inside
+// ESP_DoubleResetDetector / ESP_MultiResetDetector, are not counted.
+// Counters are kept in RTC memory, so they survive software resets (e.g. reboot loops), but not power loss
+#ifndef USE_FLASH_WRITE_STATS
+  #define USE_FLASH_WRITE_STATS     false
+#endif
+
+// Keep the non-persistent forced Config Portal flag in RTC memory instead of flash
+#ifndef FORCED_CP_USE_RTC
+  #define FORCED_CP_USE_RTC         false
+#endif
+
+// Count resets for DRD/MRD in RTC memory, without the flash writes at every boot and at timeout.
+// DRD/MRD in flash is only used after RTC memory was lost (power on), and until its timeout
+// drd / mrd is NULL when the reset was counted in RTC memory
+#ifndef RESET_DETECT_USE_RTC
+  #define RESET_DETECT_USE_RTC      false
+#endif
+
+#if USING_MRD
+  #define RESET_DETECT_TIMES        MRD_TIMES
+  #define RESET_DETECT_TIMEOUT      MRD_TIMEOUT
+#else
+  #define RESET_DETECT_TIMES        2
+  #define RESET_DETECT_TIMEOUT      DRD_TIMEOUT
+#endif
+
+// Keep BSSID and channel of the last connected AP in RTC memory, and connect directly to it
+// before scanning all channels. Kept across deep sleep and software resets, not power loss
+#ifndef USE_WIFI_AP_CACHE
+  #define USE_WIFI_AP_CACHE         false
+#endif
+
+// Timeout of direct connection to the cached AP, before scanning all channels
+#ifndef TIMEOUT_WIFI_AP_CACHE
+  #define TIMEOUT_WIFI_AP_CACHE     5000L
+#endif
+
+// Start connecting to the cached AP at the beginning of begin(), so that WiFi association runs while storage is
+// mounted and Config Data is read. The connection is kept only if its WiFi Credentials are still in Config Data.
+// The WiFi Credentials of the cached AP are also kept in RTC memory
+#ifndef USE_EARLY_WIFI
+  #define USE_EARLY_WIFI            false
+#endif
+
+#if ( USE_EARLY_WIFI && !USE_WIFI_AP_CACHE )
+  #warning USE_EARLY_WIFI needs USE_WIFI_AP_CACHE. Disable USE_EARLY_WIFI
+  #undef USE_EARLY_WIFI
+  #define USE_EARLY_WIFI            false
+#endif
+
+// Scan once, keep the result for WIFI_SCAN_CACHE_TTL ms, and connect to the best ranked WiFi Credentials first,
+// on the BSSID and channel of its strongest AP. Rank is RSSI, plus WIFI_RANK_HYSTERESIS dB for the last connected one,
+// minus WIFI_RANK_FAIL_PENALTY dB for each consecutive failure. History is kept in RTC memory
+#ifndef USE_WIFI_SCAN_RANK
+  #define USE_WIFI_SCAN_RANK        false
+#endif
+
+#if USE_WIFI_SCAN_RANK
+  #ifndef WIFI_SCAN_CACHE_TTL
+    #define WIFI_SCAN_CACHE_TTL       30000L
+  #endif
+  
+  #ifndef WIFI_RANK_HYSTERESIS
+    #define WIFI_RANK_HYSTERESIS      8
+  #endif
+  
+  #ifndef WIFI_RANK_FAIL_PENALTY
+    #define WIFI_RANK_FAIL_PENALTY    10
+  #endif
+  
+  // Timeout for each ranked AP, before trying the next one
+  #ifndef TIMEOUT_WIFI_RANKED
+    #define TIMEOUT_WIFI_RANKED       10000L
+  #endif
+#endif
+
+// Keep the last DHCP lease (IP, gateway, subnet, DNS) of each connection in RTC memory, and reuse it as static IP
+// when connecting to a known WiFi, without waiting for DHCP. After DHCP_LEASE_MAX_REUSE connections, or if Blynk
+// can't be connected with the reused lease, DHCP is used again
+#ifndef USE_DHCP_LEASE_CACHE
+  #define USE_DHCP_LEASE_CACHE      false
+#endif
+
+#if USE_DHCP_LEASE_CACHE
+  #ifndef DHCP_LEASE_MAX_REUSE
+    #define DHCP_LEASE_MAX_REUSE    20
+  #endif
+#endif
+
+// Keep resolved IP of Blynk servers in RTC memory, and connect to it without DNS after reconnect or deep sleep wake.
+// The IP is refreshed by a non-blocking DNS query after connecting, and resolved again if connection to it fails
+#ifndef USE_DNS_CACHE
+  #define USE_DNS_CACHE             false
+#endif
+
+// After connecting, refresh cached IP not resolved since this boot, or resolved more than DNS_CACHE_TTL seconds ago
+#ifndef DNS_CACHE_TTL
+  #define DNS_CACHE_TTL             3600L
+#endif
+
+// Layout of RTC data, in bytes from start of Blynk_WM RTC area. Each record has a BlynkWM_RTC_Header
+#define BLYNK_WM_RTC_FORCED_CP_OFFSET     0
+
+#if FORCED_CP_USE_RTC
+  #define BLYNK_WM_RTC_FORCED_CP_SIZE     ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_ForcedCP_RTC) )
+#else
+  #define BLYNK_WM_RTC_FORCED_CP_SIZE     0
+#endif
+
+#define BLYNK_WM_RTC_FLASH_STATS_OFFSET   ( BLYNK_WM_RTC_FORCED_CP_OFFSET + BLYNK_WM_RTC_FORCED_CP_SIZE )
+
+#if USE_FLASH_WRITE_STATS
+  #define BLYNK_WM_RTC_FLASH_STATS_SIZE   ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_FlashStats) )
+#else
+  #define BLYNK_WM_RTC_FLASH_STATS_SIZE   0
+#endif
+
+#define BLYNK_WM_RTC_AP_CACHE_OFFSET      ( BLYNK_WM_RTC_FLASH_STATS_OFFSET + BLYNK_WM_RTC_FLASH_STATS_SIZE )
+
+#if USE_WIFI_AP_CACHE
+  #define BLYNK_WM_RTC_AP_CACHE_SIZE      ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_APCache) )
+#else
+  #define BLYNK_WM_RTC_AP_CACHE_SIZE      0
+#endif
+
+#define BLYNK_WM_RTC_DNS_CACHE_OFFSET     ( BLYNK_WM_RTC_AP_CACHE_OFFSET + BLYNK_WM_RTC_AP_CACHE_SIZE )
+
+#if USE_DNS_CACHE
+  #define BLYNK_WM_RTC_DNS_CACHE_SIZE     ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_DNSCache) )
+#else
+  #define BLYNK_WM_RTC_DNS_CACHE_SIZE     0
+#endif
+
+#define BLYNK_WM_RTC_WIFI_HISTORY_OFFSET  ( BLYNK_WM_RTC_DNS_CACHE_OFFSET + BLYNK_WM_RTC_DNS_CACHE_SIZE )
+
+#if USE_WIFI_SCAN_RANK
+  #define BLYNK_WM_RTC_WIFI_HISTORY_SIZE  ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_WiFiHistory) )
+#else
+  #define BLYNK_WM_RTC_WIFI_HISTORY_SIZE  0
+#endif
+
+#define BLYNK_WM_RTC_DHCP_LEASE_OFFSET    ( BLYNK_WM_RTC_WIFI_HISTORY_OFFSET + BLYNK_WM_RTC_WIFI_HISTORY_SIZE )
+
+#if USE_DHCP_LEASE_CACHE
+  #define BLYNK_WM_RTC_DHCP_LEASE_SIZE    ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_DHCPLease) )
+#else
+  #define BLYNK_WM_RTC_DHCP_LEASE_SIZE    0
+#endif
+
+#define BLYNK_WM_RTC_RESET_DETECT_OFFSET  ( BLYNK_WM_RTC_DHCP_LEASE_OFFSET + BLYNK_WM_RTC_DHCP_LEASE_SIZE )
+
+#if RESET_DETECT_USE_RTC
+  #define BLYNK_WM_RTC_RESET_DETECT_SIZE  ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_ResetDetect_RTC) )
+#else
+  #define BLYNK_WM_RTC_RESET_DETECT_SIZE  0
+#endif
+
+#define BLYNK_WM_RTC_EARLY_WIFI_OFFSET    ( BLYNK_WM_RTC_RESET_DETECT_OFFSET + BLYNK_WM_RTC_RESET_DETECT_SIZE )
+
+#if USE_EARLY_WIFI
+  #define BLYNK_WM_RTC_EARLY_WIFI_SIZE    ( sizeof(BlynkWM_RTC_Header) + sizeof(WiFi_Credentials) )
+#else
+  #define BLYNK_WM_RTC_EARLY_WIFI_SIZE    0
+#endif
+
+#define BLYNK_WM_RTC_DUTY_CYCLE_OFFSET    ( BLYNK_WM_RTC_EARLY_WIFI_OFFSET + BLYNK_WM_RTC_EARLY_WIFI_SIZE )
+
+#if USE_DUTY_CYCLE
+  #define BLYNK_WM_RTC_DUTY_CYCLE_SIZE    ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_DutyCycle_RTC) )
+#else
+  #define BLYNK_WM_RTC_DUTY_CYCLE_SIZE    0
+#endif
+
+#define BLYNK_WM_RTC_TIME_OFFSET          ( BLYNK_WM_RTC_DUTY_CYCLE_OFFSET + BLYNK_WM_RTC_DUTY_CYCLE_SIZE )
+
+#if USE_TIME_SERVICE
+  #define BLYNK_WM_RTC_TIME_SIZE          ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_Time_RTC) )
+#else
+  #define BLYNK_WM_RTC_TIME_SIZE          0
+#endif
+
+#define BLYNK_WM_RTC_CONFIG_CACHE_OFFSET  ( BLYNK_WM_RTC_TIME_OFFSET + BLYNK_WM_RTC_TIME_SIZE )
+
+#define BLYNK_WM_RTC_MAGIC                ( (uint32_t) 0x424C0000 )
+
+typedef struct
+{
+  uint32_t magic;     // BLYNK_WM_RTC_MAGIC | data size
+  uint32_t crc;       // CRC32 of data
+} BlynkWM_RTC_Header;
+
+typedef struct
+{
+  uint32_t forcedCPFlag;
+  uint32_t flashForcedCPFlag;   // Last known flag stored in flash
+} BlynkWM_ForcedCP_RTC;
+
+typedef struct
+{
+  uint32_t resetCount;      // Resets, each within RESET_DETECT_TIMEOUT of the previous boot
+  uint32_t flashPending;    // DRD/MRD flag in flash may be set by a boot using flash, until its timeout
+} BlynkWM_ResetDetect_RTC;
+
+typedef struct
+{
+  uint32_t epoch;           // Seconds since 1970, when saved
+} BlynkWM_Time_RTC;
+
+typedef struct
+{
+  uint32_t bootCount;         // Boots since counters were reset
+  uint32_t writeCount;        // Flash write operations
+  uint32_t writeBytes;        // Bytes written to flash
+  uint32_t eraseCount;        // Flash sector / block erases, estimated
+  uint32_t bootWriteCount;    // Flash write operations since this boot
+  uint32_t bootWriteBytes;    // Bytes written to flash since this boot
+  uint32_t bootEraseCount;    // Flash erases since this boot, estimated
+} BlynkWM_FlashStats;
+
+typedef struct
+{
+  uint8_t  bssid[6];
+  uint8_t  channel;
+  uint8_t  wifiIndex;       // Index in WiFi_Creds
+  uint32_t credsCRC;        // CRC32 of WiFi_Creds[wifiIndex], to drop cache after credentials change
+} BlynkWM_APCache;
+
+typedef struct
+{
+  uint32_t credsCRC[NUM_WIFI_CREDENTIALS];    // CRC32 of WiFi_Creds, to drop history after credentials change
+  uint8_t  failCount[NUM_WIFI_CREDENTIALS];   // Consecutive failed connections
+  uint8_t  lastIndex;                         // Last connected WiFi_Creds, 0xFF if none
+} BlynkWM_WiFiHistory;
+
+typedef struct
+{
+  int8_t   rssi;              // Strongest AP of this SSID, 0 if not found
+  uint8_t  channel;
+  uint8_t  bssid[6];
+} BlynkWM_WiFiScanEntry;
+
+typedef struct
+{
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns1;
+  uint32_t dns2;
+  uint32_t credsCRC;        // CRC32 of WiFi_Creds[wifiIndex], to drop lease after credentials change
+  uint8_t  wifiIndex;       // Index in WiFi_Creds
+  uint8_t  reuseCount;      // Connections reusing this lease since DHCP
+} BlynkWM_DHCPLease;
+
+typedef struct
+{
+  uint32_t hostCRC[NUM_BLYNK_CREDENTIALS];    // CRC32 of blynk_server, to drop IP after server change
+  uint32_t ip[NUM_BLYNK_CREDENTIALS];         // 0 if none
+} BlynkWM_DNSCache;
+
+// Firmware build id, to invalidate RTC config cache after uploading new firmware
+#ifndef BLYNK_WM_BUILD_ID
+  #define BLYNK_WM_BUILD_ID         BLYNK_ASYNC_WM_VERSION " " __DATE__ " " __TIME__
+#endif
+
+// Only the Credentials used by the last connection are cached, as the whole Config Data doesn't fit in
+// ESP8266 RTC user memory. Dynamic Params follow in TLV format if they fit, otherwise they are loaded from storage
+typedef struct
+{
+  uint32_t          buildId;          // CRC32 of BLYNK_WM_BUILD_ID
+  uint32_t          dynamicDataCRC;   // CRC32 of Dynamic Params in TLV format
+  uint16_t          loadTime;         // ms used to load Config Data from storage
+  uint16_t          dynamicDataSize;  // Size of TLV Dynamic Params following, 0 if they are in storage only
+  uint8_t           wifiIndex;        // Index in WiFi_Creds of WiFi_Creds
+  uint8_t           blynkIndex;       // Index in Blynk_Creds of Blynk_Creds
+  uint16_t          reserved;
+  WiFi_Credentials  WiFi_Creds;
+  Blynk_Credentials Blynk_Creds;
+  int               blynk_port;
+} BlynkWM_ConfigCache;
+
+#if USE_RTC_CONFIG_CACHE
+  #define BLYNK_WM_RTC_CONFIG_CACHE_SIZE  ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_ConfigCache) )
+#else
+  #define BLYNK_WM_RTC_CONFIG_CACHE_SIZE  0
+#endif
+
+// Space left after all records, for the Dynamic Params of Config cache
+#define BLYNK_WM_RTC_FREE_SIZE            ( BLYNK_WM_RTC_SIZE - BLYNK_WM_RTC_CONFIG_CACHE_OFFSET - BLYNK_WM_RTC_CONFIG_CACHE_SIZE )
+
+// Config Data export / import for cloning boards.
+// Layout : BlynkWM_Export_Header, Config Data as stored (with its checkSum), Dynamic Params in TLV format (with its CRC32),
+// then CRC32 of all previous bytes
+#define BLYNK_WM_EXPORT_MAGIC         ( (uint32_t) 0x58425742 )
+#define BLYNK_WM_EXPORT_VERSION       1
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t configSize;
+  uint16_t dynamicDataSize;
+  uint16_t reserved;
+} BlynkWM_Export_Header;
+
+// Non-blocking connection. begin() returns at once, and run() connects step by step :
+// WiFi => DNS => TCP => Blynk login, each step with its own timeout
+#ifndef USE_ASYNC_CONNECT
+  #define USE_ASYNC_CONNECT         false
+#endif
+
+#if ( USE_ASYNC_CONNECT || USE_DNS_CACHE )
+  #include <lwip/dns.h>
+#endif
+
+#if USE_ASYNC_CONNECT
+
+  // Timeout for each WiFi credential
+  #ifndef TIMEOUT_ASYNC_WIFI
+    #define TIMEOUT_ASYNC_WIFI        15000L
+  #endif
+  
+  // Timeouts for each Blynk server
+  #ifndef TIMEOUT_ASYNC_DNS
+    #define TIMEOUT_ASYNC_DNS         5000L
+  #endif
+  
+  #ifndef TIMEOUT_ASYNC_TCP
+    #define TIMEOUT_ASYNC_TCP         10000L
+  #endif
+  
+  #ifndef TIMEOUT_ASYNC_LOGIN
+    #define TIMEOUT_ASYNC_LOGIN       10000L
+  #endif
+  
+  // Rounds over all Blynk servers, after WiFi connected in begin(), before starting Config Portal
+  #ifndef ASYNC_BLYNK_ROUNDS_BEFORE_CP
+    #define ASYNC_BLYNK_ROUNDS_BEFORE_CP    10
+  #endif
+#endif
+
+typedef enum
+{
+  BLYNK_WM_STATE_IDLE = 0,
+  BLYNK_WM_STATE_WIFI,
+  BLYNK_WM_STATE_PROBE,
+  BLYNK_WM_STATE_DNS,
+  BLYNK_WM_STATE_TCP,
+  BLYNK_WM_STATE_LOGIN,
+  BLYNK_WM_STATE_CONNECTED
+} BlynkWM_ConnectState;
+
+// Callback for connection events : onConnected(), onDisconnected(), onPortal()
+typedef void (*BlynkWM_EventCallback)(void);
+
+// Reconnect in run() with exponential backoff and random jitter, separately for WiFi and Blynk,
+// so that devices losing connection at the same time won't all reconnect in lockstep
+#ifndef USE_RECONNECT_BACKOFF
+  #define USE_RECONNECT_BACKOFF         false
+#endif
+
+#if USE_RECONNECT_BACKOFF
+  // Delay before first attempt, doubled after each failed attempt up to max
+  #ifndef RECONNECT_WIFI_BACKOFF_MIN
+    #define RECONNECT_WIFI_BACKOFF_MIN      1000L
+  #endif
+  
+  #ifndef RECONNECT_WIFI_BACKOFF_MAX
+    #define RECONNECT_WIFI_BACKOFF_MAX      60000L
+  #endif
+  
+  #ifndef RECONNECT_BLYNK_BACKOFF_MIN
+    #define RECONNECT_BLYNK_BACKOFF_MIN     2000L
+  #endif
+  
+  #ifndef RECONNECT_BLYNK_BACKOFF_MAX
+    #define RECONNECT_BLYNK_BACKOFF_MAX     300000L
+  #endif
+  
+  // Each delay is randomized by +/- RECONNECT_BACKOFF_JITTER percent
+  #ifndef RECONNECT_BACKOFF_JITTER
+    #define RECONNECT_BACKOFF_JITTER        50
+  #endif
+#endif
+
+// Record millis() at each boot and connection phase until first Blynk connection.
+// Read by getBootTiming(), printed in one line by printBootTiming()
+#ifndef USE_BOOT_TIMING
+  #define USE_BOOT_TIMING               false
+#endif
+
+#if USE_BOOT_TIMING
+  // Virtual pin to write the boot timing line to, once connected to Blynk. -1 => none
+  #ifndef BOOT_TIMING_VPIN
+    #define BOOT_TIMING_VPIN            -1
+  #endif
+#endif
+
+// millis() at end of each phase, 0 if not reached or not measured
+typedef struct
+{
+  uint32_t begin;           // begin() called
+  uint32_t resetDetect;     // DRD/MRD done
+  uint32_t config;          // Config Data loaded, including FS mount
+  uint32_t wifi;            // WiFi associated, and got IP by DHCP
+  uint32_t dns;             // Blynk server resolved, USE_ASYNC_CONNECT only
+  uint32_t ntp;             // Time synced, SSL only
+  uint32_t tcp;             // TCP connected, including TLS handshake for SSL. USE_ASYNC_CONNECT or SSL only
+  uint32_t login;           // Blynk logged in
+} BlynkWM_BootTiming;
+
+// Duty-cycle mode for battery-powered nodes, by runDutyCycle(): connect, send the readings queued by
+// queueVirtualWrite(), wait until Blynk server has acknowledged them, then deep sleep. Queue and per-cycle
+// statistics are kept in RTC memory
+#ifndef USE_DUTY_CYCLE
+  #define USE_DUTY_CYCLE                false
+#endif
+
+#if USE_DUTY_CYCLE
+  // Max time in ms to connect, send and get acknowledge, before going back to sleep
+  #ifndef DUTY_CYCLE_TIMEOUT
+    #define DUTY_CYCLE_TIMEOUT          20000L
+  #endif
+  
+  // Max readings queued between successful cycles. When full, the oldest reading is dropped.
+  // Each reading uses 8 bytes of RTC memory
+  #ifndef DUTY_CYCLE_QUEUE_SIZE
+    #define DUTY_CYCLE_QUEUE_SIZE       4
+  #endif
+  
+  // On connection failure, don't start Config Portal, but let runDutyCycle() sleep until next cycle.
+  // Config Portal is still started by DRD/MRD, or without valid Config Data
+  #ifndef DUTY_CYCLE_SLEEP_ON_FAIL
+    #define DUTY_CYCLE_SLEEP_ON_FAIL    true
+  #endif
+  
+  // Can be redefined, e.g. to simulate deep sleep when testing
+  #ifndef BLYNK_WM_DEEP_SLEEP
+    #define BLYNK_WM_DEEP_SLEEP(us)     ESP.deepSleep(us)
+  #endif
+#endif
+
+typedef struct
+{
+  uint8_t   pin;
+  float     value;
+} BlynkWM_QueuedWrite;
+
+// Statistics of the last cycle are updated just before deep sleep
+typedef struct
+{
+  uint32_t cycleCount;          // Cycles run
+  uint32_t failCount;           // Cycles without acknowledge from Blynk server
+  uint32_t dropCount;           // Readings dropped because queue was full
+  uint32_t timeToFirstWrite;    // millis() at first virtualWrite() of last cycle, 0 if not connected
+  uint32_t awakeTime;           // millis() at start of deep sleep of last cycle
+} BlynkWM_DutyCycleStats;
+
+#if USE_DUTY_CYCLE
+typedef struct
+{
+  BlynkWM_DutyCycleStats  stats;
+  uint32_t                queueCount;
+  BlynkWM_QueuedWrite     queue[DUTY_CYCLE_QUEUE_SIZE];
+} BlynkWM_DutyCycle_RTC;
+#endif
+
+// Measure the duration of each run(), to find what stalls loop(). Each new longest run() over RUN_TIME_BUDGET ms
+// is logged. With USE_ASYNC_CONNECT, only TCP connect and TLS handshake still block in run().
+// Without it, connecting WiFi and Blynk still blocks until connected or timeout. This is only measured, not shortened
+#ifndef USE_RUN_TIME_CHECK
+  #define USE_RUN_TIME_CHECK            false
+#endif
+
+#if USE_RUN_TIME_CHECK
+  #ifndef RUN_TIME_BUDGET
+    #define RUN_TIME_BUDGET             10
+  #endif
+#endif
+
+// Start SNTP once in begin(), and keep the last good time in RTC memory, to set the clock after soft reset or
+// deep sleep before SNTP syncs again. The SSL client then connects at once, without waiting for NTP
+#ifndef USE_TIME_SERVICE
+  #define USE_TIME_SERVICE              false
+#endif
+
+#if USE_TIME_SERVICE
+  #include <sys/time.h>
+  
+  // Interval in ms to save time in RTC memory
+  #ifndef TIME_SAVE_INTERVAL
+    #define TIME_SAVE_INTERVAL          60000L
+  #endif
+#endif
+
+// Race TCP connections to all Blynk servers before connecting, and try the fastest first.
+// Connect times are averaged, so that later connections prefer the server usually faster
+#ifndef USE_BLYNK_SERVER_PROBE
+  #define USE_BLYNK_SERVER_PROBE        false
+#endif
+
+#if USE_BLYNK_SERVER_PROBE
+  #ifndef TIMEOUT_BLYNK_SERVER_PROBE
+    #define TIMEOUT_BLYNK_SERVER_PROBE    3000L
+  #endif
+  
+  // Delay between starting each server probe. 0 => all at once
+  #ifndef BLYNK_SERVER_PROBE_STAGGER_MS
+    #define BLYNK_SERVER_PROBE_STAGGER_MS   0
+  #endif
+#endif
+
+#define BLYNK_WM_PROBE_PENDING      ( -1 )
+#define BLYNK_WM_PROBE_FAILED       ( -2 )
+
+// Callbacks may run in another task (async_tcp on ESP32). They only set result and closed.
+// The client is closed and deleted only by run() / begin()
+typedef struct
+{
+  AsyncClient*      client;       // NULL when deleted
+  unsigned long     startTime;
+  volatile int32_t  result;       // Connect time in ms, BLYNK_WM_PROBE_PENDING or BLYNK_WM_PROBE_FAILED
+  volatile bool     closed;       // Set by onDisconnect. client can then be deleted
+} BlynkWM_ServerProbe;
+
+// Dynamic Params are stored in versioned Tag-Length-Value format, keyed by MenuItem.id, so that
+// adding / removing / resizing myMenuItems[] in new firmware won't invalidate stored data.
+// Layout : BlynkWM_TLV_Header, then for each item { idLen, id, valueLen, value }, then CRC32 of all previous bytes
+#define BLYNK_WM_TLV_MAGIC            ( (uint32_t) 0x544C5642 )
+#define BLYNK_WM_TLV_VERSION          1
+
+typedef struct
+{
+  uint32_t magic;
+  uint8_t  version;
+  uint8_t  numItems;
+  uint16_t payloadLen;    // Length of all items, excluding header and CRC32
+} BlynkWM_TLV_Header;
+
 // Permit special chars such as # and %
 
 // -- HTML page fragments
@@ -294,6 +859,10 @@ const char WM_HTTP_CORS_ALLOW_ALL[]  = "*";
 
 //////////////////////////////////////////
 
+// All RTC records, once their types are all defined, must fit in RTC memory
+static_assert( BLYNK_WM_RTC_CONFIG_CACHE_OFFSET + BLYNK_WM_RTC_CONFIG_CACHE_SIZE <= BLYNK_WM_RTC_SIZE,
+               "RTC data exceeds BLYNK_WM_RTC_SIZE. Please disable some RTC features");
+
 #define BLYNK_SERVER_HARDWARE_PORT    8080
 
 #define BLYNK_BOARD_TYPE    "ESP8266"
@@ -390,27 +959,53 @@ class BlynkWifi
       pinMode(LED_BUILTIN, OUTPUT);
       digitalWrite(LED_BUILTIN, LED_OFF);
       
-#if USING_MRD
-      //// New MRD ////
-      mrd = new MultiResetDetector(MRD_TIMEOUT, MRD_ADDRESS);  
-      bool noConfigPortal = true;
-   
-      if (mrd->detectMultiReset())
-#else      
-      //// New DRD ////
-      drd = new DoubleResetDetector(DRD_TIMEOUT, DRD_ADDRESS);  
       bool noConfigPortal = true;
-   
-      if (drd->detectDoubleReset())
+      
+#if USE_BOOT_TIMING
+      setBootPhase(bootTiming.begin);
+#endif
+      
+#if USE_FLASH_WRITE_STATS
+      beginFlashStats();
+#endif
+
+#if USE_TIME_SERVICE
+      beginTimeService();
+#endif
+      
+      // Waking up from deep sleep is not a user reset => skip DRD/MRD and its flash accesses
+      deepSleepWake = isDeepSleepWake();
+      
+      if (!deepSleepWake)
+#if RESET_DETECT_USE_RTC
+      // Count resets in RTC memory, or use DRD/MRD in flash
+      if (!detectResetRTC(noConfigPortal))
 #endif
       {
+#if USING_MRD
+        //// New MRD ////
+        mrd = new MultiResetDetector(MRD_TIMEOUT, MRD_ADDRESS);  
+     
+        if (mrd->detectMultiReset())
+#else      
+        //// New DRD ////
+        drd = new DoubleResetDetector(DRD_TIMEOUT, DRD_ADDRESS);  
+     
+        if (drd->detectDoubleReset())
+#endif
+        {
 #if ( BLYNK_WM_DEBUG > 1)
-        BLYNK_LOG1(BLYNK_F("Multi or Double Reset Detected"));
+          BLYNK_LOG1(BLYNK_F("Multi or Double Reset Detected"));
 #endif      
-        noConfigPortal = false;
+          noConfigPortal = false;
+        }
       }
       //// New DRD/MRD ////
       
+#if USE_BOOT_TIMING
+      setBootPhase(bootTiming.resetDetect);
+#endif
+      
 #if ( BLYNK_WM_DEBUG > 2)    
       if (LOAD_DEFAULT_CONFIG_DATA) 
       {   
@@ -436,28 +1031,71 @@ class BlynkWifi
 
       BLYNK_LOG2(BLYNK_F("Hostname="), RFC952_hostname);
       
-      hadConfigData = getConfigData();
+#if USE_EARLY_WIFI
+      // Associate while Config Data is loaded
+      beginEarlyWiFi();
+#endif
       
-      isForcedConfigPortal = isForcedCP();
+#if USE_RTC_CONFIG_CACHE
+      unsigned long loadStartTime = millis();
       
-      //// New DRD/MRD ////
-      //  noConfigPortal when getConfigData() OK and no MRD/DRD'ed
-      //if (getConfigData() && noConfigPortal)
-      if (hadConfigData && noConfigPortal && (!isForcedConfigPortal) )
+      if (deepSleepWake && loadConfigCache())
       {
-        hadConfigData = true;
+        configCacheLoaded = true;
+        hadConfigData     = true;
         
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG1(noConfigPortal? BLYNK_F("bg: noConfigPortal = true") : BLYNK_F("bg: noConfigPortal = false"));
-#endif        
+        // Time to load from storage at last cold boot, minus time to load from RTC
+        uint16_t cacheLoadTime = millis() - loadStartTime;
+        configCacheTimeSaved = (configCacheTimeSaved > cacheLoadTime) ? (configCacheTimeSaved - cacheLoadTime) : 0;
         
-        for (uint16_t i = 0; i < NUM_WIFI_CREDENTIALS; i++)
-        {
-          wifiMulti.addAP(Blynk8266_WM_config.WiFi_Creds[i].wifi_ssid, Blynk8266_WM_config.WiFi_Creds[i].wifi_pw);
-        }
-
-        if (connectMultiWiFi() == WL_CONNECTED)
-        {
+        BLYNK_LOG2(BLYNK_F("LoadCfgCacheRTC OK,saved(ms)="), configCacheTimeSaved);
+        displayConfigData(Blynk8266_WM_config);
+      }
+      else
+      {
+        hadConfigData = getConfigData();
+        storageReady  = true;
+        
+        configLoadTime = millis() - loadStartTime;
+      }
+#else
+      hadConfigData = getConfigData();
+#endif
+      
+#if USE_BOOT_TIMING
+      setBootPhase(bootTiming.config);
+#endif
+      
+      configDataLoaded = true;
+      
+      isForcedConfigPortal = isForcedCP();
+      
+#if USE_EARLY_WIFI
+      confirmEarlyWiFi(hadConfigData && noConfigPortal && !isForcedConfigPortal);
+#endif
+      
+      //// New DRD/MRD ////
+      //  noConfigPortal when getConfigData() OK and no MRD/DRD'ed
+      //if (getConfigData() && noConfigPortal)
+      if (hadConfigData && noConfigPortal && (!isForcedConfigPortal) )
+      {
+        hadConfigData = true;
+        
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG1(noConfigPortal? BLYNK_F("bg: noConfigPortal = true") : BLYNK_F("bg: noConfigPortal = false"));
+#endif        
+        
+        for (uint16_t i = 0; i < NUM_WIFI_CREDENTIALS; i++)
+        {
+          wifiMulti.addAP(Blynk8266_WM_config.WiFi_Creds[i].wifi_ssid, Blynk8266_WM_config.WiFi_Creds[i].wifi_pw);
+        }
+
+#if USE_ASYNC_CONNECT
+        // Don't block here. run() will connect, or start Config Portal as below
+        startConnect(true);
+#else
+        if (connectMultiWiFi() == WL_CONNECTED)
+        {
           BLYNK_LOG1(BLYNK_F("bg: WiFi OK. Try Blynk"));
 
           int i = 0;
@@ -468,20 +1106,25 @@ class BlynkWifi
           if  (connected())
           {
             BLYNK_LOG1(BLYNK_F("bg: WiFi+Blynk OK"));
+            
+#if USE_BOOT_TIMING
+            finishBootTiming();
+#endif
           }
           else
           {
             BLYNK_LOG1(BLYNK_F("bg: WiFi OK, Blynk not"));
             // failed to connect to Blynk server, will start configuration mode
-            startConfigurationMode();
+            startConfigurationModeOnFail();
           }
         }
         else
         {
           BLYNK_LOG1(BLYNK_F("bg: Fail2connect WiFi+Blynk"));
           // failed to connect to Blynk server, will start configuration mode
-          startConfigurationMode();
+          startConfigurationModeOnFail();
         }
+#endif
       }
       else
       { 
@@ -508,6 +1151,19 @@ class BlynkWifi
     }
     
     //////////////////////////////////////////////
+    
+    // Connection with valid Config Data failed in begin()
+    void startConfigurationModeOnFail()
+    {
+#if (USE_DUTY_CYCLE && DUTY_CYCLE_SLEEP_ON_FAIL)
+      // runDutyCycle() retries until its timeout, then sleeps
+      BLYNK_LOG1(BLYNK_F("bg: No CP in DutyCycle"));
+#else
+      startConfigurationMode();
+#endif
+    }
+    
+    //////////////////////////////////////////////
 
 #ifndef TIMEOUT_RECONNECT_WIFI
   #define TIMEOUT_RECONNECT_WIFI   10000L
@@ -547,6 +1203,26 @@ class BlynkWifi
     
     void run()
     {
+#if USE_RUN_TIME_CHECK
+      unsigned long runStartTime = millis();
+      
+  #if USE_ASYNC_CONNECT
+      runStartState = connectState;
+  #endif
+  
+      runStep();
+      
+      checkRunTime(millis() - runStartTime);
+#else
+      runStep();
+#endif
+    }
+    
+    //////////////////////////////////////////////
+    
+    // One pass of run(). Reset detectors, connection events, then one connection step if not connected
+    void runStep()
+    {
       static int retryTimes = 0;
       
 #if USING_MRD
@@ -555,7 +1231,8 @@ class BlynkWifi
       // so that it can recognise when the timeout expires.
       // You can also call mrd.stop() when you wish to no longer
       // consider the next reset as a multi reset.
-      mrd->loop();
+      if (mrd)
+        mrd->loop();
       //// New MRD ////
 #else      
       //// New DRD ////
@@ -563,10 +1240,25 @@ class BlynkWifi
       // so that it can recognise when the timeout expires.
       // You can also call drd.stop() when you wish to no longer
       // consider the next reset as a double reset.
-      drd->loop();
+      if (drd)
+        drd->loop();
       //// New DRD ////
 #endif
 
+#if RESET_DETECT_USE_RTC
+      checkResetDetectRTC();
+#endif
+
+      checkConnectionEvents();
+
+#if USE_TIME_SERVICE
+      checkTimeService();
+#endif
+      
+#if USE_DNS_CACHE
+      checkDNSCacheRefresh();
+#endif
+
       // Lost connection in running. Give chance to reconfig.
       if ( WiFi.status() != WL_CONNECTED || !connected() )
       {
@@ -585,6 +1277,26 @@ class BlynkWifi
         }
         else
         {
+#if USE_ASYNC_CONNECT
+          // Connection in progress, one step per run()
+          if (isConnecting())
+          {
+            connectStateMachine();
+            return;
+          }
+#endif
+
+#if USE_RECONNECT_BACKOFF
+          // First delay after connection lost, then wait for the scheduled attempt
+          if (!reconnectScheduled)
+          {
+            scheduleReconnect(WiFi.status() != WL_CONNECTED);
+          }
+          
+          if (!isReconnectDue())
+            return;
+#endif
+
 #if RESET_IF_CONFIG_TIMEOUT
           // If we're here but still in configuration_mode, permit running TIMES_BEFORE_RESET times before reset hardware
           // to permit user another chance to config.
@@ -601,6 +1313,11 @@ class BlynkWifi
           }
 #endif
 
+#if USE_ASYNC_CONNECT
+          BLYNK_LOG1(BLYNK_F("run: Lost connection. Reconnect"));
+          
+          startConnect(false);
+#else
           // Not in config mode, try reconnecting before forcing to config mode
           if ( WiFi.status() != WL_CONNECTED )
           {
@@ -630,6 +1347,14 @@ class BlynkWifi
             }
           }
 
+#if USE_RECONNECT_BACKOFF
+          if ( (WiFi.status() != WL_CONNECTED) || !connected() )
+          {
+            scheduleReconnect(WiFi.status() != WL_CONNECTED);
+          }
+#endif
+#endif
+
           //BLYNK_LOG1(BLYNK_F("run: Lost connection => configMode"));
           //startConfigurationMode();
         }
@@ -642,6 +1367,13 @@ class BlynkWifi
         digitalWrite(LED_BUILTIN, LED_OFF);
       }
 
+#if USE_RECONNECT_BACKOFF
+      if ( reconnectScheduled && (WiFi.status() == WL_CONNECTED) && connected() )
+      {
+        resetReconnectBackoff();
+      }
+#endif
+
       if (connected())
       {
         Base::run();
@@ -715,73 +1447,125 @@ class BlynkWifi
     }
     
     //////////////////////////////////////////////
-
-    String getWiFiSSID(uint8_t index)
+    
+    // Zero-copy accessors, pointing directly to stored Config Data. No String allocation.
+    // Optional length is set to the string length, without the terminating NULL
+    
+    const char* getWiFiSSIDPtr(uint8_t index, size_t* length = NULL)
     { 
       if (index >= NUM_WIFI_CREDENTIALS)
-        return String("");
+        return getConfigItem("", 0, length);
         
-      if (!hadConfigData)
-        getConfigData();
+      loadConfigDataOnce();
 
-      return (String(Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid));
+      return getConfigItem(Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid, sizeof(Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid), length);
     }
     
     //////////////////////////////////////////////
 
-    String getWiFiPW(uint8_t index)
+    const char* getWiFiPWPtr(uint8_t index, size_t* length = NULL)
     {
       if (index >= NUM_WIFI_CREDENTIALS)
-        return String("");
+        return getConfigItem("", 0, length);
         
-      if (!hadConfigData)
-        getConfigData();
+      loadConfigDataOnce();
 
-      return (String(Blynk8266_WM_config.WiFi_Creds[index].wifi_pw));
+      return getConfigItem(Blynk8266_WM_config.WiFi_Creds[index].wifi_pw, sizeof(Blynk8266_WM_config.WiFi_Creds[index].wifi_pw), length);
     }
     
     //////////////////////////////////////////////
 
-    String getServerName(uint8_t index)
+    const char* getServerNamePtr(uint8_t index, size_t* length = NULL)
     {
       if (index >= NUM_BLYNK_CREDENTIALS)
-        return String("");
+        return getConfigItem("", 0, length);
 
-      if (!hadConfigData)
-        getConfigData();
+      loadConfigDataOnce();
 
-      return (String(Blynk8266_WM_config.Blynk_Creds[index].blynk_server));
+      return getConfigItem(Blynk8266_WM_config.Blynk_Creds[index].blynk_server, sizeof(Blynk8266_WM_config.Blynk_Creds[index].blynk_server), length);
     }
     
     //////////////////////////////////////////////
 
-    String getToken(uint8_t index)
+    const char* getTokenPtr(uint8_t index, size_t* length = NULL)
     {
       if (index >= NUM_BLYNK_CREDENTIALS)
-        return String("");
+        return getConfigItem("", 0, length);
 
-      if (!hadConfigData)
-        getConfigData();
+      loadConfigDataOnce();
 
-      return (String(Blynk8266_WM_config.Blynk_Creds[index].blynk_token));
+      return getConfigItem(Blynk8266_WM_config.Blynk_Creds[index].blynk_token, sizeof(Blynk8266_WM_config.Blynk_Creds[index].blynk_token), length);
     }
     
     //////////////////////////////////////////////
 
-    String getBoardName()
+    const char* getBoardNamePtr(size_t* length = NULL)
+    {
+      loadConfigDataOnce();
+
+      return getConfigItem(Blynk8266_WM_config.board_name, sizeof(Blynk8266_WM_config.board_name), length);
+    }
+    
+    //////////////////////////////////////////////
+    
+#if USE_DYNAMIC_PARAMETERS
+    // Call visitor for each Dynamic Param, reading directly from myMenuItems[]
+    void forEachMenuItem(BlynkWM_MenuItemVisitor visitor, void* userData = NULL)
+    {
+      if (!visitor)
+        return;
+        
+      loadConfigDataOnce();
+      
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {
+        visitor(myMenuItems[i], strnlen(myMenuItems[i].pdata, myMenuItems[i].maxlen), userData);
+      }
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+    // String versions, kept for compatibility
+    
+    String getWiFiSSID(uint8_t index)
+    { 
+      return String(getWiFiSSIDPtr(index));
+    }
+    
+    //////////////////////////////////////////////
+
+    String getWiFiPW(uint8_t index)
+    {
+      return String(getWiFiPWPtr(index));
+    }
+    
+    //////////////////////////////////////////////
+
+    String getServerName(uint8_t index)
+    {
+      return String(getServerNamePtr(index));
+    }
+    
+    //////////////////////////////////////////////
+
+    String getToken(uint8_t index)
     {
-      if (!hadConfigData)
-        getConfigData();
+      return String(getTokenPtr(index));
+    }
+    
+    //////////////////////////////////////////////
 
-      return (String(Blynk8266_WM_config.board_name));
+    String getBoardName()
+    {
+      return String(getBoardNamePtr());
     }
     
     //////////////////////////////////////////////
 
     int getHWPort()
     {
-      if (!hadConfigData)
-        getConfigData();
+      loadConfigDataOnce();
 
       return (Blynk8266_WM_config.blynk_port);
     }
@@ -790,8 +1574,7 @@ class BlynkWifi
 
     Blynk_WM_Configuration* getFullConfigData(Blynk_WM_Configuration *configData)
     {
-      if (!hadConfigData)
-        getConfigData();
+      loadConfigDataOnce();
 
       // Check if NULL pointer
       if (configData)
@@ -804,6 +1587,10 @@ class BlynkWifi
 
     void clearConfigData()
     {
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
       memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
       saveConfigData();
     }
@@ -811,7 +1598,7 @@ class BlynkWifi
     //////////////////////////////////////////////
     
     // Forced CP => Flag = 0xBEEFBEEF. Else => No forced CP
-    // Flag to be stored at (EEPROM_START + DRD_FLAG_DATA_SIZE + CONFIG_DATA_SIZE) 
+    // Flag to be stored at EEPROM_FORCED_CP_START, in the EEPROM flags region
     // to avoid corruption to current data
     //#define FORCED_CONFIG_PORTAL_FLAG_DATA              ( (uint32_t) 0xDEADBEEF)
     //#define FORCED_PERS_CONFIG_PORTAL_FLAG_DATA         ( (uint32_t) 0xBEEFDEAD)
@@ -848,117 +1635,506 @@ class BlynkWifi
     
     //////////////////////////////////////
     
-    // Add customs headers from v1.3.0
+#if USE_FLASH_WRITE_STATS
+    // Flash wear statistics, kept in RTC memory
+    const BlynkWM_FlashStats& getFlashStats()
+    {
+      return flashStats;
+    }
     
-    // New from v1.2.0, for configure CORS Header, default to WM_HTTP_CORS_ALLOW_ALL = "*"
-
-#if USING_CUSTOMS_STYLE
-    //sets a custom style, such as color
-    // "<style>div,input{padding:5px;font-size:1em;}
-    // input{width:95%;}body{text-align: center;}
-    // button{background-color:#16A1E7;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;}
-    // fieldset{border-radius:0.3rem;margin:0px;}</style>";
-    void setCustomsStyle(const char* CustomsStyle = BLYNK_WM_HTML_HEAD_STYLE) 
+    //////////////////////////////////////////////
+    
+    void resetFlashStats()
     {
-      BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE = CustomsStyle;
-      BLYNK_LOG2(F("Set CustomsStyle to : "), BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE);
+      memset(&flashStats, 0, sizeof(flashStats));
+      saveRTCData(BLYNK_WM_RTC_FLASH_STATS_OFFSET, &flashStats, sizeof(flashStats));
     }
     
-    //////////////////////////////////////
+    //////////////////////////////////////////////
     
-    const char* getCustomsStyle()
+    void printFlashStats()
     {
-      BLYNK_LOG2(F("Get CustomsStyle = "), BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE);
-      return BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE;
+      BLYNK_LOG6(BLYNK_F("Flash:boots="), flashStats.bootCount, BLYNK_F(",writes="), flashStats.writeCount, 
+                 BLYNK_F(",bytes="), flashStats.writeBytes);
+      BLYNK_LOG4(BLYNK_F("Flash:erases="), flashStats.eraseCount, BLYNK_F(",bootWrites="), flashStats.bootWriteCount);
     }
 #endif
-
+    
     //////////////////////////////////////
-
-#if USING_CUSTOMS_HEAD_ELEMENT    
-    //sets a custom element to add to head, like a new style tag
-    void setCustomsHeadElement(const char* CustomsHeadElement = NULL) 
+    
+    // Connection events, raised from run(). Register before calling begin()
+    
+    void onConnected(BlynkWM_EventCallback callback)
     {
-      _CustomsHeadElement = CustomsHeadElement;
-      BLYNK_LOG2(F("Set CustomsHeadElement to : "), _CustomsHeadElement);
+      connectedCallback = callback;
     }
     
-    //////////////////////////////////////
+    //////////////////////////////////////////////
     
-    const char* getCustomsHeadElement()
+    void onDisconnected(BlynkWM_EventCallback callback)
     {
-      BLYNK_LOG2(F("Get CustomsHeadElement = "), _CustomsHeadElement);
-      return _CustomsHeadElement;
+      disconnectedCallback = callback;
     }
-#endif
-
-    //////////////////////////////////////
     
-#if USING_CORS_FEATURE   
-    void setCORSHeader(const char* CORSHeaders = NULL)
-    {     
-      _CORS_Header = CORSHeaders;
-
-      BLYNK_LOG2(F("Set CORS Header to : "), _CORS_Header);
-    }
+    //////////////////////////////////////////////
     
-    //////////////////////////////////////
+    // Raised when Config Portal is started
+    void onPortal(BlynkWM_EventCallback callback)
+    {
+      portalCallback = callback;
+    }
     
-    const char* getCORSHeader()
-    {      
-      BLYNK_LOG2(F("Get CORS Header = "), _CORS_Header);
-      return _CORS_Header;
+    //////////////////////////////////////////////
+
+#if USE_BLYNK_SERVER_PROBE
+    // Average TCP connect time to Blynk server in ms, 0 if unknown
+    uint16_t getServerLatency(uint8_t index)
+    {
+      return (index < NUM_BLYNK_CREDENTIALS) ? serverLatency[index] : 0;
     }
+    
+    //////////////////////////////////////////////
 #endif
-          
-    //////////////////////////////////////
-
-
-  private:
-    AsyncWebServer *server;
-    bool configuration_mode = false;
-
-    ESP8266WiFiMulti wifiMulti;
 
-    unsigned long configTimeout;
-    bool hadConfigData = false;
-    
-    bool isForcedConfigPortal   = false;
-    bool persForcedConfigPortal = false;
+#if USE_RECONNECT_BACKOFF
+    // millis() of next reconnect attempt in run(), 0 if none scheduled
+    unsigned long getNextReconnectTime()
+    {
+      return reconnectScheduled ? nextReconnectTime : 0;
+    }
     
-    // default to channel 1
-    int WiFiAPChannel = 1;
+    //////////////////////////////////////////////
+#endif
 
-    Blynk_WM_Configuration Blynk8266_WM_config;
+#if USE_BOOT_TIMING
+    const BlynkWM_BootTiming& getBootTiming()
+    {
+      return bootTiming;
+    }
     
-    uint16_t totalDataSize = 0;
-
-    // For Config Portal, from Blynk_WM v1.0.5
-    IPAddress portal_apIP = IPAddress(192, 168, 4, 1);
-
-    String portal_ssid = "";
-    String portal_pass = "";
-
-    // For static IP, from Blynk_WM v1.0.5
-    IPAddress static_IP   = IPAddress(0, 0, 0, 0);
-    IPAddress static_GW   = IPAddress(0, 0, 0, 0);
-    IPAddress static_SN   = IPAddress(255, 255, 255, 0);
-    IPAddress static_DNS1 = IPAddress(0, 0, 0, 0);
-    IPAddress static_DNS2 = IPAddress(0, 0, 0, 0);
-
-/////////////////////////////////////
+    //////////////////////////////////////////////
     
-    // Add customs headers from v1.2.0
+    void printBootTiming()
+    {
+      char line[160];
+      
+      formatBootTiming(line, sizeof(line));
+      
+      BLYNK_LOG2(BLYNK_F("Boot(ms):"), line);
+    }
     
-#if USING_CUSTOMS_STYLE
-    const char* BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE = NULL;
+    //////////////////////////////////////////////
 #endif
+
+#if USE_DUTY_CYCLE
+    // Keep a reading in RTC memory, to be sent by runDutyCycle() of this or a later cycle
+    void queueVirtualWrite(uint8_t pin, float value)
+    {
+      loadDutyCycle();
+      
+      if (dutyCycle.queueCount >= DUTY_CYCLE_QUEUE_SIZE)
+      {
+        memmove(&dutyCycle.queue[0], &dutyCycle.queue[1], (DUTY_CYCLE_QUEUE_SIZE - 1) * sizeof(BlynkWM_QueuedWrite));
+        dutyCycle.queueCount = DUTY_CYCLE_QUEUE_SIZE - 1;
+        dutyCycle.stats.dropCount++;
+      }
+      
+      dutyCycle.queue[dutyCycle.queueCount].pin   = pin;
+      dutyCycle.queue[dutyCycle.queueCount].value = value;
+      dutyCycle.queueCount++;
+      
+      saveRTCData(BLYNK_WM_RTC_DUTY_CYCLE_OFFSET, &dutyCycle, sizeof(dutyCycle));
+    }
     
-#if USING_CUSTOMS_HEAD_ELEMENT
-    const char* _CustomsHeadElement = NULL;
-#endif
+    //////////////////////////////////////////////
     
-#if USING_CORS_FEATURE    
+    // Call after begin(). Connect to Blynk, send queued readings, call writeCallback (if any) to write more with
+    // virtualWrite(), wait until Blynk server has acknowledged all writes, then deep sleep for sleepSeconds.
+    // Readings not acknowledged within timeout ms stay queued for next cycle.
+    // Returns only if Config Portal is running, then run() must be called in loop()
+    void runDutyCycle(uint32_t sleepSeconds, BlynkWM_EventCallback writeCallback = NULL, uint32_t timeout = DUTY_CYCLE_TIMEOUT)
+    {
+      unsigned long startTime = millis();
+      uint32_t firstWriteTime = 0;
+      bool acknowledged = false;
+      
+      loadDutyCycle();
+      
+      while ( !connected() && (millis() - startTime < timeout) )
+      {
+        run();
+        
+        if (configuration_mode)
+          return;
+        
+        delay(1);
+      }
+      
+      if (connected())
+      {
+        firstWriteTime = millis();
+        
+        for (uint8_t index = 0; index < dutyCycle.queueCount; index++)
+        {
+          Base::virtualWrite(dutyCycle.queue[index].pin, dutyCycle.queue[index].value);
+        }
+        
+        if (writeCallback)
+          writeCallback();
+        
+        acknowledged = waitDutyCycleAck(startTime, timeout);
+      }
+      
+      dutyCycle.stats.cycleCount++;
+      
+      if (acknowledged)
+        dutyCycle.queueCount = 0;
+      else
+        dutyCycle.stats.failCount++;
+      
+      dutyCycle.stats.timeToFirstWrite  = firstWriteTime;
+      dutyCycle.stats.awakeTime         = millis();
+      
+      saveRTCData(BLYNK_WM_RTC_DUTY_CYCLE_OFFSET, &dutyCycle, sizeof(dutyCycle));
+      
+      BLYNK_LOG6(BLYNK_F("DutyCycle#"), dutyCycle.stats.cycleCount, BLYNK_F(",firstWrite(ms)="), firstWriteTime, 
+                 BLYNK_F(",awake(ms)="), dutyCycle.stats.awakeTime);
+      BLYNK_LOG4(BLYNK_F("DutyCycle:ack="), acknowledged, BLYNK_F(",queued="), dutyCycle.queueCount);
+      
+      Base::disconnect();
+      
+#if USE_TIME_SERVICE
+      // Time at wake
+      saveTimeRTC(sleepSeconds);
+#endif
+      
+      stopResetDetect();
+      
+      BLYNK_WM_DEEP_SLEEP( (uint64_t) sleepSeconds * 1000000ULL );
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Statistics of the previous cycle until runDutyCycle() goes to sleep
+    const BlynkWM_DutyCycleStats& getDutyCycleStats()
+    {
+      loadDutyCycle();
+      
+      return dutyCycle.stats;
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_RUN_TIME_CHECK
+    // Longest run() in ms
+    uint32_t getMaxRunTime()
+    {
+      return maxRunTime;
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Number of run() longer than RUN_TIME_BUDGET ms
+    uint32_t getRunOverruns()
+    {
+      return runOverruns;
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_TIME_SERVICE
+    // Clock synced by SNTP, or set from RTC memory
+    bool isTimeValid()
+    {
+      return (time(nullptr) >= 100000);
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_ASYNC_CONNECT
+    BlynkWM_ConnectState getConnectState()
+    {
+      return connectState;
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+    // Add customs headers from v1.3.0
+    
+    // New from v1.2.0, for configure CORS Header, default to WM_HTTP_CORS_ALLOW_ALL = "*"
+
+#if USING_CUSTOMS_STYLE
+    //sets a custom style, such as color
+    // "<style>div,input{padding:5px;font-size:1em;}
+    // input{width:95%;}body{text-align: center;}
+    // button{background-color:#16A1E7;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;}
+    // fieldset{border-radius:0.3rem;margin:0px;}</style>";
+    void setCustomsStyle(const char* CustomsStyle = BLYNK_WM_HTML_HEAD_STYLE) 
+    {
+      BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE = CustomsStyle;
+      BLYNK_LOG2(F("Set CustomsStyle to : "), BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE);
+    }
+    
+    //////////////////////////////////////
+    
+    const char* getCustomsStyle()
+    {
+      BLYNK_LOG2(F("Get CustomsStyle = "), BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE);
+      return BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE;
+    }
+#endif
+
+    //////////////////////////////////////
+
+#if USING_CUSTOMS_HEAD_ELEMENT    
+    //sets a custom element to add to head, like a new style tag
+    void setCustomsHeadElement(const char* CustomsHeadElement = NULL) 
+    {
+      _CustomsHeadElement = CustomsHeadElement;
+      BLYNK_LOG2(F("Set CustomsHeadElement to : "), _CustomsHeadElement);
+    }
+    
+    //////////////////////////////////////
+    
+    const char* getCustomsHeadElement()
+    {
+      BLYNK_LOG2(F("Get CustomsHeadElement = "), _CustomsHeadElement);
+      return _CustomsHeadElement;
+    }
+#endif
+
+    //////////////////////////////////////
+    
+#if USING_CORS_FEATURE   
+    void setCORSHeader(const char* CORSHeaders = NULL)
+    {     
+      _CORS_Header = CORSHeaders;
+
+      BLYNK_LOG2(F("Set CORS Header to : "), _CORS_Header);
+    }
+    
+    //////////////////////////////////////
+    
+    const char* getCORSHeader()
+    {      
+      BLYNK_LOG2(F("Get CORS Header = "), _CORS_Header);
+      return _CORS_Header;
+    }
+#endif
+          
+    //////////////////////////////////////
+
+
+  private:
+    AsyncWebServer *server;
+    bool configuration_mode = false;
+
+    ESP8266WiFiMulti wifiMulti;
+
+    unsigned long configTimeout;
+    bool hadConfigData = false;
+    
+    bool isForcedConfigPortal   = false;
+    bool persForcedConfigPortal = false;
+    
+    BlynkWM_EventCallback connectedCallback     = NULL;
+    BlynkWM_EventCallback disconnectedCallback  = NULL;
+    BlynkWM_EventCallback portalCallback        = NULL;
+    
+    // WiFi and Blynk connected at last run()
+    bool lastConnected = false;
+    
+#if USE_TIME_SERVICE
+    bool          timeSaved     = false;
+    unsigned long timeSaveTime  = 0;
+#endif
+    
+#if USE_RUN_TIME_CHECK
+    uint32_t maxRunTime   = 0;
+    uint32_t runOverruns  = 0;
+    
+  #if USE_ASYNC_CONNECT
+    BlynkWM_ConnectState runStartState = BLYNK_WM_STATE_IDLE;
+  #endif
+#endif
+    
+#if USE_DUTY_CYCLE
+    BlynkWM_DutyCycle_RTC dutyCycle;
+    bool dutyCycleLoaded = false;
+#endif
+    
+#if USE_BOOT_TIMING
+    BlynkWM_BootTiming bootTiming = {};
+    bool bootTimingDone = false;
+#endif
+    
+#if USE_RECONNECT_BACKOFF
+    // Current backoff of each layer, 0 after connected
+    uint32_t reconnectWiFiBackoff   = 0;
+    uint32_t reconnectBlynkBackoff  = 0;
+    
+    // millis() of next reconnect attempt in run()
+    unsigned long nextReconnectTime = 0;
+    bool reconnectScheduled         = false;
+#endif
+    
+#if USE_WIFI_AP_CACHE
+    BlynkWM_APCache apCache;
+    bool apCacheLoaded  = false;
+    bool apCacheValid   = false;
+    
+  #if USE_EARLY_WIFI
+    // WiFi Credentials of cached AP in RTC memory
+    bool earlyWiFiSaved   = false;
+    
+    // Connection to cached AP started by begin(), before Config Data was loaded
+    bool earlyWiFiStarted = false;
+  #endif
+    
+  #if USE_ASYNC_CONNECT
+    // Cached AP tried once per connection, before all WiFi Credentials
+    bool connectAPCacheTried  = false;
+    bool connectUsingAPCache  = false;
+  #endif
+#endif
+    
+#if USE_DHCP_LEASE_CACHE
+    BlynkWM_DHCPLease dhcpLease;
+    bool dhcpLeaseLoaded  = false;
+    bool dhcpLeaseValid   = false;
+    
+    // Cached lease set as static IP for current connection
+    bool dhcpLeaseApplied = false;
+#endif
+    
+#if USE_WIFI_SCAN_RANK
+    BlynkWM_WiFiHistory   wifiHistory;
+    bool wifiHistoryLoaded  = false;
+    
+    BlynkWM_WiFiScanEntry wifiScan[NUM_WIFI_CREDENTIALS];
+    unsigned long wifiScanTime  = 0;
+    bool wifiScanValid          = false;
+    
+    // WiFi_Creds indexes, best ranked first
+    uint8_t wifiOrder[NUM_WIFI_CREDENTIALS];
+#endif
+    
+#if USE_ASYNC_CONNECT
+    BlynkWM_ConnectState connectState = BLYNK_WM_STATE_IDLE;
+    
+    // millis() when connectState was entered
+    unsigned long connectStateTime  = 0;
+    
+    uint8_t connectWiFiIndex        = 0;
+    uint8_t connectBlynkIndex       = 0;
+    
+    // Failed rounds over all Blynk servers, when started by begin()
+    uint8_t connectRounds           = 0;
+    bool    connectFromBegin        = false;
+    
+    // Set by dnsFoundCallback(), which may run in another task : 0 => pending, 1 => resolved, -1 => failed
+    volatile int8_t dnsResult       = 0;
+    IPAddress       dnsIP;
+    const char*     dnsHost         = NULL;
+#endif
+
+#if USE_DNS_CACHE
+    BlynkWM_DNSCache dnsCache;
+    bool dnsCacheLoaded = false;
+    
+    // millis() of last resolution since this boot, 0 if none
+    unsigned long dnsCacheResolveTime[NUM_BLYNK_CREDENTIALS] = {};
+    
+    // Set by dnsCacheFoundCallback(), which may run in another task
+    volatile uint32_t dnsRefreshIP[NUM_BLYNK_CREDENTIALS]   = {};
+    volatile bool     dnsRefreshDone[NUM_BLYNK_CREDENTIALS] = {};
+    
+  #if USE_ASYNC_CONNECT
+    bool connectUsingCachedIP = false;
+  #endif
+#endif
+
+#if USE_BLYNK_SERVER_PROBE
+    BlynkWM_ServerProbe serverProbes[NUM_BLYNK_CREDENTIALS] = {};
+    
+    // Average connect time in ms, 0 if unknown
+    uint16_t      serverLatency[NUM_BLYNK_CREDENTIALS]      = {};
+    
+    // Indexes in Blynk_Creds, fastest first
+    uint8_t       serverOrder[NUM_BLYNK_CREDENTIALS]        = {};
+    
+    // Bit mask of started probes
+    uint32_t      serverProbeStarted    = 0;
+    unsigned long serverProbeStartTime  = 0;
+#endif
+    
+    // Config Data already loaded by begin() or an accessor
+    bool configDataLoaded = false;
+
+#if USE_FLASH_WRITE_STATS
+    BlynkWM_FlashStats flashStats;
+#endif
+
+#if RESET_DETECT_USE_RTC
+    BlynkWM_ResetDetect_RTC resetDetectRTC;
+    
+    // Waiting for RESET_DETECT_TIMEOUT after boot
+    bool resetDetectActive = false;
+#endif
+
+    bool deepSleepWake      = false;
+    
+#if USE_RTC_CONFIG_CACHE
+    bool configCacheLoaded  = false;
+    bool storageReady       = false;
+    
+    // ms saved by loading Config Data from RTC cache instead of storage
+    uint16_t configCacheTimeSaved = 0;
+    
+    // ms used to load Config Data from storage at this boot
+    uint16_t configLoadTime       = 0;
+    
+    // Index in Blynk_Creds of the connected Blynk server
+    uint8_t connectedBlynkIndex   = 0;
+#endif
+    
+    // default to channel 1
+    int WiFiAPChannel = 1;
+
+    Blynk_WM_Configuration Blynk8266_WM_config;
+    
+    uint16_t totalDataSize = 0;
+
+    // For Config Portal, from Blynk_WM v1.0.5
+    IPAddress portal_apIP = IPAddress(192, 168, 4, 1);
+
+    String portal_ssid = "";
+    String portal_pass = "";
+
+    // For static IP, from Blynk_WM v1.0.5
+    IPAddress static_IP   = IPAddress(0, 0, 0, 0);
+    IPAddress static_GW   = IPAddress(0, 0, 0, 0);
+    IPAddress static_SN   = IPAddress(255, 255, 255, 0);
+    IPAddress static_DNS1 = IPAddress(0, 0, 0, 0);
+    IPAddress static_DNS2 = IPAddress(0, 0, 0, 0);
+
+/////////////////////////////////////
+    
+    // Add customs headers from v1.2.0
+    
+#if USING_CUSTOMS_STYLE
+    const char* BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE = NULL;
+#endif
+    
+#if USING_CUSTOMS_HEAD_ELEMENT
+    const char* _CustomsHeadElement = NULL;
+#endif
+    
+#if USING_CORS_FEATURE    
     const char* _CORS_Header        = WM_HTTP_CORS_ALLOW_ALL;   //"*";
 #endif
        
@@ -1020,429 +2196,536 @@ class BlynkWifi
     
     //////////////////////////////////////
 
-    int calcChecksum()
+    bool isDeepSleepWake()
     {
-      int checkSum = 0;
-      for (uint16_t index = 0; index < (sizeof(Blynk8266_WM_config) - sizeof(Blynk8266_WM_config.checkSum)); index++)
-      {
-        checkSum += * ( ( (byte*) &Blynk8266_WM_config ) + index);
-      }
-
-      return checkSum;
+      return (ESP.getResetInfoPtr()->reason == REASON_DEEP_SLEEP_AWAKE);
     }
     
     //////////////////////////////////////
-
-#if ( USE_LITTLEFS || USE_SPIFFS )
-
-#define  CONFIG_FILENAME                  BLYNK_F("/wm_config.dat")
-#define  CONFIG_FILENAME_BACKUP           BLYNK_F("/wm_config.bak")
-
-#define  CREDENTIALS_FILENAME             BLYNK_F("/wm_cred.dat")
-#define  CREDENTIALS_FILENAME_BACKUP      BLYNK_F("/wm_cred.bak")
-
-#define  CONFIG_PORTAL_FILENAME           BLYNK_F("/wm_cp.dat")
-#define  CONFIG_PORTAL_FILENAME_BACKUP    BLYNK_F("/wm_cp.bak")
-
-    //////////////////////////////////////////////
     
-    void saveForcedCP(uint32_t value)
+    // offset and size in bytes, offset must be multiple of 4
+    void RTC_writeBytes(uint16_t offset, const void* data, uint16_t size)
     {
-      File file = FileFS.open(CONFIG_PORTAL_FILENAME, "w");
+      // Use aligned buffer as data may be not 4-byte aligned
+      uint32_t        buffer[8];
+      const uint8_t*  _pointer = (const uint8_t*) data;
       
-      BLYNK_LOG1(BLYNK_F("SaveCPFile "));
-
-      if (file)
+      while (size > 0)
       {
-        file.write((uint8_t*) &value, sizeof(value));
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));
+        uint16_t len = (size > sizeof(buffer)) ? sizeof(buffer) : size;
+        
+        memset(buffer, 0, sizeof(buffer));
+        memcpy(buffer, _pointer, len);
+        ESP.rtcUserMemoryWrite(BLYNK_WM_RTC_OFFSET + (offset / 4), buffer, (len + 3) & ~3);
+        
+        offset    += len;
+        _pointer  += len;
+        size      -= len;
       }
-      else
+    }
+    
+    //////////////////////////////////////
+    
+    void RTC_readBytes(uint16_t offset, void* data, uint16_t size)
+    {
+      uint32_t  buffer[8];
+      uint8_t*  _pointer = (uint8_t*) data;
+      
+      while (size > 0)
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
+        uint16_t len = (size > sizeof(buffer)) ? sizeof(buffer) : size;
+        
+        ESP.rtcUserMemoryRead(BLYNK_WM_RTC_OFFSET + (offset / 4), buffer, (len + 3) & ~3);
+        memcpy(_pointer, buffer, len);
+        
+        offset    += len;
+        _pointer  += len;
+        size      -= len;
       }
+    }
+    
+    //////////////////////////////////////
 
-      // Trying open redundant CP file
-      file = FileFS.open(CONFIG_PORTAL_FILENAME_BACKUP, "w");
+    uint32_t calcCRC32(const void* data, size_t length)
+    {
+      const uint8_t* _pointer = (const uint8_t*) data;
+      uint32_t crc = 0xFFFFFFFF;
       
-      BLYNK_LOG1(BLYNK_F("SaveBkUpCPFile "));
-
-      if (file)
+      while (length--)
       {
-        file.write((uint8_t *) &value, sizeof(value));
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));
+        crc ^= *_pointer++;
+        
+        for (uint8_t i = 0; i < 8; i++)
+        {
+          crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
       }
-      else
+      
+      return ~crc;
+    }
+    
+    //////////////////////////////////////
+    
+    // Store a record (header + data) in RTC memory. offset in bytes, must be multiple of 4
+    bool saveRTCData(uint16_t offset, const void* data, uint16_t size)
+    {
+      BlynkWM_RTC_Header header = { BLYNK_WM_RTC_MAGIC | size, calcCRC32(data, size) };
+      
+      if (offset + sizeof(header) + size > BLYNK_WM_RTC_SIZE)
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
+        BLYNK_LOG2(BLYNK_F("RTC overflow,offset="), offset);
+        return false;
       }
+      
+      RTC_writeBytes(offset + sizeof(header), data, size);
+      RTC_writeBytes(offset, &header, sizeof(header));
+      
+      return true;
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
     
-    void setForcedCP(bool isPersistent)
+    // Return false if record invalid (e.g. after power loss). Then data contents are undefined
+    bool loadRTCData(uint16_t offset, void* data, uint16_t size)
     {
-      uint32_t readForcedConfigPortalFlag = isPersistent? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
-
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(isPersistent ? BLYNK_F("setForcedCP Persistent") : BLYNK_F("setForcedCP non-Persistent"));
-#endif
+      BlynkWM_RTC_Header header;
       
-      saveForcedCP(readForcedConfigPortalFlag);
+      if (offset + sizeof(header) + size > BLYNK_WM_RTC_SIZE)
+        return false;
+      
+      RTC_readBytes(offset, &header, sizeof(header));
+      
+      if (header.magic != (BLYNK_WM_RTC_MAGIC | size))
+        return false;
+      
+      RTC_readBytes(offset + sizeof(header), data, size);
+      
+      return (calcCRC32(data, size) == header.crc);
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
     
-    void clearForcedCP()
+    void invalidateRTCData(uint16_t offset)
     {
-      uint32_t readForcedConfigPortalFlag = 0;
-
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(BLYNK_F("clearForcedCP"));
-#endif
+      BlynkWM_RTC_Header header = { 0, 0 };
       
-      saveForcedCP(readForcedConfigPortalFlag);
+      if (offset + sizeof(header) <= BLYNK_WM_RTC_SIZE)
+        RTC_writeBytes(offset, &header, sizeof(header));
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
 
-    bool isForcedCP()
-    {
-      uint32_t readForcedConfigPortalFlag;
+#if USE_DYNAMIC_PARAMETERS
 
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(BLYNK_F("Check if isForcedCP"));
-#endif
+    // Max size of TLV data, when all items use full maxlen
+    uint16_t TLV_getMaxDataSize()
+    {
+      uint16_t dataSize = sizeof(BlynkWM_TLV_Header) + sizeof(uint32_t);
       
-      File file = FileFS.open(CONFIG_PORTAL_FILENAME, "r");
-      BLYNK_LOG1(BLYNK_F("LoadCPFile "));
-
-      if (!file)
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
-
-        // Trying open redundant config file
-        file = FileFS.open(CONFIG_PORTAL_FILENAME_BACKUP, "r");
-        BLYNK_LOG1(BLYNK_F("LoadBkUpCPFile "));
-
-        if (!file)
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-          return false;
-        }
-       }
-
-      file.readBytes((char *) &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
-
-      BLYNK_LOG1(BLYNK_F("OK"));
-      file.close();
-      
-      // Return true if forced CP (0xDEADBEEF read at offset EPROM_START + DRD_FLAG_DATA_SIZE + CONFIG_DATA_SIZE)
-      // => set flag noForcedConfigPortal = false     
-      if (readForcedConfigPortalFlag == FORCED_CONFIG_PORTAL_FLAG_DATA)
-      {       
-        persForcedConfigPortal = false;
-        return true;
+        dataSize += 2 + strnlen(myMenuItems[i].id, MAX_ID_LEN) + myMenuItems[i].maxlen;
       }
-      else if (readForcedConfigPortalFlag == FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
-      {       
-        persForcedConfigPortal = true;
-        return true;
+      
+      return dataSize;
+    }
+    
+    //////////////////////////////////////
+    
+    // Serialize myMenuItems[] into buffer, which must be at least TLV_getMaxDataSize(). Return data size
+    uint16_t TLV_serialize(uint8_t* buffer)
+    {
+      BlynkWM_TLV_Header header;
+      uint8_t* _pointer = buffer + sizeof(header);
+      
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {
+        uint8_t idLen     = strnlen(myMenuItems[i].id, MAX_ID_LEN);
+        uint8_t valueLen  = strnlen(myMenuItems[i].pdata, myMenuItems[i].maxlen);
+        
+        *_pointer++ = idLen;
+        memcpy(_pointer, myMenuItems[i].id, idLen);
+        _pointer += idLen;
+        
+        *_pointer++ = valueLen;
+        memcpy(_pointer, myMenuItems[i].pdata, valueLen);
+        _pointer += valueLen;
       }
-      else
-      {       
+      
+      header.magic      = BLYNK_WM_TLV_MAGIC;
+      header.version    = BLYNK_WM_TLV_VERSION;
+      header.numItems   = NUM_MENU_ITEMS;
+      header.payloadLen = _pointer - buffer - sizeof(header);
+      
+      memcpy(buffer, &header, sizeof(header));
+      
+      uint32_t crc = calcCRC32(buffer, _pointer - buffer);
+      memcpy(_pointer, &crc, sizeof(crc));
+      _pointer += sizeof(crc);
+      
+      return _pointer - buffer;
+    }
+    
+    //////////////////////////////////////
+    
+    // Return true if buffer starts with a TLV header. Then dataSize is the total size including header and CRC32
+    bool TLV_checkHeader(const uint8_t* buffer, uint16_t& dataSize)
+    {
+      BlynkWM_TLV_Header header;
+      
+      memcpy(&header, buffer, sizeof(header));
+      
+      if ( (header.magic != BLYNK_WM_TLV_MAGIC) || (header.version > BLYNK_WM_TLV_VERSION) )
         return false;
-      }
+        
+      dataSize = sizeof(header) + header.payloadLen + sizeof(uint32_t);
+      
+      return true;
     }
     
-    //////////////////////////////////////////////
-
-#if USE_DYNAMIC_PARAMETERS
-
-    bool checkDynamicData()
+    //////////////////////////////////////
+    
+    // Validate then load TLV data into myMenuItems[]. Unknown ids are skipped, missing ids keep their current values,
+    // and values longer than maxlen are truncated. myMenuItems[] is untouched if data is invalid
+    bool TLV_deserialize(const uint8_t* buffer, uint16_t bufferLen)
     {
-      int checkSum = 0;
-      int readCheckSum;
-      char* readBuffer;
-           
-      File file = FileFS.open(CREDENTIALS_FILENAME, "r");
-      BLYNK_LOG1(BLYNK_F("LoadCredFile "));
-
-      if (!file)
+      uint16_t  dataSize;
+      uint32_t  crc;
+      
+      if ( (bufferLen < sizeof(BlynkWM_TLV_Header) + sizeof(crc)) || !TLV_checkHeader(buffer, dataSize) || (dataSize > bufferLen) )
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
-
-        // Trying open redundant config file
-        file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "r");
-        BLYNK_LOG1(BLYNK_F("LoadBkUpCredFile "));
-
-        if (!file)
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-          return false;
-        }
+        BLYNK_LOG1(BLYNK_F("TLV: Invalid header"));
+        return false;
       }
       
-      // Find the longest pdata, then dynamically allocate buffer. Remember to free when done
-      // This is used to store tempo data to calculate checksum to see of data is valid
-      // We dont like to destroy myMenuItems[i].pdata with invalid data
+      memcpy(&crc, buffer + dataSize - sizeof(crc), sizeof(crc));
       
-      uint16_t maxBufferLength = 0;
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        if (myMenuItems[i].maxlen > maxBufferLength)
-          maxBufferLength = myMenuItems[i].maxlen;
+      if (crc != calcCRC32(buffer, dataSize - sizeof(crc)))
+      {
+        BLYNK_LOG1(BLYNK_F("TLV: Invalid CRC"));
+        return false;
       }
       
-      if (maxBufferLength > 0)
+      const uint8_t* _pointer = buffer + sizeof(BlynkWM_TLV_Header);
+      const uint8_t* _end     = buffer + dataSize - sizeof(crc);
+      uint16_t numFound       = 0;
+      uint16_t numUnknown     = 0;
+      
+      while (_pointer < _end)
       {
-        readBuffer = new char[ maxBufferLength + 1 ];
+        uint8_t idLen = *_pointer++;
         
-        // check to see NULL => stop and return false
-        if (readBuffer == NULL)
-        {
-          BLYNK_LOG1(BLYNK_F("ChkCrR: Error can't allocate buffer."));
-          return false;
-        }
-#if ( BLYNK_WM_DEBUG > 2)          
-        else
+        if (_pointer + idLen + 1 > _end)
+          break;
+          
+        const char* id = (const char*) _pointer;
+        _pointer += idLen;
+        
+        uint8_t valueLen = *_pointer++;
+        
+        if (_pointer + valueLen > _end)
+          break;
+        
+        uint16_t i;
+        
+        for (i = 0; i < NUM_MENU_ITEMS; i++)
         {
-          BLYNK_LOG2(BLYNK_F("ChkCrR: Buffer allocated, sz="), maxBufferLength + 1);
+          if ( (strnlen(myMenuItems[i].id, MAX_ID_LEN) == idLen) && (memcmp(myMenuItems[i].id, id, idLen) == 0) )
+          {
+            // Actual size of pdata is [maxlen + 1]
+            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+            memcpy(myMenuItems[i].pdata, _pointer, (valueLen < myMenuItems[i].maxlen) ? valueLen : myMenuItems[i].maxlen);
+            
+#if ( BLYNK_WM_DEBUG > 2)        
+            BLYNK_LOG4(F("TLV:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
+#endif   
+            numFound++;
+            break;
+          }
         }
-#endif             
-      }
-     
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = readBuffer;
-
-        // Actual size of pdata is [maxlen + 1]
-        memset(readBuffer, 0, myMenuItems[i].maxlen + 1);
         
-        file.readBytes(_pointer, myMenuItems[i].maxlen);
-
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG4(F("ChkCrR:pdata="), readBuffer, F(",len="), myMenuItems[i].maxlen);
-#endif          
-               
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
-        {         
-          checkSum += *_pointer;  
-        }       
+        if (i == NUM_MENU_ITEMS)
+          numUnknown++;
+        
+        _pointer += valueLen;
       }
-
-      file.readBytes((char *) &readCheckSum, sizeof(readCheckSum));
       
-      BLYNK_LOG1(BLYNK_F("OK"));
-      file.close();
+      BLYNK_LOG6(BLYNK_F("TLV: Found="), numFound, BLYNK_F(",Unknown="), numUnknown, BLYNK_F(",Missing="), NUM_MENU_ITEMS - numFound);
       
-      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+      return true;
+    }
+    
+#endif
+
+    //////////////////////////////////////
+
+#if USE_RTC_CONFIG_CACHE
+
+#if USE_DYNAMIC_PARAMETERS
+
+    // Dynamic Params too large for the Config cache are loaded from storage, and must be the ones cached with it
+    bool loadCachedDynamicData(uint32_t dynamicDataCRC)
+    {
+      beginStorage();
       
-      // Free buffer
-      if (readBuffer != NULL)
+#if ( USE_NVS || USE_LITTLEFS || USE_SPIFFS )
+      if (!loadDynamicData())
+#else
+      if (!EEPROM_getDynamicData())
+#endif
       {
-        free(readBuffer);
-        BLYNK_LOG1(BLYNK_F("Buffer freed"));
+        return false;
       }
       
-      if ( checkSum != readCheckSum)
-      {
+      uint8_t* dataBuffer = new uint8_t[TLV_getMaxDataSize()];
+      
+      if (dataBuffer == NULL)
         return false;
-      }
+        
+      bool result = ( calcCRC32(dataBuffer, TLV_serialize(dataBuffer)) == dynamicDataCRC );
       
-      return true;    
+      delete [] dataBuffer;
+      
+      return result;
     }
     
     //////////////////////////////////////
+    
+#endif
 
-    bool loadDynamicData()
+    // Called when connected, with Config Data loaded from storage
+    void saveConfigCache()
     {
-      int checkSum = 0;
-      int readCheckSum;
-      totalDataSize = sizeof(Blynk8266_WM_config) + sizeof(readCheckSum);
+      BlynkWM_ConfigCache cache;
       
-      File file = FileFS.open(CREDENTIALS_FILENAME, "r");
-      BLYNK_LOG1(BLYNK_F("LoadCredFile "));
-
-      if (!file)
-      {
-        BLYNK_LOG1(BLYNK_F("failed"));
-
-        // Trying open redundant config file
-        file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "r");
-        BLYNK_LOG1(BLYNK_F("LoadBkUpCredFile "));
-
-        if (!file)
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-          return false;
-        }
-      }
-     
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = myMenuItems[i].pdata;
-        totalDataSize += myMenuItems[i].maxlen;
-
-        // Actual size of pdata is [maxlen + 1]
-        memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+      memset(&cache, 0, sizeof(cache));
+      
+      cache.wifiIndex   = getWiFiCredsIndex(WiFi.SSID().c_str());
+      cache.blynkIndex  = connectedBlynkIndex;
+      
+      if ( (cache.wifiIndex >= NUM_WIFI_CREDENTIALS) || (cache.blynkIndex >= NUM_BLYNK_CREDENTIALS) )
+        return;
+      
+      cache.buildId     = calcCRC32(BLYNK_WM_BUILD_ID, strlen(BLYNK_WM_BUILD_ID));
+      cache.loadTime    = configLoadTime;
+      cache.blynk_port  = Blynk8266_WM_config.blynk_port;
+      
+      memcpy(&cache.WiFi_Creds,  &Blynk8266_WM_config.WiFi_Creds[cache.wifiIndex],   sizeof(cache.WiFi_Creds));
+      memcpy(&cache.Blynk_Creds, &Blynk8266_WM_config.Blynk_Creds[cache.blynkIndex], sizeof(cache.Blynk_Creds));
+      
+#if USE_DYNAMIC_PARAMETERS
+      uint8_t* cacheBuffer = new uint8_t[sizeof(cache) + TLV_getMaxDataSize()];
+      
+      if (cacheBuffer == NULL)
+        return;
         
-        file.readBytes(_pointer, myMenuItems[i].maxlen);
-
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG4(F("CrR:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
-#endif          
-               
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
-        {         
-          checkSum += *_pointer;  
-        }       
-      }
-
-      file.readBytes((char *) &readCheckSum, sizeof(readCheckSum));
+      uint16_t dynamicDataSize = TLV_serialize(cacheBuffer + sizeof(cache));
       
-      BLYNK_LOG1(BLYNK_F("OK"));
-      file.close();
+      cache.dynamicDataCRC = calcCRC32(cacheBuffer + sizeof(cache), dynamicDataSize);
       
-      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+      if (dynamicDataSize <= BLYNK_WM_RTC_FREE_SIZE)
+      {
+        cache.dynamicDataSize = dynamicDataSize;
+      }
       
-      if ( checkSum != readCheckSum)
+      memcpy(cacheBuffer, &cache, sizeof(cache));
+#else
+      uint8_t* cacheBuffer = (uint8_t*) &cache;
+#endif
+      
+      if (saveRTCData(BLYNK_WM_RTC_CONFIG_CACHE_OFFSET, cacheBuffer, sizeof(cache) + cache.dynamicDataSize))
       {
-        return false;
+#if ( BLYNK_WM_DEBUG > 2)
+        BLYNK_LOG4(BLYNK_F("SaveCfgCacheRTC OK,loadTime="), configLoadTime, BLYNK_F(",dynData="), cache.dynamicDataSize);
+#endif
       }
       
-      return true;    
+#if USE_DYNAMIC_PARAMETERS
+      delete [] cacheBuffer;
+#endif
     }
     
     //////////////////////////////////////
-
-    void saveDynamicData()
-    {
-      int checkSum = 0;
     
-      File file = FileFS.open(CREDENTIALS_FILENAME, "w");
-      BLYNK_LOG1(BLYNK_F("SaveCredFile "));
-
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = myMenuItems[i].pdata;
-
-#if ( BLYNK_WM_DEBUG > 2)          
-        BLYNK_LOG4(F("CW1:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
-#endif
-        
-        if (file)
-        {
-          file.write((uint8_t*) _pointer, myMenuItems[i].maxlen);         
-        }
-        else
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-        }        
-                     
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
-        {         
-          checkSum += *_pointer;     
-         }
-      }
+    // Other Credentials are left empty in Config Data, until beginStorage() loads it again from storage
+    bool loadConfigCache()
+    {
+      BlynkWM_RTC_Header  rtcHeader;
+      BlynkWM_ConfigCache cache;
+      bool result = false;
       
-      if (file)
+      RTC_readBytes(BLYNK_WM_RTC_CONFIG_CACHE_OFFSET, &rtcHeader, sizeof(rtcHeader));
+      
+      uint16_t cacheSize = rtcHeader.magic & 0xFFFF;
+      
+      if ( ( (rtcHeader.magic & 0xFFFF0000) != BLYNK_WM_RTC_MAGIC ) || (cacheSize < sizeof(cache)) ||
+           (cacheSize > sizeof(cache) + BLYNK_WM_RTC_FREE_SIZE) )
       {
-        file.write((uint8_t*) &checkSum, sizeof(checkSum));     
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));    
+        return false;
       }
-      else
-      {
-        BLYNK_LOG1(BLYNK_F("failed"));
-      }   
-           
-      BLYNK_LOG2(F("CrWCSum=0x"), String(checkSum, HEX));
       
-      // Trying open redundant Auth file
-      file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "w");
-      BLYNK_LOG1(BLYNK_F("SaveBkUpCredFile "));
-
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = myMenuItems[i].pdata;
-
-#if ( BLYNK_WM_DEBUG > 2)         
-        BLYNK_LOG4(F("CW2:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
-#endif
+      uint8_t* cacheBuffer = new uint8_t[cacheSize];
+      
+      if (cacheBuffer == NULL)
+        return false;
+      
+      if (loadRTCData(BLYNK_WM_RTC_CONFIG_CACHE_OFFSET, cacheBuffer, cacheSize))
+      {
+        memcpy(&cache, cacheBuffer, sizeof(cache));
         
-        if (file)
+        if ( (cache.buildId == calcCRC32(BLYNK_WM_BUILD_ID, strlen(BLYNK_WM_BUILD_ID))) && 
+             (cacheSize == sizeof(cache) + cache.dynamicDataSize) &&
+             (cache.wifiIndex < NUM_WIFI_CREDENTIALS) && (cache.blynkIndex < NUM_BLYNK_CREDENTIALS) )
         {
-          file.write((uint8_t*) _pointer, myMenuItems[i].maxlen);         
+#if USE_DYNAMIC_PARAMETERS
+          if (cache.dynamicDataSize)
+            result = TLV_deserialize(cacheBuffer + sizeof(cache), cache.dynamicDataSize);
+          else
+            result = loadCachedDynamicData(cache.dynamicDataCRC);
+#else
+          result = true;
+#endif
+          
+          if (result)
+          {
+            memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
+            strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+            
+            memcpy(&Blynk8266_WM_config.WiFi_Creds[cache.wifiIndex],   &cache.WiFi_Creds,  sizeof(cache.WiFi_Creds));
+            memcpy(&Blynk8266_WM_config.Blynk_Creds[cache.blynkIndex], &cache.Blynk_Creds, sizeof(cache.Blynk_Creds));
+            Blynk8266_WM_config.blynk_port = cache.blynk_port;
+            
+            connectedBlynkIndex   = cache.blynkIndex;
+            configCacheTimeSaved  = cache.loadTime;
+          }
         }
-        else
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-        }        
-                     
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
-        {         
-          checkSum += *_pointer;     
-         }
       }
       
-      if (file)
-      {
-        file.write((uint8_t*) &checkSum, sizeof(checkSum));     
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));    
-      }
-      else
-      {
-        BLYNK_LOG1(BLYNK_F("failed"));
-      }   
+      delete [] cacheBuffer;
+      
+      return result;
     }
+    
 #endif
 
+    //////////////////////////////////////
+    
+    // Config Data is going to be changed in storage
+    void invalidateConfigCache()
+    {
+#if USE_RTC_CONFIG_CACHE
+      invalidateRTCData(BLYNK_WM_RTC_CONFIG_CACHE_OFFSET);
+#endif
+    }
+    
     //////////////////////////////////////
 
-    void loadConfigData()
+    // Account a flash write of size bytes, needing eraseCount sector / block erases
+    void countFlashWrite(uint32_t size, uint32_t eraseCount)
     {
-      File file = FileFS.open(CONFIG_FILENAME, "r");
-      BLYNK_LOG1(BLYNK_F("LoadCfgFile "));
+#if USE_FLASH_WRITE_STATS
+      flashStats.writeCount++;
+      flashStats.writeBytes     += size;
+      flashStats.eraseCount     += eraseCount;
+      flashStats.bootWriteCount++;
+      flashStats.bootWriteBytes += size;
+      flashStats.bootEraseCount += eraseCount;
+      
+      saveRTCData(BLYNK_WM_RTC_FLASH_STATS_OFFSET, &flashStats, sizeof(flashStats));
 
-      if (!file)
+#if ( BLYNK_WM_DEBUG > 2)
+      BLYNK_LOG4(BLYNK_F("Flash write,sz="), size, BLYNK_F(",bootWrites="), flashStats.bootWriteCount);
+#endif
+#else
+      (void) size;
+      (void) eraseCount;
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+#if USE_FLASH_WRITE_STATS
+    void beginFlashStats()
+    {
+      if (!loadRTCData(BLYNK_WM_RTC_FLASH_STATS_OFFSET, &flashStats, sizeof(flashStats)))
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
+        // After power loss
+        memset(&flashStats, 0, sizeof(flashStats));
+      }
+      
+      flashStats.bootCount++;
+      flashStats.bootWriteCount = 0;
+      flashStats.bootWriteBytes = 0;
+      flashStats.bootEraseCount = 0;
+      
+      saveRTCData(BLYNK_WM_RTC_FLASH_STATS_OFFSET, &flashStats, sizeof(flashStats));
+      
+#if ( BLYNK_WM_DEBUG > 1)
+      printFlashStats();
+#endif
+    }
+#endif
 
-        // Trying open redundant config file
-        file = FileFS.open(CONFIG_FILENAME_BACKUP, "r");
-        BLYNK_LOG1(BLYNK_F("LoadBkUpCfgFile "));
+    //////////////////////////////////////
 
-        if (!file)
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-          return;
-        }
+    // Load Config Data only once, even if invalid, to avoid repeated storage accesses
+    void loadConfigDataOnce()
+    {
+      if (!configDataLoaded)
+      {
+        hadConfigData     = getConfigData();
+        configDataLoaded  = true;
       }
+    }
+    
+    //////////////////////////////////////
+    
+    const char* getConfigItem(const char* item, size_t maxLength, size_t* length)
+    {
+      if (length)
+        *length = strnlen(item, maxLength);
+        
+      return item;
+    }
+    
+    //////////////////////////////////////
 
-      file.readBytes((char *) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+    int calcChecksum()
+    {
+      int checkSum = 0;
+      for (uint16_t index = 0; index < (sizeof(Blynk8266_WM_config) - sizeof(Blynk8266_WM_config.checkSum)); index++)
+      {
+        checkSum += * ( ( (byte*) &Blynk8266_WM_config ) + index);
+      }
 
-      BLYNK_LOG1(BLYNK_F("OK"));
-      file.close();
+      return checkSum;
     }
     
     //////////////////////////////////////
 
-    void saveConfigData()
-    {
-      File file = FileFS.open(CONFIG_FILENAME, "w");
-      BLYNK_LOG1(BLYNK_F("SaveCfgFile "));
+#if ( USE_LITTLEFS || USE_SPIFFS )
 
-      int calChecksum = calcChecksum();
-      Blynk8266_WM_config.checkSum = calChecksum;
-      BLYNK_LOG2(BLYNK_F("WCSum=0x"), String(calChecksum, HEX));
+#define  CONFIG_FILENAME                  BLYNK_F("/wm_config.dat")
+#define  CONFIG_FILENAME_BACKUP           BLYNK_F("/wm_config.bak")
+
+#define  CREDENTIALS_FILENAME             BLYNK_F("/wm_cred.dat")
+#define  CREDENTIALS_FILENAME_BACKUP      BLYNK_F("/wm_cred.bak")
+
+#define  CONFIG_PORTAL_FILENAME           BLYNK_F("/wm_cp.dat")
+#define  CONFIG_PORTAL_FILENAME_BACKUP    BLYNK_F("/wm_cp.bak")
+
+    //////////////////////////////////////////////
+    
+    void saveForcedCP(uint32_t value)
+    {
+      File file = FileFS.open(CONFIG_PORTAL_FILENAME, "w");
+      
+      BLYNK_LOG1(BLYNK_F("SaveCPFile "));
 
       if (file)
       {
-        file.write((uint8_t*) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+        file.write((uint8_t*) &value, sizeof(value));
+        countFlashWrite(sizeof(value), 1);
         file.close();
         BLYNK_LOG1(BLYNK_F("OK"));
       }
@@ -1451,13 +2734,15 @@ class BlynkWifi
         BLYNK_LOG1(BLYNK_F("failed"));
       }
 
-      // Trying open redundant Auth file
-      file = FileFS.open(CONFIG_FILENAME_BACKUP, "w");
-      BLYNK_LOG1(BLYNK_F("SaveBkUpCfgFile "));
+      // Trying open redundant CP file
+      file = FileFS.open(CONFIG_PORTAL_FILENAME_BACKUP, "w");
+      
+      BLYNK_LOG1(BLYNK_F("SaveBkUpCPFile "));
 
       if (file)
       {
-        file.write((uint8_t *) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+        file.write((uint8_t *) &value, sizeof(value));
+        countFlashWrite(sizeof(value), 1);
         file.close();
         BLYNK_LOG1(BLYNK_F("OK"));
       }
@@ -1469,243 +2754,62 @@ class BlynkWifi
     
     //////////////////////////////////////////////
     
-    void saveAllConfigData()
+    void setForcedCPFlash(bool isPersistent)
     {
-      saveConfigData();     
+      uint32_t readForcedConfigPortalFlag = isPersistent? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
+
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(isPersistent ? BLYNK_F("setForcedCP Persistent") : BLYNK_F("setForcedCP non-Persistent"));
+#endif
       
-#if USE_DYNAMIC_PARAMETERS      
-      saveDynamicData();
-#endif      
+      saveForcedCP(readForcedConfigPortalFlag);
     }
     
     //////////////////////////////////////////////
+    
+    void clearForcedCPFlash()
+    {
+      uint32_t readForcedConfigPortalFlag = 0;
 
-    // Return false if init new EEPROM or SPIFFS/LittleFS. No more need trying to connect. Go directly to config mode
-    bool getConfigData()
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(BLYNK_F("clearForcedCP"));
+#endif
+      
+      saveForcedCP(readForcedConfigPortalFlag);
+    }
+    
+    //////////////////////////////////////////////
+
+    bool isForcedCPFlash()
     {
-      bool dynamicDataValid = true; 
-      int calChecksum;  
+      uint32_t readForcedConfigPortalFlag;
+
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(BLYNK_F("Check if isForcedCP"));
+#endif
       
-      hadConfigData = false;
-      
-      if (!FileFS.begin())
-      {
-        FileFS.format();
-        
-        if (!FileFS.begin())
-        {
-#if USE_LITTLEFS
-          BLYNK_LOG1(BLYNK_F("LittleFS failed!. Please use SPIFFS or EEPROM."));
-#else
-          BLYNK_LOG1(BLYNK_F("SPIFFS failed!. Please use LittleFS or EEPROM."));
-#endif 
-          return false;
-        }
-      }
-
-      if (LOAD_DEFAULT_CONFIG_DATA)
-      {
-        // Load Config Data from Sketch
-        memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
-        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
-        
-        // Including config and dynamic data, and assume valid
-        saveAllConfigData();
-        
-#if ( BLYNK_WM_DEBUG > 2)      
-        BLYNK_LOG1(BLYNK_F("======= Start Loaded Config Data ======="));
-        displayConfigData(Blynk8266_WM_config);
-#endif
+      File file = FileFS.open(CONFIG_PORTAL_FILENAME, "r");
+      BLYNK_LOG1(BLYNK_F("LoadCPFile "));
 
-        // Don't need Config Portal anymore
-        return true; 
-      }
-#if USE_DYNAMIC_PARAMETERS      
-      else if ( ( FileFS.exists(CONFIG_FILENAME)      || FileFS.exists(CONFIG_FILENAME_BACKUP) ) &&
-                ( FileFS.exists(CREDENTIALS_FILENAME) || FileFS.exists(CREDENTIALS_FILENAME_BACKUP) ) )
-#else
-      else if ( FileFS.exists(CONFIG_FILENAME) || FileFS.exists(CONFIG_FILENAME_BACKUP) )
-#endif  
+      if (!file)
       {
-        // if config file exists, load
-        loadConfigData();
-        
-#if ( BLYNK_WM_DEBUG > 2)      
-        BLYNK_LOG1(BLYNK_F("======= Start Stored Config Data ======="));
-        displayConfigData(Blynk8266_WM_config);
-#endif
-
-        calChecksum = calcChecksum();
+        BLYNK_LOG1(BLYNK_F("failed"));
 
-        BLYNK_LOG4(BLYNK_F("CCSum=0x"), String(calChecksum, HEX),
-                   BLYNK_F(",RCSum=0x"), String(Blynk8266_WM_config.checkSum, HEX));
-                 
-#if USE_DYNAMIC_PARAMETERS                 
-        // Load dynamic data
-        dynamicDataValid = loadDynamicData();
-        
-        if (dynamicDataValid)
-        {
-  #if ( BLYNK_WM_DEBUG > 2)      
-          BLYNK_LOG1(BLYNK_F("Valid Stored Dynamic Data"));
-  #endif          
-        }
-  #if ( BLYNK_WM_DEBUG > 2)  
-        else
-        {
-          BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data. Ignored"));
-        }
-  #endif
-#endif
-      }
-      else    
-      {
-        // Not loading Default config data, but having no config file => Config Portal
-        return false;
-      }    
-      
-      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) ||
-           (calChecksum != Blynk8266_WM_config.checkSum) || !dynamicDataValid )
-                      
-      {         
-        // Including Credentials CSum
-        BLYNK_LOG2(BLYNK_F("InitCfgFile,sz="), sizeof(Blynk8266_WM_config));
+        // Trying open redundant config file
+        file = FileFS.open(CONFIG_PORTAL_FILENAME_BACKUP, "r");
+        BLYNK_LOG1(BLYNK_F("LoadBkUpCPFile "));
 
-        // doesn't have any configuration        
-        if (LOAD_DEFAULT_CONFIG_DATA)
-        {
-          memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
-        }
-        else
-        {
-          memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
-                      
-          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG);
-          Blynk8266_WM_config.blynk_port = BLYNK_SERVER_HARDWARE_PORT;      
-          strcpy(Blynk8266_WM_config.board_name,       NO_CONFIG);
-          
-#if USE_DYNAMIC_PARAMETERS       
-          for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-          {
-            // Actual size of pdata is [maxlen + 1]
-            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
-            strncpy(myMenuItems[i].pdata, NO_CONFIG, myMenuItems[i].maxlen);
-          }
-#endif
-        }
-    
-        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
-        
-        #if (USE_DYNAMIC_PARAMETERS && ( BLYNK_WM_DEBUG > 2) )
-        for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+        if (!file)
         {
-          BLYNK_LOG4(BLYNK_F("g:myMenuItems["), i, BLYNK_F("]="), myMenuItems[i].pdata );
+          BLYNK_LOG1(BLYNK_F("failed"));
+          return false;
         }
-        #endif
-        
-        // Don't need
-        Blynk8266_WM_config.checkSum = 0;
-
-        saveAllConfigData();
-
-        return false;
-      }
-      else if ( !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) ) )
-      {
-        // If SSID, PW, Server,Token ="nothing", stay in config mode forever until having config Data.
-        return false;
-      }
-      else
-      {
-        displayConfigData(Blynk8266_WM_config);
-      }
-
-      return true;
-    }
-    
-    //////////////////////////////////////
-
-#else
-
-  #ifndef EEPROM_SIZE
-    #define EEPROM_SIZE     2048
-  #else
-    #if (EEPROM_SIZE > 4096)
-      #warning EEPROM_SIZE must be <= 4096. Reset to 4096
-      #undef EEPROM_SIZE
-      #define EEPROM_SIZE     4096
-    #endif
-    // FLAG_DATA_SIZE is 4, to store DRD/MRD flag
-    #if (EEPROM_SIZE < FLAG_DATA_SIZE + CONFIG_DATA_SIZE)
-      #warning EEPROM_SIZE must be > CONFIG_DATA_SIZE. Reset to 512
-      #undef EEPROM_SIZE
-      #define EEPROM_SIZE     4096
-    #endif
-  #endif
-
-  #ifndef EEPROM_START
-    #define EEPROM_START     0      //define 256 in DRD/MRD
-  #else
-    #if (EEPROM_START + FLAG_DATA_SIZE + CONFIG_DATA_SIZE + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE > EEPROM_SIZE)
-      #error EPROM_START + FLAG_DATA_SIZE + CONFIG_DATA_SIZE + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE > EEPROM_SIZE. Please adjust.
-    #endif
-  #endif
-
-// Stating positon to store Blynk8266_WM_config
-#define BLYNK_EEPROM_START    (EEPROM_START + FLAG_DATA_SIZE)
-
-    //////////////////////////////////////////////
-    
-    void setForcedCP(bool isPersistent)
-    {
-      uint32_t readForcedConfigPortalFlag = isPersistent? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
-
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(BLYNK_F("setForcedCP"));
-#endif
-      
-      EEPROM.put(BLYNK_EEPROM_START + CONFIG_DATA_SIZE, readForcedConfigPortalFlag);
-      EEPROM.commit();
-    }
-    //////////////////////////////////////////////
-    
-    void clearForcedCP()
-    {
-#if ( BLYNK_WM_DEBUG > 2)    
-      BLYNK_LOG1(BLYNK_F("clearForcedCP"));
-#endif
-      
-      EEPROM.put(BLYNK_EEPROM_START + CONFIG_DATA_SIZE, 0);
-      EEPROM.commit();
-    }
-    
-    //////////////////////////////////////////////
+       }
 
-    bool isForcedCP()
-    {
-      uint32_t readForcedConfigPortalFlag;
+      file.readBytes((char *) &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
 
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(BLYNK_F("Check if isForcedCP"));
-#endif
-      
-      // Return true if forced CP (0xDEADBEEF read at offset EPROM_START + DRD_FLAG_DATA_SIZE + CONFIG_DATA_SIZE)
-      // => set flag noForcedConfigPortal = false
-      EEPROM.get(BLYNK_EEPROM_START + CONFIG_DATA_SIZE, readForcedConfigPortalFlag);
+      BLYNK_LOG1(BLYNK_F("OK"));
+      file.close();
       
       // Return true if forced CP (0xDEADBEEF read at offset EPROM_START + DRD_FLAG_DATA_SIZE + CONFIG_DATA_SIZE)
       // => set flag noForcedConfigPortal = false     
@@ -1726,44 +2830,70 @@ class BlynkWifi
     }
     
     //////////////////////////////////////////////
-    
+
 #if USE_DYNAMIC_PARAMETERS
 
     bool checkDynamicData()
     {
       int checkSum = 0;
       int readCheckSum;
+      char* readBuffer;
+           
+      File file = FileFS.open(CREDENTIALS_FILENAME, "r");
+      BLYNK_LOG1(BLYNK_F("LoadCredFile "));
+
+      if (!file)
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+
+        // Trying open redundant config file
+        file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "r");
+        BLYNK_LOG1(BLYNK_F("LoadBkUpCredFile "));
+
+        if (!file)
+        {
+          BLYNK_LOG1(BLYNK_F("failed"));
+          return false;
+        }
+      }
       
-      #define BUFFER_LEN      128
-      char readBuffer[BUFFER_LEN + 1];
-      
-      uint16_t offset = BLYNK_EEPROM_START + sizeof(Blynk8266_WM_config) + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
-                
       // Find the longest pdata, then dynamically allocate buffer. Remember to free when done
       // This is used to store tempo data to calculate checksum to see of data is valid
       // We dont like to destroy myMenuItems[i].pdata with invalid data
       
+      uint16_t maxBufferLength = 0;
       for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
       {       
-        if (myMenuItems[i].maxlen > BUFFER_LEN)
+        if (myMenuItems[i].maxlen > maxBufferLength)
+          maxBufferLength = myMenuItems[i].maxlen;
+      }
+      
+      if (maxBufferLength > 0)
+      {
+        readBuffer = new char[ maxBufferLength + 1 ];
+        
+        // check to see NULL => stop and return false
+        if (readBuffer == NULL)
         {
-          // Size too large, abort and flag false
-          BLYNK_LOG1(BLYNK_F("ChkCrR: Error Small Buffer."));
+          BLYNK_LOG1(BLYNK_F("ChkCrR: Error can't allocate buffer."));
           return false;
         }
+#if ( BLYNK_WM_DEBUG > 2)          
+        else
+        {
+          BLYNK_LOG2(BLYNK_F("ChkCrR: Buffer allocated, sz="), maxBufferLength + 1);
+        }
+#endif             
       }
-         
+     
       for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
       {       
         char* _pointer = readBuffer;
+
+        // Actual size of pdata is [maxlen + 1]
+        memset(readBuffer, 0, myMenuItems[i].maxlen + 1);
         
-        // Prepare buffer, more than enough
-        memset(readBuffer, 0, sizeof(readBuffer));
-        
-        // Read more than necessary, but OK and easier to code
-        EEPROM.get(offset, readBuffer);
-        // NULL terminated
-        readBuffer[myMenuItems[i].maxlen] = 0;
+        file.readBytes(_pointer, myMenuItems[i].maxlen);
 
 #if ( BLYNK_WM_DEBUG > 2)        
         BLYNK_LOG4(F("ChkCrR:pdata="), readBuffer, F(",len="), myMenuItems[i].maxlen);
@@ -1772,15 +2902,23 @@ class BlynkWifi
         for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
         {         
           checkSum += *_pointer;  
-        }   
-        
-        offset += myMenuItems[i].maxlen;    
+        }       
       }
 
-      EEPROM.get(offset, readCheckSum);
-           
-      BLYNK_LOG4(F("ChkCrR:CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
-           
+      file.readBytes((char *) &readCheckSum, sizeof(readCheckSum));
+      
+      BLYNK_LOG1(BLYNK_F("OK"));
+      file.close();
+      
+      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+      
+      // Free buffer
+      if (readBuffer != NULL)
+      {
+        free(readBuffer);
+        BLYNK_LOG1(BLYNK_F("Buffer freed"));
+      }
+      
       if ( checkSum != readCheckSum)
       {
         return false;
@@ -1791,34 +2929,54 @@ class BlynkWifi
     
     //////////////////////////////////////
 
-    bool EEPROM_getDynamicData()
+    // Load data stored in fixed layout by previous releases
+    bool loadLegacyDynamicData()
     {
-      int readCheckSum;
       int checkSum = 0;
-      uint16_t offset = BLYNK_EEPROM_START + sizeof(Blynk8266_WM_config) + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
-           
-      totalDataSize = sizeof(Blynk8266_WM_config) + sizeof(readCheckSum);
+      int readCheckSum;
       
+      File file = FileFS.open(CREDENTIALS_FILENAME, "r");
+      BLYNK_LOG1(BLYNK_F("LoadCredFile "));
+
+      if (!file)
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+
+        // Trying open redundant config file
+        file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "r");
+        BLYNK_LOG1(BLYNK_F("LoadBkUpCredFile "));
+
+        if (!file)
+        {
+          BLYNK_LOG1(BLYNK_F("failed"));
+          return false;
+        }
+      }
+     
       for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
       {       
         char* _pointer = myMenuItems[i].pdata;
         totalDataSize += myMenuItems[i].maxlen;
-        
+
         // Actual size of pdata is [maxlen + 1]
         memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+        
+        file.readBytes(_pointer, myMenuItems[i].maxlen);
+
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG4(F("CrR:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
+#endif          
                
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++,offset++)
-        {
-          *_pointer = EEPROM.read(offset);
-          
+        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
+        {         
           checkSum += *_pointer;  
-         }    
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG4(F("CR:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
-#endif             
+        }       
       }
+
+      file.readBytes((char *) &readCheckSum, sizeof(readCheckSum));
       
-      EEPROM.get(offset, readCheckSum);
+      BLYNK_LOG1(BLYNK_F("OK"));
+      file.close();
       
       BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
       
@@ -1827,236 +2985,2922 @@ class BlynkWifi
         return false;
       }
       
-      return true;
+      return true;    
     }
     
     //////////////////////////////////////
 
-    void EEPROM_putDynamicData()
+    bool loadDynamicDataFile(bool backup)
     {
-      int checkSum = 0;
-      uint16_t offset = BLYNK_EEPROM_START + sizeof(Blynk8266_WM_config) + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
-                
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = myMenuItems[i].pdata;
+      bool result = false;
+      
+      File file = FileFS.open(backup ? CREDENTIALS_FILENAME_BACKUP : CREDENTIALS_FILENAME, "r");
+      BLYNK_LOG1(backup ? BLYNK_F("LoadBkUpCredFile ") : BLYNK_F("LoadCredFile "));
+
+      if (!file)
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+        return false;
+      }
+      
+      uint16_t fileSize = file.size();
+      uint8_t* readBuffer = NULL;
+      
+      // Larger than max size of current myMenuItems[] is OK, as unknown items are skipped
+      if ( (fileSize >= sizeof(BlynkWM_TLV_Header) + sizeof(uint32_t)) && (fileSize <= TLV_getMaxDataSize() + 1024) )
+      {
+        readBuffer = new uint8_t[fileSize];
+      }
+      
+      if (readBuffer)
+      {
+        file.readBytes((char *) readBuffer, fileSize);
         
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG4(F("CW:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
-#endif
-                            
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++,offset++)
-        {
-          EEPROM.write(offset, *_pointer);
-          
-          checkSum += *_pointer;     
-         }
+        result = TLV_deserialize(readBuffer, fileSize);
+        
+        delete [] readBuffer;
       }
       
-      EEPROM.put(offset, checkSum);
-      //EEPROM.commit();
+      file.close();
+      
+      BLYNK_LOG1(result ? BLYNK_F("OK") : BLYNK_F("failed"));
       
-      BLYNK_LOG2(F("CrWCSum=0x"), String(checkSum, HEX));
+      return result;
     }
     
-#endif
-    
-    //////////////////////////////////////////////
+    //////////////////////////////////////
+
+    bool loadDynamicData()
+    {
+      totalDataSize = sizeof(Blynk8266_WM_config) + TLV_getMaxDataSize();
+      
+      if ( loadDynamicDataFile(false) || loadDynamicDataFile(true) )
+      {
+        return true;
+      }
+      
+      // Try data stored by previous releases, and convert to TLV format
+      if ( checkDynamicData() && loadLegacyDynamicData() )
+      {
+        BLYNK_LOG1(BLYNK_F("Convert legacy Dynamic Data"));
+        saveDynamicData();
+        
+        return true;
+      }
+      
+      return false;
+    }
     
-    bool getConfigData()
+    //////////////////////////////////////
+
+    void saveDynamicData()
     {
-      bool dynamicDataValid = true;
-      int calChecksum;
+      invalidateConfigCache();
       
-      hadConfigData = false; 
+      uint8_t* writeBuffer = new uint8_t[TLV_getMaxDataSize()];
       
-      EEPROM.begin(EEPROM_SIZE);
-      BLYNK_LOG2(BLYNK_F("EEPROMsz:"), EEPROM_SIZE);
+      if (writeBuffer == NULL)
+      {
+        BLYNK_LOG1(BLYNK_F("CW: Error can't allocate buffer."));
+        return;
+      }
       
-      if (LOAD_DEFAULT_CONFIG_DATA)
+      uint16_t dataSize = TLV_serialize(writeBuffer);
+    
+      File file = FileFS.open(CREDENTIALS_FILENAME, "w");
+      BLYNK_LOG1(BLYNK_F("SaveCredFile "));
+
+      if (file)
       {
-        // Load Config Data from Sketch
-        memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
-        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
-        
-        // Including config and dynamic data, and assume valid
-        saveAllConfigData();
-                 
-#if ( BLYNK_WM_DEBUG > 2)      
-        BLYNK_LOG1(BLYNK_F("======= Start Loaded Config Data ======="));
-        displayConfigData(Blynk8266_WM_config);
-#endif
+        file.write(writeBuffer, dataSize);
+        countFlashWrite(dataSize, 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));    
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }   
+           
+      BLYNK_LOG2(F("CrWSz="), dataSize);
+      
+      // Trying open redundant Auth file
+      file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "w");
+      BLYNK_LOG1(BLYNK_F("SaveBkUpCredFile "));
 
-        // Don't need Config Portal anymore
-        return true;             
+      if (file)
+      {
+        file.write(writeBuffer, dataSize);
+        countFlashWrite(dataSize, 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));    
       }
       else
       {
-        // Load data from EEPROM
-        EEPROM.get(BLYNK_EEPROM_START, Blynk8266_WM_config);
-        
-#if ( BLYNK_WM_DEBUG > 2)      
-        BLYNK_LOG1(BLYNK_F("======= Start Stored Config Data ======="));
-        displayConfigData(Blynk8266_WM_config);
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }
+      
+      delete [] writeBuffer;
+    }
 #endif
 
-        calChecksum = calcChecksum();
+    //////////////////////////////////////
 
-        BLYNK_LOG4(BLYNK_F("CCSum=0x"), String(calChecksum, HEX),
-                   BLYNK_F(",RCSum=0x"), String(Blynk8266_WM_config.checkSum, HEX));
-                 
-#if USE_DYNAMIC_PARAMETERS
-                 
-        // Load dynamic data from EEPROM
-        dynamicDataValid = EEPROM_getDynamicData();
-        
-        if (dynamicDataValid)
-        {
-  #if ( BLYNK_WM_DEBUG > 2)      
-          BLYNK_LOG1(BLYNK_F("Valid Stored Dynamic Data"));
-  #endif          
-        }
-  #if ( BLYNK_WM_DEBUG > 2)  
-        else
+    void loadConfigData()
+    {
+      File file = FileFS.open(CONFIG_FILENAME, "r");
+      BLYNK_LOG1(BLYNK_F("LoadCfgFile "));
+
+      if (!file)
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+
+        // Trying open redundant config file
+        file = FileFS.open(CONFIG_FILENAME_BACKUP, "r");
+        BLYNK_LOG1(BLYNK_F("LoadBkUpCfgFile "));
+
+        if (!file)
         {
-          BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data. Ignored"));
+          BLYNK_LOG1(BLYNK_F("failed"));
+          return;
         }
-  #endif
-#endif
       }
-        
-      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) ||
-           (calChecksum != Blynk8266_WM_config.checkSum) || !dynamicDataValid )
-      {       
-        // Including Credentials CSum
-        BLYNK_LOG4(F("InitEEPROM,sz="), EEPROM_SIZE, F(",DataSz="), totalDataSize);
 
-        // doesn't have any configuration        
-        if (LOAD_DEFAULT_CONFIG_DATA)
-        {
-          memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
-        }
-        else
-        {
-          memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
-             
-          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG);
-          Blynk8266_WM_config.blynk_port = BLYNK_SERVER_HARDWARE_PORT;      
-          strcpy(Blynk8266_WM_config.board_name,       NO_CONFIG);
-          
-#if USE_DYNAMIC_PARAMETERS        
-          for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-          {
-            // Actual size of pdata is [maxlen + 1]
-            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
-            strncpy(myMenuItems[i].pdata, NO_CONFIG, myMenuItems[i].maxlen);
-          }
+      file.readBytes((char *) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+
+      BLYNK_LOG1(BLYNK_F("OK"));
+      file.close();
+    }
+    
+    //////////////////////////////////////
+
+    void saveConfigData()
+    {
+      invalidateConfigCache();
+      
+      File file = FileFS.open(CONFIG_FILENAME, "w");
+      BLYNK_LOG1(BLYNK_F("SaveCfgFile "));
+
+      int calChecksum = calcChecksum();
+      Blynk8266_WM_config.checkSum = calChecksum;
+      BLYNK_LOG2(BLYNK_F("WCSum=0x"), String(calChecksum, HEX));
+
+      if (file)
+      {
+        file.write((uint8_t*) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+        countFlashWrite(sizeof(Blynk8266_WM_config), 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }
+
+      // Trying open redundant Auth file
+      file = FileFS.open(CONFIG_FILENAME_BACKUP, "w");
+      BLYNK_LOG1(BLYNK_F("SaveBkUpCfgFile "));
+
+      if (file)
+      {
+        file.write((uint8_t *) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+        countFlashWrite(sizeof(Blynk8266_WM_config), 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    void saveAllConfigData()
+    {
+      saveConfigData();     
+      
+#if USE_DYNAMIC_PARAMETERS      
+      saveDynamicData();
+#endif      
+    }
+    
+    //////////////////////////////////////////////
+
+    // Return false if init new EEPROM or SPIFFS/LittleFS. No more need trying to connect. Go directly to config mode
+    bool getConfigData()
+    {
+#if USE_DYNAMIC_PARAMETERS
+      bool dynamicDataValid = true;
+#endif
+      int calChecksum;  
+      
+      hadConfigData = false;
+      
+      if (!FileFS.begin())
+      {
+        FileFS.format();
+        
+        if (!FileFS.begin())
+        {
+#if USE_LITTLEFS
+          BLYNK_LOG1(BLYNK_F("LittleFS failed!. Please use SPIFFS or EEPROM."));
+#else
+          BLYNK_LOG1(BLYNK_F("SPIFFS failed!. Please use LittleFS or EEPROM."));
+#endif 
+          return false;
+        }
+      }
+
+      if (LOAD_DEFAULT_CONFIG_DATA)
+      {
+        // Load Config Data from Sketch
+        memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
+        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+        
+        // Including config and dynamic data, and assume valid
+        saveAllConfigData();
+        
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("======= Start Loaded Config Data ======="));
+        displayConfigData(Blynk8266_WM_config);
+#endif
+
+        // Don't need Config Portal anymore
+        return true; 
+      }
+      else if ( FileFS.exists(CONFIG_FILENAME) || FileFS.exists(CONFIG_FILENAME_BACKUP) )
+      {
+        // if config file exists, load
+        loadConfigData();
+        
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("======= Start Stored Config Data ======="));
+        displayConfigData(Blynk8266_WM_config);
+#endif
+
+        calChecksum = calcChecksum();
+
+        BLYNK_LOG4(BLYNK_F("CCSum=0x"), String(calChecksum, HEX),
+                   BLYNK_F(",RCSum=0x"), String(Blynk8266_WM_config.checkSum, HEX));
+                 
+#if USE_DYNAMIC_PARAMETERS                 
+        // Load dynamic data
+        dynamicDataValid = loadDynamicData();
+        
+        if (dynamicDataValid)
+        {
+  #if ( BLYNK_WM_DEBUG > 2)      
+          BLYNK_LOG1(BLYNK_F("Valid Stored Dynamic Data"));
+  #endif          
+        }
+  #if ( BLYNK_WM_DEBUG > 2)  
+        else
+        {
+          BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data"));
+        }
+  #endif
+#endif
+      }
+      else    
+      {
+        // Not loading Default config data, but having no config file => Config Portal
+        return false;
+      }    
+      
+      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) ||
+           (calChecksum != Blynk8266_WM_config.checkSum) )
+                      
+      {         
+        // Including Credentials CSum
+        BLYNK_LOG2(BLYNK_F("InitCfgFile,sz="), sizeof(Blynk8266_WM_config));
+
+        // doesn't have any configuration        
+        if (LOAD_DEFAULT_CONFIG_DATA)
+        {
+          memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
+        }
+        else
+        {
+          memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
+                      
+          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG);
+          Blynk8266_WM_config.blynk_port = BLYNK_SERVER_HARDWARE_PORT;      
+          strcpy(Blynk8266_WM_config.board_name,       NO_CONFIG);
+          
+#if USE_DYNAMIC_PARAMETERS       
+          for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+          {
+            // Actual size of pdata is [maxlen + 1]
+            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+            strncpy(myMenuItems[i].pdata, NO_CONFIG, myMenuItems[i].maxlen);
+          }
+#endif
+        }
+    
+        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+        
+        #if (USE_DYNAMIC_PARAMETERS && ( BLYNK_WM_DEBUG > 2) )
+        for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+        {
+          BLYNK_LOG4(BLYNK_F("g:myMenuItems["), i, BLYNK_F("]="), myMenuItems[i].pdata );
+        }
+        #endif
+        
+        // Don't need
+        Blynk8266_WM_config.checkSum = 0;
+
+        saveAllConfigData();
+
+        return false;
+      }
+#if USE_DYNAMIC_PARAMETERS
+      else if (!dynamicDataValid)
+      {
+        // Credentials are still valid. Dynamic Params keep their sketch defaults, and are saved again
+        BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data. Use defaults"));
+        
+        saveDynamicData();
+      }
+#endif
+
+      if ( !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) ) )
+      {
+        // If SSID, PW, Server,Token ="nothing", stay in config mode forever until having config Data.
+        return false;
+      }
+      else
+      {
+        displayConfigData(Blynk8266_WM_config);
+      }
+
+      return true;
+    }
+    
+    //////////////////////////////////////
+
+#else
+
+  #ifndef EEPROM_SIZE
+    #define EEPROM_SIZE     2048
+  #else
+    #if (EEPROM_SIZE > 4096)
+      #warning EEPROM_SIZE must be <= 4096. Reset to 4096
+      #undef EEPROM_SIZE
+      #define EEPROM_SIZE     4096
+    #endif
+  #endif
+
+  #ifndef EEPROM_START
+    #define EEPROM_START     0      //define 256 in DRD/MRD
+  #endif
+  
+  // Size reserved for the flags region. Must be multiple of 4
+  #ifndef EEPROM_FLAGS_REGION_SIZE
+    #define EEPROM_FLAGS_REGION_SIZE      16
+  #endif
+
+  // EEPROM layout, starting at EEPROM_START
+  // - Flags region, often rewritten : DRD/MRD flag (FLAG_DATA_SIZE), then forced Config Portal flag.
+  //   Reserved with EEPROM_FLAGS_REGION_SIZE bytes, so adding flags won't move the credentials
+  // - Credentials region, rarely rewritten : Blynk8266_WM_config, then Dynamic Params (TLV) up to EEPROM_SIZE
+  // Flags and credentials don't share bytes. But EEPROM.commit() still erases and rewrites the whole emulated sector
+  static constexpr uint16_t EEPROM_FORCED_CP_START      = EEPROM_START + FLAG_DATA_SIZE;
+  static constexpr uint16_t EEPROM_FLAGS_END            = EEPROM_FORCED_CP_START + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
+  static constexpr uint16_t EEPROM_CONFIG_START         = EEPROM_START + EEPROM_FLAGS_REGION_SIZE;
+  static constexpr uint16_t EEPROM_DYNAMIC_DATA_START   = EEPROM_CONFIG_START + sizeof(Blynk8266_WM_config);
+  
+  // Layout of previous releases, used only to move stored data : DRD/MRD flag, Blynk8266_WM_config, forced CP flag, Dynamic Params
+  static constexpr uint16_t EEPROM_LEGACY_CONFIG_START        = EEPROM_START + FLAG_DATA_SIZE;
+  static constexpr uint16_t EEPROM_LEGACY_FORCED_CP_START     = EEPROM_LEGACY_CONFIG_START + sizeof(Blynk8266_WM_config);
+  static constexpr uint16_t EEPROM_LEGACY_DYNAMIC_DATA_START  = EEPROM_LEGACY_FORCED_CP_START + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
+  
+  static_assert( (EEPROM_FLAGS_REGION_SIZE % 4) == 0, "EEPROM_FLAGS_REGION_SIZE must be multiple of 4");
+  // ESP_DoubleResetDetector / ESP_MultiResetDetector write their FLAG_DATA_SIZE bytes at EEPROM_START
+  static_assert( EEPROM_FLAGS_END <= EEPROM_CONFIG_START, "DRD/MRD and forced CP flags exceed EEPROM_FLAGS_REGION_SIZE. Increase it");
+  static_assert( EEPROM_DYNAMIC_DATA_START + sizeof(BlynkWM_TLV_Header) + sizeof(uint32_t) <= EEPROM_SIZE, 
+                 "EEPROM_START + Config Data > EEPROM_SIZE. Please adjust");
+  static_assert( EEPROM_LEGACY_DYNAMIC_DATA_START <= EEPROM_DYNAMIC_DATA_START, "Legacy layout must move to higher offsets");
+
+    // Some EEPROM bytes modified since last commit
+    bool eepromDirty = false;
+
+    //////////////////////////////////////////////
+    
+    // Write only the bytes different from the current EEPROM contents.
+    // Unchanged bytes don't mark the EEPROM buffer dirty, so the next commit can be skipped
+    void EEPROM_writeData(uint16_t offset, const void* data, uint16_t size)
+    {
+      const uint8_t* _pointer = (const uint8_t*) data;
+      
+      for (uint16_t i = 0; i < size; i++, offset++, _pointer++)
+      {
+        if (EEPROM.read(offset) != *_pointer)
+        {
+          EEPROM.write(offset, *_pointer);
+          eepromDirty = true;
+        }
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Commit only if something has been changed since last commit
+    bool EEPROM_commitData()
+    {
+      bool result = true;
+      
+      if (eepromDirty)
+      {
+        result = EEPROM.commit();
+        
+        countFlashWrite(EEPROM_SIZE, (EEPROM_SIZE + 4095) / 4096);
+        
+        eepromDirty = false;
+      }
+#if ( BLYNK_WM_DEBUG > 2)
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("EEPROM unchanged, no commit"));
+      }
+#endif
+      
+      return result;
+    }
+
+    //////////////////////////////////////////////
+    
+    // Copy EEPROM bytes to a higher offset, from the end as both areas can overlap
+    void EEPROM_moveData(uint16_t fromOffset, uint16_t toOffset, uint16_t size)
+    {
+      for (uint16_t i = size; i > 0; i--)
+      {
+        uint8_t data = EEPROM.read(fromOffset + i - 1);
+        
+        EEPROM_writeData(toOffset + i - 1, &data, 1);
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Move data stored with the layout of previous releases, where the forced CP flag was stored
+    // between Blynk8266_WM_config and Dynamic Params. Return true if moved
+    bool EEPROM_convertLegacyLayout()
+    {
+      EEPROM.get(EEPROM_CONFIG_START, Blynk8266_WM_config);
+      
+      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) == 0) && 
+           (calcChecksum() == Blynk8266_WM_config.checkSum) )
+      {
+        // Already new layout
+        return false;
+      }
+      
+      EEPROM.get(EEPROM_LEGACY_CONFIG_START, Blynk8266_WM_config);
+      
+      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) || 
+           (calcChecksum() != Blynk8266_WM_config.checkSum) )
+      {
+        // No valid data
+        return false;
+      }
+      
+      BLYNK_LOG1(BLYNK_F("Convert legacy EEPROM layout"));
+      
+      uint32_t readForcedConfigPortalFlag;
+      
+      EEPROM.get(EEPROM_LEGACY_FORCED_CP_START, readForcedConfigPortalFlag);
+      
+      // Dynamic Params first, as moved Blynk8266_WM_config will overwrite their legacy location
+      EEPROM_moveData(EEPROM_LEGACY_DYNAMIC_DATA_START, EEPROM_DYNAMIC_DATA_START, EEPROM_SIZE - EEPROM_DYNAMIC_DATA_START);
+      EEPROM_moveData(EEPROM_LEGACY_CONFIG_START, EEPROM_CONFIG_START, sizeof(Blynk8266_WM_config));
+      
+      EEPROM_writeData(EEPROM_FORCED_CP_START, &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
+      EEPROM_commitData();
+      
+      return true;
+    }
+    
+    //////////////////////////////////////////////
+    
+    void setForcedCPFlash(bool isPersistent)
+    {
+      uint32_t readForcedConfigPortalFlag = isPersistent? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
+
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(BLYNK_F("setForcedCP"));
+#endif
+      
+      EEPROM_writeData(EEPROM_FORCED_CP_START, &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
+      EEPROM_commitData();
+    }
+    //////////////////////////////////////////////
+    
+    void clearForcedCPFlash()
+    {
+#if ( BLYNK_WM_DEBUG > 2)    
+      BLYNK_LOG1(BLYNK_F("clearForcedCP"));
+#endif
+      
+      uint32_t readForcedConfigPortalFlag = 0;
+      
+      EEPROM_writeData(EEPROM_FORCED_CP_START, &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
+      EEPROM_commitData();
+    }
+    
+    //////////////////////////////////////////////
+
+    bool isForcedCPFlash()
+    {
+      uint32_t readForcedConfigPortalFlag;
+
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(BLYNK_F("Check if isForcedCP"));
+#endif
+      
+      // Return true if forced CP (0xDEADBEEF read at offset EEPROM_FORCED_CP_START, in flags region)
+      // => set flag noForcedConfigPortal = false
+      EEPROM.get(EEPROM_FORCED_CP_START, readForcedConfigPortalFlag);
+      
+      if (readForcedConfigPortalFlag == FORCED_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = false;
+        return true;
+      }
+      else if (readForcedConfigPortalFlag == FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = true;
+        return true;
+      }
+      else
+      {       
+        return false;
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+#if USE_DYNAMIC_PARAMETERS
+
+    bool checkDynamicData()
+    {
+      int checkSum = 0;
+      int readCheckSum;
+      
+      #define BUFFER_LEN      128
+      char readBuffer[BUFFER_LEN + 1];
+      
+      uint16_t offset = EEPROM_DYNAMIC_DATA_START;
+                
+      // Find the longest pdata, then dynamically allocate buffer. Remember to free when done
+      // This is used to store tempo data to calculate checksum to see of data is valid
+      // We dont like to destroy myMenuItems[i].pdata with invalid data
+      
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {       
+        if (myMenuItems[i].maxlen > BUFFER_LEN)
+        {
+          // Size too large, abort and flag false
+          BLYNK_LOG1(BLYNK_F("ChkCrR: Error Small Buffer."));
+          return false;
+        }
+      }
+         
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {       
+        char* _pointer = readBuffer;
+        
+        // Prepare buffer, more than enough
+        memset(readBuffer, 0, sizeof(readBuffer));
+        
+        // Read more than necessary, but OK and easier to code
+        EEPROM.get(offset, readBuffer);
+        // NULL terminated
+        readBuffer[myMenuItems[i].maxlen] = 0;
+
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG4(F("ChkCrR:pdata="), readBuffer, F(",len="), myMenuItems[i].maxlen);
+#endif          
+               
+        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
+        {         
+          checkSum += *_pointer;  
+        }   
+        
+        offset += myMenuItems[i].maxlen;    
+      }
+
+      EEPROM.get(offset, readCheckSum);
+           
+      BLYNK_LOG4(F("ChkCrR:CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+           
+      if ( checkSum != readCheckSum)
+      {
+        return false;
+      }
+      
+      return true;    
+    }
+    
+    //////////////////////////////////////
+
+    // Load data stored in fixed layout by previous releases
+    bool EEPROM_getLegacyDynamicData()
+    {
+      int readCheckSum;
+      int checkSum = 0;
+      uint16_t offset = EEPROM_DYNAMIC_DATA_START;
+      
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {       
+        char* _pointer = myMenuItems[i].pdata;
+        totalDataSize += myMenuItems[i].maxlen;
+        
+        // Actual size of pdata is [maxlen + 1]
+        memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+               
+        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++,offset++)
+        {
+          *_pointer = EEPROM.read(offset);
+          
+          checkSum += *_pointer;  
+         }    
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG4(F("CR:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
+#endif             
+      }
+      
+      EEPROM.get(offset, readCheckSum);
+      
+      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+      
+      if ( checkSum != readCheckSum)
+      {
+        return false;
+      }
+      
+      return true;
+    }
+    
+    //////////////////////////////////////
+
+    bool EEPROM_getDynamicData()
+    {
+      uint16_t dataSize;
+      uint8_t  headerBuffer[sizeof(BlynkWM_TLV_Header)];
+      bool     result = false;
+      
+      totalDataSize = sizeof(Blynk8266_WM_config) + TLV_getMaxDataSize();
+      
+      EEPROM.get(EEPROM_DYNAMIC_DATA_START, headerBuffer);
+      
+      if ( TLV_checkHeader(headerBuffer, dataSize) && (EEPROM_DYNAMIC_DATA_START + dataSize <= EEPROM_SIZE) )
+      {
+        uint8_t* readBuffer = new uint8_t[dataSize];
+        
+        if (readBuffer)
+        {
+          for (uint16_t i = 0; i < dataSize; i++)
+          {
+            readBuffer[i] = EEPROM.read(EEPROM_DYNAMIC_DATA_START + i);
+          }
+          
+          result = TLV_deserialize(readBuffer, dataSize);
+          
+          delete [] readBuffer;
+        }
+      }
+      // Try data stored by previous releases, and convert to TLV format
+      else if ( checkDynamicData() && EEPROM_getLegacyDynamicData() )
+      {
+        BLYNK_LOG1(BLYNK_F("Convert legacy Dynamic Data"));
+        saveDynamicData();
+        
+        result = true;
+      }
+      
+      return result;
+    }
+    
+    //////////////////////////////////////
+
+    void EEPROM_putDynamicData()
+    {
+      uint16_t maxDataSize = TLV_getMaxDataSize();
+      
+      if (EEPROM_DYNAMIC_DATA_START + maxDataSize > EEPROM_SIZE)
+      {
+        BLYNK_LOG2(BLYNK_F("CW: Error EEPROM_SIZE too small, need "), EEPROM_DYNAMIC_DATA_START + maxDataSize);
+        return;
+      }
+      
+      uint8_t* writeBuffer = new uint8_t[maxDataSize];
+      
+      if (writeBuffer == NULL)
+      {
+        BLYNK_LOG1(BLYNK_F("CW: Error can't allocate buffer."));
+        return;
+      }
+      
+      uint16_t dataSize = TLV_serialize(writeBuffer);
+      
+      EEPROM_writeData(EEPROM_DYNAMIC_DATA_START, writeBuffer, dataSize);
+      
+      delete [] writeBuffer;
+      
+      BLYNK_LOG2(F("CrWSz="), dataSize);
+    }
+    
+    //////////////////////////////////////
+    
+    void saveDynamicData()
+    {
+      invalidateConfigCache();
+      
+      EEPROM_putDynamicData();
+      EEPROM_commitData();
+    }
+    
+#endif
+    
+    //////////////////////////////////////////////
+    
+    bool getConfigData()
+    {
+#if USE_DYNAMIC_PARAMETERS
+      bool dynamicDataValid = true;
+#endif
+      int calChecksum;
+      
+      hadConfigData = false; 
+      
+      EEPROM.begin(EEPROM_SIZE);
+      BLYNK_LOG2(BLYNK_F("EEPROMsz:"), EEPROM_SIZE);
+      
+      if (LOAD_DEFAULT_CONFIG_DATA)
+      {
+        // Load Config Data from Sketch
+        memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
+        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+        
+        // Including config and dynamic data, and assume valid
+        saveAllConfigData();
+                 
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("======= Start Loaded Config Data ======="));
+        displayConfigData(Blynk8266_WM_config);
+#endif
+
+        // Don't need Config Portal anymore
+        return true;             
+      }
+      else
+      {
+        // Move data stored by previous releases, then load data from EEPROM
+        EEPROM_convertLegacyLayout();
+        
+        EEPROM.get(EEPROM_CONFIG_START, Blynk8266_WM_config);
+        
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("======= Start Stored Config Data ======="));
+        displayConfigData(Blynk8266_WM_config);
+#endif
+
+        calChecksum = calcChecksum();
+
+        BLYNK_LOG4(BLYNK_F("CCSum=0x"), String(calChecksum, HEX),
+                   BLYNK_F(",RCSum=0x"), String(Blynk8266_WM_config.checkSum, HEX));
+                 
+#if USE_DYNAMIC_PARAMETERS
+                 
+        // Load dynamic data from EEPROM
+        dynamicDataValid = EEPROM_getDynamicData();
+        
+        if (dynamicDataValid)
+        {
+  #if ( BLYNK_WM_DEBUG > 2)      
+          BLYNK_LOG1(BLYNK_F("Valid Stored Dynamic Data"));
+  #endif          
+        }
+  #if ( BLYNK_WM_DEBUG > 2)  
+        else
+        {
+          BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data"));
+        }
+  #endif
+#endif
+      }
+        
+      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) ||
+           (calChecksum != Blynk8266_WM_config.checkSum) )
+      {       
+        // Including Credentials CSum
+        BLYNK_LOG4(F("InitEEPROM,sz="), EEPROM_SIZE, F(",DataSz="), totalDataSize);
+
+        // doesn't have any configuration        
+        if (LOAD_DEFAULT_CONFIG_DATA)
+        {
+          memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
+        }
+        else
+        {
+          memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
+             
+          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG);
+          Blynk8266_WM_config.blynk_port = BLYNK_SERVER_HARDWARE_PORT;      
+          strcpy(Blynk8266_WM_config.board_name,       NO_CONFIG);
+          
+#if USE_DYNAMIC_PARAMETERS        
+          for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+          {
+            // Actual size of pdata is [maxlen + 1]
+            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+            strncpy(myMenuItems[i].pdata, NO_CONFIG, myMenuItems[i].maxlen);
+          }
+#endif
+        }
+    
+        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+        
+        #if ( USE_DYNAMIC_PARAMETERS && ( BLYNK_WM_DEBUG > 2) )   
+        for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+        {
+          BLYNK_LOG4(BLYNK_F("g:myMenuItems["), i, BLYNK_F("]="), myMenuItems[i].pdata );
+        }
+        #endif
+        
+        // Don't need
+        Blynk8266_WM_config.checkSum = 0;
+
+        saveAllConfigData();
+
+        return false;
+      }
+#if USE_DYNAMIC_PARAMETERS
+      else if (!dynamicDataValid)
+      {
+        // Credentials are still valid. Dynamic Params keep their sketch defaults, and are saved again
+        BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data. Use defaults"));
+        
+        saveDynamicData();
+      }
+#endif
+
+      if ( !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) ) )
+      {
+        // If SSID, PW, Server,Token ="nothing", stay in config mode forever until having config Data.
+        return false;
+      }
+      else
+      {
+        displayConfigData(Blynk8266_WM_config);
+      }
+
+      return true;
+    }
+    
+    //////////////////////////////////////
+
+    void saveConfigData()
+    {
+      invalidateConfigCache();
+      
+      int calChecksum = calcChecksum();
+      Blynk8266_WM_config.checkSum = calChecksum;
+      BLYNK_LOG4(BLYNK_F("SaveEEPROM,sz="), EEPROM_SIZE, BLYNK_F(",CSum=0x"), String(calChecksum, HEX))
+
+      EEPROM_writeData(EEPROM_CONFIG_START, &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+      
+      EEPROM_commitData();
+    }
+    
+    //////////////////////////////////////
+    
+    void saveAllConfigData()
+    {
+      int calChecksum = calcChecksum();
+      Blynk8266_WM_config.checkSum = calChecksum;
+      BLYNK_LOG4(BLYNK_F("SaveEEPROM,sz="), EEPROM_SIZE, BLYNK_F(",CSum=0x"), String(calChecksum, HEX))
+
+      EEPROM_writeData(EEPROM_CONFIG_START, &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+
+#if USE_DYNAMIC_PARAMETERS         
+      EEPROM_putDynamicData();
+#endif
+      
+      EEPROM_commitData();
+    }
+    
+    //////////////////////////////////////
+
+#endif
+
+    //////////////////////////////////////
+
+    // Non-persistent forced CP flag only needs to survive a software reset => kept in RTC memory only.
+    // Persistent flag must survive power loss => stored in flash, and mirrored in RTC memory.
+    // Flash is read only when RTC data is invalid (e.g. power-on), and written only when its flag changes
+    
+#if FORCED_CP_USE_RTC
+
+    BlynkWM_ForcedCP_RTC forcedCP_RTC = { 0, 0 };
+    
+    //////////////////////////////////////////////
+    
+    void saveForcedCP_RTC(uint32_t forcedCPFlag, uint32_t flashForcedCPFlag)
+    {
+      forcedCP_RTC.forcedCPFlag       = forcedCPFlag;
+      forcedCP_RTC.flashForcedCPFlag  = flashForcedCPFlag;
+      
+      saveRTCData(BLYNK_WM_RTC_FORCED_CP_OFFSET, &forcedCP_RTC, sizeof(forcedCP_RTC));
+    }
+    
+    //////////////////////////////////////////////
+    
+    void setForcedCP(bool isPersistent)
+    {
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
+      if (isPersistent)
+      {
+        if (forcedCP_RTC.flashForcedCPFlag != FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
+        {
+          setForcedCPFlash(true);
+        }
+        
+        saveForcedCP_RTC(FORCED_PERS_CONFIG_PORTAL_FLAG_DATA, FORCED_PERS_CONFIG_PORTAL_FLAG_DATA);
+      }
+      else
+      {
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("setForcedCP non-Persistent RTC"));
+#endif
+
+        saveForcedCP_RTC(FORCED_CONFIG_PORTAL_FLAG_DATA, forcedCP_RTC.flashForcedCPFlag);
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    void clearForcedCP()
+    {
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
+      if (forcedCP_RTC.flashForcedCPFlag != 0)
+      {
+        clearForcedCPFlash();
+      }
+      
+      if (forcedCP_RTC.forcedCPFlag != 0)
+      {
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("clearForcedCP RTC"));
+#endif
+      
+        saveForcedCP_RTC(0, 0);
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    bool isForcedCP()
+    {
+      if (loadRTCData(BLYNK_WM_RTC_FORCED_CP_OFFSET, &forcedCP_RTC, sizeof(forcedCP_RTC)))
+      {
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG2(BLYNK_F("LoadCPRTC OK,flag=0x"), String(forcedCP_RTC.forcedCPFlag, HEX));
+#endif
+      }
+      else
+      {
+        // RTC data invalid => read flash once, and keep it in RTC
+        uint32_t flashForcedCPFlag = 0;
+        
+#if USE_RTC_CONFIG_CACHE
+        mountStorage();
+#endif
+        
+        if (isForcedCPFlash())
+        {
+          flashForcedCPFlag = persForcedConfigPortal ? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
+        }
+        
+        saveForcedCP_RTC(flashForcedCPFlag, flashForcedCPFlag);
+      }
+      
+      if (forcedCP_RTC.forcedCPFlag == FORCED_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = false;
+        return true;
+      }
+      else if (forcedCP_RTC.forcedCPFlag == FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = true;
+        return true;
+      }
+      else
+      {       
+        return false;
+      }
+    }
+    
+#else
+
+    void setForcedCP(bool isPersistent)
+    {
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
+      setForcedCPFlash(isPersistent);
+    }
+    
+    //////////////////////////////////////////////
+    
+    void clearForcedCP()
+    {
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
+      clearForcedCPFlash();
+    }
+    
+    //////////////////////////////////////////////
+    
+    bool isForcedCP()
+    {
+#if USE_RTC_CONFIG_CACHE
+      mountStorage();
+#endif
+
+      return isForcedCPFlash();
+    }
+    
+#endif
+    
+    //////////////////////////////////////
+
+#if USE_RTC_CONFIG_CACHE
+    // Storage is not started when Config Data is loaded from RTC cache. Start it before reading the forced CP flag
+    void mountStorage()
+    {
+      if (storageReady)
+        return;
+        
+#if ( USE_LITTLEFS || USE_SPIFFS )
+      FileFS.begin();
+#else
+      EEPROM.begin(EEPROM_SIZE);
+#endif
+
+      storageReady = true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Start storage, with the full Config Data, before writing
+    void beginStorage()
+    {
+      mountStorage();
+      
+      // Config Data from RTC cache only has the Credentials of the last connection
+      if (configCacheLoaded)
+      {
+        configCacheLoaded = false;
+        hadConfigData     = getConfigData();
+      }
+    }
+#endif
+
+    //////////////////////////////////////
+
+#if ( USE_WIFI_AP_CACHE || USE_WIFI_SCAN_RANK || USE_DHCP_LEASE_CACHE || USE_RTC_CONFIG_CACHE )
+
+    uint32_t calcWiFiCredsCRC(uint8_t index)
+    {
+      return calcCRC32(&Blynk8266_WM_config.WiFi_Creds[index], sizeof(Blynk8266_WM_config.WiFi_Creds[index]));
+    }
+    
+    //////////////////////////////////////
+    
+    // Index in WiFi_Creds of SSID, NUM_WIFI_CREDENTIALS if not found
+    uint8_t getWiFiCredsIndex(const char* ssid)
+    {
+      uint8_t index;
+      
+      for (index = 0; index < NUM_WIFI_CREDENTIALS; index++)
+      {
+        if ( (strlen(Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid) != 0) && (strcmp(ssid, Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid) == 0) )
+          break;
+      }
+      
+      return index;
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+#if USE_WIFI_AP_CACHE
+
+    // Return true if cached AP is valid for current WiFi Credentials
+    bool loadAPCache()
+    {
+      if (!apCacheLoaded)
+      {
+        apCacheValid  = loadRTCData(BLYNK_WM_RTC_AP_CACHE_OFFSET, &apCache, sizeof(apCache));
+        apCacheLoaded = true;
+      }
+      
+      return ( apCacheValid && (apCache.channel != 0) && (apCache.wifiIndex < NUM_WIFI_CREDENTIALS) && 
+               (apCache.credsCRC == calcWiFiCredsCRC(apCache.wifiIndex)) );
+    }
+    
+    //////////////////////////////////////
+    
+    // Save the connected AP. RTC memory is written only when AP changed
+    void saveAPCache()
+    {
+      BlynkWM_APCache newCache;
+      String ssid = WiFi.SSID();
+      
+      memset(&newCache, 0, sizeof(newCache));
+      
+      for (newCache.wifiIndex = 0; newCache.wifiIndex < NUM_WIFI_CREDENTIALS; newCache.wifiIndex++)
+      {
+        if (strcmp(ssid.c_str(), Blynk8266_WM_config.WiFi_Creds[newCache.wifiIndex].wifi_ssid) == 0)
+          break;
+      }
+      
+      if (newCache.wifiIndex >= NUM_WIFI_CREDENTIALS)
+        return;
+      
+      memcpy(newCache.bssid, WiFi.BSSID(), sizeof(newCache.bssid));
+      newCache.channel  = WiFi.channel();
+      newCache.credsCRC = calcWiFiCredsCRC(newCache.wifiIndex);
+      
+#if USE_EARLY_WIFI
+      if (loadAPCache() && (memcmp(&newCache, &apCache, sizeof(apCache)) == 0) && earlyWiFiSaved)
+        return;
+#else
+      if (loadAPCache() && (memcmp(&newCache, &apCache, sizeof(apCache)) == 0))
+        return;
+#endif
+        
+      memcpy(&apCache, &newCache, sizeof(apCache));
+      apCacheValid = saveRTCData(BLYNK_WM_RTC_AP_CACHE_OFFSET, &apCache, sizeof(apCache));
+      
+#if USE_EARLY_WIFI
+      earlyWiFiSaved = saveRTCData(BLYNK_WM_RTC_EARLY_WIFI_OFFSET, &Blynk8266_WM_config.WiFi_Creds[apCache.wifiIndex], sizeof(WiFi_Credentials));
+#endif
+      
+#if ( BLYNK_WM_DEBUG > 2)
+      BLYNK_LOG4(BLYNK_F("SaveAPCache,BSSID="), WiFi.BSSIDstr(), BLYNK_F(",ch="), apCache.channel);
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    void clearAPCache()
+    {
+      apCacheValid = false;
+      invalidateRTCData(BLYNK_WM_RTC_AP_CACHE_OFFSET);
+    }
+    
+    //////////////////////////////////////
+    
+    // Start direct connection to the cached AP, on its channel, without scanning. Return false if no valid cache
+    bool beginAPCache()
+    {
+      if (!loadAPCache())
+        return false;
+        
+#if USE_EARLY_WIFI
+      if (earlyWiFiStarted)
+      {
+        // Already connecting since begin()
+        earlyWiFiStarted = false;
+        
+        return true;
+      }
+#endif
+        
+      const char* ssid  = Blynk8266_WM_config.WiFi_Creds[apCache.wifiIndex].wifi_ssid;
+      const char* pass  = Blynk8266_WM_config.WiFi_Creds[apCache.wifiIndex].wifi_pw;
+      
+      BLYNK_LOG4(BLYNK_F("Con2CachedAP:"), ssid, BLYNK_F(",ch="), apCache.channel);
+      
+#if USE_DHCP_LEASE_CACHE
+      beginDHCPLease(apCache.wifiIndex);
+#endif
+      
+      WiFi.begin(ssid, strlen(pass) ? pass : NULL, apCache.channel, apCache.bssid);
+      
+      return true;
+    }
+    
+    //////////////////////////////////////
+    
+    bool connectAPCache()
+    {
+      if (!beginAPCache())
+        return false;
+        
+      unsigned long startTime = millis();
+      
+      while ( (WiFi.status() != WL_CONNECTED) && (millis() - startTime < TIMEOUT_WIFI_AP_CACHE) )
+      {
+        delay(100);
+      }
+      
+      if (WiFi.status() == WL_CONNECTED)
+        return true;
+      
+      // AP moved to another channel, or not reachable
+      BLYNK_LOG1(BLYNK_F("CachedAP failed. Scan all"));
+      clearAPCache();
+      
+      return false;
+    }
+    
+    //////////////////////////////////////
+    
+#if USE_EARLY_WIFI
+
+    // Start connection to the cached AP, with the WiFi Credentials cached in RTC memory, before Config Data is loaded
+    void beginEarlyWiFi()
+    {
+      WiFi_Credentials creds;
+      
+      apCacheValid  = loadRTCData(BLYNK_WM_RTC_AP_CACHE_OFFSET, &apCache, sizeof(apCache));
+      apCacheLoaded = true;
+      
+      earlyWiFiSaved = loadRTCData(BLYNK_WM_RTC_EARLY_WIFI_OFFSET, &creds, sizeof(creds));
+      
+      if ( !apCacheValid || !earlyWiFiSaved || (apCache.channel == 0) || (calcCRC32(&creds, sizeof(creds)) != apCache.credsCRC) )
+        return;
+        
+      BLYNK_LOG4(BLYNK_F("EarlyCon2CachedAP:"), creds.wifi_ssid, BLYNK_F(",ch="), apCache.channel);
+      
+      setHostname();
+      
+      WiFi.begin(creds.wifi_ssid, strlen(creds.wifi_pw) ? creds.wifi_pw : NULL, apCache.channel, apCache.bssid);
+      
+      earlyWiFiStarted = true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Config Data loaded. Keep the connection started by begin() only if going to connect, with unchanged WiFi Credentials
+    void confirmEarlyWiFi(bool willConnect)
+    {
+      if (!earlyWiFiStarted)
+        return;
+        
+      if (willConnect && loadAPCache())
+      {
+#if ( BLYNK_WM_DEBUG > 2)
+        BLYNK_LOG1(BLYNK_F("EarlyWiFi confirmed"));
+#endif
+        return;
+      }
+      
+      BLYNK_LOG1(BLYNK_F("EarlyWiFi aborted"));
+      
+      earlyWiFiStarted = false;
+      WiFi.disconnect();
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+#endif
+
+#if USE_WIFI_SCAN_RANK
+
+    void loadWiFiHistory()
+    {
+      if (wifiHistoryLoaded)
+        return;
+        
+      if (!loadRTCData(BLYNK_WM_RTC_WIFI_HISTORY_OFFSET, &wifiHistory, sizeof(wifiHistory)))
+      {
+        memset(&wifiHistory, 0, sizeof(wifiHistory));
+        wifiHistory.lastIndex = 0xFF;
+      }
+      
+      // Drop history of changed WiFi Credentials
+      for (uint8_t index = 0; index < NUM_WIFI_CREDENTIALS; index++)
+      {
+        uint32_t credsCRC = calcWiFiCredsCRC(index);
+        
+        if (wifiHistory.credsCRC[index] != credsCRC)
+        {
+          wifiHistory.credsCRC[index]  = credsCRC;
+          wifiHistory.failCount[index] = 0;
+          
+          if (wifiHistory.lastIndex == index)
+            wifiHistory.lastIndex = 0xFF;
+        }
+      }
+      
+      wifiHistoryLoaded = true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Record result of connection to WiFi_Creds[index]. RTC memory is written only when history changed
+    void saveWiFiHistory(uint8_t index, bool connected)
+    {
+      if (index >= NUM_WIFI_CREDENTIALS)
+        return;
+        
+      loadWiFiHistory();
+      
+      if (connected)
+      {
+        if ( (wifiHistory.failCount[index] == 0) && (wifiHistory.lastIndex == index) )
+          return;
+          
+        wifiHistory.failCount[index]  = 0;
+        wifiHistory.lastIndex         = index;
+      }
+      else
+      {
+        if (wifiHistory.failCount[index] == 0xFF)
+          return;
+          
+        wifiHistory.failCount[index]++;
+      }
+      
+      saveRTCData(BLYNK_WM_RTC_WIFI_HISTORY_OFFSET, &wifiHistory, sizeof(wifiHistory));
+    }
+    
+    //////////////////////////////////////
+    
+    bool isWiFiScanFresh()
+    {
+      return ( wifiScanValid && (millis() - wifiScanTime < WIFI_SCAN_CACHE_TTL) );
+    }
+    
+    //////////////////////////////////////
+    
+    // Keep the strongest AP of each WiFi Credentials
+    void scanWiFi()
+    {
+      BLYNK_LOG1(BLYNK_F("Scan WiFi"));
+      
+      int16_t numNetworks = WiFi.scanNetworks();
+      
+      memset(wifiScan, 0, sizeof(wifiScan));
+      
+      for (int16_t i = 0; i < numNetworks; i++)
+      {
+        uint8_t index = getWiFiCredsIndex(WiFi.SSID(i).c_str());
+        int32_t rssi  = WiFi.RSSI(i);
+        
+        if ( (index >= NUM_WIFI_CREDENTIALS) || ( (wifiScan[index].rssi != 0) && (rssi <= wifiScan[index].rssi) ) )
+          continue;
+          
+        wifiScan[index].rssi    = (rssi < -127) ? -127 : ( (rssi >= 0) ? -1 : rssi );
+        wifiScan[index].channel = WiFi.channel(i);
+        memcpy(wifiScan[index].bssid, WiFi.BSSID(i), sizeof(wifiScan[index].bssid));
+      }
+      
+      WiFi.scanDelete();
+      
+      wifiScanTime  = millis();
+      wifiScanValid = (numNetworks >= 0);
+    }
+    
+    //////////////////////////////////////
+    
+    // Rank of WiFi_Creds[index], higher is better. Without fresh scan, rank uses history only
+    int16_t getWiFiRank(uint8_t index)
+    {
+      int16_t rank = 0;
+      
+      if (isWiFiScanFresh())
+      {
+        // Not found by scan => last
+        rank = wifiScan[index].rssi ? wifiScan[index].rssi : -1000;
+      }
+      
+      if (wifiHistory.lastIndex == index)
+        rank += WIFI_RANK_HYSTERESIS;
+        
+      rank -= (int16_t) WIFI_RANK_FAIL_PENALTY * wifiHistory.failCount[index];
+      
+      return rank;
+    }
+    
+    //////////////////////////////////////
+    
+    // Sort wifiOrder, best first. Return number of WiFi Credentials found by a fresh scan
+    uint8_t rankWiFi(bool allowScan)
+    {
+      uint8_t numFound = 0;
+      int16_t rank[NUM_WIFI_CREDENTIALS];
+      
+      if (allowScan && !isWiFiScanFresh())
+        scanWiFi();
+        
+      loadWiFiHistory();
+      
+      for (uint8_t index = 0; index < NUM_WIFI_CREDENTIALS; index++)
+      {
+        rank[index] = getWiFiRank(index);
+        
+        if (isWiFiScanFresh() && wifiScan[index].rssi)
+          numFound++;
+        
+        // Insertion sort, stable for equal rank
+        uint8_t n = index;
+        
+        while ( (n > 0) && (rank[wifiOrder[n - 1]] < rank[index]) )
+        {
+          wifiOrder[n] = wifiOrder[n - 1];
+          n--;
+        }
+        
+        wifiOrder[n] = index;
+      }
+      
+#if ( BLYNK_WM_DEBUG > 2)
+      for (uint8_t n = 0; n < NUM_WIFI_CREDENTIALS; n++)
+      {
+        BLYNK_LOG4(BLYNK_F("WiFiRank:"), Blynk8266_WM_config.WiFi_Creds[wifiOrder[n]].wifi_ssid, BLYNK_F(",rank="), rank[wifiOrder[n]]);
+      }
+#endif
+      
+      return numFound;
+    }
+    
+    //////////////////////////////////////
+    
+    // Connect to the BSSID and channel found by a fresh scan, or let WiFi find the AP
+    void beginRankedWiFi(uint8_t index)
+    {
+      const char* ssid  = Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid;
+      const char* pass  = Blynk8266_WM_config.WiFi_Creds[index].wifi_pw;
+      
+      if (isWiFiScanFresh() && wifiScan[index].rssi)
+      {
+        BLYNK_LOG6(BLYNK_F("Con2:"), ssid, BLYNK_F(",ch="), wifiScan[index].channel, BLYNK_F(",RSSI="), wifiScan[index].rssi);
+        
+        WiFi.begin(ssid, strlen(pass) ? pass : NULL, wifiScan[index].channel, wifiScan[index].bssid);
+      }
+      else
+      {
+        BLYNK_LOG2(BLYNK_F("Con2:"), ssid);
+        
+        WiFi.begin(ssid, pass);
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    // Try WiFi Credentials found by scan, best ranked first
+    bool connectRankedWiFi()
+    {
+      uint8_t numFound = rankWiFi(true);
+      
+      for (uint8_t n = 0; n < numFound; n++)
+      {
+        uint8_t index = wifiOrder[n];
+        
+#if USE_DHCP_LEASE_CACHE
+        beginDHCPLease(index);
+#endif
+        beginRankedWiFi(index);
+        
+        unsigned long startTime = millis();
+        
+        while ( (WiFi.status() != WL_CONNECTED) && (millis() - startTime < TIMEOUT_WIFI_RANKED) )
+        {
+          delay(100);
+        }
+        
+        if (WiFi.status() == WL_CONNECTED)
+          return true;
+          
+        saveWiFiHistory(index, false);
+      }
+      
+      // Scan again at next attempt
+      wifiScanValid = false;
+      
+      return false;
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+#if USE_DHCP_LEASE_CACHE
+
+    // Return true if a cached lease can be reused for WiFi_Creds[index]
+    bool loadDHCPLease(uint8_t index)
+    {
+      if (!dhcpLeaseLoaded)
+      {
+        dhcpLeaseValid  = loadRTCData(BLYNK_WM_RTC_DHCP_LEASE_OFFSET, &dhcpLease, sizeof(dhcpLease));
+        dhcpLeaseLoaded = true;
+      }
+      
+      return ( dhcpLeaseValid && (dhcpLease.ip != 0) && (dhcpLease.wifiIndex == index) && (index < NUM_WIFI_CREDENTIALS) &&
+               (dhcpLease.reuseCount < DHCP_LEASE_MAX_REUSE) && (dhcpLease.credsCRC == calcWiFiCredsCRC(index)) );
+    }
+    
+    //////////////////////////////////////
+    
+    // Keep the lease of the connected WiFi. A reused lease only counts the reuse
+    void saveDHCPLease()
+    {
+      uint8_t index = getWiFiCredsIndex(WiFi.SSID().c_str());
+      
+      if (index >= NUM_WIFI_CREDENTIALS)
+        return;
+        
+      if (dhcpLeaseApplied && loadDHCPLease(index))
+      {
+        dhcpLease.reuseCount++;
+      }
+      else
+      {
+        dhcpLease.ip          = WiFi.localIP();
+        dhcpLease.gateway     = WiFi.gatewayIP();
+        dhcpLease.subnet      = WiFi.subnetMask();
+        dhcpLease.dns1        = WiFi.dnsIP(0);
+        dhcpLease.dns2        = WiFi.dnsIP(1);
+        dhcpLease.credsCRC    = calcWiFiCredsCRC(index);
+        dhcpLease.wifiIndex   = index;
+        dhcpLease.reuseCount  = 0;
+      }
+      
+      dhcpLeaseLoaded = true;
+      dhcpLeaseValid  = saveRTCData(BLYNK_WM_RTC_DHCP_LEASE_OFFSET, &dhcpLease, sizeof(dhcpLease));
+    }
+    
+    //////////////////////////////////////
+    
+    void clearDHCPLease()
+    {
+      dhcpLeaseValid = false;
+      invalidateRTCData(BLYNK_WM_RTC_DHCP_LEASE_OFFSET);
+    }
+    
+    //////////////////////////////////////
+    
+    // Set the cached lease of WiFi_Creds[index] as static IP, or use DHCP. Must be called after setHostname()
+    void beginDHCPLease(uint8_t index)
+    {
+      if (!loadDHCPLease(index))
+      {
+        endDHCPLease();
+        
+        return;
+      }
+      
+      BLYNK_LOG4(BLYNK_F("UseCachedLease,IP="), IPAddress(dhcpLease.ip), BLYNK_F(",reuse="), dhcpLease.reuseCount);
+      
+      WiFi.config(IPAddress(dhcpLease.ip), IPAddress(dhcpLease.gateway), IPAddress(dhcpLease.subnet),
+                  IPAddress(dhcpLease.dns1), IPAddress(dhcpLease.dns2));
+                  
+      dhcpLeaseApplied = true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Back to DHCP for next WiFi.begin()
+    void endDHCPLease()
+    {
+      if (!dhcpLeaseApplied)
+        return;
+        
+      WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
+      
+      dhcpLeaseApplied = false;
+    }
+    
+    //////////////////////////////////////
+    
+    // Blynk not connected with the reused lease, which may be outdated. Return true if lease was dropped
+    bool dropDHCPLease()
+    {
+      if (!dhcpLeaseApplied)
+        return false;
+        
+      BLYNK_LOG1(BLYNK_F("CachedLease failed. Use DHCP"));
+      
+      clearDHCPLease();
+      WiFi.disconnect();
+      endDHCPLease();
+      
+      return true;
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+#if RESET_DETECT_USE_RTC
+
+    // Count this reset in RTC memory, and clear noConfigPortal if DRD/MRD detected.
+    // Return false to use DRD/MRD in flash : RTC memory lost at power on, or flash flag possibly still set
+    bool detectResetRTC(bool& noConfigPortal)
+    {
+      resetDetectActive = true;
+      
+      if ( !loadRTCData(BLYNK_WM_RTC_RESET_DETECT_OFFSET, &resetDetectRTC, sizeof(resetDetectRTC)) || resetDetectRTC.flashPending )
+      {
+        resetDetectRTC.resetCount   = 0;
+        resetDetectRTC.flashPending = 1;
+        
+        saveRTCData(BLYNK_WM_RTC_RESET_DETECT_OFFSET, &resetDetectRTC, sizeof(resetDetectRTC));
+        
+        return false;
+      }
+      
+      if (++resetDetectRTC.resetCount >= RESET_DETECT_TIMES)
+      {
+#if ( BLYNK_WM_DEBUG > 1)
+        BLYNK_LOG1(BLYNK_F("Multi or Double Reset Detected in RTC"));
+#endif
+        noConfigPortal = false;
+        resetDetectRTC.resetCount = 0;
+      }
+      
+      saveRTCData(BLYNK_WM_RTC_RESET_DETECT_OFFSET, &resetDetectRTC, sizeof(resetDetectRTC));
+      
+      return true;
+    }
+    
+    //////////////////////////////////////
+    
+    // No other reset within RESET_DETECT_TIMEOUT. Flash flag, if any, is cleared by drd->loop() / mrd->loop()
+    void checkResetDetectRTC()
+    {
+      if ( !resetDetectActive || (millis() < RESET_DETECT_TIMEOUT * 1000UL) )
+        return;
+        
+      clearResetDetectRTC();
+    }
+    
+    //////////////////////////////////////
+    
+    void clearResetDetectRTC()
+    {
+      resetDetectActive = false;
+      
+      resetDetectRTC.resetCount   = 0;
+      resetDetectRTC.flashPending = 0;
+      
+      saveRTCData(BLYNK_WM_RTC_RESET_DETECT_OFFSET, &resetDetectRTC, sizeof(resetDetectRTC));
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+#if USE_DUTY_CYCLE
+
+    // drd->loop() / mrd->loop() isn't called while in deep sleep, so its timeout never passes. Clear the flag
+    // in flash and the RTC count now, or the next user reset would be taken as a double / multi reset
+    void stopResetDetect()
+    {
+#if USING_MRD
+      if (mrd)
+        mrd->stop();
+#else
+      if (drd)
+        drd->stop();
+#endif
+
+#if RESET_DETECT_USE_RTC
+      if (resetDetectActive)
+        clearResetDetectRTC();
+#endif
+    }
+    
+    //////////////////////////////////////////////
+    
+    void loadDutyCycle()
+    {
+      if (dutyCycleLoaded)
+        return;
+      
+      if (!loadRTCData(BLYNK_WM_RTC_DUTY_CYCLE_OFFSET, &dutyCycle, sizeof(dutyCycle)) || 
+          (dutyCycle.queueCount > DUTY_CYCLE_QUEUE_SIZE) )
+      {
+        // Power-on or RTC data lost
+        memset(&dutyCycle, 0, sizeof(dutyCycle));
+      }
+      
+      dutyCycleLoaded = true;
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Ping Blynk server after writes. The server processes messages in order, so any reply after the ping
+    // means all writes were received
+    bool waitDutyCycleAck(unsigned long startTime, uint32_t timeout)
+    {
+      millis_time_t lastActivity = Base::lastActivityIn;
+      
+      Base::sendCmd(BLYNK_CMD_PING);
+      
+      while (millis() - startTime < timeout)
+      {
+        Base::run();
+        
+        if (!connected())
+          return false;
+        
+        if (Base::lastActivityIn != lastActivity)
+          return true;
+        
+        delay(1);
+      }
+      
+      BLYNK_LOG1(BLYNK_F("DutyCycle:no ack"));
+      
+      return false;
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_RUN_TIME_CHECK
+
+    void checkRunTime(uint32_t runTime)
+    {
+      bool longest = (runTime > maxRunTime);
+      
+      if (longest)
+        maxRunTime = runTime;
+      
+      if (runTime <= RUN_TIME_BUDGET)
+        return;
+        
+      runOverruns++;
+      
+      if (longest)
+      {
+#if USE_ASYNC_CONNECT
+        BLYNK_LOG4(BLYNK_F("run() overrun(ms)="), runTime, BLYNK_F(",ConnState="), runStartState);
+#else
+        BLYNK_LOG2(BLYNK_F("run() overrun(ms)="), runTime);
+#endif
+      }
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_TIME_SERVICE
+
+    void beginTimeService()
+    {
+      BlynkWM_Time_RTC timeRTC;
+      
+      // Clock is kept by ESP32 across soft resets, not by ESP8266
+      if ( !isTimeValid() && loadRTCData(BLYNK_WM_RTC_TIME_OFFSET, &timeRTC, sizeof(timeRTC)) )
+      {
+        // Add time since reset. Time lost in reset makes clock a bit late, still good to verify certificates
+        struct timeval tv = { (time_t) (timeRTC.epoch + millis() / 1000), 0 };
+        
+        settimeofday(&tv, NULL);
+        
+        BLYNK_LOG2(BLYNK_F("Time from RTC="), timeRTC.epoch);
+      }
+      
+      // Only once. SNTP syncs in the background
+      configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Keep time in RTC memory, plus seconds to add, e.g. for deep sleep
+    void saveTimeRTC(uint32_t addSeconds)
+    {
+      if (!isTimeValid())
+        return;
+      
+      BlynkWM_Time_RTC timeRTC = { (uint32_t) time(nullptr) + addSeconds };
+      
+      timeSaved     = saveRTCData(BLYNK_WM_RTC_TIME_OFFSET, &timeRTC, sizeof(timeRTC));
+      timeSaveTime  = millis();
+    }
+    
+    //////////////////////////////////////////////
+    
+    void checkTimeService()
+    {
+      if ( !timeSaved || (millis() - timeSaveTime >= TIME_SAVE_INTERVAL) )
+      {
+        saveTimeRTC(0);
+      }
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_RECONNECT_BACKOFF
+
+    // Schedule next reconnect attempt, doubling the backoff of the failed layer up to its max
+    void scheduleReconnect(bool wifiFailed)
+    {
+      uint32_t& backoff   = wifiFailed ? reconnectWiFiBackoff : reconnectBlynkBackoff;
+      uint32_t  minDelay  = wifiFailed ? RECONNECT_WIFI_BACKOFF_MIN : RECONNECT_BLYNK_BACKOFF_MIN;
+      uint32_t  maxDelay  = wifiFailed ? RECONNECT_WIFI_BACKOFF_MAX : RECONNECT_BLYNK_BACKOFF_MAX;
+      
+      if (backoff == 0)
+        backoff = minDelay;
+      else
+        backoff = (backoff > maxDelay / 2) ? maxDelay : backoff * 2;
+      
+      uint32_t jitter         = backoff * RECONNECT_BACKOFF_JITTER / 100;
+      uint32_t reconnectDelay = backoff - jitter + random(2 * jitter + 1);
+      
+      nextReconnectTime   = millis() + reconnectDelay;
+      reconnectScheduled  = true;
+      
+      BLYNK_LOG4(BLYNK_F("Reconnect in ms="), reconnectDelay, BLYNK_F(",WiFi lost="), wifiFailed);
+    }
+    
+    //////////////////////////////////////
+    
+    void resetReconnectBackoff()
+    {
+      reconnectWiFiBackoff  = 0;
+      reconnectBlynkBackoff = 0;
+      reconnectScheduled    = false;
+    }
+    
+    //////////////////////////////////////
+    
+    bool isReconnectDue()
+    {
+      return ( (long) (millis() - nextReconnectTime) >= 0 );
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+#if USE_BOOT_TIMING
+
+    // Keep the first time a phase is reached
+    void setBootPhase(uint32_t& phaseTime)
+    {
+      if ( (phaseTime == 0) && !bootTimingDone )
+      {
+        phaseTime = millis();
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    void formatBootTiming(char* line, size_t lineSize)
+    {
+      snprintf(line, lineSize, "begin=%lu,rst=%lu,cfg=%lu,wifi=%lu,dns=%lu,ntp=%lu,tcp=%lu,login=%lu",
+               (unsigned long) bootTiming.begin, (unsigned long) bootTiming.resetDetect, (unsigned long) bootTiming.config,
+               (unsigned long) bootTiming.wifi,  (unsigned long) bootTiming.dns,         (unsigned long) bootTiming.ntp,
+               (unsigned long) bootTiming.tcp,   (unsigned long) bootTiming.login);
+               
+#if USE_RTC_CONFIG_CACHE
+      size_t len = strlen(line);
+      
+      snprintf(line + len, lineSize - len, ",cfgSaved=%u", configCacheTimeSaved);
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    // Blynk logged in : stop recording, then print and optionally write to BOOT_TIMING_VPIN
+    void finishBootTiming()
+    {
+      if (bootTimingDone)
+        return;
+        
+      setBootPhase(bootTiming.wifi);
+      setBootPhase(bootTiming.login);
+      
+      bootTimingDone = true;
+      
+      printBootTiming();
+      
+#if (BOOT_TIMING_VPIN >= 0)
+      char line[160];
+      
+      formatBootTiming(line, sizeof(line));
+      Base::virtualWrite(BOOT_TIMING_VPIN, line);
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+    void checkConnectionEvents()
+    {
+      bool isConnected = ( (WiFi.status() == WL_CONNECTED) && connected() );
+      
+      if (isConnected == lastConnected)
+        return;
+        
+      lastConnected = isConnected;
+      
+#if USE_RTC_CONFIG_CACHE
+      // Cache the Credentials of this connection, unless they come from the cache
+      if (isConnected && !configCacheLoaded)
+      {
+        saveConfigCache();
+      }
+#endif
+      
+#if USE_BOOT_TIMING
+      if (isConnected)
+      {
+        finishBootTiming();
+      }
+#endif
+      
+      if (isConnected && connectedCallback)
+      {
+        connectedCallback();
+      }
+      else if (!isConnected && disconnectedCallback)
+      {
+        disconnectedCallback();
+      }
+    }
+    
+    //////////////////////////////////////
+
+#if USE_ASYNC_CONNECT
+
+    bool isConnecting()
+    {
+      return ( (connectState != BLYNK_WM_STATE_IDLE) && (connectState != BLYNK_WM_STATE_CONNECTED) );
+    }
+    
+    //////////////////////////////////////
+    
+    void startConnect(bool fromBegin)
+    {
+      connectFromBegin  = fromBegin;
+      connectRounds     = 0;
+      connectWiFiIndex  = 0;
+      connectBlynkIndex = 0;
+      
+#if USE_WIFI_AP_CACHE
+      connectAPCacheTried = false;
+#endif
+
+#if USE_WIFI_SCAN_RANK
+      // No blocking scan, use cached scan if still fresh
+      rankWiFi(false);
+#endif
+      
+      if (WiFi.status() == WL_CONNECTED)
+      {
+        connectFirstBlynkServer();
+      }
+      else
+      {
+        setConnectState(BLYNK_WM_STATE_WIFI);
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    void connectFirstBlynkServer()
+    {
+      connectBlynkIndex = 0;
+      
+#if USE_BLYNK_SERVER_PROBE
+      setConnectState(BLYNK_WM_STATE_PROBE);
+#else
+      setConnectState(BLYNK_WM_STATE_DNS);
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    // Index in WiFi_Creds of the WiFi to connect, best ranked first with USE_WIFI_SCAN_RANK
+    uint8_t getConnectWiFi()
+    {
+#if USE_WIFI_SCAN_RANK
+      return wifiOrder[connectWiFiIndex];
+#else
+      return connectWiFiIndex;
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    // Index in Blynk_Creds of the server to connect, fastest first with USE_BLYNK_SERVER_PROBE
+    uint8_t getConnectServer()
+    {
+#if USE_BLYNK_SERVER_PROBE
+      return serverOrder[connectBlynkIndex];
+#else
+      return connectBlynkIndex;
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    static void dnsFoundCallback(const char* name, const ip_addr_t* ipaddr, void* callbackArg)
+    {
+      BlynkWifi* self = (BlynkWifi*) callbackArg;
+      
+      // Ignore late answer to an abandoned request
+      if ( (self->dnsHost == NULL) || (strcmp(name, self->dnsHost) != 0) )
+        return;
+        
+      if (ipaddr)
+      {
+        self->dnsIP     = IPAddress(ip_addr_get_ip4_u32(ipaddr));
+        self->dnsResult = 1;
+      }
+      else
+      {
+        self->dnsResult = -1;
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    // Entry actions of each connection step
+    void setConnectState(BlynkWM_ConnectState state)
+    {
+      connectState      = state;
+      connectStateTime  = millis();
+      
+#if ( BLYNK_WM_DEBUG > 2)
+      BLYNK_LOG2(BLYNK_F("ConnState="), state);
+#endif
+      
+      switch (state)
+      {
+        case BLYNK_WM_STATE_WIFI:
+        
+#if USE_WIFI_AP_CACHE
+          connectUsingAPCache = false;
+          
+          if (!connectAPCacheTried)
+          {
+            connectAPCacheTried = true;
+            
+            WiFi.mode(WIFI_STA);
+            setHostname();
+            
+            connectUsingAPCache = beginAPCache();
+            
+            if (connectUsingAPCache)
+              break;
+          }
+#endif
+          
+          // Skip empty WiFi credentials
+          while ( (connectWiFiIndex < NUM_WIFI_CREDENTIALS) && (strlen(Blynk8266_WM_config.WiFi_Creds[getConnectWiFi()].wifi_ssid) == 0) )
+          {
+            connectWiFiIndex++;
+          }
+          
+          if (connectWiFiIndex >= NUM_WIFI_CREDENTIALS)
+          {
+            BLYNK_LOG1(BLYNK_F("WiFi not connected"));
+            connectFailed(true);
+            
+            return;
+          }
+          
+          WiFi.mode(WIFI_STA);
+          setHostname();
+          
+#if USE_DHCP_LEASE_CACHE
+          beginDHCPLease(getConnectWiFi());
+#endif
+
+#if USE_WIFI_SCAN_RANK
+          beginRankedWiFi(getConnectWiFi());
+#else
+          BLYNK_LOG2(BLYNK_F("Con2:"), Blynk8266_WM_config.WiFi_Creds[getConnectWiFi()].wifi_ssid);
+          
+          WiFi.begin(Blynk8266_WM_config.WiFi_Creds[getConnectWiFi()].wifi_ssid, Blynk8266_WM_config.WiFi_Creds[getConnectWiFi()].wifi_pw);
+#endif
+          
+          break;
+          
+#if USE_BLYNK_SERVER_PROBE
+        case BLYNK_WM_STATE_PROBE:
+        
+          if (!startServerProbe())
+          {
+            setConnectState(BLYNK_WM_STATE_DNS);
+          }
+          
+          break;
+#endif
+          
+        case BLYNK_WM_STATE_DNS:
+        {
+          // Resolve without blocking. lwIP caches the answer, so the following connect() won't block on DNS
+          ip_addr_t addr;
+          
+          dnsHost   = Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_server;
+          dnsResult = 0;
+          
+#if USE_DNS_CACHE
+          // Use the last known IP first, without DNS
+          connectUsingCachedIP = getDNSCache(getConnectServer(), dnsIP);
+          
+          if (connectUsingCachedIP)
+          {
+            BLYNK_LOG4(BLYNK_F("Con2CachedIP:"), dnsHost, BLYNK_F(",IP="), dnsIP);
+            dnsResult = 1;
+            
+            break;
+          }
+#endif
+          
+          err_t err = dns_gethostbyname(dnsHost, &addr, dnsFoundCallback, this);
+          
+          if (err == ERR_OK)
+          {
+            // Cached, or IP address
+            dnsIP     = IPAddress(ip_addr_get_ip4_u32(&addr));
+            dnsResult = 1;
+          }
+          else if (err != ERR_INPROGRESS)
+          {
+            dnsResult = -1;
+          }
+          
+          break;
+        }
+          
+        case BLYNK_WM_STATE_TCP:
+        
+          dnsHost = NULL;
+          
+#if USE_DNS_CACHE
+          if (connectUsingCachedIP)
+          {
+            config(Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_token, dnsIP, Blynk8266_WM_config.blynk_port);
+          }
+          else
+#endif
+          {
+            config(Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_token,
+                   Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_server, Blynk8266_WM_config.blynk_port);
+          }
+                 
+          // Timeout 0 : only sets Blynk state to connecting. TCP connect and login are done by Base::run()
+          Base::connect(0);
+          
+          break;
+          
+        case BLYNK_WM_STATE_CONNECTED:
+        
+          BLYNK_LOG4(BLYNK_F("Connected to BlynkServer="), Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_server,
+                     BLYNK_F(",Token="), Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_token);
+                     
+#if USE_DNS_CACHE
+          refreshDNSCache(getConnectServer());
+#endif
+                     
+          connectFromBegin = false;
+          
+#if USE_RTC_CONFIG_CACHE
+          connectedBlynkIndex = getConnectServer();
+#endif
+          
+#if USE_BOOT_TIMING
+          finishBootTiming();
+#endif
+          
+          // turn the LED_BUILTIN OFF to tell us we exit configuration mode.
+          digitalWrite(LED_BUILTIN, LED_OFF);
+          
+          break;
+          
+        default:
+        
+          dnsHost = NULL;
+          
+          break;
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    void connectFailed(bool wifiFailed)
+    {
+      if (!connectFromBegin)
+      {
+        // run() will start again
+        setConnectState(BLYNK_WM_STATE_IDLE);
+        
+#if USE_RECONNECT_BACKOFF
+        scheduleReconnect(wifiFailed);
+#endif
+        
+        return;
+      }
+      
+      if (wifiFailed)
+      {
+        BLYNK_LOG1(BLYNK_F("bg: Fail2connect WiFi+Blynk"));
+      }
+      else if (++connectRounds < ASYNC_BLYNK_ROUNDS_BEFORE_CP)
+      {
+        connectFirstBlynkServer();
+        
+        return;
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("bg: WiFi OK, Blynk not"));
+      }
+      
+      // failed to connect to WiFi or Blynk server, will start configuration mode
+      connectFromBegin = false;
+      setConnectState(BLYNK_WM_STATE_IDLE);
+      
+      startConfigurationModeOnFail();
+    }
+    
+    //////////////////////////////////////
+    
+    void connectNextBlynkServer()
+    {
+      conn.disconnect();
+      
+#if USE_DNS_CACHE
+      if (connectUsingCachedIP)
+      {
+        // Same server again, resolving its name
+        BLYNK_LOG1(BLYNK_F("CachedIP failed. Resolve again"));
+        
+        connectUsingCachedIP = false;
+        saveDNSCache(getConnectServer(), 0);
+        setConnectState(BLYNK_WM_STATE_DNS);
+        
+        return;
+      }
+#endif
+
+      if (++connectBlynkIndex < NUM_BLYNK_CREDENTIALS)
+      {
+        setConnectState(BLYNK_WM_STATE_DNS);
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("Blynk not connected"));
+        
+#if USE_DHCP_LEASE_CACHE
+        // Connect again with DHCP
+        if (dropDHCPLease())
+        {
+          connectWiFiIndex = 0;
+          setConnectState(BLYNK_WM_STATE_WIFI);
+          
+          return;
+        }
+#endif
+        
+        connectFailed(false);
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    // One connection step, without blocking except for TCP connect / TLS handshake in Base::run()
+    void connectStateMachine()
+    {
+      unsigned long stateTime = millis() - connectStateTime;
+      
+      // WiFi lost while connecting to Blynk
+      if ( (connectState > BLYNK_WM_STATE_WIFI) && (WiFi.status() != WL_CONNECTED) )
+      {
+        connectWiFiIndex = 0;
+        
+#if USE_WIFI_AP_CACHE
+        connectAPCacheTried = false;
+#endif
+        setConnectState(BLYNK_WM_STATE_WIFI);
+        
+        return;
+      }
+      
+      switch (connectState)
+      {
+        case BLYNK_WM_STATE_WIFI:
+        
+          if (WiFi.status() == WL_CONNECTED)
+          {
+            BLYNK_LOG4(BLYNK_F("SSID="), WiFi.SSID(), BLYNK_F(",RSSI="), WiFi.RSSI());
+            BLYNK_LOG4(BLYNK_F("Channel="), WiFi.channel(), BLYNK_F(",IP="), WiFi.localIP() );
+            
+#if USE_WIFI_AP_CACHE
+            saveAPCache();
+#endif
+
+#if USE_WIFI_SCAN_RANK
+            saveWiFiHistory(getWiFiCredsIndex(WiFi.SSID().c_str()), true);
+#endif
+
+#if USE_DHCP_LEASE_CACHE
+            saveDHCPLease();
+#endif
+
+#if USE_BOOT_TIMING
+            setBootPhase(bootTiming.wifi);
+#endif
+            
+            connectFirstBlynkServer();
+          }
+#if USE_WIFI_AP_CACHE
+          else if (connectUsingAPCache)
+          {
+            if (stateTime > TIMEOUT_WIFI_AP_CACHE)
+            {
+              // AP moved to another channel, or not reachable
+              BLYNK_LOG1(BLYNK_F("CachedAP failed. Try all"));
+              clearAPCache();
+              
+              setConnectState(BLYNK_WM_STATE_WIFI);
+            }
+          }
+#endif
+          else if (stateTime > TIMEOUT_ASYNC_WIFI)
+          {
+#if USE_WIFI_SCAN_RANK
+            saveWiFiHistory(getConnectWiFi(), false);
+#endif
+            connectWiFiIndex++;
+            setConnectState(BLYNK_WM_STATE_WIFI);
+          }
+          
+          break;
+          
+#if USE_BLYNK_SERVER_PROBE
+        case BLYNK_WM_STATE_PROBE:
+        
+          if (runServerProbe())
+          {
+            setConnectState(BLYNK_WM_STATE_DNS);
+          }
+          
+          break;
+#endif
+          
+        case BLYNK_WM_STATE_DNS:
+        
+          if (dnsResult > 0)
+          {
+#if ( BLYNK_WM_DEBUG > 2)
+            BLYNK_LOG2(BLYNK_F("DNS OK,IP="), dnsIP);
+#endif
+
+#if USE_BOOT_TIMING
+            setBootPhase(bootTiming.dns);
+#endif
+            setConnectState(BLYNK_WM_STATE_TCP);
+          }
+          else if ( (dnsResult < 0) || (stateTime > TIMEOUT_ASYNC_DNS) )
+          {
+            BLYNK_LOG2(BLYNK_F("DNS failed:"), Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_server);
+            connectNextBlynkServer();
+          }
+          
+          break;
+          
+        case BLYNK_WM_STATE_TCP:
+        
+          Base::run();
+          
+          // Connected, and login sent
+          if (conn.connected())
+          {
+#if USE_BOOT_TIMING
+            setBootPhase(bootTiming.tcp);
+#endif
+            setConnectState(BLYNK_WM_STATE_LOGIN);
+          }
+          else if (stateTime > TIMEOUT_ASYNC_TCP)
+          {
+            connectNextBlynkServer();
+          }
+          
+          break;
+          
+        case BLYNK_WM_STATE_LOGIN:
+        
+          Base::run();
+          
+          if (connected())
+          {
+            setConnectState(BLYNK_WM_STATE_CONNECTED);
+          }
+          else if (stateTime > TIMEOUT_ASYNC_LOGIN)
+          {
+            connectNextBlynkServer();
+          }
+          
+          break;
+          
+        default:
+          break;
+      }
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+#if USE_BLYNK_SERVER_PROBE
+
+    void sortServerOrder()
+    {
+      // Insertion sort, unknown latency last. Stable, so ties keep Blynk_Creds order
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        uint8_t   j       = i;
+        uint32_t  latency = serverLatency[i] ? serverLatency[i] : 0xFFFFFFFF;
+        
+        while ( (j > 0) && ( (serverLatency[serverOrder[j - 1]] ? serverLatency[serverOrder[j - 1]] : 0xFFFFFFFF) > latency ) )
+        {
+          serverOrder[j] = serverOrder[j - 1];
+          j--;
+        }
+        
+        serverOrder[j] = i;
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    void updateServerLatency(uint8_t index, uint32_t sample)
+    {
+      if (sample == 0)
+        sample = 1;
+        
+      // Exponentially weighted moving average, weight 1/4 for new sample
+      serverLatency[index] = (serverLatency[index] == 0) ? sample : ( (3 * (uint32_t) serverLatency[index] + sample) / 4 );
+    }
+    
+    //////////////////////////////////////
+    
+    // Delete the clients of closed probes. Return false if some are still closing
+    bool deleteServerProbes()
+    {
+      bool allDeleted = true;
+      
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        AsyncClient* client = serverProbes[i].client;
+        
+        if (client == NULL)
+          continue;
+          
+        if (serverProbes[i].closed)
+        {
+          serverProbes[i].client = NULL;
+          delete client;
+        }
+        else
+        {
+          allDeleted = false;
+        }
+      }
+      
+      return allDeleted;
+    }
+    
+    //////////////////////////////////////
+    
+    // Return false if probes of previous race are still closing
+    bool startServerProbe()
+    {
+      if (!deleteServerProbes())
+      {
+        sortServerOrder();
+        
+        return false;
+      }
+      
+      serverProbeStarted    = 0;
+      serverProbeStartTime  = millis();
+      
+      return true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Non-blocking TCP connection. Callbacks may run in another task, so they only set probe->result and probe->closed
+    void beginServerProbe(uint8_t index)
+    {
+      BlynkWM_ServerProbe* probe  = &serverProbes[index];
+      const char*          server = Blynk8266_WM_config.Blynk_Creds[index].blynk_server;
+      
+      probe->result = BLYNK_WM_PROBE_FAILED;
+      
+      if (strlen(server) == 0)
+        return;
+        
+      AsyncClient* client = new AsyncClient();
+      
+      if (client == NULL)
+        return;
+        
+      probe->client     = client;
+      probe->startTime  = millis();
+      probe->closed     = false;
+      probe->result     = BLYNK_WM_PROBE_PENDING;
+      
+      client->onConnect([](void* arg, AsyncClient* c)
+      {
+        BlynkWM_ServerProbe* probe = (BlynkWM_ServerProbe*) arg;
+        
+        probe->result = millis() - probe->startTime;
+        c->close(true);
+      }, probe);
+      
+      client->onError([](void* arg, AsyncClient* c, int8_t error)
+      {
+        (void) c;
+        (void) error;
+        
+        BlynkWM_ServerProbe* probe = (BlynkWM_ServerProbe*) arg;
+        
+        if (probe->result == BLYNK_WM_PROBE_PENDING)
+          probe->result = BLYNK_WM_PROBE_FAILED;
+      }, probe);
+      
+      client->onDisconnect([](void* arg, AsyncClient* c)
+      {
+        (void) c;
+        
+        BlynkWM_ServerProbe* probe = (BlynkWM_ServerProbe*) arg;
+        
+        if (probe->result == BLYNK_WM_PROBE_PENDING)
+          probe->result = BLYNK_WM_PROBE_FAILED;
+          
+        // Last access to probe from this callback
+        probe->closed = true;
+      }, probe);
+      
+      if (!client->connect(server, Blynk8266_WM_config.blynk_port))
+      {
+        // No callback when failed at once
+        probe->client = NULL;
+        probe->result = BLYNK_WM_PROBE_FAILED;
+        
+        delete client;
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    void finishServerProbe()
+    {
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        if ( (serverProbeStarted & (1UL << i)) == 0 )
+          continue;
+          
+        int32_t result = serverProbes[i].result;
+        
+        if (result >= 0)
+        {
+          updateServerLatency(i, result);
+        }
+        else if (result == BLYNK_WM_PROBE_FAILED)
+        {
+          updateServerLatency(i, TIMEOUT_BLYNK_SERVER_PROBE);
+        }
+        else
+        {
+          // Slower than the winner. Stop it, and keep its average. Deleted when closed, at next race
+          AsyncClient* client = serverProbes[i].client;
+          
+          if (client && !serverProbes[i].closed)
+            client->close(true);
+        }
+      }
+      
+      sortServerOrder();
+      
+#if ( BLYNK_WM_DEBUG > 1)
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        BLYNK_LOG4(BLYNK_F("Probe:"), Blynk8266_WM_config.Blynk_Creds[i].blynk_server, BLYNK_F(",avg(ms)="), serverLatency[i]);
+      }
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    // Start probes when due. Return true when done : a server connected, all failed, or timeout
+    bool runServerProbe()
+    {
+      unsigned long elapsed = millis() - serverProbeStartTime;
+      bool          pending = false;
+      
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        if ( (serverProbeStarted & (1UL << i)) == 0 )
+        {
+          if (elapsed < (unsigned long) i * BLYNK_SERVER_PROBE_STAGGER_MS)
+          {
+            pending = true;
+            continue;
+          }
+          
+          serverProbeStarted |= (1UL << i);
+          beginServerProbe(i);
+        }
+        
+        if (serverProbes[i].result >= 0)
+        {
+          // First connected wins
+          finishServerProbe();
+          
+          return true;
+        }
+        
+        if (serverProbes[i].result == BLYNK_WM_PROBE_PENDING)
+          pending = true;
+      }
+      
+      if (pending && (elapsed < TIMEOUT_BLYNK_SERVER_PROBE))
+        return false;
+        
+      finishServerProbe();
+      
+      return true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Blocking race, used by connectMultiBlynk()
+    void probeBlynkServers()
+    {
+      if (!startServerProbe())
+        return;
+        
+      while (!runServerProbe())
+      {
+        delay(10);
+      }
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+    bool connectMultiBlynk()
+    {
+#define BLYNK_CONNECT_TIMEOUT_MS      10000L
+
+#if USE_BLYNK_SERVER_PROBE
+      // Race TCP connections to all servers, then try the fastest first
+      probeBlynkServers();
 #endif
-        }
-    
-        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+
+      for (uint16_t n = 0; n < NUM_BLYNK_CREDENTIALS; n++)
+      {
+#if USE_BLYNK_SERVER_PROBE
+        uint16_t i = serverOrder[n];
+#else
+        uint16_t i = n;
+#endif
+
+#if USE_DNS_CACHE
+        // Connect to the last known IP first, without DNS
+        bool connectedToCachedIP = connectCachedIP(i);
         
-        #if ( USE_DYNAMIC_PARAMETERS && ( BLYNK_WM_DEBUG > 2) )   
-        for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+        if (!connectedToCachedIP)
+#endif
         {
-          BLYNK_LOG4(BLYNK_F("g:myMenuItems["), i, BLYNK_F("]="), myMenuItems[i].pdata );
+          config(Blynk8266_WM_config.Blynk_Creds[i].blynk_token,
+                 Blynk8266_WM_config.Blynk_Creds[i].blynk_server, Blynk8266_WM_config.blynk_port);
         }
-        #endif
-        
-        // Don't need
-        Blynk8266_WM_config.checkSum = 0;
 
-        saveAllConfigData();
+        if ( connected() || connect(BLYNK_CONNECT_TIMEOUT_MS) )
+        {
+#if USE_DNS_CACHE
+          refreshDNSCache(i);
+#endif
 
-        return false;
-      }
-      else if ( !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) ) )
-      {
-        // If SSID, PW, Server,Token ="nothing", stay in config mode forever until having config Data.
-        return false;
+          BLYNK_LOG4(BLYNK_F("Connected to BlynkServer="), Blynk8266_WM_config.Blynk_Creds[i].blynk_server,
+                     BLYNK_F(",Token="), Blynk8266_WM_config.Blynk_Creds[i].blynk_token);
+
+#if USE_RTC_CONFIG_CACHE
+          connectedBlynkIndex = i;
+#endif
+
+          return true;
+        }
       }
-      else
+
+      BLYNK_LOG1(BLYNK_F("Blynk not connected"));
+      
+#if USE_DHCP_LEASE_CACHE
+      // Connect again with DHCP
+      if (dropDHCPLease())
       {
-        displayConfigData(Blynk8266_WM_config);
+        connectMultiWiFi();
       }
+#endif
+
+      return false;
 
-      return true;
     }
     
     //////////////////////////////////////
 
-    void saveConfigData()
-    {
-      int calChecksum = calcChecksum();
-      Blynk8266_WM_config.checkSum = calChecksum;
-      BLYNK_LOG4(BLYNK_F("SaveEEPROM,sz="), EEPROM_SIZE, BLYNK_F(",CSum=0x"), String(calChecksum, HEX))
+#if USE_DNS_CACHE
 
-      EEPROM.put(BLYNK_EEPROM_START, Blynk8266_WM_config);
+    uint32_t calcDNSCacheHostCRC(uint8_t index)
+    {
+      return calcCRC32(Blynk8266_WM_config.Blynk_Creds[index].blynk_server, strlen(Blynk8266_WM_config.Blynk_Creds[index].blynk_server));
+    }
+    
+    //////////////////////////////////////
+    
+    void loadDNSCache()
+    {
+      if (dnsCacheLoaded)
+        return;
+        
+      if (!loadRTCData(BLYNK_WM_RTC_DNS_CACHE_OFFSET, &dnsCache, sizeof(dnsCache)))
+      {
+        memset(&dnsCache, 0, sizeof(dnsCache));
+      }
       
-      EEPROM.commit();
+      dnsCacheLoaded = true;
     }
     
     //////////////////////////////////////
     
-    void saveAllConfigData()
+    // Return true and cached IP of Blynk server
+    bool getDNSCache(uint8_t index, IPAddress& ip)
     {
-      int calChecksum = calcChecksum();
-      Blynk8266_WM_config.checkSum = calChecksum;
-      BLYNK_LOG4(BLYNK_F("SaveEEPROM,sz="), EEPROM_SIZE, BLYNK_F(",CSum=0x"), String(calChecksum, HEX))
-
-      EEPROM.put(BLYNK_EEPROM_START, Blynk8266_WM_config);   
-
-#if USE_DYNAMIC_PARAMETERS         
-      EEPROM_putDynamicData();
-#endif
+      loadDNSCache();
+      
+      if ( (dnsCache.ip[index] == 0) || (dnsCache.hostCRC[index] != calcDNSCacheHostCRC(index)) )
+        return false;
+        
+      ip = IPAddress(dnsCache.ip[index]);
       
-      EEPROM.commit();
+      return true;
     }
     
     //////////////////////////////////////
-
+    
+    // RTC memory is written only when IP changed
+    void saveDNSCache(uint8_t index, uint32_t ip)
+    {
+      loadDNSCache();
+      
+      if (ip != 0)
+      {
+        dnsCacheResolveTime[index] = millis() | 1;
+      }
+      
+      uint32_t hostCRC = calcDNSCacheHostCRC(index);
+      
+      if ( (dnsCache.ip[index] == ip) && (dnsCache.hostCRC[index] == hostCRC) )
+        return;
+        
+      dnsCache.ip[index]      = ip;
+      dnsCache.hostCRC[index] = hostCRC;
+      
+      saveRTCData(BLYNK_WM_RTC_DNS_CACHE_OFFSET, &dnsCache, sizeof(dnsCache));
+      
+#if ( BLYNK_WM_DEBUG > 2)
+      BLYNK_LOG4(BLYNK_F("SaveDNSCache:"), Blynk8266_WM_config.Blynk_Creds[index].blynk_server, BLYNK_F(",IP="), IPAddress(ip));
 #endif
-
+    }
+    
     //////////////////////////////////////
-
-    bool connectMultiBlynk()
+    
+    static void dnsCacheFoundCallback(const char* name, const ip_addr_t* ipaddr, void* callbackArg)
     {
-#define BLYNK_CONNECT_TIMEOUT_MS      10000L
-
-      for (uint16_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      BlynkWifi* self = (BlynkWifi*) callbackArg;
+      
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
       {
-        config(Blynk8266_WM_config.Blynk_Creds[i].blynk_token,
-               Blynk8266_WM_config.Blynk_Creds[i].blynk_server, Blynk8266_WM_config.blynk_port);
-
-        if (connect(BLYNK_CONNECT_TIMEOUT_MS) )
+        if (strcmp(name, self->Blynk8266_WM_config.Blynk_Creds[i].blynk_server) == 0)
         {
-          BLYNK_LOG4(BLYNK_F("Connected to BlynkServer="), Blynk8266_WM_config.Blynk_Creds[i].blynk_server,
-                     BLYNK_F(",Token="), Blynk8266_WM_config.Blynk_Creds[i].blynk_token);
-          return true;
+          self->dnsRefreshIP[i]   = ipaddr ? ip_addr_get_ip4_u32(ipaddr) : 0;
+          self->dnsRefreshDone[i] = true;
         }
       }
-
-      BLYNK_LOG1(BLYNK_F("Blynk not connected"));
-
+    }
+    
+    //////////////////////////////////////
+    
+    // Non-blocking DNS query after connection, to keep cached IP up to date.
+    // lwIP answers at once when it has just resolved the name
+    void refreshDNSCache(uint8_t index)
+    {
+      if ( dnsCacheResolveTime[index] && (millis() - dnsCacheResolveTime[index] < DNS_CACHE_TTL * 1000UL) )
+        return;
+        
+      ip_addr_t addr;
+      
+      if (dns_gethostbyname(Blynk8266_WM_config.Blynk_Creds[index].blynk_server, &addr, dnsCacheFoundCallback, this) == ERR_OK)
+      {
+        saveDNSCache(index, ip_addr_get_ip4_u32(&addr));
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    // Called from run(), to save answers of refreshDNSCache()
+    void checkDNSCacheRefresh()
+    {
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        if (dnsRefreshDone[i])
+        {
+          dnsRefreshDone[i] = false;
+          
+          // Keep old IP if query failed
+          if (dnsRefreshIP[i] != 0)
+            saveDNSCache(i, dnsRefreshIP[i]);
+        }
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    // Blocking connection to cached IP, used by connectMultiBlynk(). Drop the IP if failed
+    bool connectCachedIP(uint8_t index)
+    {
+      IPAddress cachedIP;
+      
+      if (!getDNSCache(index, cachedIP))
+        return false;
+        
+      BLYNK_LOG4(BLYNK_F("Con2CachedIP:"), Blynk8266_WM_config.Blynk_Creds[index].blynk_server, BLYNK_F(",IP="), cachedIP);
+      
+      config(Blynk8266_WM_config.Blynk_Creds[index].blynk_token, cachedIP, Blynk8266_WM_config.blynk_port);
+      
+      if (connect(BLYNK_CONNECT_TIMEOUT_MS))
+        return true;
+        
+      BLYNK_LOG1(BLYNK_F("CachedIP failed. Resolve again"));
+      saveDNSCache(index, 0);
+      
       return false;
-
     }
     
     //////////////////////////////////////
+    
+#endif
 
     uint8_t connectMultiWiFi()
     {
@@ -2071,21 +5915,60 @@ class BlynkWifi
       setHostname();
            
       int i = 0;
-      status = wifiMulti.run();
-      delay(WIFI_MULTI_CONNECT_WAITING_MS);
-
-      while ( ( i++ < 10 ) && ( status != WL_CONNECTED ) )
+      
+#if USE_WIFI_AP_CACHE
+      // Try last connected AP first, without scanning all channels
+      if (connectAPCache())
+      {
+        status = WL_CONNECTED;
+      }
+      else
+#endif
+#if USE_WIFI_SCAN_RANK
+      if (connectRankedWiFi())
+      {
+        status = WL_CONNECTED;
+      }
+      else
+#endif
       {
+#if USE_DHCP_LEASE_CACHE
+        // WiFi to connect is chosen by WiFiMulti
+        endDHCPLease();
+#endif
+
         status = wifiMulti.run();
+        delay(WIFI_MULTI_CONNECT_WAITING_MS);
 
-        if ( status == WL_CONNECTED )
-          break;
-        else
-          delay(WIFI_MULTI_CONNECT_WAITING_MS);
+        while ( ( i++ < 10 ) && ( status != WL_CONNECTED ) )
+        {
+          status = wifiMulti.run();
+
+          if ( status == WL_CONNECTED )
+            break;
+          else
+            delay(WIFI_MULTI_CONNECT_WAITING_MS);
+        }
       }
 
       if ( status == WL_CONNECTED )
       {
+#if USE_WIFI_AP_CACHE
+        saveAPCache();
+#endif
+
+#if USE_WIFI_SCAN_RANK
+        saveWiFiHistory(getWiFiCredsIndex(WiFi.SSID().c_str()), true);
+#endif
+
+#if USE_DHCP_LEASE_CACHE
+        saveDHCPLease();
+#endif
+
+#if USE_BOOT_TIMING
+        setBootPhase(bootTiming.wifi);
+#endif
+
         BLYNK_LOG2(BLYNK_F("WiFi connected after time: "), i);
         BLYNK_LOG4(BLYNK_F("SSID="), WiFi.SSID(), BLYNK_F(",RSSI="), WiFi.RSSI());
         BLYNK_LOG4(BLYNK_F("Channel="), WiFi.channel(), BLYNK_F(",IP="), WiFi.localIP() );
@@ -2466,8 +6349,194 @@ class BlynkWifi
   #define CONFIG_TIMEOUT			60000L
 #endif
 
+    //////////////////////////////////////////////
+    
+    // Max size of the export data
+    uint16_t getExportMaxSize()
+    {
+#if USE_DYNAMIC_PARAMETERS
+      return sizeof(BlynkWM_Export_Header) + sizeof(Blynk8266_WM_config) + TLV_getMaxDataSize() + sizeof(uint32_t);
+#else
+      return sizeof(BlynkWM_Export_Header) + sizeof(Blynk8266_WM_config) + sizeof(uint32_t);
+#endif
+    }
+    
+    //////////////////////////////////////////////
+
+    // Download stored Config Data and Dynamic Params as one binary blob
+    void handleExport(AsyncWebServerRequest *request)
+    {
+      uint8_t* exportBuffer = new uint8_t[getExportMaxSize()];
+      
+      if (exportBuffer == NULL)
+      {
+        request->send(500, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Out of memory");
+        return;
+      }
+      
+      BlynkWM_Export_Header header;
+      uint8_t* _pointer = exportBuffer + sizeof(header);
+      
+      header.magic            = BLYNK_WM_EXPORT_MAGIC;
+      header.version          = BLYNK_WM_EXPORT_VERSION;
+      header.configSize       = sizeof(Blynk8266_WM_config);
+      header.reserved         = 0;
+      
+      // Same checkSum as stored
+      Blynk8266_WM_config.checkSum = calcChecksum();
+      memcpy(_pointer, &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+      _pointer += sizeof(Blynk8266_WM_config);
+      
+#if USE_DYNAMIC_PARAMETERS
+      header.dynamicDataSize  = TLV_serialize(_pointer);
+#else
+      header.dynamicDataSize  = 0;
+#endif
+      _pointer += header.dynamicDataSize;
+      
+      memcpy(exportBuffer, &header, sizeof(header));
+      
+      uint32_t crc = calcCRC32(exportBuffer, _pointer - exportBuffer);
+      memcpy(_pointer, &crc, sizeof(crc));
+      _pointer += sizeof(crc);
+
+      BLYNK_LOG2(BLYNK_F("h:Export,sz="), _pointer - exportBuffer);
+      
+      AsyncResponseStream *response = request->beginResponseStream("application/octet-stream");
+      
+      response->addHeader("Content-Disposition", "attachment; filename=\"blynk_wm.bin\"");
+      response->addHeader(FPSTR(WM_HTTP_CACHE_CONTROL), FPSTR(WM_HTTP_NO_STORE));
+      response->write(exportBuffer, _pointer - exportBuffer);
+      
+      delete [] exportBuffer;
+      
+      request->send(response);
+    }
+    
+    //////////////////////////////////////////////
+    
+    typedef struct
+    {
+      uint16_t size;
+      uint16_t capacity;
+      uint8_t  data[];
+    } BlynkWM_Import_Buffer;
+    
+    // Accumulate uploaded data (raw body or multipart file) into request->_tempObject, freed by AsyncWebServer
+    void handleImportData(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index)
+    {
+      BlynkWM_Import_Buffer* importBuffer = (BlynkWM_Import_Buffer*) request->_tempObject;
+      
+      if ( (index == 0) && (importBuffer == NULL) )
+      {
+        uint16_t capacity = getExportMaxSize();
+        
+        importBuffer = (BlynkWM_Import_Buffer*) malloc(sizeof(BlynkWM_Import_Buffer) + capacity);
+        
+        if (importBuffer)
+        {
+          importBuffer->size      = 0;
+          importBuffer->capacity  = capacity;
+        }
+        
+        request->_tempObject = importBuffer;
+      }
+      
+      if ( importBuffer && (index == importBuffer->size) && (importBuffer->size + len <= importBuffer->capacity) )
+      {
+        memcpy(importBuffer->data + importBuffer->size, data, len);
+        importBuffer->size += len;
+      }
+      else if (importBuffer)
+      {
+        // Too large or out of order => invalid
+        importBuffer->capacity = 0;
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Validate the uploaded blob, then save it with one write and reset
+    void handleImport(AsyncWebServerRequest *request)
+    {
+      BlynkWM_Import_Buffer* importBuffer = (BlynkWM_Import_Buffer*) request->_tempObject;
+      BlynkWM_Export_Header header;
+      
+      if ( (importBuffer == NULL) || (importBuffer->capacity == 0) || (importBuffer->size < sizeof(header) + sizeof(uint32_t)) )
+      {
+        request->send(400, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Invalid size");
+        return;
+      }
+      
+      uint8_t* _pointer = importBuffer->data;
+      uint32_t crc;
+      
+      memcpy(&header, _pointer, sizeof(header));
+      memcpy(&crc, _pointer + importBuffer->size - sizeof(crc), sizeof(crc));
+      
+      if ( (header.magic != BLYNK_WM_EXPORT_MAGIC) || (header.version != BLYNK_WM_EXPORT_VERSION) || 
+           (header.configSize != sizeof(Blynk8266_WM_config)) ||
+           (importBuffer->size != sizeof(header) + header.configSize + header.dynamicDataSize + sizeof(crc)) ||
+           (crc != calcCRC32(_pointer, importBuffer->size - sizeof(crc))) )
+      {
+        BLYNK_LOG1(BLYNK_F("h:Import invalid"));
+        request->send(400, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Invalid data");
+        return;
+      }
+      
+      _pointer += sizeof(header);
+      
+      Blynk_WM_Configuration importConfig;
+      
+      memcpy(&importConfig, _pointer, sizeof(importConfig));
+      _pointer += sizeof(importConfig);
+      
+      // Must be data of the same board type
+      if (strncmp(importConfig.header, BLYNK_BOARD_TYPE, sizeof(importConfig.header)) != 0)
+      {
+        BLYNK_LOG1(BLYNK_F("h:Import wrong board type"));
+        request->send(400, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Wrong board type");
+        return;
+      }
+      
+#if USE_DYNAMIC_PARAMETERS
+      // myMenuItems[] is untouched if TLV data is invalid
+      if ( (header.dynamicDataSize > 0) && !TLV_deserialize(_pointer, header.dynamicDataSize) )
+      {
+        request->send(400, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Invalid Dynamic Data");
+        return;
+      }
+#endif
+      
+      memcpy(&Blynk8266_WM_config, &importConfig, sizeof(Blynk8266_WM_config));
+      
+      BLYNK_LOG1(BLYNK_F("h:Import OK"));
+      
+      saveAllConfigData();
+      
+      // Done with CP, Clear CP Flag here if forced
+      if (isForcedConfigPortal)
+      {
+        clearForcedCP();
+      }
+      
+      request->send(200, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Imported. Reset");
+
+      BLYNK_LOG1(BLYNK_F("h:Rst"));
+
+      // Delay then reset the board after save data
+      delay(1000);
+      ESP.reset();
+    }
+    
+    //////////////////////////////////////////////
+
     void startConfigurationMode()
     {
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
       // turn the LED_BUILTIN ON to tell us we are in configuration mode.
       digitalWrite(LED_BUILTIN, LED_ON);
 
@@ -2513,7 +6582,16 @@ class BlynkWifi
       //See https://stackoverflow.com/questions/39803135/c-unresolved-overloaded-function-type?rq=1
       if (server)
       {
-        server->on("/", HTTP_GET, [this](AsyncWebServerRequest * request)  { handleRequest(request); });        
+        server->on("/", HTTP_GET, [this](AsyncWebServerRequest * request)  { handleRequest(request); });
+        
+        // Cloning : download / upload all stored data as one binary blob
+        server->on("/export", HTTP_GET, [this](AsyncWebServerRequest * request)  { handleExport(request); });
+        server->on("/import", HTTP_POST, [this](AsyncWebServerRequest * request)  { handleImport(request); },
+                   [this](AsyncWebServerRequest * request, const String& filename, size_t index, uint8_t *data, size_t len, bool final)
+                   { (void) filename; (void) final; handleImportData(request, data, len, index); },
+                   [this](AsyncWebServerRequest * request, uint8_t *data, size_t len, size_t index, size_t total)
+                   { (void) total; handleImportData(request, data, len, index); });
+        
         server->begin();
       }
 
@@ -2535,6 +6613,11 @@ class BlynkWifi
 #endif        
       } 
       configuration_mode = true;
+      
+      if (portalCallback)
+      {
+        portalCallback();
+      }
     }
 };
 
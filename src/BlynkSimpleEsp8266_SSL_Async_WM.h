@@ -137,7 +137,7 @@ static const unsigned char BLYNK_DEFAULT_CERT_DER[] PROGMEM =
   #endif
 
   // EEPROM Memory Address for the MultiResetDetector to use
-  #ifndef MRD_TIMEOUT
+  #ifndef MRD_ADDRESS
     #define MRD_ADDRESS 0
   #endif
   
@@ -181,7 +181,9 @@ static const unsigned char BLYNK_DEFAULT_CERT_DER[] PROGMEM =
   #define DRD_TIMEOUT 10
 
   // RTC Memory Address for the DoubleResetDetector to use
-  #define DRD_ADDRESS 0
+  #ifndef DRD_ADDRESS
+    #define DRD_ADDRESS 0
+  #endif
   
   #include <ESP_DoubleResetDetector.h>      //https://github.com/khoih-prog/ESP_DoubleResetDetector
 
@@ -193,6 +195,31 @@ static const unsigned char BLYNK_DEFAULT_CERT_DER[] PROGMEM =
 #endif
 
 
+// TLS buffers of BearSSL. By default, receive buffer is for full 16KB records (16709 bytes), transmit buffer is
+// 837 bytes. With 512, 1024, 2048 or 4096, Max Fragment Length of that size is negotiated with the server, so that
+// receive buffer is (size + 325) bytes. Transmit buffer is then for 512-byte records (597 bytes), enough for Blynk.
+// If the server doesn't support it, receive buffer stays 16KB. Can also be set by Blynk.setTLSBufferSize()
+#ifndef TLS_BUFFER_SIZE
+  #define TLS_BUFFER_SIZE           0
+#endif
+
+// Keep the TLS session of the last connection, and offer it at reconnect. If the server still has it, the
+// abbreviated handshake skips certificate verification and key exchange
+#ifndef USE_TLS_SESSION
+  #define USE_TLS_SESSION           false
+#endif
+
+// Also keep the TLS session in RTC memory, to resume it after deep sleep or soft reset
+#ifndef TLS_SESSION_USE_RTC
+  #define TLS_SESSION_USE_RTC       false
+#endif
+
+#if ( TLS_SESSION_USE_RTC && !USE_TLS_SESSION )
+  #warning TLS_SESSION_USE_RTC needs USE_TLS_SESSION. Disable TLS_SESSION_USE_RTC
+  #undef TLS_SESSION_USE_RTC
+  #define TLS_SESSION_USE_RTC       false
+#endif
+
   template <typename Client>
 class BlynkArduinoClientSecure
   : public BlynkArduinoClientGen<Client>
@@ -208,19 +235,54 @@ class BlynkArduinoClientSecure
     }
 
     bool setCACert(const uint8_t* caCert, unsigned caCertLen) {
-      bool res = this->client->setCACert(caCert, caCertLen);
+      bool res = setTrustAnchors(caCert, caCertLen);
       if (!res) {
         BLYNK_LOG1("Failed to load root CA certificate!");
       }
       return res;
     }
 
+    // X509List reads DER certificates with memcpy_P, from PROGMEM or RAM
     bool setCACert_P(const uint8_t* caCert, unsigned caCertLen) {
-      bool res = this->client->setCACert_P(caCert, caCertLen);
-      if (!res) {
-        BLYNK_LOG1("Failed to load root CA certificate!");
+      return setCACert(caCert, caCertLen);
+    }
+    
+    // 512, 1024, 2048 or 4096 to negotiate Max Fragment Length, 0 for default buffers. For next connect()
+    void setTLSBufferSize(uint16_t size)
+    {
+      if (size != bufferSize)
+      {
+        bufferSize  = size;
+        mflnProbed  = false;
+        
+        if (!bufferSize)
+        {
+          // Full size records
+          this->client->setBufferSizes(16384, 512);
+        }
       }
-      return res;
+    }
+    
+    uint16_t getTLSBufferSize()
+    {
+      return bufferSize;
+    }
+    
+    // Max Fragment Length accepted by the server, at last connect()
+    bool isMFLNSupported()
+    {
+      return mflnSupported;
+    }
+    
+    // Time in ms to parse the root CA certificates, and heap they use
+    unsigned long getCACertParseTime()
+    {
+      return caCertParseTime;
+    }
+    
+    uint32_t getCACertRAM()
+    {
+      return caCertRAM;
     }
 
     bool connect()
@@ -231,14 +293,22 @@ class BlynkArduinoClientSecure
 
       // Synchronize time useing SNTP. This is necessary to verify that
       // the TLS certificates offered by the server are currently valid.
-      configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+      // Not again if time is already valid, e.g. synced by USE_ASYNC_CONNECT without blocking
       time_t now = time(nullptr);
-
-      int i = 0;
-      while ( (i++ < 30) && (now < 100000) ) 
+      
+      if (now < 100000)
       {
-        delay(1000);
+        startNTP();
         now = time(nullptr);
+
+        int i = 0;
+        while ( (i++ < 30) && (now < 100000) ) 
+        {
+          delay(1000);
+          now = time(nullptr);
+        }
+
+        ntpSyncTime = (now < 100000) ? 0 : millis();
       }
 
       struct tm timeinfo;
@@ -247,9 +317,36 @@ class BlynkArduinoClientSecure
       ntpTime.trim();
       BLYNK_LOG2("NTP time: ", ntpTime);
 
+      if (bufferSize)
+      {
+        setBufferSizes();
+      }
+
+#if USE_TLS_SESSION
+      // Offer the session of last connection. BearSSL updates it after handshake
+      BearSSL::Session lastSession = tlsSession;
+      
+      this->client->setSession(&tlsSession);
+#endif
+
+      unsigned long handshakeStart = millis();
+      
       // Now try connecting
       if (BlynkArduinoClientGen<Client>::connect())
       {
+        tlsConnectTime    = millis();
+        tlsHandshakeTime  = tlsConnectTime - handshakeStart;
+        
+#if USE_TLS_SESSION
+        // Session parameters are unchanged only if resumed
+        tlsResumed      = tlsSessionValid && (memcmp(&lastSession, &tlsSession, sizeof(tlsSession)) == 0);
+        tlsSessionValid = true;
+        
+        BLYNK_LOG4(BLYNK_F("TLS(ms)="), tlsHandshakeTime, BLYNK_F(",resumed="), tlsResumed);
+#else
+        BLYNK_LOG2(BLYNK_F("TLS(ms)="), tlsHandshakeTime);
+#endif
+        
         if (fingerprint && this->client->verify(fingerprint, this->domain))
         {
           BLYNK_LOG1(BLYNK_F("Fingerprint OK"));
@@ -261,12 +358,155 @@ class BlynkArduinoClientSecure
           return true;
         }
         BLYNK_LOG1(BLYNK_F("Certificate not validated"));
+        
+#if USE_TLS_SESSION
+        // Don't resume a session with a server not validated
+        tlsSession      = BearSSL::Session();
+        tlsSessionValid = false;
+#endif
+
         return false;
       }
       return false;
     }
+    
+    // Start SNTP once. It then keeps syncing in the background, also after failed or lost connections
+    void startNTP()
+    {
+      if (!ntpStarted)
+      {
+        configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+        ntpStarted = true;
+      }
+    }
+    
+    // millis() when NTP time was synced by connect(), 0 if failed or synced before
+    unsigned long getNTPSyncTime()
+    {
+      return ntpSyncTime;
+    }
+    
+    // millis() when TCP and TLS were connected at last connect()
+    unsigned long getTLSConnectTime()
+    {
+      return tlsConnectTime;
+    }
+
+    // Duration of TCP connect and TLS handshake at last connect(), in ms
+    unsigned long getTLSHandshakeTime()
+    {
+      return tlsHandshakeTime;
+    }
+    
+#if USE_TLS_SESSION
+    // Last connect() resumed the TLS session
+    bool isTLSResumed()
+    {
+      return tlsResumed;
+    }
+    
+    // Copy of the session of last connection, false if none
+    bool getTLSSession(BearSSL::Session& session)
+    {
+      session = tlsSession;
+      
+      return tlsSessionValid;
+    }
+    
+    void setTLSSession(const BearSSL::Session& session)
+    {
+      tlsSession      = session;
+      tlsSessionValid = true;
+    }
+#endif
 
   private:
+    bool          ntpStarted      = false;
+    unsigned long ntpSyncTime     = 0;
+    unsigned long tlsConnectTime  = 0;
+    unsigned long tlsHandshakeTime = 0;
+    
+#if USE_TLS_SESSION
+    BearSSL::Session tlsSession;
+    bool tlsSessionValid  = false;
+    bool tlsResumed       = false;
+#endif
+    
+    // Probe server once for Max Fragment Length, then size buffers. Probe is done again for another server
+    void setBufferSizes()
+    {
+      if ( !mflnProbed || (mflnDomain != this->domain) || (mflnPort != this->port) || 
+           (!this->domain && !(mflnAddr == this->addr)) )
+      {
+        if (this->domain)
+          mflnSupported = Client::probeMaxFragmentLength(this->domain, this->port, bufferSize);
+        else
+          mflnSupported = Client::probeMaxFragmentLength(this->addr, this->port, bufferSize);
+        
+        mflnProbed  = true;
+        mflnDomain  = this->domain;
+        mflnAddr    = this->addr;
+        mflnPort    = this->port;
+        
+        BLYNK_LOG4(BLYNK_F("MFLN="), bufferSize, BLYNK_F(",supported="), mflnSupported);
+      }
+      
+      // Without MFLN, server may send full 16KB records
+      this->client->setBufferSizes(mflnSupported ? bufferSize : 16384, 512);
+    }
+    
+    uint16_t      bufferSize      = TLS_BUFFER_SIZE;
+    bool          mflnProbed      = false;
+    bool          mflnSupported   = false;
+    const char*   mflnDomain      = NULL;
+    IPAddress     mflnAddr;
+    uint16_t      mflnPort        = 0;
+    
+    // Root CA certificates parsed once by setCACert(), shared by all connections.
+    // config() sets the same certificate at each connection
+    bool setTrustAnchors(const uint8_t* caCert, unsigned caCertLen)
+    {
+      if (!trustAnchors || (caCert != trustAnchorsCert) || (caCertLen != trustAnchorsLen))
+      {
+        unsigned long parseStart  = millis();
+        uint32_t      freeHeap    = ESP.getFreeHeap();
+        
+        // Parse first, the client may still use the current list
+        BearSSL::X509List* anchors = new BearSSL::X509List(caCert, caCertLen);
+        
+        if (anchors->getCount() == 0)
+        {
+          delete anchors;
+          
+          // Keep the current list, or none
+          this->client->setTrustAnchors(trustAnchors);
+          
+          return false;
+        }
+        
+        caCertParseTime = millis() - parseStart;
+        caCertRAM       = freeHeap - ESP.getFreeHeap();
+        
+        delete trustAnchors;
+        
+        trustAnchors      = anchors;
+        trustAnchorsCert  = caCert;
+        trustAnchorsLen   = caCertLen;
+        
+        BLYNK_LOG4(BLYNK_F("CA parsed(ms)="), caCertParseTime, BLYNK_F(",RAM="), caCertRAM);
+      }
+      
+      this->client->setTrustAnchors(trustAnchors);
+      
+      return true;
+    }
+    
+    BearSSL::X509List*  trustAnchors      = NULL;
+    const uint8_t*      trustAnchorsCert  = NULL;
+    unsigned            trustAnchorsLen   = 0;
+    unsigned long       caCertParseTime   = 0;
+    uint32_t            caCertRAM         = 0;
+    
     const char* fingerprint;
 };
 
@@ -281,6 +521,9 @@ typedef struct
   uint8_t maxlen;
 } MenuItem;
 
+// Called by forEachMenuItem() for each Dynamic Param. valueLength is the length of item.pdata
+typedef void (*BlynkWM_MenuItemVisitor)(const MenuItem& item, size_t valueLength, void* userData);
+
 #if USE_DYNAMIC_PARAMETERS
   extern uint16_t NUM_MENU_ITEMS;
   extern MenuItem myMenuItems [];
@@ -332,408 +575,1114 @@ uint16_t CONFIG_DATA_SIZE = sizeof(Blynk_WM_Configuration);
 extern bool LOAD_DEFAULT_CONFIG_DATA;
 extern Blynk_WM_Configuration defaultConfig;
 
-// Permit special chars such as # and %
+// Cache the WiFi and Blynk Credentials of the last connection and the Dynamic Params in RTC memory, so that waking up
+// from deep sleep won't need to read them from LittleFS / SPIFFS / EEPROM / NVS, and won't run DRD/MRD
+#ifndef USE_RTC_CONFIG_CACHE
+  #define USE_RTC_CONFIG_CACHE      false
+#endif
 
-// -- HTML page fragments
+// RTC memory is used to keep small data across software resets and deep sleep, without any flash write.
+// For ESP8266, RTC user memory is 512 bytes (128 4-byte blocks). BLYNK_WM_RTC_OFFSET is in 4-byte blocks,
+// and the first 32 blocks are left for the sketch.
+#ifndef BLYNK_WM_RTC_OFFSET
+  #define BLYNK_WM_RTC_OFFSET       32
+#endif
 
-const char BLYNK_WM_HTML_HEAD_START[] /*PROGMEM*/ = "<!DOCTYPE html><html><head><title>BlynkSimpleEsp8266_SSL_Async_WM</title>";
+#ifndef BLYNK_WM_RTC_SIZE
+  #define BLYNK_WM_RTC_SIZE         ( 512 - ( BLYNK_WM_RTC_OFFSET * 4 ) )
+#endif
 
-const char BLYNK_WM_HTML_HEAD_STYLE[] /*PROGMEM*/ = "<style>div,input{padding:5px;font-size:1em;}input{width:95%;}body{text-align: center;}button{background-color:#16A1E7;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;}fieldset{border-radius:0.3rem;margin:0px;}</style>";
+#if ( ( BLYNK_WM_RTC_OFFSET * 4 ) + BLYNK_WM_RTC_SIZE > 512 )
+  #error BLYNK_WM_RTC_OFFSET and BLYNK_WM_RTC_SIZE exceed ESP8266 RTC user memory
+#endif
 
-const char BLYNK_WM_HTML_HEAD_END[]   /*PROGMEM*/ = "</head><div style=\"text-align:left;display:inline-block;min-width:260px;\">\
-<fieldset><div><label>WiFi SSID</label><input value=\"[[id]]\"id=\"id\"><div></div></div>\
-<div><label>PWD</label><input value=\"[[pw]]\"id=\"pw\"><div></div></div>\
-<div><label>WiFi SSID1</label><input value=\"[[id1]]\"id=\"id1\"><div></div></div>\
-<div><label>PWD1</label><input value=\"[[pw1]]\"id=\"pw1\"><div></div></div></fieldset>\
-<fieldset><div><label>Blynk Server</label><input value=\"[[sv]]\"id=\"sv\"><div></div></div>\
-<div><label>Token</label><input value=\"[[tk]]\"id=\"tk\"><div></div></div>\
-<div><label>Blynk Server1</label><input value=\"[[sv1]]\"id=\"sv1\"><div></div></div>\
-<div><label>Token1</label><input value=\"[[tk1]]\"id=\"tk1\"><div></div></div>\
-<div><label>Port</label><input value=\"[[pt]]\"id=\"pt\"><div></div></div></fieldset>\
-<fieldset><div><label>Board Name</label><input value=\"[[nm]]\"id=\"nm\"><div></div></div></fieldset>";
+// Count flash writes / erases of Config Data, Dynamic Params and forced CP flag. DRD/MRD flag writes, done inside
+// ESP_DoubleResetDetector / ESP_MultiResetDetector, are not counted.
+// Counters are kept in RTC memory, so they survive software resets (e.g. reboot loops), but not power loss
+#ifndef USE_FLASH_WRITE_STATS
+  #define USE_FLASH_WRITE_STATS     false
+#endif
 
-const char BLYNK_WM_FLDSET_START[]  /*PROGMEM*/ = "<fieldset>";
-const char BLYNK_WM_FLDSET_END[]    /*PROGMEM*/ = "</fieldset>";
-const char BLYNK_WM_HTML_PARAM[]    /*PROGMEM*/ = "<div><label>{b}</label><input value='[[{v}]]'id='{i}'><div></div></div>";
-const char BLYNK_WM_HTML_BUTTON[]   /*PROGMEM*/ = "<button onclick=\"sv()\">Save</button></div>";
-const char BLYNK_WM_HTML_SCRIPT[]   /*PROGMEM*/ = "<script id=\"jsbin-javascript\">\
-function udVal(key,val){var request=new XMLHttpRequest();var url='/?key='+key+'&value='+encodeURIComponent(val);request.open('GET',url,false);request.send(null);}\
-function sv(){udVal('id',document.getElementById('id').value);udVal('pw',document.getElementById('pw').value);\
-udVal('id1',document.getElementById('id1').value);udVal('pw1',document.getElementById('pw1').value);\
-udVal('sv',document.getElementById('sv').value);udVal('tk',document.getElementById('tk').value);\
-udVal('sv1',document.getElementById('sv1').value);udVal('tk1',document.getElementById('tk1').value);\
-udVal('pt',document.getElementById('pt').value);udVal('nm',document.getElementById('nm').value);";
+// Keep the non-persistent forced Config Portal flag in RTC memory instead of flash
+#ifndef FORCED_CP_USE_RTC
+  #define FORCED_CP_USE_RTC         false
+#endif
 
-const char BLYNK_WM_HTML_SCRIPT_ITEM[]  /*PROGMEM*/ = "udVal('{d}',document.getElementById('{d}').value);";
-const char BLYNK_WM_HTML_SCRIPT_END[]   /*PROGMEM*/ = "alert('Updated');}</script>";
-const char BLYNK_WM_HTML_END[]          /*PROGMEM*/ = "</html>";
+// Count resets for DRD/MRD in RTC memory, without the flash writes at every boot and at timeout.
+// DRD/MRD in flash is only used after RTC memory was lost (power on), and until its timeout
+// drd / mrd is NULL when the reset was counted in RTC memory
+#ifndef RESET_DETECT_USE_RTC
+  #define RESET_DETECT_USE_RTC      false
+#endif
 
-//////////////////////////////////////////
+#if USING_MRD
+  #define RESET_DETECT_TIMES        MRD_TIMES
+  #define RESET_DETECT_TIMEOUT      MRD_TIMEOUT
+#else
+  #define RESET_DETECT_TIMES        2
+  #define RESET_DETECT_TIMEOUT      DRD_TIMEOUT
+#endif
 
-//KH Add repeatedly used const
-//KH, from v1.2.0
-const char WM_HTTP_HEAD_CL[]         = "Content-Length";
-const char WM_HTTP_HEAD_TEXT_HTML[]  = "text/html";
-const char WM_HTTP_HEAD_TEXT_PLAIN[] = "text/plain";
-const char WM_HTTP_CACHE_CONTROL[]   = "Cache-Control";
-const char WM_HTTP_NO_STORE[]        = "no-cache, no-store, must-revalidate";
-const char WM_HTTP_PRAGMA[]          = "Pragma";
-const char WM_HTTP_NO_CACHE[]        = "no-cache";
-const char WM_HTTP_EXPIRES[]         = "Expires";
-const char WM_HTTP_CORS[]            = "Access-Control-Allow-Origin";
-const char WM_HTTP_CORS_ALLOW_ALL[]  = "*";
+// Keep BSSID and channel of the last connected AP in RTC memory, and connect directly to it
+// before scanning all channels. Kept across deep sleep and software resets, not power loss
+#ifndef USE_WIFI_AP_CACHE
+  #define USE_WIFI_AP_CACHE         false
+#endif
 
-//////////////////////////////////////////
+// Timeout of direct connection to the cached AP, before scanning all channels
+#ifndef TIMEOUT_WIFI_AP_CACHE
+  #define TIMEOUT_WIFI_AP_CACHE     5000L
+#endif
 
-#define BLYNK_SERVER_HARDWARE_PORT    9443
+// Start connecting to the cached AP at the beginning of begin(), so that WiFi association runs while storage is
+// mounted and Config Data is read. The connection is kept only if its WiFi Credentials are still in Config Data.
+// The WiFi Credentials of the cached AP are also kept in RTC memory
+#ifndef USE_EARLY_WIFI
+  #define USE_EARLY_WIFI            false
+#endif
 
-#define BLYNK_BOARD_TYPE      "SSL_ESP8266"
-#define NO_CONFIG             "blank"
+#if ( USE_EARLY_WIFI && !USE_WIFI_AP_CACHE )
+  #warning USE_EARLY_WIFI needs USE_WIFI_AP_CACHE. Disable USE_EARLY_WIFI
+  #undef USE_EARLY_WIFI
+  #define USE_EARLY_WIFI            false
+#endif
 
-template <typename Transport>
-class BlynkWifi
-  : public BlynkProtocol<Transport>
-{
-    typedef BlynkProtocol<Transport> Base;
-  public:
-    BlynkWifi(Transport& transp)
-      : Base(transp)
-    {}
+// Scan once, keep the result for WIFI_SCAN_CACHE_TTL ms, and connect to the best ranked WiFi Credentials first,
+// on the BSSID and channel of its strongest AP. Rank is RSSI, plus WIFI_RANK_HYSTERESIS dB for the last connected one,
+// minus WIFI_RANK_FAIL_PENALTY dB for each consecutive failure. History is kept in RTC memory
+#ifndef USE_WIFI_SCAN_RANK
+  #define USE_WIFI_SCAN_RANK        false
+#endif
 
-    void connectWiFi(const char* ssid, const char* pass)
-    {
-      BLYNK_LOG2(BLYNK_F("Con2:"), ssid);
-      WiFi.mode(WIFI_STA);
+#if USE_WIFI_SCAN_RANK
+  #ifndef WIFI_SCAN_CACHE_TTL
+    #define WIFI_SCAN_CACHE_TTL       30000L
+  #endif
+  
+  #ifndef WIFI_RANK_HYSTERESIS
+    #define WIFI_RANK_HYSTERESIS      8
+  #endif
+  
+  #ifndef WIFI_RANK_FAIL_PENALTY
+    #define WIFI_RANK_FAIL_PENALTY    10
+  #endif
+  
+  // Timeout for each ranked AP, before trying the next one
+  #ifndef TIMEOUT_WIFI_RANKED
+    #define TIMEOUT_WIFI_RANKED       10000L
+  #endif
+#endif
 
-      if (static_IP != IPAddress(0, 0, 0, 0))
-      {
-        BLYNK_LOG1(BLYNK_F("UseStatIP"));
-        WiFi.config(static_IP, static_GW, static_SN, static_DNS1, static_DNS2);
-      }
+// Keep the last DHCP lease (IP, gateway, subnet, DNS) of each connection in RTC memory, and reuse it as static IP
+// when connecting to a known WiFi, without waiting for DHCP. After DHCP_LEASE_MAX_REUSE connections, or if Blynk
+// can't be connected with the reused lease, DHCP is used again
+#ifndef USE_DHCP_LEASE_CACHE
+  #define USE_DHCP_LEASE_CACHE      false
+#endif
 
-      setHostname();
+#if USE_DHCP_LEASE_CACHE
+  #ifndef DHCP_LEASE_MAX_REUSE
+    #define DHCP_LEASE_MAX_REUSE    20
+  #endif
+#endif
 
-      if (WiFi.status() != WL_CONNECTED)
-      {
-        if (pass && strlen(pass))
-        {
-          WiFi.begin(ssid, pass);
-        } else
-        {
-          WiFi.begin(ssid);
-        }
-      }
-      while (WiFi.status() != WL_CONNECTED)
-      {
-        BlynkDelay(500);
-      }
+// Layout of RTC data, in bytes from start of Blynk_WM RTC area. Each record has a BlynkWM_RTC_Header
+#define BLYNK_WM_RTC_FORCED_CP_OFFSET     0
 
-      BLYNK_LOG1(BLYNK_F("Conn2WiFi"));
-      displayWiFiData();
-    }
+#if FORCED_CP_USE_RTC
+  #define BLYNK_WM_RTC_FORCED_CP_SIZE     ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_ForcedCP_RTC) )
+#else
+  #define BLYNK_WM_RTC_FORCED_CP_SIZE     0
+#endif
 
-    void config(const char* auth,
-                const char* domain = BLYNK_DEFAULT_DOMAIN,
-                uint16_t    port   = BLYNK_DEFAULT_PORT_SSL,
-                const char* fingerprint = NULL)
-    {
-      Base::begin(auth);
-      this->conn.begin(domain, port);
+#define BLYNK_WM_RTC_FLASH_STATS_OFFSET   ( BLYNK_WM_RTC_FORCED_CP_OFFSET + BLYNK_WM_RTC_FORCED_CP_SIZE )
 
-      if (fingerprint) {
-        this->conn.setFingerprint(fingerprint);
-      } else {
-        this->conn.setCACert_P(BLYNK_DEFAULT_CERT_DER, sizeof(BLYNK_DEFAULT_CERT_DER));
-      }
-    }
+#if USE_FLASH_WRITE_STATS
+  #define BLYNK_WM_RTC_FLASH_STATS_SIZE   ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_FlashStats) )
+#else
+  #define BLYNK_WM_RTC_FLASH_STATS_SIZE   0
+#endif
 
-    void config(const char* auth,
-                IPAddress   ip,
-                uint16_t    port = BLYNK_DEFAULT_PORT_SSL,
-                const char* fingerprint = NULL)
-    {
-      Base::begin(auth);
-      this->conn.begin(ip, port);
+#define BLYNK_WM_RTC_AP_CACHE_OFFSET      ( BLYNK_WM_RTC_FLASH_STATS_OFFSET + BLYNK_WM_RTC_FLASH_STATS_SIZE )
 
-      if (fingerprint) {
-        this->conn.setFingerprint(fingerprint);
-      } else {
-        this->conn.setCACert_P(BLYNK_DEFAULT_CERT_DER, sizeof(BLYNK_DEFAULT_CERT_DER));
-      }
-    }
+#if USE_WIFI_AP_CACHE
+  #define BLYNK_WM_RTC_AP_CACHE_SIZE      ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_APCache) )
+#else
+  #define BLYNK_WM_RTC_AP_CACHE_SIZE      0
+#endif
 
-    void begin(const char* auth,
-               const char* ssid,
-               const char* pass,
-               const char* domain = BLYNK_DEFAULT_DOMAIN,
-               uint16_t    port   = BLYNK_DEFAULT_PORT_SSL,
-               const char* fingerprint = NULL)
-    {
-      connectWiFi(ssid, pass);
-      config(auth, domain, port, fingerprint);
-      while (this->connect() != true) {}
-    }
-
-    void begin(const char* auth,
-               const char* ssid,
-               const char* pass,
-               IPAddress   ip,
-               uint16_t    port   = BLYNK_DEFAULT_PORT_SSL,
-               const char* fingerprint = NULL)
-    {
-      connectWiFi(ssid, pass);
-      config(auth, ip, port, fingerprint);
-      while (this->connect() != true) {}
-    }
-
-    // For ESP8266
-#define LED_ON      LOW
-#define LED_OFF     HIGH
+#define BLYNK_WM_RTC_WIFI_HISTORY_OFFSET  ( BLYNK_WM_RTC_AP_CACHE_OFFSET + BLYNK_WM_RTC_AP_CACHE_SIZE )
 
-    void begin(const char *iHostname = "", const char* fingerprint = NULL)
-    {
-#define TIMEOUT_CONNECT_WIFI			30000
-      (void) fingerprint;
-      
-      //Turn OFF
-      pinMode(LED_BUILTIN, OUTPUT);
-      digitalWrite(LED_BUILTIN, LED_OFF);
-      
-#if USING_MRD
-      //// New MRD ////
-      mrd = new MultiResetDetector(MRD_TIMEOUT, MRD_ADDRESS);  
-      bool noConfigPortal = true;
-   
-      if (mrd->detectMultiReset())
-#else      
-      //// New DRD ////
-      drd = new DoubleResetDetector(DRD_TIMEOUT, DRD_ADDRESS);  
-      bool noConfigPortal = true;
-   
-      if (drd->detectDoubleReset())
-#endif
-      {
-#if ( BLYNK_WM_DEBUG > 1)
-        BLYNK_LOG1(BLYNK_F("Multi or Double Reset Detected"));
-#endif      
-        noConfigPortal = false;
-      }
-      //// New DRD/MRD ////
-      
-#if ( BLYNK_WM_DEBUG > 2)    
-      if (LOAD_DEFAULT_CONFIG_DATA) 
-      {   
-        BLYNK_LOG1(BLYNK_F("======= Start Default Config Data ======="));
-        displayConfigData(defaultConfig);
-      }
+#if USE_WIFI_SCAN_RANK
+  #define BLYNK_WM_RTC_WIFI_HISTORY_SIZE  ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_WiFiHistory) )
+#else
+  #define BLYNK_WM_RTC_WIFI_HISTORY_SIZE  0
 #endif
 
-      WiFi.mode(WIFI_STA);
-
-      if (iHostname[0] == 0)
-      {
-        String _hostname = "ESP8266-" + String(ESP.getChipId(), HEX);
-        _hostname.toUpperCase();
-
-        getRFC952_hostname(_hostname.c_str());
+#define BLYNK_WM_RTC_DHCP_LEASE_OFFSET    ( BLYNK_WM_RTC_WIFI_HISTORY_OFFSET + BLYNK_WM_RTC_WIFI_HISTORY_SIZE )
 
-      }
-      else
-      {
-        // Prepare and store the hostname only not NULL
-        getRFC952_hostname(iHostname);
-      }
+#if USE_DHCP_LEASE_CACHE
+  #define BLYNK_WM_RTC_DHCP_LEASE_SIZE    ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_DHCPLease) )
+#else
+  #define BLYNK_WM_RTC_DHCP_LEASE_SIZE    0
+#endif
 
-      BLYNK_LOG2(BLYNK_F("Hostname="), RFC952_hostname);
-          
-      hadConfigData = getConfigData();
-      
-      isForcedConfigPortal = isForcedCP();
-      
-      //// New DRD/MRD ////
-      //  noConfigPortal when getConfigData() OK and no MRD/DRD'ed
-      //if (getConfigData() && noConfigPortal)
-      if (hadConfigData && noConfigPortal && (!isForcedConfigPortal) )
-      {
-        hadConfigData = true;
+#define BLYNK_WM_RTC_RESET_DETECT_OFFSET  ( BLYNK_WM_RTC_DHCP_LEASE_OFFSET + BLYNK_WM_RTC_DHCP_LEASE_SIZE )
 
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG1(noConfigPortal? BLYNK_F("bg: noConfigPortal = true") : BLYNK_F("bg: noConfigPortal = false"));
+#if RESET_DETECT_USE_RTC
+  #define BLYNK_WM_RTC_RESET_DETECT_SIZE  ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_ResetDetect_RTC) )
+#else
+  #define BLYNK_WM_RTC_RESET_DETECT_SIZE  0
 #endif
 
-        for (uint16_t i = 0; i < NUM_WIFI_CREDENTIALS; i++)
-        {
-          wifiMulti.addAP(Blynk8266_WM_config.WiFi_Creds[i].wifi_ssid, Blynk8266_WM_config.WiFi_Creds[i].wifi_pw);
-        }
+#define BLYNK_WM_RTC_EARLY_WIFI_OFFSET    ( BLYNK_WM_RTC_RESET_DETECT_OFFSET + BLYNK_WM_RTC_RESET_DETECT_SIZE )
 
-        if (connectMultiWiFi() == WL_CONNECTED)
-        {
-          BLYNK_LOG1(BLYNK_F("bg: WiFi OK. Try Blynk"));
+#if USE_EARLY_WIFI
+  #define BLYNK_WM_RTC_EARLY_WIFI_SIZE    ( sizeof(BlynkWM_RTC_Header) + sizeof(WiFi_Credentials) )
+#else
+  #define BLYNK_WM_RTC_EARLY_WIFI_SIZE    0
+#endif
 
-          int i = 0;
-          while ( (i++ < 10) && !connectMultiBlynk() )
-          {
-          }
+#define BLYNK_WM_RTC_DUTY_CYCLE_OFFSET    ( BLYNK_WM_RTC_EARLY_WIFI_OFFSET + BLYNK_WM_RTC_EARLY_WIFI_SIZE )
 
-          if  (this->connected())
-          {
-            BLYNK_LOG1(BLYNK_F("bg: WiFi+Blynk OK"));
-          }
-          else
-          {
-            BLYNK_LOG1(BLYNK_F("bg: WiFi OK, Blynk not"));
-            // failed to connect to Blynk server, will start configuration mode
-            startConfigurationMode();
-          }
-        }
-        else
-        {
-          BLYNK_LOG1(BLYNK_F("bg: Fail2connect WiFi+Blynk"));
-          // failed to connect to Blynk server, will start configuration mode
-          startConfigurationMode();
-        }
-      }
-      else
-      { 
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG1(isForcedConfigPortal? BLYNK_F("bg: isForcedConfigPortal = true") : BLYNK_F("bg: isForcedConfigPortal = false"));
+#if USE_DUTY_CYCLE
+  #define BLYNK_WM_RTC_DUTY_CYCLE_SIZE    ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_DutyCycle_RTC) )
+#else
+  #define BLYNK_WM_RTC_DUTY_CYCLE_SIZE    0
 #endif
-                                
-        // If not persistent => clear the flag so that after reset. no more CP, even CP not entered and saved
-        if (persForcedConfigPortal)
-        {
-          BLYNK_LOG2(BLYNK_F("bg:Stay forever in CP:"), isForcedConfigPortal ? BLYNK_F("Forced-Persistent") : (noConfigPortal ? BLYNK_F("No ConfigDat") : BLYNK_F("DRD/MRD")));
-        }
-        else
-        {
-          BLYNK_LOG2(BLYNK_F("bg:Stay forever in CP:"), isForcedConfigPortal ? BLYNK_F("Forced-non-Persistent") : (noConfigPortal ? BLYNK_F("No ConfigDat") : BLYNK_F("DRD/MRD")));
-          clearForcedCP();
-        }
-          
-        hadConfigData = isForcedConfigPortal ? true : (noConfigPortal ? false : true);
-        
-        // failed to connect to Blynk server, will start configuration mode
-        startConfigurationMode();
-      }
-    }
-    
-    //////////////////////////////////////////////
 
-#ifndef TIMEOUT_RECONNECT_WIFI
-  #define TIMEOUT_RECONNECT_WIFI   10000L
+#define BLYNK_WM_RTC_TIME_OFFSET          ( BLYNK_WM_RTC_DUTY_CYCLE_OFFSET + BLYNK_WM_RTC_DUTY_CYCLE_SIZE )
+
+#if USE_TIME_SERVICE
+  #define BLYNK_WM_RTC_TIME_SIZE          ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_Time_RTC) )
 #else
-    // Force range of user-defined TIMEOUT_RECONNECT_WIFI between 10-60s
-  #if (TIMEOUT_RECONNECT_WIFI < 10000L)
-    #warning TIMEOUT_RECONNECT_WIFI too low. Reseting to 10000
-    #undef TIMEOUT_RECONNECT_WIFI
-    #define TIMEOUT_RECONNECT_WIFI   10000L
-  #elif (TIMEOUT_RECONNECT_WIFI > 60000L)
-    #warning TIMEOUT_RECONNECT_WIFI too high. Reseting to 60000
-    #undef TIMEOUT_RECONNECT_WIFI
-    #define TIMEOUT_RECONNECT_WIFI   60000L
-  #endif
+  #define BLYNK_WM_RTC_TIME_SIZE          0
 #endif
 
-#ifndef RESET_IF_CONFIG_TIMEOUT
-  #define RESET_IF_CONFIG_TIMEOUT   true
-#endif
+#define BLYNK_WM_RTC_TLS_SESSION_OFFSET   ( BLYNK_WM_RTC_TIME_OFFSET + BLYNK_WM_RTC_TIME_SIZE )
 
-#ifndef CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET
-  #define CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET          10
+#if TLS_SESSION_USE_RTC
+  #define BLYNK_WM_RTC_TLS_SESSION_SIZE   ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_TLSSession_RTC) )
 #else
-  // Force range of user-defined TIMES_BEFORE_RESET between 2-100
-  #if (CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET < 2)
-    #warning CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET too low. Reseting to 2
-    #undef CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET
-    #define CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET   2
-  #elif (CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET > 100)
-    #warning CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET too high. Reseting to 100
-    #undef CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET
-    #define CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET   100
-  #endif
+  #define BLYNK_WM_RTC_TLS_SESSION_SIZE   0
 #endif
 
-    //////////////////////////////////////////////
-    
-    void run()
-    {
-      static int retryTimes = 0;
-      
-#if USING_MRD
-      //// New MRD ////
-      // Call the mulyi reset detector loop method every so often,
-      // so that it can recognise when the timeout expires.
-      // You can also call mrd.stop() when you wish to no longer
-      // consider the next reset as a multi reset.
-      mrd->loop();
-      //// New MRD ////
-#else      
-      //// New DRD ////
-      // Call the double reset detector loop method every so often,
-      // so that it can recognise when the timeout expires.
-      // You can also call drd.stop() when you wish to no longer
-      // consider the next reset as a double reset.
-      drd->loop();
-      //// New DRD ////
-#endif
+#define BLYNK_WM_RTC_CONFIG_CACHE_OFFSET  ( BLYNK_WM_RTC_TLS_SESSION_OFFSET + BLYNK_WM_RTC_TLS_SESSION_SIZE )
 
-      // Lost connection in running. Give chance to reconfig.
-      if ( WiFi.status() != WL_CONNECTED || !this->connected() )
-      {
-        // If configTimeout but user hasn't connected to configWeb => try to reconnect WiFi / Blynk.
-        // But if user has connected to configWeb, stay there until done, then reset hardware
-        if ( configuration_mode && ( configTimeout == 0 ||  millis() < configTimeout ) )
-        {
-          retryTimes = 0;
+#define BLYNK_WM_RTC_MAGIC                ( (uint32_t) 0x424C0000 )
 
-#if ( ARDUINO_ESP32S2_DEV || ARDUINO_FEATHERS2 || ARDUINO_PROS2 || ARDUINO_MICROS2 )
-          // Fix ESP32-S2 issue with WebServer (https://github.com/espressif/arduino-esp32/issues/4348)
-          delay(1);
-#endif
+typedef struct
+{
+  uint32_t magic;     // BLYNK_WM_RTC_MAGIC | data size
+  uint32_t crc;       // CRC32 of data
+} BlynkWM_RTC_Header;
 
-          return;
-        }
-        else
-        {
-#if RESET_IF_CONFIG_TIMEOUT
-          // If we're here but still in configuration_mode, permit running TIMES_BEFORE_RESET times before reset hardware
-          // to permit user another chance to config.
-          if ( configuration_mode && (configTimeout != 0) )
-          {
-            if (++retryTimes <= CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET)
-            {
-              BLYNK_LOG2(BLYNK_F("run: WiFi lost, configTimeout. Connect WiFi+Blynk. Retry#:"), retryTimes);
-            }
-            else
-            {
-              ESP.reset();
-            }
-          }
+typedef struct
+{
+  uint32_t forcedCPFlag;
+  uint32_t flashForcedCPFlag;   // Last known flag stored in flash
+} BlynkWM_ForcedCP_RTC;
+
+typedef struct
+{
+  uint32_t resetCount;      // Resets, each within RESET_DETECT_TIMEOUT of the previous boot
+  uint32_t flashPending;    // DRD/MRD flag in flash may be set by a boot using flash, until its timeout
+} BlynkWM_ResetDetect_RTC;
+
+#if TLS_SESSION_USE_RTC
+// BearSSL session, padded to multiple of 4 bytes
+typedef struct
+{
+  uint8_t data[ (sizeof(BearSSL::Session) + 3) & ~3 ];
+} BlynkWM_TLSSession_RTC;
 #endif
 
-          // Not in config mode, try reconnecting before forcing to config mode
-          if ( WiFi.status() != WL_CONNECTED )
-          {
-            BLYNK_LOG1(BLYNK_F("run: WiFi lost. Reconnect WiFi+Blynk"));
+typedef struct
+{
+  uint32_t epoch;           // Seconds since 1970, when saved
+} BlynkWM_Time_RTC;
 
-            if (connectMultiWiFi() == WL_CONNECTED)
-            {
-              // turn the LED_BUILTIN OFF to tell us we exit configuration mode.
-              digitalWrite(LED_BUILTIN, LED_OFF);
+typedef struct
+{
+  uint32_t bootCount;         // Boots since counters were reset
+  uint32_t writeCount;        // Flash write operations
+  uint32_t writeBytes;        // Bytes written to flash
+  uint32_t eraseCount;        // Flash sector / block erases, estimated
+  uint32_t bootWriteCount;    // Flash write operations since this boot
+  uint32_t bootWriteBytes;    // Bytes written to flash since this boot
+  uint32_t bootEraseCount;    // Flash erases since this boot, estimated
+} BlynkWM_FlashStats;
 
-              BLYNK_LOG1(BLYNK_F("run: WiFi reconnected. Connect to Blynk"));
+typedef struct
+{
+  uint8_t  bssid[6];
+  uint8_t  channel;
+  uint8_t  wifiIndex;       // Index in WiFi_Creds
+  uint32_t credsCRC;        // CRC32 of WiFi_Creds[wifiIndex], to drop cache after credentials change
+} BlynkWM_APCache;
 
-              if (this->connectMultiBlynk())
-              {
-                BLYNK_LOG1(BLYNK_F("run: WiFi+Blynk reconnected"));
-              }
-            }
-          }
-          else
-          {
-            BLYNK_LOG1(BLYNK_F("run: Blynk lost. Connect Blynk"));
+typedef struct
+{
+  uint32_t credsCRC[NUM_WIFI_CREDENTIALS];    // CRC32 of WiFi_Creds, to drop history after credentials change
+  uint8_t  failCount[NUM_WIFI_CREDENTIALS];   // Consecutive failed connections
+  uint8_t  lastIndex;                         // Last connected WiFi_Creds, 0xFF if none
+} BlynkWM_WiFiHistory;
 
-            if (this->connectMultiBlynk())
+typedef struct
+{
+  int8_t   rssi;              // Strongest AP of this SSID, 0 if not found
+  uint8_t  channel;
+  uint8_t  bssid[6];
+} BlynkWM_WiFiScanEntry;
+
+typedef struct
+{
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns1;
+  uint32_t dns2;
+  uint32_t credsCRC;        // CRC32 of WiFi_Creds[wifiIndex], to drop lease after credentials change
+  uint8_t  wifiIndex;       // Index in WiFi_Creds
+  uint8_t  reuseCount;      // Connections reusing this lease since DHCP
+} BlynkWM_DHCPLease;
+
+// Firmware build id, to invalidate RTC config cache after uploading new firmware
+#ifndef BLYNK_WM_BUILD_ID
+  #define BLYNK_WM_BUILD_ID         BLYNK_ASYNC_WM_VERSION " " __DATE__ " " __TIME__
+#endif
+
+// Only the Credentials used by the last connection are cached, as the whole Config Data doesn't fit in
+// ESP8266 RTC user memory. Dynamic Params follow in TLV format if they fit, otherwise they are loaded from storage
+typedef struct
+{
+  uint32_t          buildId;          // CRC32 of BLYNK_WM_BUILD_ID
+  uint32_t          dynamicDataCRC;   // CRC32 of Dynamic Params in TLV format
+  uint16_t          loadTime;         // ms used to load Config Data from storage
+  uint16_t          dynamicDataSize;  // Size of TLV Dynamic Params following, 0 if they are in storage only
+  uint8_t           wifiIndex;        // Index in WiFi_Creds of WiFi_Creds
+  uint8_t           blynkIndex;       // Index in Blynk_Creds of Blynk_Creds
+  uint16_t          reserved;
+  WiFi_Credentials  WiFi_Creds;
+  Blynk_Credentials Blynk_Creds;
+  int               blynk_port;
+} BlynkWM_ConfigCache;
+
+#if USE_RTC_CONFIG_CACHE
+  #define BLYNK_WM_RTC_CONFIG_CACHE_SIZE  ( sizeof(BlynkWM_RTC_Header) + sizeof(BlynkWM_ConfigCache) )
+#else
+  #define BLYNK_WM_RTC_CONFIG_CACHE_SIZE  0
+#endif
+
+// Space left after all records, for the Dynamic Params of Config cache
+#define BLYNK_WM_RTC_FREE_SIZE            ( BLYNK_WM_RTC_SIZE - BLYNK_WM_RTC_CONFIG_CACHE_OFFSET - BLYNK_WM_RTC_CONFIG_CACHE_SIZE )
+
+// Config Data export / import for cloning boards.
+// Layout : BlynkWM_Export_Header, Config Data as stored (with its checkSum), Dynamic Params in TLV format (with its CRC32),
+// then CRC32 of all previous bytes
+#define BLYNK_WM_EXPORT_MAGIC         ( (uint32_t) 0x58425742 )
+#define BLYNK_WM_EXPORT_VERSION       1
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t configSize;
+  uint16_t dynamicDataSize;
+  uint16_t reserved;
+} BlynkWM_Export_Header;
+
+// Non-blocking connection. begin() returns at once, and run() connects step by step :
+// WiFi => DNS => TCP => Blynk login, each step with its own timeout
+#ifndef USE_ASYNC_CONNECT
+  #define USE_ASYNC_CONNECT         false
+#endif
+
+#if USE_ASYNC_CONNECT
+  #include <lwip/dns.h>
+
+  // Timeout for each WiFi credential
+  #ifndef TIMEOUT_ASYNC_WIFI
+    #define TIMEOUT_ASYNC_WIFI        15000L
+  #endif
+  
+  // Timeouts for each Blynk server
+  #ifndef TIMEOUT_ASYNC_DNS
+    #define TIMEOUT_ASYNC_DNS         5000L
+  #endif
+  
+  // Time is needed to verify the server certificate
+  #ifndef TIMEOUT_ASYNC_NTP
+    #define TIMEOUT_ASYNC_NTP         30000L
+  #endif
+  
+  #ifndef TIMEOUT_ASYNC_TCP
+    #define TIMEOUT_ASYNC_TCP         10000L
+  #endif
+  
+  #ifndef TIMEOUT_ASYNC_LOGIN
+    #define TIMEOUT_ASYNC_LOGIN       10000L
+  #endif
+  
+  // Rounds over all Blynk servers, after WiFi connected in begin(), before starting Config Portal
+  #ifndef ASYNC_BLYNK_ROUNDS_BEFORE_CP
+    #define ASYNC_BLYNK_ROUNDS_BEFORE_CP    10
+  #endif
+#endif
+
+typedef enum
+{
+  BLYNK_WM_STATE_IDLE = 0,
+  BLYNK_WM_STATE_WIFI,
+  BLYNK_WM_STATE_PROBE,
+  BLYNK_WM_STATE_DNS,
+  BLYNK_WM_STATE_NTP,
+  BLYNK_WM_STATE_TCP,
+  BLYNK_WM_STATE_LOGIN,
+  BLYNK_WM_STATE_CONNECTED
+} BlynkWM_ConnectState;
+
+// Callback for connection events : onConnected(), onDisconnected(), onPortal()
+typedef void (*BlynkWM_EventCallback)(void);
+
+// Reconnect in run() with exponential backoff and random jitter, separately for WiFi and Blynk,
+// so that devices losing connection at the same time won't all reconnect in lockstep
+#ifndef USE_RECONNECT_BACKOFF
+  #define USE_RECONNECT_BACKOFF         false
+#endif
+
+#if USE_RECONNECT_BACKOFF
+  // Delay before first attempt, doubled after each failed attempt up to max
+  #ifndef RECONNECT_WIFI_BACKOFF_MIN
+    #define RECONNECT_WIFI_BACKOFF_MIN      1000L
+  #endif
+  
+  #ifndef RECONNECT_WIFI_BACKOFF_MAX
+    #define RECONNECT_WIFI_BACKOFF_MAX      60000L
+  #endif
+  
+  #ifndef RECONNECT_BLYNK_BACKOFF_MIN
+    #define RECONNECT_BLYNK_BACKOFF_MIN     2000L
+  #endif
+  
+  #ifndef RECONNECT_BLYNK_BACKOFF_MAX
+    #define RECONNECT_BLYNK_BACKOFF_MAX     300000L
+  #endif
+  
+  // Each delay is randomized by +/- RECONNECT_BACKOFF_JITTER percent
+  #ifndef RECONNECT_BACKOFF_JITTER
+    #define RECONNECT_BACKOFF_JITTER        50
+  #endif
+#endif
+
+// Record millis() at each boot and connection phase until first Blynk connection.
+// Read by getBootTiming(), printed in one line by printBootTiming()
+#ifndef USE_BOOT_TIMING
+  #define USE_BOOT_TIMING               false
+#endif
+
+#if USE_BOOT_TIMING
+  // Virtual pin to write the boot timing line to, once connected to Blynk. -1 => none
+  #ifndef BOOT_TIMING_VPIN
+    #define BOOT_TIMING_VPIN            -1
+  #endif
+#endif
+
+// millis() at end of each phase, 0 if not reached or not measured
+typedef struct
+{
+  uint32_t begin;           // begin() called
+  uint32_t resetDetect;     // DRD/MRD done
+  uint32_t config;          // Config Data loaded, including FS mount
+  uint32_t wifi;            // WiFi associated, and got IP by DHCP
+  uint32_t dns;             // Blynk server resolved, USE_ASYNC_CONNECT only
+  uint32_t ntp;             // Time synced, SSL only
+  uint32_t tcp;             // TCP connected, including TLS handshake for SSL. USE_ASYNC_CONNECT or SSL only
+  uint32_t login;           // Blynk logged in
+} BlynkWM_BootTiming;
+
+// Duty-cycle mode for battery-powered nodes, by runDutyCycle(): connect, send the readings queued by
+// queueVirtualWrite(), wait until Blynk server has acknowledged them, then deep sleep. Queue and per-cycle
+// statistics are kept in RTC memory
+#ifndef USE_DUTY_CYCLE
+  #define USE_DUTY_CYCLE                false
+#endif
+
+#if USE_DUTY_CYCLE
+  // Max time in ms to connect, send and get acknowledge, before going back to sleep
+  #ifndef DUTY_CYCLE_TIMEOUT
+    #define DUTY_CYCLE_TIMEOUT          20000L
+  #endif
+  
+  // Max readings queued between successful cycles. When full, the oldest reading is dropped.
+  // Each reading uses 8 bytes of RTC memory
+  #ifndef DUTY_CYCLE_QUEUE_SIZE
+    #define DUTY_CYCLE_QUEUE_SIZE       4
+  #endif
+  
+  // On connection failure, don't start Config Portal, but let runDutyCycle() sleep until next cycle.
+  // Config Portal is still started by DRD/MRD, or without valid Config Data
+  #ifndef DUTY_CYCLE_SLEEP_ON_FAIL
+    #define DUTY_CYCLE_SLEEP_ON_FAIL    true
+  #endif
+  
+  // Can be redefined, e.g. to simulate deep sleep when testing
+  #ifndef BLYNK_WM_DEEP_SLEEP
+    #define BLYNK_WM_DEEP_SLEEP(us)     ESP.deepSleep(us)
+  #endif
+#endif
+
+typedef struct
+{
+  uint8_t   pin;
+  float     value;
+} BlynkWM_QueuedWrite;
+
+// Statistics of the last cycle are updated just before deep sleep
+typedef struct
+{
+  uint32_t cycleCount;          // Cycles run
+  uint32_t failCount;           // Cycles without acknowledge from Blynk server
+  uint32_t dropCount;           // Readings dropped because queue was full
+  uint32_t timeToFirstWrite;    // millis() at first virtualWrite() of last cycle, 0 if not connected
+  uint32_t awakeTime;           // millis() at start of deep sleep of last cycle
+} BlynkWM_DutyCycleStats;
+
+#if USE_DUTY_CYCLE
+typedef struct
+{
+  BlynkWM_DutyCycleStats  stats;
+  uint32_t                queueCount;
+  BlynkWM_QueuedWrite     queue[DUTY_CYCLE_QUEUE_SIZE];
+} BlynkWM_DutyCycle_RTC;
+#endif
+
+// Measure the duration of each run(), to find what stalls loop(). Each new longest run() over RUN_TIME_BUDGET ms
+// is logged. With USE_ASYNC_CONNECT, only TCP connect and TLS handshake still block in run().
+// Without it, connecting WiFi and Blynk still blocks until connected or timeout. This is only measured, not shortened
+#ifndef USE_RUN_TIME_CHECK
+  #define USE_RUN_TIME_CHECK            false
+#endif
+
+#if USE_RUN_TIME_CHECK
+  #ifndef RUN_TIME_BUDGET
+    #define RUN_TIME_BUDGET             10
+  #endif
+#endif
+
+// Start SNTP once in begin(), and keep the last good time in RTC memory, to set the clock after soft reset or
+// deep sleep before SNTP syncs again. The SSL client then connects at once, without waiting for NTP
+#ifndef USE_TIME_SERVICE
+  #define USE_TIME_SERVICE              false
+#endif
+
+#if USE_TIME_SERVICE
+  #include <sys/time.h>
+  
+  // Interval in ms to save time in RTC memory
+  #ifndef TIME_SAVE_INTERVAL
+    #define TIME_SAVE_INTERVAL          60000L
+  #endif
+#endif
+
+// Race TCP connections to all Blynk servers before connecting, and try the fastest first.
+// Connect times are averaged, so that later connections prefer the server usually faster
+#ifndef USE_BLYNK_SERVER_PROBE
+  #define USE_BLYNK_SERVER_PROBE        false
+#endif
+
+#if USE_BLYNK_SERVER_PROBE
+  #ifndef TIMEOUT_BLYNK_SERVER_PROBE
+    #define TIMEOUT_BLYNK_SERVER_PROBE    3000L
+  #endif
+  
+  // Delay between starting each server probe. 0 => all at once
+  #ifndef BLYNK_SERVER_PROBE_STAGGER_MS
+    #define BLYNK_SERVER_PROBE_STAGGER_MS   0
+  #endif
+#endif
+
+#define BLYNK_WM_PROBE_PENDING      ( -1 )
+#define BLYNK_WM_PROBE_FAILED       ( -2 )
+
+// Callbacks may run in another task (async_tcp on ESP32). They only set result and closed.
+// The client is closed and deleted only by run() / begin()
+typedef struct
+{
+  AsyncClient*      client;       // NULL when deleted
+  unsigned long     startTime;
+  volatile int32_t  result;       // Connect time in ms, BLYNK_WM_PROBE_PENDING or BLYNK_WM_PROBE_FAILED
+  volatile bool     closed;       // Set by onDisconnect. client can then be deleted
+} BlynkWM_ServerProbe;
+
+// Dynamic Params are stored in versioned Tag-Length-Value format, keyed by MenuItem.id, so that
+// adding / removing / resizing myMenuItems[] in new firmware won't invalidate stored data.
+// Layout : BlynkWM_TLV_Header, then for each item { idLen, id, valueLen, value }, then CRC32 of all previous bytes
+#define BLYNK_WM_TLV_MAGIC            ( (uint32_t) 0x544C5642 )
+#define BLYNK_WM_TLV_VERSION          1
+
+typedef struct
+{
+  uint32_t magic;
+  uint8_t  version;
+  uint8_t  numItems;
+  uint16_t payloadLen;    // Length of all items, excluding header and CRC32
+} BlynkWM_TLV_Header;
+
+// Permit special chars such as # and %
+
+// -- HTML page fragments
+
+const char BLYNK_WM_HTML_HEAD_START[] /*PROGMEM*/ = "<!DOCTYPE html><html><head><title>BlynkSimpleEsp8266_SSL_Async_WM</title>";
+
+const char BLYNK_WM_HTML_HEAD_STYLE[] /*PROGMEM*/ = "<style>div,input{padding:5px;font-size:1em;}input{width:95%;}body{text-align: center;}button{background-color:#16A1E7;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;}fieldset{border-radius:0.3rem;margin:0px;}</style>";
+
+const char BLYNK_WM_HTML_HEAD_END[]   /*PROGMEM*/ = "</head><div style=\"text-align:left;display:inline-block;min-width:260px;\">\
+<fieldset><div><label>WiFi SSID</label><input value=\"[[id]]\"id=\"id\"><div></div></div>\
+<div><label>PWD</label><input value=\"[[pw]]\"id=\"pw\"><div></div></div>\
+<div><label>WiFi SSID1</label><input value=\"[[id1]]\"id=\"id1\"><div></div></div>\
+<div><label>PWD1</label><input value=\"[[pw1]]\"id=\"pw1\"><div></div></div></fieldset>\
+<fieldset><div><label>Blynk Server</label><input value=\"[[sv]]\"id=\"sv\"><div></div></div>\
+<div><label>Token</label><input value=\"[[tk]]\"id=\"tk\"><div></div></div>\
+<div><label>Blynk Server1</label><input value=\"[[sv1]]\"id=\"sv1\"><div></div></div>\
+<div><label>Token1</label><input value=\"[[tk1]]\"id=\"tk1\"><div></div></div>\
+<div><label>Port</label><input value=\"[[pt]]\"id=\"pt\"><div></div></div></fieldset>\
+<fieldset><div><label>Board Name</label><input value=\"[[nm]]\"id=\"nm\"><div></div></div></fieldset>";
+
+const char BLYNK_WM_FLDSET_START[]  /*PROGMEM*/ = "<fieldset>";
+const char BLYNK_WM_FLDSET_END[]    /*PROGMEM*/ = "</fieldset>";
+const char BLYNK_WM_HTML_PARAM[]    /*PROGMEM*/ = "<div><label>{b}</label><input value='[[{v}]]'id='{i}'><div></div></div>";
+const char BLYNK_WM_HTML_BUTTON[]   /*PROGMEM*/ = "<button onclick=\"sv()\">Save</button></div>";
+const char BLYNK_WM_HTML_SCRIPT[]   /*PROGMEM*/ = "<script id=\"jsbin-javascript\">\
+function udVal(key,val){var request=new XMLHttpRequest();var url='/?key='+key+'&value='+encodeURIComponent(val);request.open('GET',url,false);request.send(null);}\
+function sv(){udVal('id',document.getElementById('id').value);udVal('pw',document.getElementById('pw').value);\
+udVal('id1',document.getElementById('id1').value);udVal('pw1',document.getElementById('pw1').value);\
+udVal('sv',document.getElementById('sv').value);udVal('tk',document.getElementById('tk').value);\
+udVal('sv1',document.getElementById('sv1').value);udVal('tk1',document.getElementById('tk1').value);\
+udVal('pt',document.getElementById('pt').value);udVal('nm',document.getElementById('nm').value);";
+
+const char BLYNK_WM_HTML_SCRIPT_ITEM[]  /*PROGMEM*/ = "udVal('{d}',document.getElementById('{d}').value);";
+const char BLYNK_WM_HTML_SCRIPT_END[]   /*PROGMEM*/ = "alert('Updated');}</script>";
+const char BLYNK_WM_HTML_END[]          /*PROGMEM*/ = "</html>";
+
+//////////////////////////////////////////
+
+//KH Add repeatedly used const
+//KH, from v1.2.0
+const char WM_HTTP_HEAD_CL[]         = "Content-Length";
+const char WM_HTTP_HEAD_TEXT_HTML[]  = "text/html";
+const char WM_HTTP_HEAD_TEXT_PLAIN[] = "text/plain";
+const char WM_HTTP_CACHE_CONTROL[]   = "Cache-Control";
+const char WM_HTTP_NO_STORE[]        = "no-cache, no-store, must-revalidate";
+const char WM_HTTP_PRAGMA[]          = "Pragma";
+const char WM_HTTP_NO_CACHE[]        = "no-cache";
+const char WM_HTTP_EXPIRES[]         = "Expires";
+const char WM_HTTP_CORS[]            = "Access-Control-Allow-Origin";
+const char WM_HTTP_CORS_ALLOW_ALL[]  = "*";
+
+//////////////////////////////////////////
+
+// All RTC records, once their types are all defined, must fit in RTC memory
+static_assert( BLYNK_WM_RTC_CONFIG_CACHE_OFFSET + BLYNK_WM_RTC_CONFIG_CACHE_SIZE <= BLYNK_WM_RTC_SIZE,
+               "RTC data exceeds BLYNK_WM_RTC_SIZE. Please disable some RTC features");
+
+#define BLYNK_SERVER_HARDWARE_PORT    9443
+
+#define BLYNK_BOARD_TYPE      "SSL_ESP8266"
+#define NO_CONFIG             "blank"
+
+template <typename Transport>
+class BlynkWifi
+  : public BlynkProtocol<Transport>
+{
+    typedef BlynkProtocol<Transport> Base;
+  public:
+    BlynkWifi(Transport& transp)
+      : Base(transp)
+    {}
+
+    void connectWiFi(const char* ssid, const char* pass)
+    {
+      BLYNK_LOG2(BLYNK_F("Con2:"), ssid);
+      WiFi.mode(WIFI_STA);
+
+      if (static_IP != IPAddress(0, 0, 0, 0))
+      {
+        BLYNK_LOG1(BLYNK_F("UseStatIP"));
+        WiFi.config(static_IP, static_GW, static_SN, static_DNS1, static_DNS2);
+      }
+
+      setHostname();
+
+      if (WiFi.status() != WL_CONNECTED)
+      {
+        if (pass && strlen(pass))
+        {
+          WiFi.begin(ssid, pass);
+        } else
+        {
+          WiFi.begin(ssid);
+        }
+      }
+      while (WiFi.status() != WL_CONNECTED)
+      {
+        BlynkDelay(500);
+      }
+
+      BLYNK_LOG1(BLYNK_F("Conn2WiFi"));
+      displayWiFiData();
+    }
+
+    void config(const char* auth,
+                const char* domain = BLYNK_DEFAULT_DOMAIN,
+                uint16_t    port   = BLYNK_DEFAULT_PORT_SSL,
+                const char* fingerprint = NULL)
+    {
+      Base::begin(auth);
+      this->conn.begin(domain, port);
+
+      if (fingerprint) {
+        this->conn.setFingerprint(fingerprint);
+      } else {
+        this->conn.setCACert_P(BLYNK_DEFAULT_CERT_DER, sizeof(BLYNK_DEFAULT_CERT_DER));
+      }
+    }
+
+    void config(const char* auth,
+                IPAddress   ip,
+                uint16_t    port = BLYNK_DEFAULT_PORT_SSL,
+                const char* fingerprint = NULL)
+    {
+      Base::begin(auth);
+      this->conn.begin(ip, port);
+
+      if (fingerprint) {
+        this->conn.setFingerprint(fingerprint);
+      } else {
+        this->conn.setCACert_P(BLYNK_DEFAULT_CERT_DER, sizeof(BLYNK_DEFAULT_CERT_DER));
+      }
+    }
+
+    void begin(const char* auth,
+               const char* ssid,
+               const char* pass,
+               const char* domain = BLYNK_DEFAULT_DOMAIN,
+               uint16_t    port   = BLYNK_DEFAULT_PORT_SSL,
+               const char* fingerprint = NULL)
+    {
+      connectWiFi(ssid, pass);
+      config(auth, domain, port, fingerprint);
+      while (this->connect() != true) {}
+    }
+
+    void begin(const char* auth,
+               const char* ssid,
+               const char* pass,
+               IPAddress   ip,
+               uint16_t    port   = BLYNK_DEFAULT_PORT_SSL,
+               const char* fingerprint = NULL)
+    {
+      connectWiFi(ssid, pass);
+      config(auth, ip, port, fingerprint);
+      while (this->connect() != true) {}
+    }
+
+    // For ESP8266
+#define LED_ON      LOW
+#define LED_OFF     HIGH
+
+    void begin(const char *iHostname = "", const char* fingerprint = NULL)
+    {
+#define TIMEOUT_CONNECT_WIFI			30000
+      (void) fingerprint;
+      
+      //Turn OFF
+      pinMode(LED_BUILTIN, OUTPUT);
+      digitalWrite(LED_BUILTIN, LED_OFF);
+      
+      bool noConfigPortal = true;
+      
+#if USE_BOOT_TIMING
+      setBootPhase(bootTiming.begin);
+#endif
+      
+#if USE_FLASH_WRITE_STATS
+      beginFlashStats();
+#endif
+
+#if USE_TIME_SERVICE
+      beginTimeService();
+#endif
+
+#if TLS_SESSION_USE_RTC
+      loadTLSSession();
+#endif
+      
+      // Waking up from deep sleep is not a user reset => skip DRD/MRD and its flash accesses
+      deepSleepWake = isDeepSleepWake();
+      
+      if (!deepSleepWake)
+#if RESET_DETECT_USE_RTC
+      // Count resets in RTC memory, or use DRD/MRD in flash
+      if (!detectResetRTC(noConfigPortal))
+#endif
+      {
+#if USING_MRD
+        //// New MRD ////
+        mrd = new MultiResetDetector(MRD_TIMEOUT, MRD_ADDRESS);  
+     
+        if (mrd->detectMultiReset())
+#else      
+        //// New DRD ////
+        drd = new DoubleResetDetector(DRD_TIMEOUT, DRD_ADDRESS);  
+     
+        if (drd->detectDoubleReset())
+#endif
+        {
+#if ( BLYNK_WM_DEBUG > 1)
+          BLYNK_LOG1(BLYNK_F("Multi or Double Reset Detected"));
+#endif      
+          noConfigPortal = false;
+        }
+      }
+      //// New DRD/MRD ////
+      
+#if USE_BOOT_TIMING
+      setBootPhase(bootTiming.resetDetect);
+#endif
+      
+#if ( BLYNK_WM_DEBUG > 2)    
+      if (LOAD_DEFAULT_CONFIG_DATA) 
+      {   
+        BLYNK_LOG1(BLYNK_F("======= Start Default Config Data ======="));
+        displayConfigData(defaultConfig);
+      }
+#endif
+
+      WiFi.mode(WIFI_STA);
+
+      if (iHostname[0] == 0)
+      {
+        String _hostname = "ESP8266-" + String(ESP.getChipId(), HEX);
+        _hostname.toUpperCase();
+
+        getRFC952_hostname(_hostname.c_str());
+
+      }
+      else
+      {
+        // Prepare and store the hostname only not NULL
+        getRFC952_hostname(iHostname);
+      }
+
+      BLYNK_LOG2(BLYNK_F("Hostname="), RFC952_hostname);
+      
+#if USE_EARLY_WIFI
+      // Associate while Config Data is loaded
+      beginEarlyWiFi();
+#endif
+          
+#if USE_RTC_CONFIG_CACHE
+      unsigned long loadStartTime = millis();
+      
+      if (deepSleepWake && loadConfigCache())
+      {
+        configCacheLoaded = true;
+        hadConfigData     = true;
+        
+        // Time to load from storage at last cold boot, minus time to load from RTC
+        uint16_t cacheLoadTime = millis() - loadStartTime;
+        configCacheTimeSaved = (configCacheTimeSaved > cacheLoadTime) ? (configCacheTimeSaved - cacheLoadTime) : 0;
+        
+        BLYNK_LOG2(BLYNK_F("LoadCfgCacheRTC OK,saved(ms)="), configCacheTimeSaved);
+        displayConfigData(Blynk8266_WM_config);
+      }
+      else
+      {
+        hadConfigData = getConfigData();
+        storageReady  = true;
+        
+        configLoadTime = millis() - loadStartTime;
+      }
+#else
+      hadConfigData = getConfigData();
+#endif
+      
+#if USE_BOOT_TIMING
+      setBootPhase(bootTiming.config);
+#endif
+      
+      configDataLoaded = true;
+      
+      isForcedConfigPortal = isForcedCP();
+      
+#if USE_EARLY_WIFI
+      confirmEarlyWiFi(hadConfigData && noConfigPortal && !isForcedConfigPortal);
+#endif
+      
+      //// New DRD/MRD ////
+      //  noConfigPortal when getConfigData() OK and no MRD/DRD'ed
+      //if (getConfigData() && noConfigPortal)
+      if (hadConfigData && noConfigPortal && (!isForcedConfigPortal) )
+      {
+        hadConfigData = true;
+
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG1(noConfigPortal? BLYNK_F("bg: noConfigPortal = true") : BLYNK_F("bg: noConfigPortal = false"));
+#endif
+
+        for (uint16_t i = 0; i < NUM_WIFI_CREDENTIALS; i++)
+        {
+          wifiMulti.addAP(Blynk8266_WM_config.WiFi_Creds[i].wifi_ssid, Blynk8266_WM_config.WiFi_Creds[i].wifi_pw);
+        }
+
+#if USE_ASYNC_CONNECT
+        // Don't block here. run() will connect, or start Config Portal as below
+        startConnect(true);
+#else
+        if (connectMultiWiFi() == WL_CONNECTED)
+        {
+          BLYNK_LOG1(BLYNK_F("bg: WiFi OK. Try Blynk"));
+
+          int i = 0;
+          while ( (i++ < 10) && !connectMultiBlynk() )
+          {
+          }
+
+          if  (this->connected())
+          {
+            BLYNK_LOG1(BLYNK_F("bg: WiFi+Blynk OK"));
+            
+#if USE_BOOT_TIMING
+            finishBootTiming();
+#endif
+          }
+          else
+          {
+            BLYNK_LOG1(BLYNK_F("bg: WiFi OK, Blynk not"));
+            // failed to connect to Blynk server, will start configuration mode
+            startConfigurationModeOnFail();
+          }
+        }
+        else
+        {
+          BLYNK_LOG1(BLYNK_F("bg: Fail2connect WiFi+Blynk"));
+          // failed to connect to Blynk server, will start configuration mode
+          startConfigurationModeOnFail();
+        }
+#endif
+      }
+      else
+      { 
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG1(isForcedConfigPortal? BLYNK_F("bg: isForcedConfigPortal = true") : BLYNK_F("bg: isForcedConfigPortal = false"));
+#endif
+                                
+        // If not persistent => clear the flag so that after reset. no more CP, even CP not entered and saved
+        if (persForcedConfigPortal)
+        {
+          BLYNK_LOG2(BLYNK_F("bg:Stay forever in CP:"), isForcedConfigPortal ? BLYNK_F("Forced-Persistent") : (noConfigPortal ? BLYNK_F("No ConfigDat") : BLYNK_F("DRD/MRD")));
+        }
+        else
+        {
+          BLYNK_LOG2(BLYNK_F("bg:Stay forever in CP:"), isForcedConfigPortal ? BLYNK_F("Forced-non-Persistent") : (noConfigPortal ? BLYNK_F("No ConfigDat") : BLYNK_F("DRD/MRD")));
+          clearForcedCP();
+        }
+          
+        hadConfigData = isForcedConfigPortal ? true : (noConfigPortal ? false : true);
+        
+        // failed to connect to Blynk server, will start configuration mode
+        startConfigurationMode();
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Connection with valid Config Data failed in begin()
+    void startConfigurationModeOnFail()
+    {
+#if (USE_DUTY_CYCLE && DUTY_CYCLE_SLEEP_ON_FAIL)
+      // runDutyCycle() retries until its timeout, then sleeps
+      BLYNK_LOG1(BLYNK_F("bg: No CP in DutyCycle"));
+#else
+      startConfigurationMode();
+#endif
+    }
+    
+    //////////////////////////////////////////////
+
+#ifndef TIMEOUT_RECONNECT_WIFI
+  #define TIMEOUT_RECONNECT_WIFI   10000L
+#else
+    // Force range of user-defined TIMEOUT_RECONNECT_WIFI between 10-60s
+  #if (TIMEOUT_RECONNECT_WIFI < 10000L)
+    #warning TIMEOUT_RECONNECT_WIFI too low. Reseting to 10000
+    #undef TIMEOUT_RECONNECT_WIFI
+    #define TIMEOUT_RECONNECT_WIFI   10000L
+  #elif (TIMEOUT_RECONNECT_WIFI > 60000L)
+    #warning TIMEOUT_RECONNECT_WIFI too high. Reseting to 60000
+    #undef TIMEOUT_RECONNECT_WIFI
+    #define TIMEOUT_RECONNECT_WIFI   60000L
+  #endif
+#endif
+
+#ifndef RESET_IF_CONFIG_TIMEOUT
+  #define RESET_IF_CONFIG_TIMEOUT   true
+#endif
+
+#ifndef CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET
+  #define CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET          10
+#else
+  // Force range of user-defined TIMES_BEFORE_RESET between 2-100
+  #if (CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET < 2)
+    #warning CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET too low. Reseting to 2
+    #undef CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET
+    #define CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET   2
+  #elif (CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET > 100)
+    #warning CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET too high. Reseting to 100
+    #undef CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET
+    #define CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET   100
+  #endif
+#endif
+
+    //////////////////////////////////////////////
+    
+    void run()
+    {
+#if USE_RUN_TIME_CHECK
+      unsigned long runStartTime = millis();
+      
+  #if USE_ASYNC_CONNECT
+      runStartState = connectState;
+  #endif
+  
+      runStep();
+      
+      checkRunTime(millis() - runStartTime);
+#else
+      runStep();
+#endif
+    }
+    
+    //////////////////////////////////////////////
+    
+    // One pass of run(). Reset detectors, connection events, then one connection step if not connected
+    void runStep()
+    {
+      static int retryTimes = 0;
+      
+#if USING_MRD
+      //// New MRD ////
+      // Call the mulyi reset detector loop method every so often,
+      // so that it can recognise when the timeout expires.
+      // You can also call mrd.stop() when you wish to no longer
+      // consider the next reset as a multi reset.
+      if (mrd)
+        mrd->loop();
+      //// New MRD ////
+#else      
+      //// New DRD ////
+      // Call the double reset detector loop method every so often,
+      // so that it can recognise when the timeout expires.
+      // You can also call drd.stop() when you wish to no longer
+      // consider the next reset as a double reset.
+      if (drd)
+        drd->loop();
+      //// New DRD ////
+#endif
+
+#if RESET_DETECT_USE_RTC
+      checkResetDetectRTC();
+#endif
+
+      checkConnectionEvents();
+
+#if USE_TIME_SERVICE
+      checkTimeService();
+#endif
+
+      // Lost connection in running. Give chance to reconfig.
+      if ( WiFi.status() != WL_CONNECTED || !this->connected() )
+      {
+        // If configTimeout but user hasn't connected to configWeb => try to reconnect WiFi / Blynk.
+        // But if user has connected to configWeb, stay there until done, then reset hardware
+        if ( configuration_mode && ( configTimeout == 0 ||  millis() < configTimeout ) )
+        {
+          retryTimes = 0;
+
+#if ( ARDUINO_ESP32S2_DEV || ARDUINO_FEATHERS2 || ARDUINO_PROS2 || ARDUINO_MICROS2 )
+          // Fix ESP32-S2 issue with WebServer (https://github.com/espressif/arduino-esp32/issues/4348)
+          delay(1);
+#endif
+
+          return;
+        }
+        else
+        {
+#if USE_ASYNC_CONNECT
+          // Connection in progress, one step per run()
+          if (isConnecting())
+          {
+            connectStateMachine();
+            return;
+          }
+#endif
+
+#if USE_RECONNECT_BACKOFF
+          // First delay after connection lost, then wait for the scheduled attempt
+          if (!reconnectScheduled)
+          {
+            scheduleReconnect(WiFi.status() != WL_CONNECTED);
+          }
+          
+          if (!isReconnectDue())
+            return;
+#endif
+
+#if RESET_IF_CONFIG_TIMEOUT
+          // If we're here but still in configuration_mode, permit running TIMES_BEFORE_RESET times before reset hardware
+          // to permit user another chance to config.
+          if ( configuration_mode && (configTimeout != 0) )
+          {
+            if (++retryTimes <= CONFIG_TIMEOUT_RETRYTIMES_BEFORE_RESET)
+            {
+              BLYNK_LOG2(BLYNK_F("run: WiFi lost, configTimeout. Connect WiFi+Blynk. Retry#:"), retryTimes);
+            }
+            else
+            {
+              ESP.reset();
+            }
+          }
+#endif
+
+#if USE_ASYNC_CONNECT
+          BLYNK_LOG1(BLYNK_F("run: Lost connection. Reconnect"));
+          
+          startConnect(false);
+#else
+          // Not in config mode, try reconnecting before forcing to config mode
+          if ( WiFi.status() != WL_CONNECTED )
+          {
+            BLYNK_LOG1(BLYNK_F("run: WiFi lost. Reconnect WiFi+Blynk"));
+
+            if (connectMultiWiFi() == WL_CONNECTED)
+            {
+              // turn the LED_BUILTIN OFF to tell us we exit configuration mode.
+              digitalWrite(LED_BUILTIN, LED_OFF);
+
+              BLYNK_LOG1(BLYNK_F("run: WiFi reconnected. Connect to Blynk"));
+
+              if (this->connectMultiBlynk())
+              {
+                BLYNK_LOG1(BLYNK_F("run: WiFi+Blynk reconnected"));
+              }
+            }
+          }
+          else
+          {
+            BLYNK_LOG1(BLYNK_F("run: Blynk lost. Connect Blynk"));
+
+            if (this->connectMultiBlynk())
             {
               // turn the LED_BUILTIN OFF to tell us we exit configuration mode.
               digitalWrite(LED_BUILTIN, LED_OFF);
@@ -741,1416 +1690,4453 @@ class BlynkWifi
             }
           }
 
-          //BLYNK_LOG1(BLYNK_F("run: Lost connection => configMode"));
-          //startConfigurationMode();
+#if USE_RECONNECT_BACKOFF
+          if ( (WiFi.status() != WL_CONNECTED) || !this->connected() )
+          {
+            scheduleReconnect(WiFi.status() != WL_CONNECTED);
+          }
+#endif
+#endif
+
+          //BLYNK_LOG1(BLYNK_F("run: Lost connection => configMode"));
+          //startConfigurationMode();
+        }
+      }
+      else if (configuration_mode)
+      {
+        configuration_mode = false;
+        BLYNK_LOG1(BLYNK_F("run: got WiFi+Blynk back"));
+        // turn the LED_BUILTIN OFF to tell us we exit configuration mode.
+        digitalWrite(LED_BUILTIN, LED_OFF);
+      }
+
+#if USE_RECONNECT_BACKOFF
+      if ( reconnectScheduled && (WiFi.status() == WL_CONNECTED) && this->connected() )
+      {
+        resetReconnectBackoff();
+      }
+#endif
+
+      if (this->connected())
+      {
+        Base::run();
+      }
+    }
+
+    //////////////////////////////////////////////
+
+    void setHostname()
+    {
+      if (RFC952_hostname[0] != 0)
+      {
+        WiFi.hostname(RFC952_hostname);
+      }
+    }
+    
+    //////////////////////////////////////////////
+
+    void setConfigPortalIP(IPAddress portalIP = IPAddress(192, 168, 4, 1))
+    {
+      portal_apIP = portalIP;
+    }
+    
+    //////////////////////////////////////////////
+
+    void setConfigPortal(String ssid = "", String pass = "")
+    {
+      portal_ssid = ssid;
+      portal_pass = pass;
+    }
+    
+    //////////////////////////////////////////////
+
+#define MIN_WIFI_CHANNEL      1
+#define MAX_WIFI_CHANNEL      11
+
+    int setConfigPortalChannel(int channel = 1)
+    {
+      // If channel < MIN_WIFI_CHANNEL - 1 or channel > MAX_WIFI_CHANNEL => channel = 1
+      // If channel == 0 => will use random channel from MIN_WIFI_CHANNEL to MAX_WIFI_CHANNEL
+      // If (MIN_WIFI_CHANNEL <= channel <= MAX_WIFI_CHANNEL) => use it
+      if ( (channel < MIN_WIFI_CHANNEL - 1) || (channel > MAX_WIFI_CHANNEL) )
+        WiFiAPChannel = 1;
+      else if ( (channel >= MIN_WIFI_CHANNEL - 1) && (channel <= MAX_WIFI_CHANNEL) )
+        WiFiAPChannel = channel;
+
+      return WiFiAPChannel;
+    }
+    
+    //////////////////////////////////////////////
+    
+    void setSTAStaticIPConfig(IPAddress ip, IPAddress gw, IPAddress sn = IPAddress(255, 255, 255, 0),
+                              IPAddress dns_address_1 = IPAddress(0, 0, 0, 0),
+                              IPAddress dns_address_2 = IPAddress(0, 0, 0, 0))
+    {
+      static_IP     = ip;
+      static_GW     = gw;
+      static_SN     = sn;
+
+      // Default to local GW
+      if (dns_address_1 == IPAddress(0, 0, 0, 0))
+        static_DNS1   = gw;
+      else
+        static_DNS1   = dns_address_1;
+
+      // Default to Google DNS (8, 8, 8, 8)
+      if (dns_address_2 == IPAddress(0, 0, 0, 0))
+        static_DNS2   = IPAddress(8, 8, 8, 8);
+      else
+        static_DNS2   = dns_address_2;
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Zero-copy accessors, pointing directly to stored Config Data. No String allocation.
+    // Optional length is set to the string length, without the terminating NULL
+    
+    const char* getWiFiSSIDPtr(uint8_t index, size_t* length = NULL)
+    { 
+      if (index >= NUM_WIFI_CREDENTIALS)
+        return getConfigItem("", 0, length);
+        
+      loadConfigDataOnce();
+
+      return getConfigItem(Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid, sizeof(Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid), length);
+    }
+    
+    //////////////////////////////////////////////
+
+    const char* getWiFiPWPtr(uint8_t index, size_t* length = NULL)
+    {
+      if (index >= NUM_WIFI_CREDENTIALS)
+        return getConfigItem("", 0, length);
+        
+      loadConfigDataOnce();
+
+      return getConfigItem(Blynk8266_WM_config.WiFi_Creds[index].wifi_pw, sizeof(Blynk8266_WM_config.WiFi_Creds[index].wifi_pw), length);
+    }
+    
+    //////////////////////////////////////////////
+
+    const char* getServerNamePtr(uint8_t index, size_t* length = NULL)
+    {
+      if (index >= NUM_BLYNK_CREDENTIALS)
+        return getConfigItem("", 0, length);
+
+      loadConfigDataOnce();
+
+      return getConfigItem(Blynk8266_WM_config.Blynk_Creds[index].blynk_server, sizeof(Blynk8266_WM_config.Blynk_Creds[index].blynk_server), length);
+    }
+    
+    //////////////////////////////////////////////
+
+    const char* getTokenPtr(uint8_t index, size_t* length = NULL)
+    {
+      if (index >= NUM_BLYNK_CREDENTIALS)
+        return getConfigItem("", 0, length);
+
+      loadConfigDataOnce();
+
+      return getConfigItem(Blynk8266_WM_config.Blynk_Creds[index].blynk_token, sizeof(Blynk8266_WM_config.Blynk_Creds[index].blynk_token), length);
+    }
+    
+    //////////////////////////////////////////////
+
+    const char* getBoardNamePtr(size_t* length = NULL)
+    {
+      loadConfigDataOnce();
+
+      return getConfigItem(Blynk8266_WM_config.board_name, sizeof(Blynk8266_WM_config.board_name), length);
+    }
+    
+    //////////////////////////////////////////////
+    
+#if USE_DYNAMIC_PARAMETERS
+    // Call visitor for each Dynamic Param, reading directly from myMenuItems[]
+    void forEachMenuItem(BlynkWM_MenuItemVisitor visitor, void* userData = NULL)
+    {
+      if (!visitor)
+        return;
+        
+      loadConfigDataOnce();
+      
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {
+        visitor(myMenuItems[i], strnlen(myMenuItems[i].pdata, myMenuItems[i].maxlen), userData);
+      }
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+    // String versions, kept for compatibility
+    
+    String getWiFiSSID(uint8_t index)
+    { 
+      return String(getWiFiSSIDPtr(index));
+    }
+    
+    //////////////////////////////////////////////
+
+    String getWiFiPW(uint8_t index)
+    {
+      return String(getWiFiPWPtr(index));
+    }
+    
+    //////////////////////////////////////////////
+
+    String getServerName(uint8_t index)
+    {
+      return String(getServerNamePtr(index));
+    }
+    
+    //////////////////////////////////////////////
+
+    String getToken(uint8_t index)
+    {
+      return String(getTokenPtr(index));
+    }
+    
+    //////////////////////////////////////////////
+
+    String getBoardName()
+    {
+      return String(getBoardNamePtr());
+    }
+    
+    //////////////////////////////////////////////
+
+    int getHWPort()
+    {
+      loadConfigDataOnce();
+
+      return (Blynk8266_WM_config.blynk_port);
+    }
+    
+    //////////////////////////////////////////////
+
+    Blynk_WM_Configuration* getFullConfigData(Blynk_WM_Configuration *configData)
+    {
+      loadConfigDataOnce();
+
+      // Check if NULL pointer
+      if (configData)
+        memcpy(configData, &Blynk8266_WM_config, sizeof(Blynk_WM_Configuration));
+
+      return (configData);
+    }
+    
+    //////////////////////////////////////////////
+
+    void clearConfigData()
+    {
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
+      memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
+      saveConfigData();
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Forced CP => Flag = 0xBEEFBEEF. Else => No forced CP
+    // Flag to be stored at EEPROM_FORCED_CP_START, in the EEPROM flags region
+    // to avoid corruption to current data
+    //#define FORCED_CONFIG_PORTAL_FLAG_DATA              ( (uint32_t) 0xDEADBEEF)
+    //#define FORCED_PERS_CONFIG_PORTAL_FLAG_DATA         ( (uint32_t) 0xBEEFDEAD)
+    
+    const uint32_t FORCED_CONFIG_PORTAL_FLAG_DATA       = 0xDEADBEEF;
+    const uint32_t FORCED_PERS_CONFIG_PORTAL_FLAG_DATA  = 0xBEEFDEAD;
+    
+    #define FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE     4
+    
+    void resetAndEnterConfigPortal()
+    {
+      persForcedConfigPortal = false;
+      
+      setForcedCP(false);
+      
+      // Delay then reset the ESP8266 after save data
+      delay(1000);
+      ESP.reset();
+    }
+    
+    //////////////////////////////////////////////
+    
+    // This will keep CP forever, until you successfully enter CP, and Save data to clear the flag.
+    void resetAndEnterConfigPortalPersistent()
+    {
+      persForcedConfigPortal = true;
+      
+      setForcedCP(true);
+      
+      // Delay then reset the ESP8266 after save data
+      delay(1000);
+      ESP.reset();
+    }
+    
+    //////////////////////////////////////
+    
+#if USE_FLASH_WRITE_STATS
+    // Flash wear statistics, kept in RTC memory
+    const BlynkWM_FlashStats& getFlashStats()
+    {
+      return flashStats;
+    }
+    
+    //////////////////////////////////////////////
+    
+    void resetFlashStats()
+    {
+      memset(&flashStats, 0, sizeof(flashStats));
+      saveRTCData(BLYNK_WM_RTC_FLASH_STATS_OFFSET, &flashStats, sizeof(flashStats));
+    }
+    
+    //////////////////////////////////////////////
+    
+    void printFlashStats()
+    {
+      BLYNK_LOG6(BLYNK_F("Flash:boots="), flashStats.bootCount, BLYNK_F(",writes="), flashStats.writeCount, 
+                 BLYNK_F(",bytes="), flashStats.writeBytes);
+      BLYNK_LOG4(BLYNK_F("Flash:erases="), flashStats.eraseCount, BLYNK_F(",bootWrites="), flashStats.bootWriteCount);
+    }
+#endif
+    
+    //////////////////////////////////////
+    
+    // Connection events, raised from run(). Register before calling begin()
+    
+    void onConnected(BlynkWM_EventCallback callback)
+    {
+      connectedCallback = callback;
+    }
+    
+    //////////////////////////////////////////////
+    
+    void onDisconnected(BlynkWM_EventCallback callback)
+    {
+      disconnectedCallback = callback;
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Raised when Config Portal is started
+    void onPortal(BlynkWM_EventCallback callback)
+    {
+      portalCallback = callback;
+    }
+    
+    //////////////////////////////////////////////
+
+#if USE_BLYNK_SERVER_PROBE
+    // Average TCP connect time to Blynk server in ms, 0 if unknown
+    uint16_t getServerLatency(uint8_t index)
+    {
+      return (index < NUM_BLYNK_CREDENTIALS) ? serverLatency[index] : 0;
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_RECONNECT_BACKOFF
+    // millis() of next reconnect attempt in run(), 0 if none scheduled
+    unsigned long getNextReconnectTime()
+    {
+      return reconnectScheduled ? nextReconnectTime : 0;
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_BOOT_TIMING
+    const BlynkWM_BootTiming& getBootTiming()
+    {
+      return bootTiming;
+    }
+    
+    //////////////////////////////////////////////
+    
+    void printBootTiming()
+    {
+      char line[160];
+      
+      formatBootTiming(line, sizeof(line));
+      
+      BLYNK_LOG2(BLYNK_F("Boot(ms):"), line);
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_DUTY_CYCLE
+    // Keep a reading in RTC memory, to be sent by runDutyCycle() of this or a later cycle
+    void queueVirtualWrite(uint8_t pin, float value)
+    {
+      loadDutyCycle();
+      
+      if (dutyCycle.queueCount >= DUTY_CYCLE_QUEUE_SIZE)
+      {
+        memmove(&dutyCycle.queue[0], &dutyCycle.queue[1], (DUTY_CYCLE_QUEUE_SIZE - 1) * sizeof(BlynkWM_QueuedWrite));
+        dutyCycle.queueCount = DUTY_CYCLE_QUEUE_SIZE - 1;
+        dutyCycle.stats.dropCount++;
+      }
+      
+      dutyCycle.queue[dutyCycle.queueCount].pin   = pin;
+      dutyCycle.queue[dutyCycle.queueCount].value = value;
+      dutyCycle.queueCount++;
+      
+      saveRTCData(BLYNK_WM_RTC_DUTY_CYCLE_OFFSET, &dutyCycle, sizeof(dutyCycle));
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Call after begin(). Connect to Blynk, send queued readings, call writeCallback (if any) to write more with
+    // virtualWrite(), wait until Blynk server has acknowledged all writes, then deep sleep for sleepSeconds.
+    // Readings not acknowledged within timeout ms stay queued for next cycle.
+    // Returns only if Config Portal is running, then run() must be called in loop()
+    void runDutyCycle(uint32_t sleepSeconds, BlynkWM_EventCallback writeCallback = NULL, uint32_t timeout = DUTY_CYCLE_TIMEOUT)
+    {
+      unsigned long startTime = millis();
+      uint32_t firstWriteTime = 0;
+      bool acknowledged = false;
+      
+      loadDutyCycle();
+      
+      while ( !this->connected() && (millis() - startTime < timeout) )
+      {
+        run();
+        
+        if (configuration_mode)
+          return;
+        
+        delay(1);
+      }
+      
+      if (this->connected())
+      {
+        firstWriteTime = millis();
+        
+        for (uint8_t index = 0; index < dutyCycle.queueCount; index++)
+        {
+          Base::virtualWrite(dutyCycle.queue[index].pin, dutyCycle.queue[index].value);
+        }
+        
+        if (writeCallback)
+          writeCallback();
+        
+        acknowledged = waitDutyCycleAck(startTime, timeout);
+      }
+      
+      dutyCycle.stats.cycleCount++;
+      
+      if (acknowledged)
+        dutyCycle.queueCount = 0;
+      else
+        dutyCycle.stats.failCount++;
+      
+      dutyCycle.stats.timeToFirstWrite  = firstWriteTime;
+      dutyCycle.stats.awakeTime         = millis();
+      
+      saveRTCData(BLYNK_WM_RTC_DUTY_CYCLE_OFFSET, &dutyCycle, sizeof(dutyCycle));
+      
+      BLYNK_LOG6(BLYNK_F("DutyCycle#"), dutyCycle.stats.cycleCount, BLYNK_F(",firstWrite(ms)="), firstWriteTime, 
+                 BLYNK_F(",awake(ms)="), dutyCycle.stats.awakeTime);
+      BLYNK_LOG4(BLYNK_F("DutyCycle:ack="), acknowledged, BLYNK_F(",queued="), dutyCycle.queueCount);
+      
+      Base::disconnect();
+      
+#if USE_TIME_SERVICE
+      // Time at wake
+      saveTimeRTC(sleepSeconds);
+#endif
+      
+      stopResetDetect();
+      
+      BLYNK_WM_DEEP_SLEEP( (uint64_t) sleepSeconds * 1000000ULL );
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Statistics of the previous cycle until runDutyCycle() goes to sleep
+    const BlynkWM_DutyCycleStats& getDutyCycleStats()
+    {
+      loadDutyCycle();
+      
+      return dutyCycle.stats;
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_RUN_TIME_CHECK
+    // Longest run() in ms
+    uint32_t getMaxRunTime()
+    {
+      return maxRunTime;
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Number of run() longer than RUN_TIME_BUDGET ms
+    uint32_t getRunOverruns()
+    {
+      return runOverruns;
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_TIME_SERVICE
+    // Clock synced by SNTP, or set from RTC memory
+    bool isTimeValid()
+    {
+      return (time(nullptr) >= 100000);
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+    // Duration of TCP connect and TLS handshake of last connection, in ms
+    unsigned long getTLSHandshakeTime()
+    {
+      return this->conn.getTLSHandshakeTime();
+    }
+    
+    //////////////////////////////////////////////
+
+    // 512, 1024, 2048 or 4096 to negotiate TLS Max Fragment Length and use smaller buffers, 0 for default buffers.
+    // Used from next connection
+    void setTLSBufferSize(uint16_t size)
+    {
+      this->conn.setTLSBufferSize(size);
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Blynk server accepted Max Fragment Length of setTLSBufferSize()
+    bool isMFLNSupported()
+    {
+      return this->conn.isMFLNSupported();
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Time in ms to parse the root CA certificates, once for all connections
+    unsigned long getCACertParseTime()
+    {
+      return this->conn.getCACertParseTime();
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Heap used by the parsed root CA certificates
+    uint32_t getCACertRAM()
+    {
+      return this->conn.getCACertRAM();
+    }
+    
+    //////////////////////////////////////////////
+    
+#if USE_TLS_SESSION
+    // Last connection resumed the TLS session, with abbreviated handshake
+    bool isTLSResumed()
+    {
+      return this->conn.isTLSResumed();
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+#if USE_ASYNC_CONNECT
+    BlynkWM_ConnectState getConnectState()
+    {
+      return connectState;
+    }
+    
+    //////////////////////////////////////////////
+#endif
+
+    // Add customs headers from v1.3.0
+    
+    // New from v1.2.0, for configure CORS Header, default to WM_HTTP_CORS_ALLOW_ALL = "*"
+
+#if USING_CUSTOMS_STYLE
+    //sets a custom style, such as color
+    // "<style>div,input{padding:5px;font-size:1em;}
+    // input{width:95%;}body{text-align: center;}
+    // button{background-color:#16A1E7;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;}
+    // fieldset{border-radius:0.3rem;margin:0px;}</style>";
+    void setCustomsStyle(const char* CustomsStyle = BLYNK_WM_HTML_HEAD_STYLE) 
+    {
+      BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE = CustomsStyle;
+      BLYNK_LOG2(F("Set CustomsStyle to : "), BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE);
+    }
+    
+    //////////////////////////////////////
+    
+    const char* getCustomsStyle()
+    {
+      BLYNK_LOG2(F("Get CustomsStyle = "), BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE);
+      return BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE;
+    }
+#endif
+
+    //////////////////////////////////////
+
+#if USING_CUSTOMS_HEAD_ELEMENT    
+    //sets a custom element to add to head, like a new style tag
+    void setCustomsHeadElement(const char* CustomsHeadElement = NULL) 
+    {
+      _CustomsHeadElement = CustomsHeadElement;
+      BLYNK_LOG2(F("Set CustomsHeadElement to : "), _CustomsHeadElement);
+    }
+    
+    //////////////////////////////////////
+    
+    const char* getCustomsHeadElement()
+    {
+      BLYNK_LOG2(F("Get CustomsHeadElement = "), _CustomsHeadElement);
+      return _CustomsHeadElement;
+    }
+#endif
+
+    //////////////////////////////////////
+    
+#if USING_CORS_FEATURE   
+    void setCORSHeader(const char* CORSHeaders = NULL)
+    {     
+      _CORS_Header = CORSHeaders;
+
+      BLYNK_LOG2(F("Set CORS Header to : "), _CORS_Header);
+    }
+    
+    //////////////////////////////////////
+    
+    const char* getCORSHeader()
+    {      
+      BLYNK_LOG2(F("Get CORS Header = "), _CORS_Header);
+      return _CORS_Header;
+    }
+#endif
+          
+    //////////////////////////////////////
+
+
+  private:
+    AsyncWebServer *server;
+    bool configuration_mode = false;
+
+    ESP8266WiFiMulti wifiMulti;
+
+    unsigned long configTimeout;
+    bool hadConfigData = false;
+    
+    bool isForcedConfigPortal   = false;
+    bool persForcedConfigPortal = false;
+    
+    BlynkWM_EventCallback connectedCallback     = NULL;
+    BlynkWM_EventCallback disconnectedCallback  = NULL;
+    BlynkWM_EventCallback portalCallback        = NULL;
+    
+    // WiFi and Blynk connected at last run()
+    bool lastConnected = false;
+    
+#if USE_TIME_SERVICE
+    bool          timeSaved     = false;
+    unsigned long timeSaveTime  = 0;
+#endif
+    
+#if USE_RUN_TIME_CHECK
+    uint32_t maxRunTime   = 0;
+    uint32_t runOverruns  = 0;
+    
+  #if USE_ASYNC_CONNECT
+    BlynkWM_ConnectState runStartState = BLYNK_WM_STATE_IDLE;
+  #endif
+#endif
+    
+#if USE_DUTY_CYCLE
+    BlynkWM_DutyCycle_RTC dutyCycle;
+    bool dutyCycleLoaded = false;
+#endif
+    
+#if USE_BOOT_TIMING
+    BlynkWM_BootTiming bootTiming = {};
+    bool bootTimingDone = false;
+#endif
+    
+#if USE_RECONNECT_BACKOFF
+    // Current backoff of each layer, 0 after connected
+    uint32_t reconnectWiFiBackoff   = 0;
+    uint32_t reconnectBlynkBackoff  = 0;
+    
+    // millis() of next reconnect attempt in run()
+    unsigned long nextReconnectTime = 0;
+    bool reconnectScheduled         = false;
+#endif
+    
+#if USE_WIFI_AP_CACHE
+    BlynkWM_APCache apCache;
+    bool apCacheLoaded  = false;
+    bool apCacheValid   = false;
+    
+  #if USE_EARLY_WIFI
+    // WiFi Credentials of cached AP in RTC memory
+    bool earlyWiFiSaved   = false;
+    
+    // Connection to cached AP started by begin(), before Config Data was loaded
+    bool earlyWiFiStarted = false;
+  #endif
+    
+  #if USE_ASYNC_CONNECT
+    // Cached AP tried once per connection, before all WiFi Credentials
+    bool connectAPCacheTried  = false;
+    bool connectUsingAPCache  = false;
+  #endif
+#endif
+    
+#if USE_DHCP_LEASE_CACHE
+    BlynkWM_DHCPLease dhcpLease;
+    bool dhcpLeaseLoaded  = false;
+    bool dhcpLeaseValid   = false;
+    
+    // Cached lease set as static IP for current connection
+    bool dhcpLeaseApplied = false;
+#endif
+    
+#if USE_WIFI_SCAN_RANK
+    BlynkWM_WiFiHistory   wifiHistory;
+    bool wifiHistoryLoaded  = false;
+    
+    BlynkWM_WiFiScanEntry wifiScan[NUM_WIFI_CREDENTIALS];
+    unsigned long wifiScanTime  = 0;
+    bool wifiScanValid          = false;
+    
+    // WiFi_Creds indexes, best ranked first
+    uint8_t wifiOrder[NUM_WIFI_CREDENTIALS];
+#endif
+    
+#if USE_ASYNC_CONNECT
+    BlynkWM_ConnectState connectState = BLYNK_WM_STATE_IDLE;
+    
+    // millis() when connectState was entered
+    unsigned long connectStateTime  = 0;
+    
+    uint8_t connectWiFiIndex        = 0;
+    uint8_t connectBlynkIndex       = 0;
+    
+    // Failed rounds over all Blynk servers, when started by begin()
+    uint8_t connectRounds           = 0;
+    bool    connectFromBegin        = false;
+    
+    // Set by dnsFoundCallback(), which may run in another task : 0 => pending, 1 => resolved, -1 => failed
+    volatile int8_t dnsResult       = 0;
+    IPAddress       dnsIP;
+    const char*     dnsHost         = NULL;
+#endif
+
+#if USE_BLYNK_SERVER_PROBE
+    BlynkWM_ServerProbe serverProbes[NUM_BLYNK_CREDENTIALS] = {};
+    
+    // Average connect time in ms, 0 if unknown
+    uint16_t      serverLatency[NUM_BLYNK_CREDENTIALS]      = {};
+    
+    // Indexes in Blynk_Creds, fastest first
+    uint8_t       serverOrder[NUM_BLYNK_CREDENTIALS]        = {};
+    
+    // Bit mask of started probes
+    uint32_t      serverProbeStarted    = 0;
+    unsigned long serverProbeStartTime  = 0;
+#endif
+    
+    // Config Data already loaded by begin() or an accessor
+    bool configDataLoaded = false;
+
+#if USE_FLASH_WRITE_STATS
+    BlynkWM_FlashStats flashStats;
+#endif
+
+#if RESET_DETECT_USE_RTC
+    BlynkWM_ResetDetect_RTC resetDetectRTC;
+    
+    // Waiting for RESET_DETECT_TIMEOUT after boot
+    bool resetDetectActive = false;
+#endif
+
+    bool deepSleepWake      = false;
+    
+#if USE_RTC_CONFIG_CACHE
+    bool configCacheLoaded  = false;
+    bool storageReady       = false;
+    
+    // ms saved by loading Config Data from RTC cache instead of storage
+    uint16_t configCacheTimeSaved = 0;
+    
+    // ms used to load Config Data from storage at this boot
+    uint16_t configLoadTime       = 0;
+    
+    // Index in Blynk_Creds of the connected Blynk server
+    uint8_t connectedBlynkIndex   = 0;
+#endif
+    
+    // default to channel 1
+    int WiFiAPChannel = 1;
+
+    Blynk_WM_Configuration Blynk8266_WM_config;
+    
+    uint16_t totalDataSize = 0;
+
+    // For Config Portal, from Blynk_WM v1.0.5
+    IPAddress portal_apIP = IPAddress(192, 168, 4, 1);
+
+    String portal_ssid = "";
+    String portal_pass = "";
+
+    // For static IP, from Blynk_WM v1.0.5
+    IPAddress static_IP   = IPAddress(0, 0, 0, 0);
+    IPAddress static_GW   = IPAddress(0, 0, 0, 0);
+    IPAddress static_SN   = IPAddress(255, 255, 255, 0);
+    IPAddress static_DNS1 = IPAddress(0, 0, 0, 0);
+    IPAddress static_DNS2 = IPAddress(0, 0, 0, 0);
+
+/////////////////////////////////////
+    
+    // Add customs headers from v1.2.0
+    
+#if USING_CUSTOMS_STYLE
+    const char* BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE = NULL;
+#endif
+    
+#if USING_CUSTOMS_HEAD_ELEMENT
+    const char* _CustomsHeadElement = NULL;
+#endif
+    
+#if USING_CORS_FEATURE    
+    const char* _CORS_Header        = WM_HTTP_CORS_ALLOW_ALL;   //"*";
+#endif
+       
+    //////////////////////////////////////
+    
+#define RFC952_HOSTNAME_MAXLEN      24
+
+    char RFC952_hostname[RFC952_HOSTNAME_MAXLEN + 1];
+
+    char* getRFC952_hostname(const char* iHostname)
+    {
+      memset(RFC952_hostname, 0, sizeof(RFC952_hostname));
+
+      size_t len = ( RFC952_HOSTNAME_MAXLEN < strlen(iHostname) ) ? RFC952_HOSTNAME_MAXLEN : strlen(iHostname);
+
+      size_t j = 0;
+
+      for (size_t i = 0; i < len - 1; i++)
+      {
+        if ( isalnum(iHostname[i]) || iHostname[i] == '-' )
+        {
+          RFC952_hostname[j] = iHostname[i];
+          j++;
+        }
+      }
+      // no '-' as last char
+      if ( isalnum(iHostname[len - 1]) || (iHostname[len - 1] != '-') )
+        RFC952_hostname[j] = iHostname[len - 1];
+
+      return RFC952_hostname;
+    }
+    
+    //////////////////////////////////////
+
+    void displayConfigData(Blynk_WM_Configuration configData)
+    {
+      BLYNK_LOG4(BLYNK_F("Hdr="),       configData.header,
+                 BLYNK_F(",BrdName="),  configData.board_name);
+      BLYNK_LOG4(BLYNK_F("SSID="),      configData.WiFi_Creds[0].wifi_ssid,
+                 BLYNK_F(",PW="),       configData.WiFi_Creds[0].wifi_pw);
+      BLYNK_LOG4(BLYNK_F("SSID1="),     configData.WiFi_Creds[1].wifi_ssid,
+                 BLYNK_F(",PW1="),      configData.WiFi_Creds[1].wifi_pw);
+      BLYNK_LOG4(BLYNK_F("Server="),    configData.Blynk_Creds[0].blynk_server,
+                 BLYNK_F(",Token="),    configData.Blynk_Creds[0].blynk_token);
+      BLYNK_LOG4(BLYNK_F("Server1="),   configData.Blynk_Creds[1].blynk_server,
+                 BLYNK_F(",Token1="),   configData.Blynk_Creds[1].blynk_token);
+      BLYNK_LOG2(BLYNK_F("Port="),      configData.blynk_port);
+      BLYNK_LOG1(BLYNK_F("======= End Config Data ======="));
+    }
+    
+    //////////////////////////////////////
+
+    void displayWiFiData()
+    {
+      BLYNK_LOG6(BLYNK_F("IP="), WiFi.localIP().toString(), BLYNK_F(",GW="), WiFi.gatewayIP().toString(),
+                 BLYNK_F(",SN="), WiFi.subnetMask().toString());
+      BLYNK_LOG4(BLYNK_F("DNS1="), WiFi.dnsIP(0).toString(), BLYNK_F(",DNS2="), WiFi.dnsIP(1).toString());
+    }
+    
+    //////////////////////////////////////
+
+    bool isDeepSleepWake()
+    {
+      return (ESP.getResetInfoPtr()->reason == REASON_DEEP_SLEEP_AWAKE);
+    }
+    
+    //////////////////////////////////////
+    
+    // offset and size in bytes, offset must be multiple of 4
+    void RTC_writeBytes(uint16_t offset, const void* data, uint16_t size)
+    {
+      // Use aligned buffer as data may be not 4-byte aligned
+      uint32_t        buffer[8];
+      const uint8_t*  _pointer = (const uint8_t*) data;
+      
+      while (size > 0)
+      {
+        uint16_t len = (size > sizeof(buffer)) ? sizeof(buffer) : size;
+        
+        memset(buffer, 0, sizeof(buffer));
+        memcpy(buffer, _pointer, len);
+        ESP.rtcUserMemoryWrite(BLYNK_WM_RTC_OFFSET + (offset / 4), buffer, (len + 3) & ~3);
+        
+        offset    += len;
+        _pointer  += len;
+        size      -= len;
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    void RTC_readBytes(uint16_t offset, void* data, uint16_t size)
+    {
+      uint32_t  buffer[8];
+      uint8_t*  _pointer = (uint8_t*) data;
+      
+      while (size > 0)
+      {
+        uint16_t len = (size > sizeof(buffer)) ? sizeof(buffer) : size;
+        
+        ESP.rtcUserMemoryRead(BLYNK_WM_RTC_OFFSET + (offset / 4), buffer, (len + 3) & ~3);
+        memcpy(_pointer, buffer, len);
+        
+        offset    += len;
+        _pointer  += len;
+        size      -= len;
+      }
+    }
+    
+    //////////////////////////////////////
+
+    uint32_t calcCRC32(const void* data, size_t length)
+    {
+      const uint8_t* _pointer = (const uint8_t*) data;
+      uint32_t crc = 0xFFFFFFFF;
+      
+      while (length--)
+      {
+        crc ^= *_pointer++;
+        
+        for (uint8_t i = 0; i < 8; i++)
+        {
+          crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+      }
+      
+      return ~crc;
+    }
+    
+    //////////////////////////////////////
+    
+    // Store a record (header + data) in RTC memory. offset in bytes, must be multiple of 4
+    bool saveRTCData(uint16_t offset, const void* data, uint16_t size)
+    {
+      BlynkWM_RTC_Header header = { BLYNK_WM_RTC_MAGIC | size, calcCRC32(data, size) };
+      
+      if (offset + sizeof(header) + size > BLYNK_WM_RTC_SIZE)
+      {
+        BLYNK_LOG2(BLYNK_F("RTC overflow,offset="), offset);
+        return false;
+      }
+      
+      RTC_writeBytes(offset + sizeof(header), data, size);
+      RTC_writeBytes(offset, &header, sizeof(header));
+      
+      return true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Return false if record invalid (e.g. after power loss). Then data contents are undefined
+    bool loadRTCData(uint16_t offset, void* data, uint16_t size)
+    {
+      BlynkWM_RTC_Header header;
+      
+      if (offset + sizeof(header) + size > BLYNK_WM_RTC_SIZE)
+        return false;
+      
+      RTC_readBytes(offset, &header, sizeof(header));
+      
+      if (header.magic != (BLYNK_WM_RTC_MAGIC | size))
+        return false;
+      
+      RTC_readBytes(offset + sizeof(header), data, size);
+      
+      return (calcCRC32(data, size) == header.crc);
+    }
+    
+    //////////////////////////////////////
+    
+    void invalidateRTCData(uint16_t offset)
+    {
+      BlynkWM_RTC_Header header = { 0, 0 };
+      
+      if (offset + sizeof(header) <= BLYNK_WM_RTC_SIZE)
+        RTC_writeBytes(offset, &header, sizeof(header));
+    }
+    
+    //////////////////////////////////////
+
+#if USE_DYNAMIC_PARAMETERS
+
+    // Max size of TLV data, when all items use full maxlen
+    uint16_t TLV_getMaxDataSize()
+    {
+      uint16_t dataSize = sizeof(BlynkWM_TLV_Header) + sizeof(uint32_t);
+      
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {
+        dataSize += 2 + strnlen(myMenuItems[i].id, MAX_ID_LEN) + myMenuItems[i].maxlen;
+      }
+      
+      return dataSize;
+    }
+    
+    //////////////////////////////////////
+    
+    // Serialize myMenuItems[] into buffer, which must be at least TLV_getMaxDataSize(). Return data size
+    uint16_t TLV_serialize(uint8_t* buffer)
+    {
+      BlynkWM_TLV_Header header;
+      uint8_t* _pointer = buffer + sizeof(header);
+      
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {
+        uint8_t idLen     = strnlen(myMenuItems[i].id, MAX_ID_LEN);
+        uint8_t valueLen  = strnlen(myMenuItems[i].pdata, myMenuItems[i].maxlen);
+        
+        *_pointer++ = idLen;
+        memcpy(_pointer, myMenuItems[i].id, idLen);
+        _pointer += idLen;
+        
+        *_pointer++ = valueLen;
+        memcpy(_pointer, myMenuItems[i].pdata, valueLen);
+        _pointer += valueLen;
+      }
+      
+      header.magic      = BLYNK_WM_TLV_MAGIC;
+      header.version    = BLYNK_WM_TLV_VERSION;
+      header.numItems   = NUM_MENU_ITEMS;
+      header.payloadLen = _pointer - buffer - sizeof(header);
+      
+      memcpy(buffer, &header, sizeof(header));
+      
+      uint32_t crc = calcCRC32(buffer, _pointer - buffer);
+      memcpy(_pointer, &crc, sizeof(crc));
+      _pointer += sizeof(crc);
+      
+      return _pointer - buffer;
+    }
+    
+    //////////////////////////////////////
+    
+    // Return true if buffer starts with a TLV header. Then dataSize is the total size including header and CRC32
+    bool TLV_checkHeader(const uint8_t* buffer, uint16_t& dataSize)
+    {
+      BlynkWM_TLV_Header header;
+      
+      memcpy(&header, buffer, sizeof(header));
+      
+      if ( (header.magic != BLYNK_WM_TLV_MAGIC) || (header.version > BLYNK_WM_TLV_VERSION) )
+        return false;
+        
+      dataSize = sizeof(header) + header.payloadLen + sizeof(uint32_t);
+      
+      return true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Validate then load TLV data into myMenuItems[]. Unknown ids are skipped, missing ids keep their current values,
+    // and values longer than maxlen are truncated. myMenuItems[] is untouched if data is invalid
+    bool TLV_deserialize(const uint8_t* buffer, uint16_t bufferLen)
+    {
+      uint16_t  dataSize;
+      uint32_t  crc;
+      
+      if ( (bufferLen < sizeof(BlynkWM_TLV_Header) + sizeof(crc)) || !TLV_checkHeader(buffer, dataSize) || (dataSize > bufferLen) )
+      {
+        BLYNK_LOG1(BLYNK_F("TLV: Invalid header"));
+        return false;
+      }
+      
+      memcpy(&crc, buffer + dataSize - sizeof(crc), sizeof(crc));
+      
+      if (crc != calcCRC32(buffer, dataSize - sizeof(crc)))
+      {
+        BLYNK_LOG1(BLYNK_F("TLV: Invalid CRC"));
+        return false;
+      }
+      
+      const uint8_t* _pointer = buffer + sizeof(BlynkWM_TLV_Header);
+      const uint8_t* _end     = buffer + dataSize - sizeof(crc);
+      uint16_t numFound       = 0;
+      uint16_t numUnknown     = 0;
+      
+      while (_pointer < _end)
+      {
+        uint8_t idLen = *_pointer++;
+        
+        if (_pointer + idLen + 1 > _end)
+          break;
+          
+        const char* id = (const char*) _pointer;
+        _pointer += idLen;
+        
+        uint8_t valueLen = *_pointer++;
+        
+        if (_pointer + valueLen > _end)
+          break;
+        
+        uint16_t i;
+        
+        for (i = 0; i < NUM_MENU_ITEMS; i++)
+        {
+          if ( (strnlen(myMenuItems[i].id, MAX_ID_LEN) == idLen) && (memcmp(myMenuItems[i].id, id, idLen) == 0) )
+          {
+            // Actual size of pdata is [maxlen + 1]
+            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+            memcpy(myMenuItems[i].pdata, _pointer, (valueLen < myMenuItems[i].maxlen) ? valueLen : myMenuItems[i].maxlen);
+            
+#if ( BLYNK_WM_DEBUG > 2)        
+            BLYNK_LOG4(F("TLV:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
+#endif   
+            numFound++;
+            break;
+          }
+        }
+        
+        if (i == NUM_MENU_ITEMS)
+          numUnknown++;
+        
+        _pointer += valueLen;
+      }
+      
+      BLYNK_LOG6(BLYNK_F("TLV: Found="), numFound, BLYNK_F(",Unknown="), numUnknown, BLYNK_F(",Missing="), NUM_MENU_ITEMS - numFound);
+      
+      return true;
+    }
+    
+#endif
+
+    //////////////////////////////////////
+
+#if USE_RTC_CONFIG_CACHE
+
+#if USE_DYNAMIC_PARAMETERS
+
+    // Dynamic Params too large for the Config cache are loaded from storage, and must be the ones cached with it
+    bool loadCachedDynamicData(uint32_t dynamicDataCRC)
+    {
+      beginStorage();
+      
+#if ( USE_NVS || USE_LITTLEFS || USE_SPIFFS )
+      if (!loadDynamicData())
+#else
+      if (!EEPROM_getDynamicData())
+#endif
+      {
+        return false;
+      }
+      
+      uint8_t* dataBuffer = new uint8_t[TLV_getMaxDataSize()];
+      
+      if (dataBuffer == NULL)
+        return false;
+        
+      bool result = ( calcCRC32(dataBuffer, TLV_serialize(dataBuffer)) == dynamicDataCRC );
+      
+      delete [] dataBuffer;
+      
+      return result;
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+    // Called when connected, with Config Data loaded from storage
+    void saveConfigCache()
+    {
+      BlynkWM_ConfigCache cache;
+      
+      memset(&cache, 0, sizeof(cache));
+      
+      cache.wifiIndex   = getWiFiCredsIndex(WiFi.SSID().c_str());
+      cache.blynkIndex  = connectedBlynkIndex;
+      
+      if ( (cache.wifiIndex >= NUM_WIFI_CREDENTIALS) || (cache.blynkIndex >= NUM_BLYNK_CREDENTIALS) )
+        return;
+      
+      cache.buildId     = calcCRC32(BLYNK_WM_BUILD_ID, strlen(BLYNK_WM_BUILD_ID));
+      cache.loadTime    = configLoadTime;
+      cache.blynk_port  = Blynk8266_WM_config.blynk_port;
+      
+      memcpy(&cache.WiFi_Creds,  &Blynk8266_WM_config.WiFi_Creds[cache.wifiIndex],   sizeof(cache.WiFi_Creds));
+      memcpy(&cache.Blynk_Creds, &Blynk8266_WM_config.Blynk_Creds[cache.blynkIndex], sizeof(cache.Blynk_Creds));
+      
+#if USE_DYNAMIC_PARAMETERS
+      uint8_t* cacheBuffer = new uint8_t[sizeof(cache) + TLV_getMaxDataSize()];
+      
+      if (cacheBuffer == NULL)
+        return;
+        
+      uint16_t dynamicDataSize = TLV_serialize(cacheBuffer + sizeof(cache));
+      
+      cache.dynamicDataCRC = calcCRC32(cacheBuffer + sizeof(cache), dynamicDataSize);
+      
+      if (dynamicDataSize <= BLYNK_WM_RTC_FREE_SIZE)
+      {
+        cache.dynamicDataSize = dynamicDataSize;
+      }
+      
+      memcpy(cacheBuffer, &cache, sizeof(cache));
+#else
+      uint8_t* cacheBuffer = (uint8_t*) &cache;
+#endif
+      
+      if (saveRTCData(BLYNK_WM_RTC_CONFIG_CACHE_OFFSET, cacheBuffer, sizeof(cache) + cache.dynamicDataSize))
+      {
+#if ( BLYNK_WM_DEBUG > 2)
+        BLYNK_LOG4(BLYNK_F("SaveCfgCacheRTC OK,loadTime="), configLoadTime, BLYNK_F(",dynData="), cache.dynamicDataSize);
+#endif
+      }
+      
+#if USE_DYNAMIC_PARAMETERS
+      delete [] cacheBuffer;
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    // Other Credentials are left empty in Config Data, until beginStorage() loads it again from storage
+    bool loadConfigCache()
+    {
+      BlynkWM_RTC_Header  rtcHeader;
+      BlynkWM_ConfigCache cache;
+      bool result = false;
+      
+      RTC_readBytes(BLYNK_WM_RTC_CONFIG_CACHE_OFFSET, &rtcHeader, sizeof(rtcHeader));
+      
+      uint16_t cacheSize = rtcHeader.magic & 0xFFFF;
+      
+      if ( ( (rtcHeader.magic & 0xFFFF0000) != BLYNK_WM_RTC_MAGIC ) || (cacheSize < sizeof(cache)) ||
+           (cacheSize > sizeof(cache) + BLYNK_WM_RTC_FREE_SIZE) )
+      {
+        return false;
+      }
+      
+      uint8_t* cacheBuffer = new uint8_t[cacheSize];
+      
+      if (cacheBuffer == NULL)
+        return false;
+      
+      if (loadRTCData(BLYNK_WM_RTC_CONFIG_CACHE_OFFSET, cacheBuffer, cacheSize))
+      {
+        memcpy(&cache, cacheBuffer, sizeof(cache));
+        
+        if ( (cache.buildId == calcCRC32(BLYNK_WM_BUILD_ID, strlen(BLYNK_WM_BUILD_ID))) && 
+             (cacheSize == sizeof(cache) + cache.dynamicDataSize) &&
+             (cache.wifiIndex < NUM_WIFI_CREDENTIALS) && (cache.blynkIndex < NUM_BLYNK_CREDENTIALS) )
+        {
+#if USE_DYNAMIC_PARAMETERS
+          if (cache.dynamicDataSize)
+            result = TLV_deserialize(cacheBuffer + sizeof(cache), cache.dynamicDataSize);
+          else
+            result = loadCachedDynamicData(cache.dynamicDataCRC);
+#else
+          result = true;
+#endif
+          
+          if (result)
+          {
+            memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
+            strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+            
+            memcpy(&Blynk8266_WM_config.WiFi_Creds[cache.wifiIndex],   &cache.WiFi_Creds,  sizeof(cache.WiFi_Creds));
+            memcpy(&Blynk8266_WM_config.Blynk_Creds[cache.blynkIndex], &cache.Blynk_Creds, sizeof(cache.Blynk_Creds));
+            Blynk8266_WM_config.blynk_port = cache.blynk_port;
+            
+            connectedBlynkIndex   = cache.blynkIndex;
+            configCacheTimeSaved  = cache.loadTime;
+          }
+        }
+      }
+      
+      delete [] cacheBuffer;
+      
+      return result;
+    }
+    
+#endif
+
+    //////////////////////////////////////
+    
+    // Config Data is going to be changed in storage
+    void invalidateConfigCache()
+    {
+#if USE_RTC_CONFIG_CACHE
+      invalidateRTCData(BLYNK_WM_RTC_CONFIG_CACHE_OFFSET);
+#endif
+    }
+    
+    //////////////////////////////////////
+
+    // Account a flash write of size bytes, needing eraseCount sector / block erases
+    void countFlashWrite(uint32_t size, uint32_t eraseCount)
+    {
+#if USE_FLASH_WRITE_STATS
+      flashStats.writeCount++;
+      flashStats.writeBytes     += size;
+      flashStats.eraseCount     += eraseCount;
+      flashStats.bootWriteCount++;
+      flashStats.bootWriteBytes += size;
+      flashStats.bootEraseCount += eraseCount;
+      
+      saveRTCData(BLYNK_WM_RTC_FLASH_STATS_OFFSET, &flashStats, sizeof(flashStats));
+
+#if ( BLYNK_WM_DEBUG > 2)
+      BLYNK_LOG4(BLYNK_F("Flash write,sz="), size, BLYNK_F(",bootWrites="), flashStats.bootWriteCount);
+#endif
+#else
+      (void) size;
+      (void) eraseCount;
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+#if USE_FLASH_WRITE_STATS
+    void beginFlashStats()
+    {
+      if (!loadRTCData(BLYNK_WM_RTC_FLASH_STATS_OFFSET, &flashStats, sizeof(flashStats)))
+      {
+        // After power loss
+        memset(&flashStats, 0, sizeof(flashStats));
+      }
+      
+      flashStats.bootCount++;
+      flashStats.bootWriteCount = 0;
+      flashStats.bootWriteBytes = 0;
+      flashStats.bootEraseCount = 0;
+      
+      saveRTCData(BLYNK_WM_RTC_FLASH_STATS_OFFSET, &flashStats, sizeof(flashStats));
+      
+#if ( BLYNK_WM_DEBUG > 1)
+      printFlashStats();
+#endif
+    }
+#endif
+
+    //////////////////////////////////////
+
+    // Load Config Data only once, even if invalid, to avoid repeated storage accesses
+    void loadConfigDataOnce()
+    {
+      if (!configDataLoaded)
+      {
+        hadConfigData     = getConfigData();
+        configDataLoaded  = true;
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    const char* getConfigItem(const char* item, size_t maxLength, size_t* length)
+    {
+      if (length)
+        *length = strnlen(item, maxLength);
+        
+      return item;
+    }
+    
+    //////////////////////////////////////
+
+    int calcChecksum()
+    {
+      int checkSum = 0;
+      for (uint16_t index = 0; index < (sizeof(Blynk8266_WM_config) - sizeof(Blynk8266_WM_config.checkSum)); index++)
+      {
+        checkSum += * ( ( (byte*) &Blynk8266_WM_config ) + index);
+      }
+
+      return checkSum;
+    }
+    
+    //////////////////////////////////////
+
+#if ( USE_LITTLEFS || USE_SPIFFS )
+
+#define  CONFIG_FILENAME                  BLYNK_F("/wmssl_conf.dat")
+#define  CONFIG_FILENAME_BACKUP           BLYNK_F("/wmssl_conf.bak")
+
+#define  CREDENTIALS_FILENAME             BLYNK_F("/wmssl_cred.dat")
+#define  CREDENTIALS_FILENAME_BACKUP        BLYNK_F("/wmssl_cred.bak")
+
+#define  CONFIG_PORTAL_FILENAME           BLYNK_F("/wm_cp.dat")
+#define  CONFIG_PORTAL_FILENAME_BACKUP    BLYNK_F("/wm_cp.bak")
+
+    //////////////////////////////////////////////
+    
+    void saveForcedCP(uint32_t value)
+    {
+      File file = FileFS.open(CONFIG_PORTAL_FILENAME, "w");
+      
+      BLYNK_LOG1(BLYNK_F("SaveCPFile "));
+
+      if (file)
+      {
+        file.write((uint8_t*) &value, sizeof(value));
+        countFlashWrite(sizeof(value), 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }
+
+      // Trying open redundant CP file
+      file = FileFS.open(CONFIG_PORTAL_FILENAME_BACKUP, "w");
+      
+      BLYNK_LOG1(BLYNK_F("SaveBkUpCPFile "));
+
+      if (file)
+      {
+        file.write((uint8_t *) &value, sizeof(value));
+        countFlashWrite(sizeof(value), 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    void setForcedCPFlash(bool isPersistent)
+    {
+      uint32_t readForcedConfigPortalFlag = isPersistent? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
+
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(isPersistent ? BLYNK_F("setForcedCP Persistent") : BLYNK_F("setForcedCP non-Persistent"));
+#endif
+      
+      saveForcedCP(readForcedConfigPortalFlag);
+    }
+    
+    //////////////////////////////////////////////
+    
+    void clearForcedCPFlash()
+    {
+      uint32_t readForcedConfigPortalFlag = 0;
+
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(BLYNK_F("clearForcedCP"));
+#endif
+      
+      saveForcedCP(readForcedConfigPortalFlag);
+    }
+    
+    //////////////////////////////////////////////
+
+    bool isForcedCPFlash()
+    {
+      uint32_t readForcedConfigPortalFlag;
+
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(BLYNK_F("Check if isForcedCP"));
+#endif
+      
+      File file = FileFS.open(CONFIG_PORTAL_FILENAME, "r");
+      BLYNK_LOG1(BLYNK_F("LoadCPFile "));
+
+      if (!file)
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+
+        // Trying open redundant config file
+        file = FileFS.open(CONFIG_PORTAL_FILENAME_BACKUP, "r");
+        BLYNK_LOG1(BLYNK_F("LoadBkUpCPFile "));
+
+        if (!file)
+        {
+          BLYNK_LOG1(BLYNK_F("failed"));
+          return false;
+        }
+       }
+
+      file.readBytes((char *) &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
+
+      BLYNK_LOG1(BLYNK_F("OK"));
+      file.close();
+      
+      // Return true if forced CP (0xDEADBEEF read at offset EPROM_START + DRD_FLAG_DATA_SIZE + CONFIG_DATA_SIZE)
+      // => set flag noForcedConfigPortal = false     
+      if (readForcedConfigPortalFlag == FORCED_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = false;
+        return true;
+      }
+      else if (readForcedConfigPortalFlag == FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = true;
+        return true;
+      }
+      else
+      {       
+        return false;
+      }
+    }
+    
+    //////////////////////////////////////////////
+
+#if USE_DYNAMIC_PARAMETERS
+
+    bool checkDynamicData()
+    {
+      int checkSum = 0;
+      int readCheckSum;
+      char* readBuffer;
+           
+      File file = FileFS.open(CREDENTIALS_FILENAME, "r");
+      BLYNK_LOG1(BLYNK_F("LoadCredFile "));
+
+      if (!file)
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+
+        // Trying open redundant config file
+        file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "r");
+        BLYNK_LOG1(BLYNK_F("LoadBkUpCredFile "));
+
+        if (!file)
+        {
+          BLYNK_LOG1(BLYNK_F("failed"));
+          return false;
+        }
+      }
+      
+      // Find the longest pdata, then dynamically allocate buffer. Remember to free when done
+      // This is used to store tempo data to calculate checksum to see of data is valid
+      // We dont like to destroy myMenuItems[i].pdata with invalid data
+      
+      uint16_t maxBufferLength = 0;
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {       
+        if (myMenuItems[i].maxlen > maxBufferLength)
+          maxBufferLength = myMenuItems[i].maxlen;
+      }
+      
+      if (maxBufferLength > 0)
+      {
+        readBuffer = new char[ maxBufferLength + 1 ];
+        
+        // check to see NULL => stop and return false
+        if (readBuffer == NULL)
+        {
+          BLYNK_LOG1(BLYNK_F("ChkCrR: Error can't allocate buffer."));
+          return false;
+        }
+#if ( BLYNK_WM_DEBUG > 2)          
+        else
+        {
+          BLYNK_LOG2(BLYNK_F("ChkCrR: Buffer allocated, sz="), maxBufferLength + 1);
+        }
+#endif             
+      }
+     
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {       
+        char* _pointer = readBuffer;
+
+        // Actual size of pdata is [maxlen + 1]
+        memset(readBuffer, 0, myMenuItems[i].maxlen + 1);
+        
+        file.readBytes(_pointer, myMenuItems[i].maxlen);
+
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG4(F("ChkCrR:pdata="), readBuffer, F(",len="), myMenuItems[i].maxlen);
+#endif          
+               
+        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
+        {         
+          checkSum += *_pointer;  
+        }       
+      }
+
+      file.readBytes((char *) &readCheckSum, sizeof(readCheckSum));
+      
+      BLYNK_LOG1(BLYNK_F("OK"));
+      file.close();
+      
+      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+      
+      // Free buffer
+      if (readBuffer != NULL)
+      {
+        free(readBuffer);
+        BLYNK_LOG1(BLYNK_F("Buffer freed"));
+      }
+      
+      if ( checkSum != readCheckSum)
+      {
+        return false;
+      }
+      
+      return true;    
+    }
+    
+    //////////////////////////////////////
+
+    // Load data stored in fixed layout by previous releases
+    bool loadLegacyDynamicData()
+    {
+      int checkSum = 0;
+      int readCheckSum;
+      
+      File file = FileFS.open(CREDENTIALS_FILENAME, "r");
+      BLYNK_LOG1(BLYNK_F("LoadCredFile "));
+
+      if (!file)
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+
+        // Trying open redundant config file
+        file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "r");
+        BLYNK_LOG1(BLYNK_F("LoadBkUpCredFile "));
+
+        if (!file)
+        {
+          BLYNK_LOG1(BLYNK_F("failed"));
+          return false;
+        }
+      }
+     
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {       
+        char* _pointer = myMenuItems[i].pdata;
+        totalDataSize += myMenuItems[i].maxlen;
+
+        // Actual size of pdata is [maxlen + 1]
+        memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+        
+        file.readBytes(_pointer, myMenuItems[i].maxlen);
+
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG4(F("CrR:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
+#endif          
+               
+        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
+        {         
+          checkSum += *_pointer;  
+        }       
+      }
+
+      file.readBytes((char *) &readCheckSum, sizeof(readCheckSum));
+      
+      BLYNK_LOG1(BLYNK_F("OK"));
+      file.close();
+      
+      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+      
+      if ( checkSum != readCheckSum)
+      {
+        return false;
+      }
+      
+      return true;    
+    }
+    
+    //////////////////////////////////////
+
+    bool loadDynamicDataFile(bool backup)
+    {
+      bool result = false;
+      
+      File file = FileFS.open(backup ? CREDENTIALS_FILENAME_BACKUP : CREDENTIALS_FILENAME, "r");
+      BLYNK_LOG1(backup ? BLYNK_F("LoadBkUpCredFile ") : BLYNK_F("LoadCredFile "));
+
+      if (!file)
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+        return false;
+      }
+      
+      uint16_t fileSize = file.size();
+      uint8_t* readBuffer = NULL;
+      
+      // Larger than max size of current myMenuItems[] is OK, as unknown items are skipped
+      if ( (fileSize >= sizeof(BlynkWM_TLV_Header) + sizeof(uint32_t)) && (fileSize <= TLV_getMaxDataSize() + 1024) )
+      {
+        readBuffer = new uint8_t[fileSize];
+      }
+      
+      if (readBuffer)
+      {
+        file.readBytes((char *) readBuffer, fileSize);
+        
+        result = TLV_deserialize(readBuffer, fileSize);
+        
+        delete [] readBuffer;
+      }
+      
+      file.close();
+      
+      BLYNK_LOG1(result ? BLYNK_F("OK") : BLYNK_F("failed"));
+      
+      return result;
+    }
+    
+    //////////////////////////////////////
+
+    bool loadDynamicData()
+    {
+      totalDataSize = sizeof(Blynk8266_WM_config) + TLV_getMaxDataSize();
+      
+      if ( loadDynamicDataFile(false) || loadDynamicDataFile(true) )
+      {
+        return true;
+      }
+      
+      // Try data stored by previous releases, and convert to TLV format
+      if ( checkDynamicData() && loadLegacyDynamicData() )
+      {
+        BLYNK_LOG1(BLYNK_F("Convert legacy Dynamic Data"));
+        saveDynamicData();
+        
+        return true;
+      }
+      
+      return false;
+    }
+    
+    //////////////////////////////////////
+
+    void saveDynamicData()
+    {
+      invalidateConfigCache();
+      
+      uint8_t* writeBuffer = new uint8_t[TLV_getMaxDataSize()];
+      
+      if (writeBuffer == NULL)
+      {
+        BLYNK_LOG1(BLYNK_F("CW: Error can't allocate buffer."));
+        return;
+      }
+      
+      uint16_t dataSize = TLV_serialize(writeBuffer);
+    
+      File file = FileFS.open(CREDENTIALS_FILENAME, "w");
+      BLYNK_LOG1(BLYNK_F("SaveCredFile "));
+
+      if (file)
+      {
+        file.write(writeBuffer, dataSize);
+        countFlashWrite(dataSize, 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));    
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }   
+           
+      BLYNK_LOG2(F("CrWSz="), dataSize);
+      
+      // Trying open redundant Auth file
+      file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "w");
+      BLYNK_LOG1(BLYNK_F("SaveBkUpCredFile "));
+
+      if (file)
+      {
+        file.write(writeBuffer, dataSize);
+        countFlashWrite(dataSize, 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));    
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }
+      
+      delete [] writeBuffer;
+    }
+#endif
+
+    //////////////////////////////////////
+
+    void loadConfigData()
+    {
+      File file = FileFS.open(CONFIG_FILENAME, "r");
+      BLYNK_LOG1(BLYNK_F("LoadCfgFile "));
+
+      if (!file)
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+
+        // Trying open redundant config file
+        file = FileFS.open(CONFIG_FILENAME_BACKUP, "r");
+        BLYNK_LOG1(BLYNK_F("LoadBkUpCfgFile "));
+
+        if (!file)
+        {
+          BLYNK_LOG1(BLYNK_F("failed"));
+          return;
+        }
+      }
+
+      file.readBytes((char *) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+
+      BLYNK_LOG1(BLYNK_F("OK"));
+      file.close();
+    }
+    
+    //////////////////////////////////////
+
+    void saveConfigData()
+    {
+      invalidateConfigCache();
+      
+      File file = FileFS.open(CONFIG_FILENAME, "w");
+      BLYNK_LOG1(BLYNK_F("SaveCfgFile "));
+
+      int calChecksum = calcChecksum();
+      Blynk8266_WM_config.checkSum = calChecksum;
+      BLYNK_LOG2(BLYNK_F("WCSum=0x"), String(calChecksum, HEX));
+
+      if (file)
+      {
+        file.write((uint8_t*) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+        countFlashWrite(sizeof(Blynk8266_WM_config), 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }
+
+      // Trying open redundant Auth file
+      file = FileFS.open(CONFIG_FILENAME_BACKUP, "w");
+      BLYNK_LOG1(BLYNK_F("SaveBkUpCfgFile "));
+
+      if (file)
+      {
+        file.write((uint8_t *) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+        countFlashWrite(sizeof(Blynk8266_WM_config), 1);
+        file.close();
+        BLYNK_LOG1(BLYNK_F("OK"));
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("failed"));
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    void saveAllConfigData()
+    {
+      saveConfigData();     
+      
+#if USE_DYNAMIC_PARAMETERS      
+      saveDynamicData();
+#endif      
+    }
+    
+    //////////////////////////////////////////////
+
+    // Return false if init new EEPROM or SPIFFS/LittleFS. No more need trying to connect. Go directly to config mode
+    bool getConfigData()
+    {
+#if USE_DYNAMIC_PARAMETERS
+      bool dynamicDataValid = true;
+#endif
+      int calChecksum;  
+      
+      hadConfigData = false;
+      
+      if (!FileFS.begin())
+      {
+        FileFS.format();
+        
+        if (!FileFS.begin())
+        {
+#if USE_LITTLEFS
+          BLYNK_LOG1(BLYNK_F("LittleFS failed!. Please use SPIFFS or EEPROM."));
+#else
+          BLYNK_LOG1(BLYNK_F("SPIFFS failed!. Please use LittleFS or EEPROM."));
+#endif 
+          return false;
+        }
+      }
+
+      if (LOAD_DEFAULT_CONFIG_DATA)
+      {
+        // Load Config Data from Sketch
+        memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
+        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+        
+        // Including config and dynamic data, and assume valid
+        saveAllConfigData();
+        
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("======= Start Loaded Config Data ======="));
+        displayConfigData(Blynk8266_WM_config);
+#endif
+
+        // Don't need Config Portal anymore
+        return true; 
+      }
+      else if ( FileFS.exists(CONFIG_FILENAME) || FileFS.exists(CONFIG_FILENAME_BACKUP) )
+      {
+        // if config file exists, load
+        loadConfigData();
+        
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("======= Start Stored Config Data ======="));
+        displayConfigData(Blynk8266_WM_config);
+#endif
+
+        calChecksum = calcChecksum();
+
+        BLYNK_LOG4(BLYNK_F("CCSum=0x"), String(calChecksum, HEX),
+                   BLYNK_F(",RCSum=0x"), String(Blynk8266_WM_config.checkSum, HEX));
+                 
+#if USE_DYNAMIC_PARAMETERS                 
+        // Load dynamic data
+        dynamicDataValid = loadDynamicData();
+        
+        if (dynamicDataValid)
+        {
+  #if ( BLYNK_WM_DEBUG > 2)      
+          BLYNK_LOG1(BLYNK_F("Valid Stored Dynamic Data"));
+  #endif          
+        }
+  #if ( BLYNK_WM_DEBUG > 2)  
+        else
+        {
+          BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data"));
+        }
+  #endif
+#endif
+      }
+      else    
+      {
+        // Not loading Default config data, but having no config file => Config Portal
+        return false;
+      }    
+      
+      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) ||
+           (calChecksum != Blynk8266_WM_config.checkSum) )
+                      
+      {         
+        // Including Credentials CSum
+        BLYNK_LOG2(BLYNK_F("InitCfgFile,sz="), sizeof(Blynk8266_WM_config));
+
+        // doesn't have any configuration        
+        if (LOAD_DEFAULT_CONFIG_DATA)
+        {
+          memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
+        }
+        else
+        {
+          memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
+                      
+          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG);
+          Blynk8266_WM_config.blynk_port = BLYNK_SERVER_HARDWARE_PORT;      
+          strcpy(Blynk8266_WM_config.board_name,       NO_CONFIG);
+          
+#if USE_DYNAMIC_PARAMETERS       
+          for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+          {
+            // Actual size of pdata is [maxlen + 1]
+            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+            strncpy(myMenuItems[i].pdata, NO_CONFIG, myMenuItems[i].maxlen);
+          }
+#endif
+        }
+    
+        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+        
+        #if (USE_DYNAMIC_PARAMETERS && ( BLYNK_WM_DEBUG > 2) )
+        for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+        {
+          BLYNK_LOG4(BLYNK_F("g:myMenuItems["), i, BLYNK_F("]="), myMenuItems[i].pdata );
+        }
+        #endif
+        
+        // Don't need
+        Blynk8266_WM_config.checkSum = 0;
+
+        saveAllConfigData();
+
+        return false;
+      }
+#if USE_DYNAMIC_PARAMETERS
+      else if (!dynamicDataValid)
+      {
+        // Credentials are still valid. Dynamic Params keep their sketch defaults, and are saved again
+        BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data. Use defaults"));
+        
+        saveDynamicData();
+      }
+#endif
+
+      if ( !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) ) )
+      {
+        // If SSID, PW, Server,Token ="nothing", stay in config mode forever until having config Data.
+        return false;
+      }
+      else
+      {
+        displayConfigData(Blynk8266_WM_config);
+      }
+
+      return true;
+    }
+    
+    //////////////////////////////////////
+
+#else
+
+  #ifndef EEPROM_SIZE
+    #define EEPROM_SIZE     2048
+  #else
+    #if (EEPROM_SIZE > 4096)
+      #warning EEPROM_SIZE must be <= 4096. Reset to 4096
+      #undef EEPROM_SIZE
+      #define EEPROM_SIZE     4096
+    #endif
+  #endif
+
+  #ifndef EEPROM_START
+    #define EEPROM_START     0      //define 256 in DRD/MRD
+  #endif
+  
+  // Size reserved for the flags region. Must be multiple of 4
+  #ifndef EEPROM_FLAGS_REGION_SIZE
+    #define EEPROM_FLAGS_REGION_SIZE      16
+  #endif
+
+  // EEPROM layout, starting at EEPROM_START
+  // - Flags region, often rewritten : DRD/MRD flag (FLAG_DATA_SIZE), then forced Config Portal flag.
+  //   Reserved with EEPROM_FLAGS_REGION_SIZE bytes, so adding flags won't move the credentials
+  // - Credentials region, rarely rewritten : Blynk8266_WM_config, then Dynamic Params (TLV) up to EEPROM_SIZE
+  // Flags and credentials don't share bytes. But EEPROM.commit() still erases and rewrites the whole emulated sector
+  static constexpr uint16_t EEPROM_FORCED_CP_START      = EEPROM_START + FLAG_DATA_SIZE;
+  static constexpr uint16_t EEPROM_FLAGS_END            = EEPROM_FORCED_CP_START + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
+  static constexpr uint16_t EEPROM_CONFIG_START         = EEPROM_START + EEPROM_FLAGS_REGION_SIZE;
+  static constexpr uint16_t EEPROM_DYNAMIC_DATA_START   = EEPROM_CONFIG_START + sizeof(Blynk8266_WM_config);
+  
+  // Layout of previous releases, used only to move stored data : DRD/MRD flag, Blynk8266_WM_config, forced CP flag, Dynamic Params
+  static constexpr uint16_t EEPROM_LEGACY_CONFIG_START        = EEPROM_START + FLAG_DATA_SIZE;
+  static constexpr uint16_t EEPROM_LEGACY_FORCED_CP_START     = EEPROM_LEGACY_CONFIG_START + sizeof(Blynk8266_WM_config);
+  static constexpr uint16_t EEPROM_LEGACY_DYNAMIC_DATA_START  = EEPROM_LEGACY_FORCED_CP_START + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
+  
+  static_assert( (EEPROM_FLAGS_REGION_SIZE % 4) == 0, "EEPROM_FLAGS_REGION_SIZE must be multiple of 4");
+  // ESP_DoubleResetDetector / ESP_MultiResetDetector write their FLAG_DATA_SIZE bytes at EEPROM_START
+  static_assert( EEPROM_FLAGS_END <= EEPROM_CONFIG_START, "DRD/MRD and forced CP flags exceed EEPROM_FLAGS_REGION_SIZE. Increase it");
+  static_assert( EEPROM_DYNAMIC_DATA_START + sizeof(BlynkWM_TLV_Header) + sizeof(uint32_t) <= EEPROM_SIZE, 
+                 "EEPROM_START + Config Data > EEPROM_SIZE. Please adjust");
+  static_assert( EEPROM_LEGACY_DYNAMIC_DATA_START <= EEPROM_DYNAMIC_DATA_START, "Legacy layout must move to higher offsets");
+
+    // Some EEPROM bytes modified since last commit
+    bool eepromDirty = false;
+
+    //////////////////////////////////////////////
+    
+    // Write only the bytes different from the current EEPROM contents.
+    // Unchanged bytes don't mark the EEPROM buffer dirty, so the next commit can be skipped
+    void EEPROM_writeData(uint16_t offset, const void* data, uint16_t size)
+    {
+      const uint8_t* _pointer = (const uint8_t*) data;
+      
+      for (uint16_t i = 0; i < size; i++, offset++, _pointer++)
+      {
+        if (EEPROM.read(offset) != *_pointer)
+        {
+          EEPROM.write(offset, *_pointer);
+          eepromDirty = true;
         }
       }
-      else if (configuration_mode)
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Commit only if something has been changed since last commit
+    bool EEPROM_commitData()
+    {
+      bool result = true;
+      
+      if (eepromDirty)
       {
-        configuration_mode = false;
-        BLYNK_LOG1(BLYNK_F("run: got WiFi+Blynk back"));
-        // turn the LED_BUILTIN OFF to tell us we exit configuration mode.
-        digitalWrite(LED_BUILTIN, LED_OFF);
+        result = EEPROM.commit();
+        
+        countFlashWrite(EEPROM_SIZE, (EEPROM_SIZE + 4095) / 4096);
+        
+        eepromDirty = false;
+      }
+#if ( BLYNK_WM_DEBUG > 2)
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("EEPROM unchanged, no commit"));
+      }
+#endif
+      
+      return result;
+    }
+
+    //////////////////////////////////////////////
+    
+    // Copy EEPROM bytes to a higher offset, from the end as both areas can overlap
+    void EEPROM_moveData(uint16_t fromOffset, uint16_t toOffset, uint16_t size)
+    {
+      for (uint16_t i = size; i > 0; i--)
+      {
+        uint8_t data = EEPROM.read(fromOffset + i - 1);
+        
+        EEPROM_writeData(toOffset + i - 1, &data, 1);
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Move data stored with the layout of previous releases, where the forced CP flag was stored
+    // between Blynk8266_WM_config and Dynamic Params. Return true if moved
+    bool EEPROM_convertLegacyLayout()
+    {
+      EEPROM.get(EEPROM_CONFIG_START, Blynk8266_WM_config);
+      
+      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) == 0) && 
+           (calcChecksum() == Blynk8266_WM_config.checkSum) )
+      {
+        // Already new layout
+        return false;
+      }
+      
+      EEPROM.get(EEPROM_LEGACY_CONFIG_START, Blynk8266_WM_config);
+      
+      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) || 
+           (calcChecksum() != Blynk8266_WM_config.checkSum) )
+      {
+        // No valid data
+        return false;
+      }
+      
+      BLYNK_LOG1(BLYNK_F("Convert legacy EEPROM layout"));
+      
+      uint32_t readForcedConfigPortalFlag;
+      
+      EEPROM.get(EEPROM_LEGACY_FORCED_CP_START, readForcedConfigPortalFlag);
+      
+      // Dynamic Params first, as moved Blynk8266_WM_config will overwrite their legacy location
+      EEPROM_moveData(EEPROM_LEGACY_DYNAMIC_DATA_START, EEPROM_DYNAMIC_DATA_START, EEPROM_SIZE - EEPROM_DYNAMIC_DATA_START);
+      EEPROM_moveData(EEPROM_LEGACY_CONFIG_START, EEPROM_CONFIG_START, sizeof(Blynk8266_WM_config));
+      
+      EEPROM_writeData(EEPROM_FORCED_CP_START, &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
+      EEPROM_commitData();
+      
+      return true;
+    }
+    
+    //////////////////////////////////////////////
+    
+    void setForcedCPFlash(bool isPersistent)
+    {
+      uint32_t readForcedConfigPortalFlag = isPersistent? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
+
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(BLYNK_F("setForcedCP"));
+#endif
+      
+      EEPROM_writeData(EEPROM_FORCED_CP_START, &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
+      EEPROM_commitData();
+    }
+    
+    //////////////////////////////////////////////
+    
+    void clearForcedCPFlash()
+    {
+#if ( BLYNK_WM_DEBUG > 2)    
+      BLYNK_LOG1(BLYNK_F("clearForcedCP"));
+#endif
+      
+      uint32_t readForcedConfigPortalFlag = 0;
+      
+      EEPROM_writeData(EEPROM_FORCED_CP_START, &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
+      EEPROM_commitData();
+    }
+    
+    //////////////////////////////////////////////
+
+    bool isForcedCPFlash()
+    {
+      uint32_t readForcedConfigPortalFlag;
+
+#if ( BLYNK_WM_DEBUG > 2)      
+      BLYNK_LOG1(BLYNK_F("Check if isForcedCP"));
+#endif
+      
+      // Return true if forced CP (0xDEADBEEF read at offset EEPROM_FORCED_CP_START, in flags region)
+      // => set flag noForcedConfigPortal = false
+      EEPROM.get(EEPROM_FORCED_CP_START, readForcedConfigPortalFlag);
+      
+      if (readForcedConfigPortalFlag == FORCED_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = false;
+        return true;
+      }
+      else if (readForcedConfigPortalFlag == FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = true;
+        return true;
+      }
+      else
+      {       
+        return false;
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+#if USE_DYNAMIC_PARAMETERS
+
+    bool checkDynamicData()
+    {
+      int checkSum = 0;
+      int readCheckSum;
+      
+      #define BUFFER_LEN      128
+      char readBuffer[BUFFER_LEN + 1];
+      
+      uint16_t offset = EEPROM_DYNAMIC_DATA_START;
+                
+      // Find the longest pdata, then dynamically allocate buffer. Remember to free when done
+      // This is used to store tempo data to calculate checksum to see of data is valid
+      // We dont like to destroy myMenuItems[i].pdata with invalid data
+      
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {       
+        if (myMenuItems[i].maxlen > BUFFER_LEN)
+        {
+          // Size too large, abort and flag false
+          BLYNK_LOG1(BLYNK_F("ChkCrR: Error Small Buffer."));
+          return false;
+        }
+      }
+         
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {       
+        char* _pointer = readBuffer;
+        
+        // Prepare buffer, more than enough
+        memset(readBuffer, 0, sizeof(readBuffer));
+        
+        // Read more than necessary, but OK and easier to code
+        EEPROM.get(offset, readBuffer);
+        // NULL terminated
+        readBuffer[myMenuItems[i].maxlen] = 0;
+
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG4(F("ChkCrR:pdata="), readBuffer, F(",len="), myMenuItems[i].maxlen);
+#endif          
+               
+        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
+        {         
+          checkSum += *_pointer;  
+        }   
+        
+        offset += myMenuItems[i].maxlen;    
       }
 
-      if (this->connected())
+      EEPROM.get(offset, readCheckSum);
+           
+      BLYNK_LOG4(F("ChkCrR:CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+           
+      if ( checkSum != readCheckSum)
       {
-        Base::run();
+        return false;
       }
+      
+      return true;    
     }
+    
+    //////////////////////////////////////
 
-    //////////////////////////////////////////////
-
-    void setHostname()
+    // Load data stored in fixed layout by previous releases
+    bool EEPROM_getLegacyDynamicData()
     {
-      if (RFC952_hostname[0] != 0)
+      int readCheckSum;
+      int checkSum = 0;
+      uint16_t offset = EEPROM_DYNAMIC_DATA_START;
+      
+      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+      {       
+        char* _pointer = myMenuItems[i].pdata;
+        totalDataSize += myMenuItems[i].maxlen;
+        
+        // Actual size of pdata is [maxlen + 1]
+        memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+               
+        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++,offset++)
+        {
+          *_pointer = EEPROM.read(offset);
+          
+          checkSum += *_pointer;  
+         }    
+#if ( BLYNK_WM_DEBUG > 2)        
+        BLYNK_LOG4(F("CR:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
+#endif             
+      }
+      
+      EEPROM.get(offset, readCheckSum);
+      
+      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+      
+      if ( checkSum != readCheckSum)
       {
-        WiFi.hostname(RFC952_hostname);
+        return false;
       }
+      
+      return true;
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
 
-    void setConfigPortalIP(IPAddress portalIP = IPAddress(192, 168, 4, 1))
+    bool EEPROM_getDynamicData()
     {
-      portal_apIP = portalIP;
+      uint16_t dataSize;
+      uint8_t  headerBuffer[sizeof(BlynkWM_TLV_Header)];
+      bool     result = false;
+      
+      totalDataSize = sizeof(Blynk8266_WM_config) + TLV_getMaxDataSize();
+      
+      EEPROM.get(EEPROM_DYNAMIC_DATA_START, headerBuffer);
+      
+      if ( TLV_checkHeader(headerBuffer, dataSize) && (EEPROM_DYNAMIC_DATA_START + dataSize <= EEPROM_SIZE) )
+      {
+        uint8_t* readBuffer = new uint8_t[dataSize];
+        
+        if (readBuffer)
+        {
+          for (uint16_t i = 0; i < dataSize; i++)
+          {
+            readBuffer[i] = EEPROM.read(EEPROM_DYNAMIC_DATA_START + i);
+          }
+          
+          result = TLV_deserialize(readBuffer, dataSize);
+          
+          delete [] readBuffer;
+        }
+      }
+      // Try data stored by previous releases, and convert to TLV format
+      else if ( checkDynamicData() && EEPROM_getLegacyDynamicData() )
+      {
+        BLYNK_LOG1(BLYNK_F("Convert legacy Dynamic Data"));
+        saveDynamicData();
+        
+        result = true;
+      }
+      
+      return result;
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
 
-    void setConfigPortal(String ssid = "", String pass = "")
+    void EEPROM_putDynamicData()
     {
-      portal_ssid = ssid;
-      portal_pass = pass;
+      uint16_t maxDataSize = TLV_getMaxDataSize();
+      
+      if (EEPROM_DYNAMIC_DATA_START + maxDataSize > EEPROM_SIZE)
+      {
+        BLYNK_LOG2(BLYNK_F("CW: Error EEPROM_SIZE too small, need "), EEPROM_DYNAMIC_DATA_START + maxDataSize);
+        return;
+      }
+      
+      uint8_t* writeBuffer = new uint8_t[maxDataSize];
+      
+      if (writeBuffer == NULL)
+      {
+        BLYNK_LOG1(BLYNK_F("CW: Error can't allocate buffer."));
+        return;
+      }
+      
+      uint16_t dataSize = TLV_serialize(writeBuffer);
+      
+      EEPROM_writeData(EEPROM_DYNAMIC_DATA_START, writeBuffer, dataSize);
+      
+      delete [] writeBuffer;
+      
+      BLYNK_LOG2(F("CrWSz="), dataSize);
     }
     
-    //////////////////////////////////////////////
-
-#define MIN_WIFI_CHANNEL      1
-#define MAX_WIFI_CHANNEL      11
-
-    int setConfigPortalChannel(int channel = 1)
+    //////////////////////////////////////
+    
+    void saveDynamicData()
     {
-      // If channel < MIN_WIFI_CHANNEL - 1 or channel > MAX_WIFI_CHANNEL => channel = 1
-      // If channel == 0 => will use random channel from MIN_WIFI_CHANNEL to MAX_WIFI_CHANNEL
-      // If (MIN_WIFI_CHANNEL <= channel <= MAX_WIFI_CHANNEL) => use it
-      if ( (channel < MIN_WIFI_CHANNEL - 1) || (channel > MAX_WIFI_CHANNEL) )
-        WiFiAPChannel = 1;
-      else if ( (channel >= MIN_WIFI_CHANNEL - 1) && (channel <= MAX_WIFI_CHANNEL) )
-        WiFiAPChannel = channel;
-
-      return WiFiAPChannel;
+      invalidateConfigCache();
+      
+      EEPROM_putDynamicData();
+      EEPROM_commitData();
     }
     
+#endif
+    
     //////////////////////////////////////////////
     
-    void setSTAStaticIPConfig(IPAddress ip, IPAddress gw, IPAddress sn = IPAddress(255, 255, 255, 0),
-                              IPAddress dns_address_1 = IPAddress(0, 0, 0, 0),
-                              IPAddress dns_address_2 = IPAddress(0, 0, 0, 0))
+    bool getConfigData()
     {
-      static_IP     = ip;
-      static_GW     = gw;
-      static_SN     = sn;
+#if USE_DYNAMIC_PARAMETERS
+      bool dynamicDataValid = true;
+#endif
+      int calChecksum;
+      
+      hadConfigData = false; 
+      
+      EEPROM.begin(EEPROM_SIZE);
+      BLYNK_LOG2(BLYNK_F("EEPROMsz:"), EEPROM_SIZE);
+      
+      if (LOAD_DEFAULT_CONFIG_DATA)
+      {
+        // Load Config Data from Sketch
+        memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
+        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+        
+        // Including config and dynamic data, and assume valid
+        saveAllConfigData();
+                 
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("======= Start Loaded Config Data ======="));
+        displayConfigData(Blynk8266_WM_config);
+#endif
 
-      // Default to local GW
-      if (dns_address_1 == IPAddress(0, 0, 0, 0))
-        static_DNS1   = gw;
+        // Don't need Config Portal anymore
+        return true;             
+      }
       else
-        static_DNS1   = dns_address_1;
+      {
+        // Move data stored by previous releases, then load data from EEPROM
+        EEPROM_convertLegacyLayout();
+        
+        EEPROM.get(EEPROM_CONFIG_START, Blynk8266_WM_config);
+        
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("======= Start Stored Config Data ======="));
+        displayConfigData(Blynk8266_WM_config);
+#endif
 
-      // Default to Google DNS (8, 8, 8, 8)
-      if (dns_address_2 == IPAddress(0, 0, 0, 0))
-        static_DNS2   = IPAddress(8, 8, 8, 8);
+        calChecksum = calcChecksum();
+
+        BLYNK_LOG4(BLYNK_F("CCSum=0x"), String(calChecksum, HEX),
+                   BLYNK_F(",RCSum=0x"), String(Blynk8266_WM_config.checkSum, HEX));
+                 
+#if USE_DYNAMIC_PARAMETERS
+                 
+        // Load dynamic data from EEPROM
+        dynamicDataValid = EEPROM_getDynamicData();
+        
+        if (dynamicDataValid)
+        {
+  #if ( BLYNK_WM_DEBUG > 2)      
+          BLYNK_LOG1(BLYNK_F("Valid Stored Dynamic Data"));
+  #endif          
+        }
+  #if ( BLYNK_WM_DEBUG > 2)  
+        else
+        {
+          BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data"));
+        }
+  #endif
+#endif
+      }
+        
+      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) ||
+           (calChecksum != Blynk8266_WM_config.checkSum) )
+      {       
+        // Including Credentials CSum
+        BLYNK_LOG4(F("InitEEPROM,sz="), EEPROM_SIZE, F(",DataSz="), totalDataSize);
+
+        // doesn't have any configuration        
+        if (LOAD_DEFAULT_CONFIG_DATA)
+        {
+          memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
+        }
+        else
+        {
+          memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
+             
+          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG);
+          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG);
+          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG);
+          Blynk8266_WM_config.blynk_port = BLYNK_SERVER_HARDWARE_PORT;      
+          strcpy(Blynk8266_WM_config.board_name,       NO_CONFIG);
+          
+#if USE_DYNAMIC_PARAMETERS        
+          for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+          {
+            // Actual size of pdata is [maxlen + 1]
+            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+            strncpy(myMenuItems[i].pdata, NO_CONFIG, myMenuItems[i].maxlen);
+          }
+#endif
+        }
+    
+        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+        
+        #if ( USE_DYNAMIC_PARAMETERS && ( BLYNK_WM_DEBUG > 2) )   
+        for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+        {
+          BLYNK_LOG4(BLYNK_F("g:myMenuItems["), i, BLYNK_F("]="), myMenuItems[i].pdata );
+        }
+        #endif
+        
+        // Don't need
+        Blynk8266_WM_config.checkSum = 0;
+
+        saveAllConfigData();
+
+        return false;
+      }
+#if USE_DYNAMIC_PARAMETERS
+      else if (!dynamicDataValid)
+      {
+        // Credentials are still valid. Dynamic Params keep their sketch defaults, and are saved again
+        BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data. Use defaults"));
+        
+        saveDynamicData();
+      }
+#endif
+
+      if ( !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
+                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) ) )
+      {
+        // If SSID, PW, Server,Token ="nothing", stay in config mode forever until having config Data.
+        return false;
+      }
       else
-        static_DNS2   = dns_address_2;
-    }
-    
-    //////////////////////////////////////////////
-
-    String getWiFiSSID(uint8_t index)
-    { 
-      if (index >= NUM_WIFI_CREDENTIALS)
-        return String("");
-        
-      if (!hadConfigData)
-        getConfigData();
+      {
+        displayConfigData(Blynk8266_WM_config);
+      }
 
-      return (String(Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid));
+      return true;
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
 
-    String getWiFiPW(uint8_t index)
+    void saveConfigData()
     {
-      if (index >= NUM_WIFI_CREDENTIALS)
-        return String("");
-        
-      if (!hadConfigData)
-        getConfigData();
+      invalidateConfigCache();
+      
+      int calChecksum = calcChecksum();
+      Blynk8266_WM_config.checkSum = calChecksum;
+      BLYNK_LOG4(BLYNK_F("SaveEEPROM,sz="), EEPROM_SIZE, BLYNK_F(",CSum=0x"), String(calChecksum, HEX))
 
-      return (String(Blynk8266_WM_config.WiFi_Creds[index].wifi_pw));
+      EEPROM_writeData(EEPROM_CONFIG_START, &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+      
+      EEPROM_commitData();
     }
     
-    //////////////////////////////////////////////
-
-    String getServerName(uint8_t index)
+    //////////////////////////////////////
+    
+    void saveAllConfigData()
     {
-      if (index >= NUM_BLYNK_CREDENTIALS)
-        return String("");
+      int calChecksum = calcChecksum();
+      Blynk8266_WM_config.checkSum = calChecksum;
+      BLYNK_LOG4(BLYNK_F("SaveEEPROM,sz="), EEPROM_SIZE, BLYNK_F(",CSum=0x"), String(calChecksum, HEX))
 
-      if (!hadConfigData)
-        getConfigData();
+      EEPROM_writeData(EEPROM_CONFIG_START, &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
 
-      return (String(Blynk8266_WM_config.Blynk_Creds[index].blynk_server));
+#if USE_DYNAMIC_PARAMETERS         
+      EEPROM_putDynamicData();
+#endif
+      
+      EEPROM_commitData();
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
 
-    String getToken(uint8_t index)
-    {
-      if (index >= NUM_BLYNK_CREDENTIALS)
-        return String("");
+#endif
 
-      if (!hadConfigData)
-        getConfigData();
+    //////////////////////////////////////
 
-      return (String(Blynk8266_WM_config.Blynk_Creds[index].blynk_token));
-    }
+    // Non-persistent forced CP flag only needs to survive a software reset => kept in RTC memory only.
+    // Persistent flag must survive power loss => stored in flash, and mirrored in RTC memory.
+    // Flash is read only when RTC data is invalid (e.g. power-on), and written only when its flag changes
     
-    //////////////////////////////////////////////
+#if FORCED_CP_USE_RTC
 
-    String getBoardName()
-    {
-      if (!hadConfigData)
-        getConfigData();
-
-      return (String(Blynk8266_WM_config.board_name));
-    }
+    BlynkWM_ForcedCP_RTC forcedCP_RTC = { 0, 0 };
     
     //////////////////////////////////////////////
-
-    int getHWPort()
+    
+    void saveForcedCP_RTC(uint32_t forcedCPFlag, uint32_t flashForcedCPFlag)
     {
-      if (!hadConfigData)
-        getConfigData();
-
-      return (Blynk8266_WM_config.blynk_port);
+      forcedCP_RTC.forcedCPFlag       = forcedCPFlag;
+      forcedCP_RTC.flashForcedCPFlag  = flashForcedCPFlag;
+      
+      saveRTCData(BLYNK_WM_RTC_FORCED_CP_OFFSET, &forcedCP_RTC, sizeof(forcedCP_RTC));
     }
     
     //////////////////////////////////////////////
-
-    Blynk_WM_Configuration* getFullConfigData(Blynk_WM_Configuration *configData)
+    
+    void setForcedCP(bool isPersistent)
     {
-      if (!hadConfigData)
-        getConfigData();
-
-      // Check if NULL pointer
-      if (configData)
-        memcpy(configData, &Blynk8266_WM_config, sizeof(Blynk_WM_Configuration));
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
 
-      return (configData);
-    }
-    
-    //////////////////////////////////////////////
+      if (isPersistent)
+      {
+        if (forcedCP_RTC.flashForcedCPFlag != FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
+        {
+          setForcedCPFlash(true);
+        }
+        
+        saveForcedCP_RTC(FORCED_PERS_CONFIG_PORTAL_FLAG_DATA, FORCED_PERS_CONFIG_PORTAL_FLAG_DATA);
+      }
+      else
+      {
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("setForcedCP non-Persistent RTC"));
+#endif
 
-    void clearConfigData()
-    {
-      memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
-      saveConfigData();
+        saveForcedCP_RTC(FORCED_CONFIG_PORTAL_FLAG_DATA, forcedCP_RTC.flashForcedCPFlag);
+      }
     }
     
     //////////////////////////////////////////////
     
-    // Forced CP => Flag = 0xBEEFBEEF. Else => No forced CP
-    // Flag to be stored at (EEPROM_START + DRD_FLAG_DATA_SIZE + CONFIG_DATA_SIZE) 
-    // to avoid corruption to current data
-    //#define FORCED_CONFIG_PORTAL_FLAG_DATA              ( (uint32_t) 0xDEADBEEF)
-    //#define FORCED_PERS_CONFIG_PORTAL_FLAG_DATA         ( (uint32_t) 0xBEEFDEAD)
-    
-    const uint32_t FORCED_CONFIG_PORTAL_FLAG_DATA       = 0xDEADBEEF;
-    const uint32_t FORCED_PERS_CONFIG_PORTAL_FLAG_DATA  = 0xBEEFDEAD;
-    
-    #define FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE     4
-    
-    void resetAndEnterConfigPortal()
+    void clearForcedCP()
     {
-      persForcedConfigPortal = false;
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
+      if (forcedCP_RTC.flashForcedCPFlag != 0)
+      {
+        clearForcedCPFlash();
+      }
       
-      setForcedCP(false);
+      if (forcedCP_RTC.forcedCPFlag != 0)
+      {
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG1(BLYNK_F("clearForcedCP RTC"));
+#endif
       
-      // Delay then reset the ESP8266 after save data
-      delay(1000);
-      ESP.reset();
+        saveForcedCP_RTC(0, 0);
+      }
     }
     
     //////////////////////////////////////////////
     
-    // This will keep CP forever, until you successfully enter CP, and Save data to clear the flag.
-    void resetAndEnterConfigPortalPersistent()
+    bool isForcedCP()
     {
-      persForcedConfigPortal = true;
-      
-      setForcedCP(true);
+      if (loadRTCData(BLYNK_WM_RTC_FORCED_CP_OFFSET, &forcedCP_RTC, sizeof(forcedCP_RTC)))
+      {
+#if ( BLYNK_WM_DEBUG > 2)      
+        BLYNK_LOG2(BLYNK_F("LoadCPRTC OK,flag=0x"), String(forcedCP_RTC.forcedCPFlag, HEX));
+#endif
+      }
+      else
+      {
+        // RTC data invalid => read flash once, and keep it in RTC
+        uint32_t flashForcedCPFlag = 0;
+        
+#if USE_RTC_CONFIG_CACHE
+        mountStorage();
+#endif
+        
+        if (isForcedCPFlash())
+        {
+          flashForcedCPFlag = persForcedConfigPortal ? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
+        }
+        
+        saveForcedCP_RTC(flashForcedCPFlag, flashForcedCPFlag);
+      }
       
-      // Delay then reset the ESP8266 after save data
-      delay(1000);
-      ESP.reset();
+      if (forcedCP_RTC.forcedCPFlag == FORCED_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = false;
+        return true;
+      }
+      else if (forcedCP_RTC.forcedCPFlag == FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
+      {       
+        persForcedConfigPortal = true;
+        return true;
+      }
+      else
+      {       
+        return false;
+      }
     }
     
-    //////////////////////////////////////
-    
-    // Add customs headers from v1.3.0
-    
-    // New from v1.2.0, for configure CORS Header, default to WM_HTTP_CORS_ALLOW_ALL = "*"
+#else
 
-#if USING_CUSTOMS_STYLE
-    //sets a custom style, such as color
-    // "<style>div,input{padding:5px;font-size:1em;}
-    // input{width:95%;}body{text-align: center;}
-    // button{background-color:#16A1E7;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;}
-    // fieldset{border-radius:0.3rem;margin:0px;}</style>";
-    void setCustomsStyle(const char* CustomsStyle = BLYNK_WM_HTML_HEAD_STYLE) 
+    void setForcedCP(bool isPersistent)
     {
-      BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE = CustomsStyle;
-      BLYNK_LOG2(F("Set CustomsStyle to : "), BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE);
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
+      setForcedCPFlash(isPersistent);
     }
     
-    //////////////////////////////////////
+    //////////////////////////////////////////////
     
-    const char* getCustomsStyle()
+    void clearForcedCP()
     {
-      BLYNK_LOG2(F("Get CustomsStyle = "), BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE);
-      return BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE;
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
+      clearForcedCPFlash();
     }
+    
+    //////////////////////////////////////////////
+    
+    bool isForcedCP()
+    {
+#if USE_RTC_CONFIG_CACHE
+      mountStorage();
 #endif
 
+      return isForcedCPFlash();
+    }
+    
+#endif
+    
     //////////////////////////////////////
 
-#if USING_CUSTOMS_HEAD_ELEMENT    
-    //sets a custom element to add to head, like a new style tag
-    void setCustomsHeadElement(const char* CustomsHeadElement = NULL) 
+#if USE_RTC_CONFIG_CACHE
+    // Storage is not started when Config Data is loaded from RTC cache. Start it before reading the forced CP flag
+    void mountStorage()
     {
-      _CustomsHeadElement = CustomsHeadElement;
-      BLYNK_LOG2(F("Set CustomsHeadElement to : "), _CustomsHeadElement);
+      if (storageReady)
+        return;
+        
+#if ( USE_LITTLEFS || USE_SPIFFS )
+      FileFS.begin();
+#else
+      EEPROM.begin(EEPROM_SIZE);
+#endif
+
+      storageReady = true;
     }
     
     //////////////////////////////////////
     
-    const char* getCustomsHeadElement()
+    // Start storage, with the full Config Data, before writing
+    void beginStorage()
     {
-      BLYNK_LOG2(F("Get CustomsHeadElement = "), _CustomsHeadElement);
-      return _CustomsHeadElement;
+      mountStorage();
+      
+      // Config Data from RTC cache only has the Credentials of the last connection
+      if (configCacheLoaded)
+      {
+        configCacheLoaded = false;
+        hadConfigData     = getConfigData();
+      }
     }
 #endif
 
     //////////////////////////////////////
-    
-#if USING_CORS_FEATURE   
-    void setCORSHeader(const char* CORSHeaders = NULL)
-    {     
-      _CORS_Header = CORSHeaders;
 
-      BLYNK_LOG2(F("Set CORS Header to : "), _CORS_Header);
+#if ( USE_WIFI_AP_CACHE || USE_WIFI_SCAN_RANK || USE_DHCP_LEASE_CACHE || USE_RTC_CONFIG_CACHE )
+
+    uint32_t calcWiFiCredsCRC(uint8_t index)
+    {
+      return calcCRC32(&Blynk8266_WM_config.WiFi_Creds[index], sizeof(Blynk8266_WM_config.WiFi_Creds[index]));
     }
     
     //////////////////////////////////////
     
-    const char* getCORSHeader()
-    {      
-      BLYNK_LOG2(F("Get CORS Header = "), _CORS_Header);
-      return _CORS_Header;
+    // Index in WiFi_Creds of SSID, NUM_WIFI_CREDENTIALS if not found
+    uint8_t getWiFiCredsIndex(const char* ssid)
+    {
+      uint8_t index;
+      
+      for (index = 0; index < NUM_WIFI_CREDENTIALS; index++)
+      {
+        if ( (strlen(Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid) != 0) && (strcmp(ssid, Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid) == 0) )
+          break;
+      }
+      
+      return index;
     }
-#endif
-          
-    //////////////////////////////////////
-
-
-  private:
-    AsyncWebServer *server;
-    bool configuration_mode = false;
-
-    ESP8266WiFiMulti wifiMulti;
-
-    unsigned long configTimeout;
-    bool hadConfigData = false;
-    
-    bool isForcedConfigPortal   = false;
-    bool persForcedConfigPortal = false;
     
-    // default to channel 1
-    int WiFiAPChannel = 1;
-
-    Blynk_WM_Configuration Blynk8266_WM_config;
+    //////////////////////////////////////
     
-    uint16_t totalDataSize = 0;
-
-    // For Config Portal, from Blynk_WM v1.0.5
-    IPAddress portal_apIP = IPAddress(192, 168, 4, 1);
-
-    String portal_ssid = "";
-    String portal_pass = "";
+#endif
 
-    // For static IP, from Blynk_WM v1.0.5
-    IPAddress static_IP   = IPAddress(0, 0, 0, 0);
-    IPAddress static_GW   = IPAddress(0, 0, 0, 0);
-    IPAddress static_SN   = IPAddress(255, 255, 255, 0);
-    IPAddress static_DNS1 = IPAddress(0, 0, 0, 0);
-    IPAddress static_DNS2 = IPAddress(0, 0, 0, 0);
+#if USE_WIFI_AP_CACHE
 
-/////////////////////////////////////
+    // Return true if cached AP is valid for current WiFi Credentials
+    bool loadAPCache()
+    {
+      if (!apCacheLoaded)
+      {
+        apCacheValid  = loadRTCData(BLYNK_WM_RTC_AP_CACHE_OFFSET, &apCache, sizeof(apCache));
+        apCacheLoaded = true;
+      }
+      
+      return ( apCacheValid && (apCache.channel != 0) && (apCache.wifiIndex < NUM_WIFI_CREDENTIALS) && 
+               (apCache.credsCRC == calcWiFiCredsCRC(apCache.wifiIndex)) );
+    }
     
-    // Add customs headers from v1.2.0
+    //////////////////////////////////////
     
-#if USING_CUSTOMS_STYLE
-    const char* BLYNK_WM_HTML_HEAD_CUSTOMS_STYLE = NULL;
+    // Save the connected AP. RTC memory is written only when AP changed
+    void saveAPCache()
+    {
+      BlynkWM_APCache newCache;
+      String ssid = WiFi.SSID();
+      
+      memset(&newCache, 0, sizeof(newCache));
+      
+      for (newCache.wifiIndex = 0; newCache.wifiIndex < NUM_WIFI_CREDENTIALS; newCache.wifiIndex++)
+      {
+        if (strcmp(ssid.c_str(), Blynk8266_WM_config.WiFi_Creds[newCache.wifiIndex].wifi_ssid) == 0)
+          break;
+      }
+      
+      if (newCache.wifiIndex >= NUM_WIFI_CREDENTIALS)
+        return;
+      
+      memcpy(newCache.bssid, WiFi.BSSID(), sizeof(newCache.bssid));
+      newCache.channel  = WiFi.channel();
+      newCache.credsCRC = calcWiFiCredsCRC(newCache.wifiIndex);
+      
+#if USE_EARLY_WIFI
+      if (loadAPCache() && (memcmp(&newCache, &apCache, sizeof(apCache)) == 0) && earlyWiFiSaved)
+        return;
+#else
+      if (loadAPCache() && (memcmp(&newCache, &apCache, sizeof(apCache)) == 0))
+        return;
 #endif
-    
-#if USING_CUSTOMS_HEAD_ELEMENT
-    const char* _CustomsHeadElement = NULL;
+        
+      memcpy(&apCache, &newCache, sizeof(apCache));
+      apCacheValid = saveRTCData(BLYNK_WM_RTC_AP_CACHE_OFFSET, &apCache, sizeof(apCache));
+      
+#if USE_EARLY_WIFI
+      earlyWiFiSaved = saveRTCData(BLYNK_WM_RTC_EARLY_WIFI_OFFSET, &Blynk8266_WM_config.WiFi_Creds[apCache.wifiIndex], sizeof(WiFi_Credentials));
 #endif
-    
-#if USING_CORS_FEATURE    
-    const char* _CORS_Header        = WM_HTTP_CORS_ALLOW_ALL;   //"*";
+      
+#if ( BLYNK_WM_DEBUG > 2)
+      BLYNK_LOG4(BLYNK_F("SaveAPCache,BSSID="), WiFi.BSSIDstr(), BLYNK_F(",ch="), apCache.channel);
 #endif
-       
+    }
+    
     //////////////////////////////////////
     
-#define RFC952_HOSTNAME_MAXLEN      24
-
-    char RFC952_hostname[RFC952_HOSTNAME_MAXLEN + 1];
-
-    char* getRFC952_hostname(const char* iHostname)
+    void clearAPCache()
     {
-      memset(RFC952_hostname, 0, sizeof(RFC952_hostname));
-
-      size_t len = ( RFC952_HOSTNAME_MAXLEN < strlen(iHostname) ) ? RFC952_HOSTNAME_MAXLEN : strlen(iHostname);
-
-      size_t j = 0;
-
-      for (size_t i = 0; i < len - 1; i++)
+      apCacheValid = false;
+      invalidateRTCData(BLYNK_WM_RTC_AP_CACHE_OFFSET);
+    }
+    
+    //////////////////////////////////////
+    
+    // Start direct connection to the cached AP, on its channel, without scanning. Return false if no valid cache
+    bool beginAPCache()
+    {
+      if (!loadAPCache())
+        return false;
+        
+#if USE_EARLY_WIFI
+      if (earlyWiFiStarted)
       {
-        if ( isalnum(iHostname[i]) || iHostname[i] == '-' )
-        {
-          RFC952_hostname[j] = iHostname[i];
-          j++;
-        }
+        // Already connecting since begin()
+        earlyWiFiStarted = false;
+        
+        return true;
       }
-      // no '-' as last char
-      if ( isalnum(iHostname[len - 1]) || (iHostname[len - 1] != '-') )
-        RFC952_hostname[j] = iHostname[len - 1];
-
-      return RFC952_hostname;
+#endif
+        
+      const char* ssid  = Blynk8266_WM_config.WiFi_Creds[apCache.wifiIndex].wifi_ssid;
+      const char* pass  = Blynk8266_WM_config.WiFi_Creds[apCache.wifiIndex].wifi_pw;
+      
+      BLYNK_LOG4(BLYNK_F("Con2CachedAP:"), ssid, BLYNK_F(",ch="), apCache.channel);
+      
+#if USE_DHCP_LEASE_CACHE
+      beginDHCPLease(apCache.wifiIndex);
+#endif
+      
+      WiFi.begin(ssid, strlen(pass) ? pass : NULL, apCache.channel, apCache.bssid);
+      
+      return true;
     }
     
     //////////////////////////////////////
-
-    void displayConfigData(Blynk_WM_Configuration configData)
+    
+    bool connectAPCache()
     {
-      BLYNK_LOG4(BLYNK_F("Hdr="),       configData.header,
-                 BLYNK_F(",BrdName="),  configData.board_name);
-      BLYNK_LOG4(BLYNK_F("SSID="),      configData.WiFi_Creds[0].wifi_ssid,
-                 BLYNK_F(",PW="),       configData.WiFi_Creds[0].wifi_pw);
-      BLYNK_LOG4(BLYNK_F("SSID1="),     configData.WiFi_Creds[1].wifi_ssid,
-                 BLYNK_F(",PW1="),      configData.WiFi_Creds[1].wifi_pw);
-      BLYNK_LOG4(BLYNK_F("Server="),    configData.Blynk_Creds[0].blynk_server,
-                 BLYNK_F(",Token="),    configData.Blynk_Creds[0].blynk_token);
-      BLYNK_LOG4(BLYNK_F("Server1="),   configData.Blynk_Creds[1].blynk_server,
-                 BLYNK_F(",Token1="),   configData.Blynk_Creds[1].blynk_token);
-      BLYNK_LOG2(BLYNK_F("Port="),      configData.blynk_port);
-      BLYNK_LOG1(BLYNK_F("======= End Config Data ======="));
+      if (!beginAPCache())
+        return false;
+        
+      unsigned long startTime = millis();
+      
+      while ( (WiFi.status() != WL_CONNECTED) && (millis() - startTime < TIMEOUT_WIFI_AP_CACHE) )
+      {
+        delay(100);
+      }
+      
+      if (WiFi.status() == WL_CONNECTED)
+        return true;
+      
+      // AP moved to another channel, or not reachable
+      BLYNK_LOG1(BLYNK_F("CachedAP failed. Scan all"));
+      clearAPCache();
+      
+      return false;
     }
     
     //////////////////////////////////////
+    
+#if USE_EARLY_WIFI
 
-    void displayWiFiData()
+    // Start connection to the cached AP, with the WiFi Credentials cached in RTC memory, before Config Data is loaded
+    void beginEarlyWiFi()
     {
-      BLYNK_LOG6(BLYNK_F("IP="), WiFi.localIP().toString(), BLYNK_F(",GW="), WiFi.gatewayIP().toString(),
-                 BLYNK_F(",SN="), WiFi.subnetMask().toString());
-      BLYNK_LOG4(BLYNK_F("DNS1="), WiFi.dnsIP(0).toString(), BLYNK_F(",DNS2="), WiFi.dnsIP(1).toString());
+      WiFi_Credentials creds;
+      
+      apCacheValid  = loadRTCData(BLYNK_WM_RTC_AP_CACHE_OFFSET, &apCache, sizeof(apCache));
+      apCacheLoaded = true;
+      
+      earlyWiFiSaved = loadRTCData(BLYNK_WM_RTC_EARLY_WIFI_OFFSET, &creds, sizeof(creds));
+      
+      if ( !apCacheValid || !earlyWiFiSaved || (apCache.channel == 0) || (calcCRC32(&creds, sizeof(creds)) != apCache.credsCRC) )
+        return;
+        
+      BLYNK_LOG4(BLYNK_F("EarlyCon2CachedAP:"), creds.wifi_ssid, BLYNK_F(",ch="), apCache.channel);
+      
+      setHostname();
+      
+      WiFi.begin(creds.wifi_ssid, strlen(creds.wifi_pw) ? creds.wifi_pw : NULL, apCache.channel, apCache.bssid);
+      
+      earlyWiFiStarted = true;
     }
     
     //////////////////////////////////////
-
-    int calcChecksum()
+    
+    // Config Data loaded. Keep the connection started by begin() only if going to connect, with unchanged WiFi Credentials
+    void confirmEarlyWiFi(bool willConnect)
     {
-      int checkSum = 0;
-      for (uint16_t index = 0; index < (sizeof(Blynk8266_WM_config) - sizeof(Blynk8266_WM_config.checkSum)); index++)
+      if (!earlyWiFiStarted)
+        return;
+        
+      if (willConnect && loadAPCache())
       {
-        checkSum += * ( ( (byte*) &Blynk8266_WM_config ) + index);
+#if ( BLYNK_WM_DEBUG > 2)
+        BLYNK_LOG1(BLYNK_F("EarlyWiFi confirmed"));
+#endif
+        return;
       }
-
-      return checkSum;
+      
+      BLYNK_LOG1(BLYNK_F("EarlyWiFi aborted"));
+      
+      earlyWiFiStarted = false;
+      WiFi.disconnect();
     }
     
     //////////////////////////////////////
+    
+#endif
 
-#if ( USE_LITTLEFS || USE_SPIFFS )
-
-#define  CONFIG_FILENAME                  BLYNK_F("/wmssl_conf.dat")
-#define  CONFIG_FILENAME_BACKUP           BLYNK_F("/wmssl_conf.bak")
-
-#define  CREDENTIALS_FILENAME             BLYNK_F("/wmssl_cred.dat")
-#define  CREDENTIALS_FILENAME_BACKUP        BLYNK_F("/wmssl_cred.bak")
+#endif
 
-#define  CONFIG_PORTAL_FILENAME           BLYNK_F("/wm_cp.dat")
-#define  CONFIG_PORTAL_FILENAME_BACKUP    BLYNK_F("/wm_cp.bak")
+#if USE_WIFI_SCAN_RANK
 
-    //////////////////////////////////////////////
-    
-    void saveForcedCP(uint32_t value)
+    void loadWiFiHistory()
     {
-      File file = FileFS.open(CONFIG_PORTAL_FILENAME, "w");
-      
-      BLYNK_LOG1(BLYNK_F("SaveCPFile "));
-
-      if (file)
+      if (wifiHistoryLoaded)
+        return;
+        
+      if (!loadRTCData(BLYNK_WM_RTC_WIFI_HISTORY_OFFSET, &wifiHistory, sizeof(wifiHistory)))
       {
-        file.write((uint8_t*) &value, sizeof(value));
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));
+        memset(&wifiHistory, 0, sizeof(wifiHistory));
+        wifiHistory.lastIndex = 0xFF;
       }
-      else
+      
+      // Drop history of changed WiFi Credentials
+      for (uint8_t index = 0; index < NUM_WIFI_CREDENTIALS; index++)
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
+        uint32_t credsCRC = calcWiFiCredsCRC(index);
+        
+        if (wifiHistory.credsCRC[index] != credsCRC)
+        {
+          wifiHistory.credsCRC[index]  = credsCRC;
+          wifiHistory.failCount[index] = 0;
+          
+          if (wifiHistory.lastIndex == index)
+            wifiHistory.lastIndex = 0xFF;
+        }
       }
-
-      // Trying open redundant CP file
-      file = FileFS.open(CONFIG_PORTAL_FILENAME_BACKUP, "w");
       
-      BLYNK_LOG1(BLYNK_F("SaveBkUpCPFile "));
-
-      if (file)
+      wifiHistoryLoaded = true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Record result of connection to WiFi_Creds[index]. RTC memory is written only when history changed
+    void saveWiFiHistory(uint8_t index, bool connected)
+    {
+      if (index >= NUM_WIFI_CREDENTIALS)
+        return;
+        
+      loadWiFiHistory();
+      
+      if (connected)
       {
-        file.write((uint8_t *) &value, sizeof(value));
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));
+        if ( (wifiHistory.failCount[index] == 0) && (wifiHistory.lastIndex == index) )
+          return;
+          
+        wifiHistory.failCount[index]  = 0;
+        wifiHistory.lastIndex         = index;
       }
       else
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
+        if (wifiHistory.failCount[index] == 0xFF)
+          return;
+          
+        wifiHistory.failCount[index]++;
       }
+      
+      saveRTCData(BLYNK_WM_RTC_WIFI_HISTORY_OFFSET, &wifiHistory, sizeof(wifiHistory));
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
     
-    void setForcedCP(bool isPersistent)
+    bool isWiFiScanFresh()
     {
-      uint32_t readForcedConfigPortalFlag = isPersistent? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
-
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(isPersistent ? BLYNK_F("setForcedCP Persistent") : BLYNK_F("setForcedCP non-Persistent"));
-#endif
-      
-      saveForcedCP(readForcedConfigPortalFlag);
+      return ( wifiScanValid && (millis() - wifiScanTime < WIFI_SCAN_CACHE_TTL) );
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
     
-    void clearForcedCP()
+    // Keep the strongest AP of each WiFi Credentials
+    void scanWiFi()
     {
-      uint32_t readForcedConfigPortalFlag = 0;
-
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(BLYNK_F("clearForcedCP"));
-#endif
+      BLYNK_LOG1(BLYNK_F("Scan WiFi"));
       
-      saveForcedCP(readForcedConfigPortalFlag);
+      int16_t numNetworks = WiFi.scanNetworks();
+      
+      memset(wifiScan, 0, sizeof(wifiScan));
+      
+      for (int16_t i = 0; i < numNetworks; i++)
+      {
+        uint8_t index = getWiFiCredsIndex(WiFi.SSID(i).c_str());
+        int32_t rssi  = WiFi.RSSI(i);
+        
+        if ( (index >= NUM_WIFI_CREDENTIALS) || ( (wifiScan[index].rssi != 0) && (rssi <= wifiScan[index].rssi) ) )
+          continue;
+          
+        wifiScan[index].rssi    = (rssi < -127) ? -127 : ( (rssi >= 0) ? -1 : rssi );
+        wifiScan[index].channel = WiFi.channel(i);
+        memcpy(wifiScan[index].bssid, WiFi.BSSID(i), sizeof(wifiScan[index].bssid));
+      }
+      
+      WiFi.scanDelete();
+      
+      wifiScanTime  = millis();
+      wifiScanValid = (numNetworks >= 0);
     }
     
-    //////////////////////////////////////////////
-
-    bool isForcedCP()
+    //////////////////////////////////////
+    
+    // Rank of WiFi_Creds[index], higher is better. Without fresh scan, rank uses history only
+    int16_t getWiFiRank(uint8_t index)
     {
-      uint32_t readForcedConfigPortalFlag;
-
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(BLYNK_F("Check if isForcedCP"));
-#endif
+      int16_t rank = 0;
       
-      File file = FileFS.open(CONFIG_PORTAL_FILENAME, "r");
-      BLYNK_LOG1(BLYNK_F("LoadCPFile "));
-
-      if (!file)
+      if (isWiFiScanFresh())
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
-
-        // Trying open redundant config file
-        file = FileFS.open(CONFIG_PORTAL_FILENAME_BACKUP, "r");
-        BLYNK_LOG1(BLYNK_F("LoadBkUpCPFile "));
-
-        if (!file)
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-          return false;
-        }
-       }
-
-      file.readBytes((char *) &readForcedConfigPortalFlag, sizeof(readForcedConfigPortalFlag));
-
-      BLYNK_LOG1(BLYNK_F("OK"));
-      file.close();
-      
-      // Return true if forced CP (0xDEADBEEF read at offset EPROM_START + DRD_FLAG_DATA_SIZE + CONFIG_DATA_SIZE)
-      // => set flag noForcedConfigPortal = false     
-      if (readForcedConfigPortalFlag == FORCED_CONFIG_PORTAL_FLAG_DATA)
-      {       
-        persForcedConfigPortal = false;
-        return true;
-      }
-      else if (readForcedConfigPortalFlag == FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
-      {       
-        persForcedConfigPortal = true;
-        return true;
-      }
-      else
-      {       
-        return false;
+        // Not found by scan => last
+        rank = wifiScan[index].rssi ? wifiScan[index].rssi : -1000;
       }
-    }
-    
-    //////////////////////////////////////////////
-
-#if USE_DYNAMIC_PARAMETERS
-
-    bool checkDynamicData()
+      
+      if (wifiHistory.lastIndex == index)
+        rank += WIFI_RANK_HYSTERESIS;
+        
+      rank -= (int16_t) WIFI_RANK_FAIL_PENALTY * wifiHistory.failCount[index];
+      
+      return rank;
+    }
+    
+    //////////////////////////////////////
+    
+    // Sort wifiOrder, best first. Return number of WiFi Credentials found by a fresh scan
+    uint8_t rankWiFi(bool allowScan)
     {
-      int checkSum = 0;
-      int readCheckSum;
-      char* readBuffer;
-           
-      File file = FileFS.open(CREDENTIALS_FILENAME, "r");
-      BLYNK_LOG1(BLYNK_F("LoadCredFile "));
-
-      if (!file)
+      uint8_t numFound = 0;
+      int16_t rank[NUM_WIFI_CREDENTIALS];
+      
+      if (allowScan && !isWiFiScanFresh())
+        scanWiFi();
+        
+      loadWiFiHistory();
+      
+      for (uint8_t index = 0; index < NUM_WIFI_CREDENTIALS; index++)
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
-
-        // Trying open redundant config file
-        file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "r");
-        BLYNK_LOG1(BLYNK_F("LoadBkUpCredFile "));
-
-        if (!file)
+        rank[index] = getWiFiRank(index);
+        
+        if (isWiFiScanFresh() && wifiScan[index].rssi)
+          numFound++;
+        
+        // Insertion sort, stable for equal rank
+        uint8_t n = index;
+        
+        while ( (n > 0) && (rank[wifiOrder[n - 1]] < rank[index]) )
         {
-          BLYNK_LOG1(BLYNK_F("failed"));
-          return false;
+          wifiOrder[n] = wifiOrder[n - 1];
+          n--;
         }
+        
+        wifiOrder[n] = index;
       }
       
-      // Find the longest pdata, then dynamically allocate buffer. Remember to free when done
-      // This is used to store tempo data to calculate checksum to see of data is valid
-      // We dont like to destroy myMenuItems[i].pdata with invalid data
+#if ( BLYNK_WM_DEBUG > 2)
+      for (uint8_t n = 0; n < NUM_WIFI_CREDENTIALS; n++)
+      {
+        BLYNK_LOG4(BLYNK_F("WiFiRank:"), Blynk8266_WM_config.WiFi_Creds[wifiOrder[n]].wifi_ssid, BLYNK_F(",rank="), rank[wifiOrder[n]]);
+      }
+#endif
       
-      uint16_t maxBufferLength = 0;
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        if (myMenuItems[i].maxlen > maxBufferLength)
-          maxBufferLength = myMenuItems[i].maxlen;
+      return numFound;
+    }
+    
+    //////////////////////////////////////
+    
+    // Connect to the BSSID and channel found by a fresh scan, or let WiFi find the AP
+    void beginRankedWiFi(uint8_t index)
+    {
+      const char* ssid  = Blynk8266_WM_config.WiFi_Creds[index].wifi_ssid;
+      const char* pass  = Blynk8266_WM_config.WiFi_Creds[index].wifi_pw;
+      
+      if (isWiFiScanFresh() && wifiScan[index].rssi)
+      {
+        BLYNK_LOG6(BLYNK_F("Con2:"), ssid, BLYNK_F(",ch="), wifiScan[index].channel, BLYNK_F(",RSSI="), wifiScan[index].rssi);
+        
+        WiFi.begin(ssid, strlen(pass) ? pass : NULL, wifiScan[index].channel, wifiScan[index].bssid);
+      }
+      else
+      {
+        BLYNK_LOG2(BLYNK_F("Con2:"), ssid);
+        
+        WiFi.begin(ssid, pass);
       }
+    }
+    
+    //////////////////////////////////////
+    
+    // Try WiFi Credentials found by scan, best ranked first
+    bool connectRankedWiFi()
+    {
+      uint8_t numFound = rankWiFi(true);
       
-      if (maxBufferLength > 0)
+      for (uint8_t n = 0; n < numFound; n++)
       {
-        readBuffer = new char[ maxBufferLength + 1 ];
+        uint8_t index = wifiOrder[n];
         
-        // check to see NULL => stop and return false
-        if (readBuffer == NULL)
-        {
-          BLYNK_LOG1(BLYNK_F("ChkCrR: Error can't allocate buffer."));
-          return false;
-        }
-#if ( BLYNK_WM_DEBUG > 2)          
-        else
+#if USE_DHCP_LEASE_CACHE
+        beginDHCPLease(index);
+#endif
+        beginRankedWiFi(index);
+        
+        unsigned long startTime = millis();
+        
+        while ( (WiFi.status() != WL_CONNECTED) && (millis() - startTime < TIMEOUT_WIFI_RANKED) )
         {
-          BLYNK_LOG2(BLYNK_F("ChkCrR: Buffer allocated, sz="), maxBufferLength + 1);
+          delay(100);
         }
-#endif             
+        
+        if (WiFi.status() == WL_CONNECTED)
+          return true;
+          
+        saveWiFiHistory(index, false);
       }
-     
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = readBuffer;
+      
+      // Scan again at next attempt
+      wifiScanValid = false;
+      
+      return false;
+    }
+    
+    //////////////////////////////////////
+    
+#endif
 
-        // Actual size of pdata is [maxlen + 1]
-        memset(readBuffer, 0, myMenuItems[i].maxlen + 1);
-        
-        file.readBytes(_pointer, myMenuItems[i].maxlen);
+#if USE_DHCP_LEASE_CACHE
 
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG4(F("ChkCrR:pdata="), readBuffer, F(",len="), myMenuItems[i].maxlen);
-#endif          
-               
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
-        {         
-          checkSum += *_pointer;  
-        }       
+    // Return true if a cached lease can be reused for WiFi_Creds[index]
+    bool loadDHCPLease(uint8_t index)
+    {
+      if (!dhcpLeaseLoaded)
+      {
+        dhcpLeaseValid  = loadRTCData(BLYNK_WM_RTC_DHCP_LEASE_OFFSET, &dhcpLease, sizeof(dhcpLease));
+        dhcpLeaseLoaded = true;
       }
-
-      file.readBytes((char *) &readCheckSum, sizeof(readCheckSum));
-      
-      BLYNK_LOG1(BLYNK_F("OK"));
-      file.close();
       
-      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+      return ( dhcpLeaseValid && (dhcpLease.ip != 0) && (dhcpLease.wifiIndex == index) && (index < NUM_WIFI_CREDENTIALS) &&
+               (dhcpLease.reuseCount < DHCP_LEASE_MAX_REUSE) && (dhcpLease.credsCRC == calcWiFiCredsCRC(index)) );
+    }
+    
+    //////////////////////////////////////
+    
+    // Keep the lease of the connected WiFi. A reused lease only counts the reuse
+    void saveDHCPLease()
+    {
+      uint8_t index = getWiFiCredsIndex(WiFi.SSID().c_str());
       
-      // Free buffer
-      if (readBuffer != NULL)
+      if (index >= NUM_WIFI_CREDENTIALS)
+        return;
+        
+      if (dhcpLeaseApplied && loadDHCPLease(index))
       {
-        free(readBuffer);
-        BLYNK_LOG1(BLYNK_F("Buffer freed"));
+        dhcpLease.reuseCount++;
       }
-      
-      if ( checkSum != readCheckSum)
+      else
       {
-        return false;
+        dhcpLease.ip          = WiFi.localIP();
+        dhcpLease.gateway     = WiFi.gatewayIP();
+        dhcpLease.subnet      = WiFi.subnetMask();
+        dhcpLease.dns1        = WiFi.dnsIP(0);
+        dhcpLease.dns2        = WiFi.dnsIP(1);
+        dhcpLease.credsCRC    = calcWiFiCredsCRC(index);
+        dhcpLease.wifiIndex   = index;
+        dhcpLease.reuseCount  = 0;
       }
       
-      return true;    
+      dhcpLeaseLoaded = true;
+      dhcpLeaseValid  = saveRTCData(BLYNK_WM_RTC_DHCP_LEASE_OFFSET, &dhcpLease, sizeof(dhcpLease));
     }
     
     //////////////////////////////////////
-
-    bool loadDynamicData()
+    
+    void clearDHCPLease()
     {
-      int checkSum = 0;
-      int readCheckSum;
-      totalDataSize = sizeof(Blynk8266_WM_config) + sizeof(readCheckSum);
-      
-      File file = FileFS.open(CREDENTIALS_FILENAME, "r");
-      BLYNK_LOG1(BLYNK_F("LoadCredFile "));
-
-      if (!file)
+      dhcpLeaseValid = false;
+      invalidateRTCData(BLYNK_WM_RTC_DHCP_LEASE_OFFSET);
+    }
+    
+    //////////////////////////////////////
+    
+    // Set the cached lease of WiFi_Creds[index] as static IP, or use DHCP. Must be called after setHostname()
+    void beginDHCPLease(uint8_t index)
+    {
+      if (!loadDHCPLease(index))
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
-
-        // Trying open redundant config file
-        file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "r");
-        BLYNK_LOG1(BLYNK_F("LoadBkUpCredFile "));
-
-        if (!file)
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-          return false;
-        }
-      }
-     
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = myMenuItems[i].pdata;
-        totalDataSize += myMenuItems[i].maxlen;
-
-        // Actual size of pdata is [maxlen + 1]
-        memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
+        endDHCPLease();
         
-        file.readBytes(_pointer, myMenuItems[i].maxlen);
-
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG4(F("CrR:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
-#endif          
-               
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
-        {         
-          checkSum += *_pointer;  
-        }       
+        return;
       }
-
-      file.readBytes((char *) &readCheckSum, sizeof(readCheckSum));
       
-      BLYNK_LOG1(BLYNK_F("OK"));
-      file.close();
+      BLYNK_LOG4(BLYNK_F("UseCachedLease,IP="), IPAddress(dhcpLease.ip), BLYNK_F(",reuse="), dhcpLease.reuseCount);
       
-      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
+      WiFi.config(IPAddress(dhcpLease.ip), IPAddress(dhcpLease.gateway), IPAddress(dhcpLease.subnet),
+                  IPAddress(dhcpLease.dns1), IPAddress(dhcpLease.dns2));
+                  
+      dhcpLeaseApplied = true;
+    }
+    
+    //////////////////////////////////////
+    
+    // Back to DHCP for next WiFi.begin()
+    void endDHCPLease()
+    {
+      if (!dhcpLeaseApplied)
+        return;
+        
+      WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
       
-      if ( checkSum != readCheckSum)
+      dhcpLeaseApplied = false;
+    }
+    
+    //////////////////////////////////////
+    
+    // Blynk not connected with the reused lease, which may be outdated. Return true if lease was dropped
+    bool dropDHCPLease()
+    {
+      if (!dhcpLeaseApplied)
+        return false;
+        
+      BLYNK_LOG1(BLYNK_F("CachedLease failed. Use DHCP"));
+      
+      clearDHCPLease();
+      WiFi.disconnect();
+      endDHCPLease();
+      
+      return true;
+    }
+    
+    //////////////////////////////////////
+    
+#endif
+
+#if RESET_DETECT_USE_RTC
+
+    // Count this reset in RTC memory, and clear noConfigPortal if DRD/MRD detected.
+    // Return false to use DRD/MRD in flash : RTC memory lost at power on, or flash flag possibly still set
+    bool detectResetRTC(bool& noConfigPortal)
+    {
+      resetDetectActive = true;
+      
+      if ( !loadRTCData(BLYNK_WM_RTC_RESET_DETECT_OFFSET, &resetDetectRTC, sizeof(resetDetectRTC)) || resetDetectRTC.flashPending )
       {
+        resetDetectRTC.resetCount   = 0;
+        resetDetectRTC.flashPending = 1;
+        
+        saveRTCData(BLYNK_WM_RTC_RESET_DETECT_OFFSET, &resetDetectRTC, sizeof(resetDetectRTC));
+        
         return false;
       }
       
-      return true;    
+      if (++resetDetectRTC.resetCount >= RESET_DETECT_TIMES)
+      {
+#if ( BLYNK_WM_DEBUG > 1)
+        BLYNK_LOG1(BLYNK_F("Multi or Double Reset Detected in RTC"));
+#endif
+        noConfigPortal = false;
+        resetDetectRTC.resetCount = 0;
+      }
+      
+      saveRTCData(BLYNK_WM_RTC_RESET_DETECT_OFFSET, &resetDetectRTC, sizeof(resetDetectRTC));
+      
+      return true;
     }
     
     //////////////////////////////////////
-
-    void saveDynamicData()
+    
+    // No other reset within RESET_DETECT_TIMEOUT. Flash flag, if any, is cleared by drd->loop() / mrd->loop()
+    void checkResetDetectRTC()
     {
-      int checkSum = 0;
+      if ( !resetDetectActive || (millis() < RESET_DETECT_TIMEOUT * 1000UL) )
+        return;
+        
+      clearResetDetectRTC();
+    }
     
-      File file = FileFS.open(CREDENTIALS_FILENAME, "w");
-      BLYNK_LOG1(BLYNK_F("SaveCredFile "));
+    //////////////////////////////////////
+    
+    void clearResetDetectRTC()
+    {
+      resetDetectActive = false;
+      
+      resetDetectRTC.resetCount   = 0;
+      resetDetectRTC.flashPending = 0;
+      
+      saveRTCData(BLYNK_WM_RTC_RESET_DETECT_OFFSET, &resetDetectRTC, sizeof(resetDetectRTC));
+    }
+    
+    //////////////////////////////////////
+    
+#endif
 
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = myMenuItems[i].pdata;
+#if USE_DUTY_CYCLE
 
-#if ( BLYNK_WM_DEBUG > 2)          
-        BLYNK_LOG4(F("CW1:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
+    // drd->loop() / mrd->loop() isn't called while in deep sleep, so its timeout never passes. Clear the flag
+    // in flash and the RTC count now, or the next user reset would be taken as a double / multi reset
+    void stopResetDetect()
+    {
+#if USING_MRD
+      if (mrd)
+        mrd->stop();
+#else
+      if (drd)
+        drd->stop();
 #endif
-        
-        if (file)
-        {
-          file.write((uint8_t*) _pointer, myMenuItems[i].maxlen);         
-        }
-        else
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-        }        
-                     
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
-        {         
-          checkSum += *_pointer;     
-         }
+
+#if RESET_DETECT_USE_RTC
+      if (resetDetectActive)
+        clearResetDetectRTC();
+#endif
+    }
+    
+    //////////////////////////////////////////////
+    
+    void loadDutyCycle()
+    {
+      if (dutyCycleLoaded)
+        return;
+      
+      if (!loadRTCData(BLYNK_WM_RTC_DUTY_CYCLE_OFFSET, &dutyCycle, sizeof(dutyCycle)) || 
+          (dutyCycle.queueCount > DUTY_CYCLE_QUEUE_SIZE) )
+      {
+        // Power-on or RTC data lost
+        memset(&dutyCycle, 0, sizeof(dutyCycle));
       }
       
-      if (file)
+      dutyCycleLoaded = true;
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Ping Blynk server after writes. The server processes messages in order, so any reply after the ping
+    // means all writes were received
+    bool waitDutyCycleAck(unsigned long startTime, uint32_t timeout)
+    {
+      millis_time_t lastActivity = Base::lastActivityIn;
+      
+      Base::sendCmd(BLYNK_CMD_PING);
+      
+      while (millis() - startTime < timeout)
       {
-        file.write((uint8_t*) &checkSum, sizeof(checkSum));     
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));    
+        Base::run();
+        
+        if (!this->connected())
+          return false;
+        
+        if (Base::lastActivityIn != lastActivity)
+          return true;
+        
+        delay(1);
       }
-      else
-      {
-        BLYNK_LOG1(BLYNK_F("failed"));
-      }   
-           
-      BLYNK_LOG2(F("CrWCSum=0x"), String(checkSum, HEX));
       
-      // Trying open redundant Auth file
-      file = FileFS.open(CREDENTIALS_FILENAME_BACKUP, "w");
-      BLYNK_LOG1(BLYNK_F("SaveBkUpCredFile "));
+      BLYNK_LOG1(BLYNK_F("DutyCycle:no ack"));
+      
+      return false;
+    }
+    
+    //////////////////////////////////////////////
+#endif
 
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = myMenuItems[i].pdata;
+#if USE_RUN_TIME_CHECK
 
-#if ( BLYNK_WM_DEBUG > 2)         
-        BLYNK_LOG4(F("CW2:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
-#endif
+    void checkRunTime(uint32_t runTime)
+    {
+      bool longest = (runTime > maxRunTime);
+      
+      if (longest)
+        maxRunTime = runTime;
+      
+      if (runTime <= RUN_TIME_BUDGET)
+        return;
         
-        if (file)
-        {
-          file.write((uint8_t*) _pointer, myMenuItems[i].maxlen);         
-        }
-        else
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-        }        
-                     
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
-        {         
-          checkSum += *_pointer;     
-         }
-      }
+      runOverruns++;
       
-      if (file)
+      if (longest)
       {
-        file.write((uint8_t*) &checkSum, sizeof(checkSum));     
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));    
+#if USE_ASYNC_CONNECT
+        BLYNK_LOG4(BLYNK_F("run() overrun(ms)="), runTime, BLYNK_F(",ConnState="), runStartState);
+#else
+        BLYNK_LOG2(BLYNK_F("run() overrun(ms)="), runTime);
+#endif
       }
-      else
-      {
-        BLYNK_LOG1(BLYNK_F("failed"));
-      }   
     }
+    
+    //////////////////////////////////////////////
 #endif
 
-    //////////////////////////////////////
+#if USE_TIME_SERVICE
 
-    void loadConfigData()
+    void beginTimeService()
     {
-      File file = FileFS.open(CONFIG_FILENAME, "r");
-      BLYNK_LOG1(BLYNK_F("LoadCfgFile "));
-
-      if (!file)
+      BlynkWM_Time_RTC timeRTC;
+      
+      // Clock is kept by ESP32 across soft resets, not by ESP8266
+      if ( !isTimeValid() && loadRTCData(BLYNK_WM_RTC_TIME_OFFSET, &timeRTC, sizeof(timeRTC)) )
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
-
-        // Trying open redundant config file
-        file = FileFS.open(CONFIG_FILENAME_BACKUP, "r");
-        BLYNK_LOG1(BLYNK_F("LoadBkUpCfgFile "));
-
-        if (!file)
-        {
-          BLYNK_LOG1(BLYNK_F("failed"));
-          return;
-        }
+        // Add time since reset. Time lost in reset makes clock a bit late, still good to verify certificates
+        struct timeval tv = { (time_t) (timeRTC.epoch + millis() / 1000), 0 };
+        
+        settimeofday(&tv, NULL);
+        
+        BLYNK_LOG2(BLYNK_F("Time from RTC="), timeRTC.epoch);
       }
-
-      file.readBytes((char *) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
-
-      BLYNK_LOG1(BLYNK_F("OK"));
-      file.close();
+      
+      // Only once. SNTP syncs in the background, and SSL client won't start it again
+      this->conn.startNTP();
     }
     
-    //////////////////////////////////////
-
-    void saveConfigData()
+    //////////////////////////////////////////////
+    
+    // Keep time in RTC memory, plus seconds to add, e.g. for deep sleep
+    void saveTimeRTC(uint32_t addSeconds)
     {
-      File file = FileFS.open(CONFIG_FILENAME, "w");
-      BLYNK_LOG1(BLYNK_F("SaveCfgFile "));
-
-      int calChecksum = calcChecksum();
-      Blynk8266_WM_config.checkSum = calChecksum;
-      BLYNK_LOG2(BLYNK_F("WCSum=0x"), String(calChecksum, HEX));
-
-      if (file)
-      {
-        file.write((uint8_t*) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));
-      }
-      else
+      if (!isTimeValid())
+        return;
+      
+      BlynkWM_Time_RTC timeRTC = { (uint32_t) time(nullptr) + addSeconds };
+      
+      timeSaved     = saveRTCData(BLYNK_WM_RTC_TIME_OFFSET, &timeRTC, sizeof(timeRTC));
+      timeSaveTime  = millis();
+    }
+    
+    //////////////////////////////////////////////
+    
+    void checkTimeService()
+    {
+      if ( !timeSaved || (millis() - timeSaveTime >= TIME_SAVE_INTERVAL) )
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
+        saveTimeRTC(0);
       }
+    }
+    
+    //////////////////////////////////////////////
+#endif
 
-      // Trying open redundant Auth file
-      file = FileFS.open(CONFIG_FILENAME_BACKUP, "w");
-      BLYNK_LOG1(BLYNK_F("SaveBkUpCfgFile "));
+#if TLS_SESSION_USE_RTC
 
-      if (file)
-      {
-        file.write((uint8_t *) &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
-        file.close();
-        BLYNK_LOG1(BLYNK_F("OK"));
-      }
-      else
+    // Restore TLS session kept before deep sleep or reset
+    void loadTLSSession()
+    {
+      BlynkWM_TLSSession_RTC  sessionRTC;
+      BearSSL::Session        session;
+      
+      if (loadRTCData(BLYNK_WM_RTC_TLS_SESSION_OFFSET, &sessionRTC, sizeof(sessionRTC)))
       {
-        BLYNK_LOG1(BLYNK_F("failed"));
+        memcpy(&session, sessionRTC.data, sizeof(session));
+        this->conn.setTLSSession(session);
       }
     }
     
     //////////////////////////////////////////////
     
-    void saveAllConfigData()
+    void saveTLSSession()
     {
-      saveConfigData();     
+      BlynkWM_TLSSession_RTC  sessionRTC;
+      BearSSL::Session        session;
       
-#if USE_DYNAMIC_PARAMETERS      
-      saveDynamicData();
-#endif      
+      if (!this->conn.getTLSSession(session))
+        return;
+      
+      memset(&sessionRTC, 0, sizeof(sessionRTC));
+      memcpy(sessionRTC.data, &session, sizeof(session));
+      
+      saveRTCData(BLYNK_WM_RTC_TLS_SESSION_OFFSET, &sessionRTC, sizeof(sessionRTC));
     }
     
     //////////////////////////////////////////////
+#endif
 
-    // Return false if init new EEPROM or SPIFFS/LittleFS. No more need trying to connect. Go directly to config mode
-    bool getConfigData()
+#if USE_RECONNECT_BACKOFF
+
+    // Schedule next reconnect attempt, doubling the backoff of the failed layer up to its max
+    void scheduleReconnect(bool wifiFailed)
     {
-      bool dynamicDataValid = true;
-      int calChecksum;  
+      uint32_t& backoff   = wifiFailed ? reconnectWiFiBackoff : reconnectBlynkBackoff;
+      uint32_t  minDelay  = wifiFailed ? RECONNECT_WIFI_BACKOFF_MIN : RECONNECT_BLYNK_BACKOFF_MIN;
+      uint32_t  maxDelay  = wifiFailed ? RECONNECT_WIFI_BACKOFF_MAX : RECONNECT_BLYNK_BACKOFF_MAX;
       
-      hadConfigData = false;
+      if (backoff == 0)
+        backoff = minDelay;
+      else
+        backoff = (backoff > maxDelay / 2) ? maxDelay : backoff * 2;
       
-      if (!FileFS.begin())
-      {
-        FileFS.format();
-        
-        if (!FileFS.begin())
-        {
-#if USE_LITTLEFS
-          BLYNK_LOG1(BLYNK_F("LittleFS failed!. Please use SPIFFS or EEPROM."));
-#else
-          BLYNK_LOG1(BLYNK_F("SPIFFS failed!. Please use LittleFS or EEPROM."));
-#endif 
-          return false;
-        }
-      }
-
-      if (LOAD_DEFAULT_CONFIG_DATA)
-      {
-        // Load Config Data from Sketch
-        memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
-        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
-        
-        // Including config and dynamic data, and assume valid
-        saveAllConfigData();
-        
-#if ( BLYNK_WM_DEBUG > 2)      
-        BLYNK_LOG1(BLYNK_F("======= Start Loaded Config Data ======="));
-        displayConfigData(Blynk8266_WM_config);
-#endif
-
-        // Don't need Config Portal anymore
-        return true; 
-      }
-#if USE_DYNAMIC_PARAMETERS      
-      else if ( ( FileFS.exists(CONFIG_FILENAME)      || FileFS.exists(CONFIG_FILENAME_BACKUP) ) &&
-                ( FileFS.exists(CREDENTIALS_FILENAME) || FileFS.exists(CREDENTIALS_FILENAME_BACKUP) ) )
-#else
-      else if ( FileFS.exists(CONFIG_FILENAME) || FileFS.exists(CONFIG_FILENAME_BACKUP) )
-#endif  
-      {
-        // if config file exists, load
-        loadConfigData();
-        
-#if ( BLYNK_WM_DEBUG > 2)      
-        BLYNK_LOG1(BLYNK_F("======= Start Stored Config Data ======="));
-        displayConfigData(Blynk8266_WM_config);
+      uint32_t jitter         = backoff * RECONNECT_BACKOFF_JITTER / 100;
+      uint32_t reconnectDelay = backoff - jitter + random(2 * jitter + 1);
+      
+      nextReconnectTime   = millis() + reconnectDelay;
+      reconnectScheduled  = true;
+      
+      BLYNK_LOG4(BLYNK_F("Reconnect in ms="), reconnectDelay, BLYNK_F(",WiFi lost="), wifiFailed);
+    }
+    
+    //////////////////////////////////////
+    
+    void resetReconnectBackoff()
+    {
+      reconnectWiFiBackoff  = 0;
+      reconnectBlynkBackoff = 0;
+      reconnectScheduled    = false;
+    }
+    
+    //////////////////////////////////////
+    
+    bool isReconnectDue()
+    {
+      return ( (long) (millis() - nextReconnectTime) >= 0 );
+    }
+    
+    //////////////////////////////////////
+    
 #endif
 
-        calChecksum = calcChecksum();
-
-        BLYNK_LOG4(BLYNK_F("CCSum=0x"), String(calChecksum, HEX),
-                   BLYNK_F(",RCSum=0x"), String(Blynk8266_WM_config.checkSum, HEX));
-                 
-#if USE_DYNAMIC_PARAMETERS                 
-        // Load dynamic data
-        dynamicDataValid = loadDynamicData();
-        
-        if (dynamicDataValid)
-        {
-  #if ( BLYNK_WM_DEBUG > 2)      
-          BLYNK_LOG1(BLYNK_F("Valid Stored Dynamic Data"));
-  #endif          
-        }
-  #if ( BLYNK_WM_DEBUG > 2)  
-        else
-        {
-          BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data. Ignored"));
-        }
-  #endif
-#endif
-      }
-      else    
-      {
-        // Not loading Default config data, but having no config file => Config Portal
-        return false;
-      }    
-      
-      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) ||
-           (calChecksum != Blynk8266_WM_config.checkSum) || !dynamicDataValid )
-                      
-      {         
-        // Including Credentials CSum
-        BLYNK_LOG2(BLYNK_F("InitCfgFile,sz="), sizeof(Blynk8266_WM_config));
+#if USE_BOOT_TIMING
 
-        // doesn't have any configuration        
-        if (LOAD_DEFAULT_CONFIG_DATA)
-        {
-          memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
-        }
-        else
-        {
-          memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
-                      
-          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG);
-          Blynk8266_WM_config.blynk_port = BLYNK_SERVER_HARDWARE_PORT;      
-          strcpy(Blynk8266_WM_config.board_name,       NO_CONFIG);
-          
-#if USE_DYNAMIC_PARAMETERS       
-          for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-          {
-            // Actual size of pdata is [maxlen + 1]
-            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
-            strncpy(myMenuItems[i].pdata, NO_CONFIG, myMenuItems[i].maxlen);
-          }
+    // Keep the first time a phase is reached
+    void setBootPhase(uint32_t& phaseTime)
+    {
+      if ( (phaseTime == 0) && !bootTimingDone )
+      {
+        phaseTime = millis();
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    void formatBootTiming(char* line, size_t lineSize)
+    {
+      snprintf(line, lineSize, "begin=%lu,rst=%lu,cfg=%lu,wifi=%lu,dns=%lu,ntp=%lu,tcp=%lu,login=%lu",
+               (unsigned long) bootTiming.begin, (unsigned long) bootTiming.resetDetect, (unsigned long) bootTiming.config,
+               (unsigned long) bootTiming.wifi,  (unsigned long) bootTiming.dns,         (unsigned long) bootTiming.ntp,
+               (unsigned long) bootTiming.tcp,   (unsigned long) bootTiming.login);
+               
+#if USE_RTC_CONFIG_CACHE
+      size_t len = strlen(line);
+      
+      snprintf(line + len, lineSize - len, ",cfgSaved=%u", configCacheTimeSaved);
 #endif
-        }
+    }
     
-        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+    //////////////////////////////////////
+    
+    // Blynk logged in : stop recording, then print and optionally write to BOOT_TIMING_VPIN
+    void finishBootTiming()
+    {
+      if (bootTimingDone)
+        return;
         
-        #if (USE_DYNAMIC_PARAMETERS && ( BLYNK_WM_DEBUG > 2) )
-        for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-        {
-          BLYNK_LOG4(BLYNK_F("g:myMenuItems["), i, BLYNK_F("]="), myMenuItems[i].pdata );
-        }
-        #endif
+      // NTP sync and TLS handshake are done inside the transport
+      if (bootTiming.ntp == 0)
+        bootTiming.ntp = this->conn.getNTPSyncTime();
         
-        // Don't need
-        Blynk8266_WM_config.checkSum = 0;
+      if (bootTiming.tcp == 0)
+        bootTiming.tcp = this->conn.getTLSConnectTime();
+        
+      setBootPhase(bootTiming.wifi);
+      setBootPhase(bootTiming.login);
+      
+      bootTimingDone = true;
+      
+      printBootTiming();
+      
+#if (BOOT_TIMING_VPIN >= 0)
+      char line[160];
+      
+      formatBootTiming(line, sizeof(line));
+      Base::virtualWrite(BOOT_TIMING_VPIN, line);
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+#endif
 
-        saveAllConfigData();
+    void checkConnectionEvents()
+    {
+      bool isConnected = ( (WiFi.status() == WL_CONNECTED) && this->connected() );
+      
+      if (isConnected == lastConnected)
+        return;
+        
+      lastConnected = isConnected;
+      
+#if USE_RTC_CONFIG_CACHE
+      // Cache the Credentials of this connection, unless they come from the cache
+      if (isConnected && !configCacheLoaded)
+      {
+        saveConfigCache();
+      }
+#endif
+      
+#if USE_BOOT_TIMING
+      if (isConnected)
+      {
+        finishBootTiming();
+      }
+#endif
 
-        return false;
+#if TLS_SESSION_USE_RTC
+      if (isConnected)
+      {
+        saveTLSSession();
       }
-      else if ( !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) ) )
+#endif
+      
+      if (isConnected && connectedCallback)
       {
-        // If SSID, PW, Server,Token ="nothing", stay in config mode forever until having config Data.
-        return false;
+        connectedCallback();
       }
-      else
+      else if (!isConnected && disconnectedCallback)
       {
-        displayConfigData(Blynk8266_WM_config);
+        disconnectedCallback();
       }
-
-      return true;
     }
     
     //////////////////////////////////////
 
-#else
-
-  #ifndef EEPROM_SIZE
-    #define EEPROM_SIZE     2048
-  #else
-    #if (EEPROM_SIZE > 4096)
-      #warning EEPROM_SIZE must be <= 4096. Reset to 4096
-      #undef EEPROM_SIZE
-      #define EEPROM_SIZE     4096
-    #endif
-    // FLAG_DATA_SIZE is 4, to store DRD/MRD flag
-    #if (EEPROM_SIZE < FLAG_DATA_SIZE + CONFIG_DATA_SIZE)
-      #warning EEPROM_SIZE must be > CONFIG_DATA_SIZE. Reset to 512
-      #undef EEPROM_SIZE
-      #define EEPROM_SIZE     4096
-    #endif
-  #endif
-
-  #ifndef EEPROM_START
-    #define EEPROM_START     0      //define 256 in DRD/MRD
-  #else
-    #if (EEPROM_START + FLAG_DATA_SIZE + CONFIG_DATA_SIZE + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE > EEPROM_SIZE)
-      #error EPROM_START + FLAG_DATA_SIZE + CONFIG_DATA_SIZE + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE > EEPROM_SIZE. Please adjust.
-    #endif
-  #endif
+#if USE_ASYNC_CONNECT
 
-// Stating positon to store BlynkESP32_WM_config
-#define BLYNK_EEPROM_START    (EEPROM_START + FLAG_DATA_SIZE)
-
-    //////////////////////////////////////////////
+    bool isConnecting()
+    {
+      return ( (connectState != BLYNK_WM_STATE_IDLE) && (connectState != BLYNK_WM_STATE_CONNECTED) );
+    }
     
-    void setForcedCP(bool isPersistent)
+    //////////////////////////////////////
+    
+    void startConnect(bool fromBegin)
     {
-      uint32_t readForcedConfigPortalFlag = isPersistent? FORCED_PERS_CONFIG_PORTAL_FLAG_DATA : FORCED_CONFIG_PORTAL_FLAG_DATA;
+      connectFromBegin  = fromBegin;
+      connectRounds     = 0;
+      connectWiFiIndex  = 0;
+      connectBlynkIndex = 0;
+      
+#if USE_WIFI_AP_CACHE
+      connectAPCacheTried = false;
+#endif
 
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(BLYNK_F("setForcedCP"));
+#if USE_WIFI_SCAN_RANK
+      // No blocking scan, use cached scan if still fresh
+      rankWiFi(false);
 #endif
       
-      EEPROM.put(BLYNK_EEPROM_START + CONFIG_DATA_SIZE, readForcedConfigPortalFlag);
-      EEPROM.commit();
+      if (WiFi.status() == WL_CONNECTED)
+      {
+        connectFirstBlynkServer();
+      }
+      else
+      {
+        setConnectState(BLYNK_WM_STATE_WIFI);
+      }
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
     
-    void clearForcedCP()
+    void connectFirstBlynkServer()
     {
-#if ( BLYNK_WM_DEBUG > 2)    
-      BLYNK_LOG1(BLYNK_F("clearForcedCP"));
+      connectBlynkIndex = 0;
+      
+#if USE_BLYNK_SERVER_PROBE
+      setConnectState(BLYNK_WM_STATE_PROBE);
+#else
+      setConnectState(BLYNK_WM_STATE_DNS);
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    // Index in WiFi_Creds of the WiFi to connect, best ranked first with USE_WIFI_SCAN_RANK
+    uint8_t getConnectWiFi()
+    {
+#if USE_WIFI_SCAN_RANK
+      return wifiOrder[connectWiFiIndex];
+#else
+      return connectWiFiIndex;
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    // Index in Blynk_Creds of the server to connect, fastest first with USE_BLYNK_SERVER_PROBE
+    uint8_t getConnectServer()
+    {
+#if USE_BLYNK_SERVER_PROBE
+      return serverOrder[connectBlynkIndex];
+#else
+      return connectBlynkIndex;
 #endif
+    }
+    
+    //////////////////////////////////////
+    
+    static void dnsFoundCallback(const char* name, const ip_addr_t* ipaddr, void* callbackArg)
+    {
+      BlynkWifi* self = (BlynkWifi*) callbackArg;
       
-      EEPROM.put(BLYNK_EEPROM_START + CONFIG_DATA_SIZE, 0);
-      EEPROM.commit();
+      // Ignore late answer to an abandoned request
+      if ( (self->dnsHost == NULL) || (strcmp(name, self->dnsHost) != 0) )
+        return;
+        
+      if (ipaddr)
+      {
+        self->dnsIP     = IPAddress(ip_addr_get_ip4_u32(ipaddr));
+        self->dnsResult = 1;
+      }
+      else
+      {
+        self->dnsResult = -1;
+      }
     }
     
-    //////////////////////////////////////////////
-
-    bool isForcedCP()
+    //////////////////////////////////////
+    
+    // Entry actions of each connection step
+    void setConnectState(BlynkWM_ConnectState state)
     {
-      uint32_t readForcedConfigPortalFlag;
-
-#if ( BLYNK_WM_DEBUG > 2)      
-      BLYNK_LOG1(BLYNK_F("Check if isForcedCP"));
+      connectState      = state;
+      connectStateTime  = millis();
+      
+#if ( BLYNK_WM_DEBUG > 2)
+      BLYNK_LOG2(BLYNK_F("ConnState="), state);
 #endif
       
-      // Return true if forced CP (0xDEADBEEF read at offset EPROM_START + DRD_FLAG_DATA_SIZE + CONFIG_DATA_SIZE)
-      // => set flag noForcedConfigPortal = false
-      EEPROM.get(BLYNK_EEPROM_START + CONFIG_DATA_SIZE, readForcedConfigPortalFlag);
+      switch (state)
+      {
+        case BLYNK_WM_STATE_WIFI:
+        
+#if USE_WIFI_AP_CACHE
+          connectUsingAPCache = false;
+          
+          if (!connectAPCacheTried)
+          {
+            connectAPCacheTried = true;
+            
+            WiFi.mode(WIFI_STA);
+            setHostname();
+            
+            connectUsingAPCache = beginAPCache();
+            
+            if (connectUsingAPCache)
+              break;
+          }
+#endif
+          
+          // Skip empty WiFi credentials
+          while ( (connectWiFiIndex < NUM_WIFI_CREDENTIALS) && (strlen(Blynk8266_WM_config.WiFi_Creds[getConnectWiFi()].wifi_ssid) == 0) )
+          {
+            connectWiFiIndex++;
+          }
+          
+          if (connectWiFiIndex >= NUM_WIFI_CREDENTIALS)
+          {
+            BLYNK_LOG1(BLYNK_F("WiFi not connected"));
+            connectFailed(true);
+            
+            return;
+          }
+          
+          WiFi.mode(WIFI_STA);
+          setHostname();
+          
+#if USE_DHCP_LEASE_CACHE
+          beginDHCPLease(getConnectWiFi());
+#endif
+
+#if USE_WIFI_SCAN_RANK
+          beginRankedWiFi(getConnectWiFi());
+#else
+          BLYNK_LOG2(BLYNK_F("Con2:"), Blynk8266_WM_config.WiFi_Creds[getConnectWiFi()].wifi_ssid);
+          
+          WiFi.begin(Blynk8266_WM_config.WiFi_Creds[getConnectWiFi()].wifi_ssid, Blynk8266_WM_config.WiFi_Creds[getConnectWiFi()].wifi_pw);
+#endif
+          
+          break;
+          
+#if USE_BLYNK_SERVER_PROBE
+        case BLYNK_WM_STATE_PROBE:
+        
+          if (!startServerProbe())
+          {
+            setConnectState(BLYNK_WM_STATE_DNS);
+          }
+          
+          break;
+#endif
+          
+        case BLYNK_WM_STATE_DNS:
+        {
+          // Resolve without blocking. lwIP caches the answer, so the following connect() won't block on DNS
+          ip_addr_t addr;
+          
+          dnsHost   = Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_server;
+          dnsResult = 0;
+          
+          err_t err = dns_gethostbyname(dnsHost, &addr, dnsFoundCallback, this);
+          
+          if (err == ERR_OK)
+          {
+            // Cached, or IP address
+            dnsIP     = IPAddress(ip_addr_get_ip4_u32(&addr));
+            dnsResult = 1;
+          }
+          else if (err != ERR_INPROGRESS)
+          {
+            dnsResult = -1;
+          }
+          
+          break;
+        }
+          
+        case BLYNK_WM_STATE_NTP:
+        
+          dnsHost = NULL;
+          
+          if (time(nullptr) >= 100000)
+          {
+            setConnectState(BLYNK_WM_STATE_TCP);
+          }
+          else
+          {
+            // Poll time in each step, instead of waiting in connect() of transport
+            this->conn.startNTP();
+          }
+          
+          break;
+          
+        case BLYNK_WM_STATE_TCP:
+        
+          dnsHost = NULL;
+          
+          config(Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_token,
+                 Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_server, Blynk8266_WM_config.blynk_port);
+                 
+          // Timeout 0 : only sets Blynk state to connecting. TCP connect and login are done by Base::run()
+          Base::connect(0);
+          
+          break;
+          
+        case BLYNK_WM_STATE_CONNECTED:
+        
+          BLYNK_LOG4(BLYNK_F("Connected to BlynkServer="), Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_server,
+                     BLYNK_F(",Token="), Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_token);
+                     
+          connectFromBegin = false;
+          
+#if USE_RTC_CONFIG_CACHE
+          connectedBlynkIndex = getConnectServer();
+#endif
+          
+#if USE_BOOT_TIMING
+          finishBootTiming();
+#endif
+          
+          // turn the LED_BUILTIN OFF to tell us we exit configuration mode.
+          digitalWrite(LED_BUILTIN, LED_OFF);
+          
+          break;
+          
+        default:
+        
+          dnsHost = NULL;
+          
+          break;
+      }
+    }
+    
+    //////////////////////////////////////
+    
+    void connectFailed(bool wifiFailed)
+    {
+      if (!connectFromBegin)
+      {
+        // run() will start again
+        setConnectState(BLYNK_WM_STATE_IDLE);
+        
+#if USE_RECONNECT_BACKOFF
+        scheduleReconnect(wifiFailed);
+#endif
+        
+        return;
+      }
       
-      // Return true if forced CP (0xDEADBEEF read at offset EPROM_START + DRD_FLAG_DATA_SIZE + CONFIG_DATA_SIZE)
-      // => set flag noForcedConfigPortal = false     
-      if (readForcedConfigPortalFlag == FORCED_CONFIG_PORTAL_FLAG_DATA)
-      {       
-        persForcedConfigPortal = false;
-        return true;
+      if (wifiFailed)
+      {
+        BLYNK_LOG1(BLYNK_F("bg: Fail2connect WiFi+Blynk"));
       }
-      else if (readForcedConfigPortalFlag == FORCED_PERS_CONFIG_PORTAL_FLAG_DATA)
-      {       
-        persForcedConfigPortal = true;
-        return true;
+      else if (++connectRounds < ASYNC_BLYNK_ROUNDS_BEFORE_CP)
+      {
+        connectFirstBlynkServer();
+        
+        return;
+      }
+      else
+      {
+        BLYNK_LOG1(BLYNK_F("bg: WiFi OK, Blynk not"));
+      }
+      
+      // failed to connect to WiFi or Blynk server, will start configuration mode
+      connectFromBegin = false;
+      setConnectState(BLYNK_WM_STATE_IDLE);
+      
+      startConfigurationModeOnFail();
+    }
+    
+    //////////////////////////////////////
+    
+    void connectNextBlynkServer()
+    {
+      this->conn.disconnect();
+      
+      if (++connectBlynkIndex < NUM_BLYNK_CREDENTIALS)
+      {
+        setConnectState(BLYNK_WM_STATE_DNS);
       }
       else
-      {       
-        return false;
+      {
+        BLYNK_LOG1(BLYNK_F("Blynk not connected"));
+        
+#if USE_DHCP_LEASE_CACHE
+        // Connect again with DHCP
+        if (dropDHCPLease())
+        {
+          connectWiFiIndex = 0;
+          setConnectState(BLYNK_WM_STATE_WIFI);
+          
+          return;
+        }
+#endif
+        
+        connectFailed(false);
       }
     }
     
-    //////////////////////////////////////////////
+    //////////////////////////////////////
     
-#if USE_DYNAMIC_PARAMETERS
-
-    bool checkDynamicData()
+    // One connection step, without blocking except for TCP connect / TLS handshake in Base::run()
+    // Time is synced in its own step, so connect() of transport won't wait for NTP
+    void connectStateMachine()
     {
-      int checkSum = 0;
-      int readCheckSum;
-      
-      #define BUFFER_LEN      128
-      char readBuffer[BUFFER_LEN + 1];
-      
-      uint16_t offset = BLYNK_EEPROM_START + sizeof(Blynk8266_WM_config) + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
-                
-      // Find the longest pdata, then dynamically allocate buffer. Remember to free when done
-      // This is used to store tempo data to calculate checksum to see of data is valid
-      // We dont like to destroy myMenuItems[i].pdata with invalid data
+      unsigned long stateTime = millis() - connectStateTime;
       
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        if (myMenuItems[i].maxlen > BUFFER_LEN)
-        {
-          // Size too large, abort and flag false
-          BLYNK_LOG1(BLYNK_F("ChkCrR: Error Small Buffer."));
-          return false;
-        }
-      }
-         
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = readBuffer;
+      // WiFi lost while connecting to Blynk
+      if ( (connectState > BLYNK_WM_STATE_WIFI) && (WiFi.status() != WL_CONNECTED) )
+      {
+        connectWiFiIndex = 0;
         
-        // Prepare buffer, more than enough
-        memset(readBuffer, 0, sizeof(readBuffer));
+#if USE_WIFI_AP_CACHE
+        connectAPCacheTried = false;
+#endif
+        setConnectState(BLYNK_WM_STATE_WIFI);
         
-        // Read more than necessary, but OK and easier to code
-        EEPROM.get(offset, readBuffer);
-        // NULL terminated
-        readBuffer[myMenuItems[i].maxlen] = 0;
+        return;
+      }
+      
+      switch (connectState)
+      {
+        case BLYNK_WM_STATE_WIFI:
+        
+          if (WiFi.status() == WL_CONNECTED)
+          {
+            BLYNK_LOG4(BLYNK_F("SSID="), WiFi.SSID(), BLYNK_F(",RSSI="), WiFi.RSSI());
+            BLYNK_LOG4(BLYNK_F("Channel="), WiFi.channel(), BLYNK_F(",IP="), WiFi.localIP() );
+            
+#if USE_WIFI_AP_CACHE
+            saveAPCache();
+#endif
 
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG4(F("ChkCrR:pdata="), readBuffer, F(",len="), myMenuItems[i].maxlen);
-#endif          
-               
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++)
-        {         
-          checkSum += *_pointer;  
-        }   
+#if USE_WIFI_SCAN_RANK
+            saveWiFiHistory(getWiFiCredsIndex(WiFi.SSID().c_str()), true);
+#endif
+
+#if USE_DHCP_LEASE_CACHE
+            saveDHCPLease();
+#endif
+
+#if USE_BOOT_TIMING
+            setBootPhase(bootTiming.wifi);
+#endif
+            
+            connectFirstBlynkServer();
+          }
+#if USE_WIFI_AP_CACHE
+          else if (connectUsingAPCache)
+          {
+            if (stateTime > TIMEOUT_WIFI_AP_CACHE)
+            {
+              // AP moved to another channel, or not reachable
+              BLYNK_LOG1(BLYNK_F("CachedAP failed. Try all"));
+              clearAPCache();
+              
+              setConnectState(BLYNK_WM_STATE_WIFI);
+            }
+          }
+#endif
+          else if (stateTime > TIMEOUT_ASYNC_WIFI)
+          {
+#if USE_WIFI_SCAN_RANK
+            saveWiFiHistory(getConnectWiFi(), false);
+#endif
+            connectWiFiIndex++;
+            setConnectState(BLYNK_WM_STATE_WIFI);
+          }
+          
+          break;
+          
+#if USE_BLYNK_SERVER_PROBE
+        case BLYNK_WM_STATE_PROBE:
         
-        offset += myMenuItems[i].maxlen;    
-      }
+          if (runServerProbe())
+          {
+            setConnectState(BLYNK_WM_STATE_DNS);
+          }
+          
+          break;
+#endif
+          
+        case BLYNK_WM_STATE_DNS:
+        
+          if (dnsResult > 0)
+          {
+#if ( BLYNK_WM_DEBUG > 2)
+            BLYNK_LOG2(BLYNK_F("DNS OK,IP="), dnsIP);
+#endif
 
-      EEPROM.get(offset, readCheckSum);
-           
-      BLYNK_LOG4(F("ChkCrR:CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
-           
-      if ( checkSum != readCheckSum)
-      {
-        return false;
+#if USE_BOOT_TIMING
+            setBootPhase(bootTiming.dns);
+#endif
+            setConnectState(BLYNK_WM_STATE_NTP);
+          }
+          else if ( (dnsResult < 0) || (stateTime > TIMEOUT_ASYNC_DNS) )
+          {
+            BLYNK_LOG2(BLYNK_F("DNS failed:"), Blynk8266_WM_config.Blynk_Creds[getConnectServer()].blynk_server);
+            connectNextBlynkServer();
+          }
+          
+          break;
+          
+        case BLYNK_WM_STATE_NTP:
+        
+          if (time(nullptr) >= 100000)
+          {
+#if USE_BOOT_TIMING
+            setBootPhase(bootTiming.ntp);
+#endif
+            setConnectState(BLYNK_WM_STATE_TCP);
+          }
+          else if (stateTime > TIMEOUT_ASYNC_NTP)
+          {
+            BLYNK_LOG1(BLYNK_F("NTP failed"));
+            connectNextBlynkServer();
+          }
+          
+          break;
+          
+        case BLYNK_WM_STATE_TCP:
+        
+          Base::run();
+          
+          // Connected, and login sent
+          if (this->conn.connected())
+          {
+#if USE_BOOT_TIMING
+            setBootPhase(bootTiming.tcp);
+#endif
+            setConnectState(BLYNK_WM_STATE_LOGIN);
+          }
+          else if (stateTime > TIMEOUT_ASYNC_TCP)
+          {
+            connectNextBlynkServer();
+          }
+          
+          break;
+          
+        case BLYNK_WM_STATE_LOGIN:
+        
+          Base::run();
+          
+          if (this->connected())
+          {
+            setConnectState(BLYNK_WM_STATE_CONNECTED);
+          }
+          else if (stateTime > TIMEOUT_ASYNC_LOGIN)
+          {
+            connectNextBlynkServer();
+          }
+          
+          break;
+          
+        default:
+          break;
       }
-      
-      return true;    
     }
     
     //////////////////////////////////////
+    
+#endif
 
-    bool EEPROM_getDynamicData()
+#if USE_BLYNK_SERVER_PROBE
+
+    void sortServerOrder()
     {
-      int readCheckSum;
-      int checkSum = 0;
-      uint16_t offset = BLYNK_EEPROM_START + sizeof(Blynk8266_WM_config) + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
-           
-      totalDataSize = sizeof(Blynk8266_WM_config) + sizeof(readCheckSum);
-      
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = myMenuItems[i].pdata;
-        totalDataSize += myMenuItems[i].maxlen;
+      // Insertion sort, unknown latency last. Stable, so ties keep Blynk_Creds order
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        uint8_t   j       = i;
+        uint32_t  latency = serverLatency[i] ? serverLatency[i] : 0xFFFFFFFF;
         
-        // Actual size of pdata is [maxlen + 1]
-        memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
-               
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++,offset++)
+        while ( (j > 0) && ( (serverLatency[serverOrder[j - 1]] ? serverLatency[serverOrder[j - 1]] : 0xFFFFFFFF) > latency ) )
         {
-          *_pointer = EEPROM.read(offset);
-          
-          checkSum += *_pointer;  
-         }    
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG4(F("CR:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
-#endif             
+          serverOrder[j] = serverOrder[j - 1];
+          j--;
+        }
+        
+        serverOrder[j] = i;
       }
+    }
+    
+    //////////////////////////////////////
+    
+    void updateServerLatency(uint8_t index, uint32_t sample)
+    {
+      if (sample == 0)
+        sample = 1;
+        
+      // Exponentially weighted moving average, weight 1/4 for new sample
+      serverLatency[index] = (serverLatency[index] == 0) ? sample : ( (3 * (uint32_t) serverLatency[index] + sample) / 4 );
+    }
+    
+    //////////////////////////////////////
+    
+    // Delete the clients of closed probes. Return false if some are still closing
+    bool deleteServerProbes()
+    {
+      bool allDeleted = true;
       
-      EEPROM.get(offset, readCheckSum);
-      
-      BLYNK_LOG4(F("CrCCsum=0x"), String(checkSum, HEX), F(",CrRCsum=0x"), String(readCheckSum, HEX));
-      
-      if ( checkSum != readCheckSum)
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
       {
-        return false;
+        AsyncClient* client = serverProbes[i].client;
+        
+        if (client == NULL)
+          continue;
+          
+        if (serverProbes[i].closed)
+        {
+          serverProbes[i].client = NULL;
+          delete client;
+        }
+        else
+        {
+          allDeleted = false;
+        }
       }
       
-      return true;
+      return allDeleted;
     }
     
     //////////////////////////////////////
-
-    void EEPROM_putDynamicData()
+    
+    // Return false if probes of previous race are still closing
+    bool startServerProbe()
     {
-      int checkSum = 0;
-      uint16_t offset = BLYNK_EEPROM_START + sizeof(Blynk8266_WM_config);
-                
-      for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
-      {       
-        char* _pointer = myMenuItems[i].pdata;
+      if (!deleteServerProbes())
+      {
+        sortServerOrder();
         
-#if ( BLYNK_WM_DEBUG > 2)        
-        BLYNK_LOG4(F("CW:pdata="), myMenuItems[i].pdata, F(",len="), myMenuItems[i].maxlen);
-#endif
-                            
-        for (uint16_t j = 0; j < myMenuItems[i].maxlen; j++,_pointer++,offset++)
-        {
-          EEPROM.write(offset, *_pointer);
-          
-          checkSum += *_pointer;     
-         }
+        return false;
       }
       
-      EEPROM.put(offset, checkSum);
-      //EEPROM.commit();
+      serverProbeStarted    = 0;
+      serverProbeStartTime  = millis();
       
-      BLYNK_LOG2(F("CrWCSum=0x"), String(checkSum, HEX));
+      return true;
     }
     
-#endif
-    
-    //////////////////////////////////////////////
+    //////////////////////////////////////
     
-    bool getConfigData()
+    // Non-blocking TCP connection. Callbacks may run in another task, so they only set probe->result and probe->closed
+    void beginServerProbe(uint8_t index)
     {
-      bool dynamicDataValid = true;
-      int calChecksum;
+      BlynkWM_ServerProbe* probe  = &serverProbes[index];
+      const char*          server = Blynk8266_WM_config.Blynk_Creds[index].blynk_server;
       
-      hadConfigData = false; 
+      probe->result = BLYNK_WM_PROBE_FAILED;
       
-      EEPROM.begin(EEPROM_SIZE);
-      BLYNK_LOG2(BLYNK_F("EEPROMsz:"), EEPROM_SIZE);
+      if (strlen(server) == 0)
+        return;
+        
+      AsyncClient* client = new AsyncClient();
       
-      if (LOAD_DEFAULT_CONFIG_DATA)
+      if (client == NULL)
+        return;
+        
+      probe->client     = client;
+      probe->startTime  = millis();
+      probe->closed     = false;
+      probe->result     = BLYNK_WM_PROBE_PENDING;
+      
+      client->onConnect([](void* arg, AsyncClient* c)
       {
-        // Load Config Data from Sketch
-        memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config)) + FORCED_CONFIG_PORTAL_FLAG_DATA_SIZE;
-        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
+        BlynkWM_ServerProbe* probe = (BlynkWM_ServerProbe*) arg;
         
-        // Including config and dynamic data, and assume valid
-        saveAllConfigData();
-                 
-#if ( BLYNK_WM_DEBUG > 2)      
-        BLYNK_LOG1(BLYNK_F("======= Start Loaded Config Data ======="));
-        displayConfigData(Blynk8266_WM_config);
-#endif
-
-        // Don't need Config Portal anymore
-        return true;             
-      }
-      else
+        probe->result = millis() - probe->startTime;
+        c->close(true);
+      }, probe);
+      
+      client->onError([](void* arg, AsyncClient* c, int8_t error)
       {
-        // Load data from EEPROM
-        EEPROM.get(BLYNK_EEPROM_START, Blynk8266_WM_config);
+        (void) c;
+        (void) error;
         
-#if ( BLYNK_WM_DEBUG > 2)      
-        BLYNK_LOG1(BLYNK_F("======= Start Stored Config Data ======="));
-        displayConfigData(Blynk8266_WM_config);
-#endif
-
-        calChecksum = calcChecksum();
-
-        BLYNK_LOG4(BLYNK_F("CCSum=0x"), String(calChecksum, HEX),
-                   BLYNK_F(",RCSum=0x"), String(Blynk8266_WM_config.checkSum, HEX));
-                 
-#if USE_DYNAMIC_PARAMETERS
-                 
-        // Load dynamic data from EEPROM
-        dynamicDataValid = EEPROM_getDynamicData();
+        BlynkWM_ServerProbe* probe = (BlynkWM_ServerProbe*) arg;
+        
+        if (probe->result == BLYNK_WM_PROBE_PENDING)
+          probe->result = BLYNK_WM_PROBE_FAILED;
+      }, probe);
+      
+      client->onDisconnect([](void* arg, AsyncClient* c)
+      {
+        (void) c;
+        
+        BlynkWM_ServerProbe* probe = (BlynkWM_ServerProbe*) arg;
+        
+        if (probe->result == BLYNK_WM_PROBE_PENDING)
+          probe->result = BLYNK_WM_PROBE_FAILED;
+          
+        // Last access to probe from this callback
+        probe->closed = true;
+      }, probe);
+      
+      if (!client->connect(server, Blynk8266_WM_config.blynk_port))
+      {
+        // No callback when failed at once
+        probe->client = NULL;
+        probe->result = BLYNK_WM_PROBE_FAILED;
         
-        if (dynamicDataValid)
-        {
-  #if ( BLYNK_WM_DEBUG > 2)      
-          BLYNK_LOG1(BLYNK_F("Valid Stored Dynamic Data"));
-  #endif          
-        }
-  #if ( BLYNK_WM_DEBUG > 2)  
-        else
-        {
-          BLYNK_LOG1(BLYNK_F("Invalid Stored Dynamic Data. Ignored"));
-        }
-  #endif
-#endif
+        delete client;
       }
+    }
+    
+    //////////////////////////////////////
+    
+    void finishServerProbe()
+    {
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        if ( (serverProbeStarted & (1UL << i)) == 0 )
+          continue;
+          
+        int32_t result = serverProbes[i].result;
         
-      if ( (strncmp(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE, strlen(BLYNK_BOARD_TYPE)) != 0) ||
-           (calChecksum != Blynk8266_WM_config.checkSum) || !dynamicDataValid )
-      {       
-        // Including Credentials CSum
-        BLYNK_LOG4(F("InitEEPROM,sz="), EEPROM_SIZE, F(",DataSz="), totalDataSize);
-
-        // doesn't have any configuration        
-        if (LOAD_DEFAULT_CONFIG_DATA)
+        if (result >= 0)
         {
-          memcpy(&Blynk8266_WM_config, &defaultConfig, sizeof(Blynk8266_WM_config));
+          updateServerLatency(i, result);
+        }
+        else if (result == BLYNK_WM_PROBE_FAILED)
+        {
+          updateServerLatency(i, TIMEOUT_BLYNK_SERVER_PROBE);
         }
         else
         {
-          memset(&Blynk8266_WM_config, 0, sizeof(Blynk8266_WM_config));
-             
-          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG);
-          strcpy(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG);
-          strcpy(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG);
-          Blynk8266_WM_config.blynk_port = BLYNK_SERVER_HARDWARE_PORT;      
-          strcpy(Blynk8266_WM_config.board_name,       NO_CONFIG);
+          // Slower than the winner. Stop it, and keep its average. Deleted when closed, at next race
+          AsyncClient* client = serverProbes[i].client;
           
-#if USE_DYNAMIC_PARAMETERS        
-          for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+          if (client && !serverProbes[i].closed)
+            client->close(true);
+        }
+      }
+      
+      sortServerOrder();
+      
+#if ( BLYNK_WM_DEBUG > 1)
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        BLYNK_LOG4(BLYNK_F("Probe:"), Blynk8266_WM_config.Blynk_Creds[i].blynk_server, BLYNK_F(",avg(ms)="), serverLatency[i]);
+      }
+#endif
+    }
+    
+    //////////////////////////////////////
+    
+    // Start probes when due. Return true when done : a server connected, all failed, or timeout
+    bool runServerProbe()
+    {
+      unsigned long elapsed = millis() - serverProbeStartTime;
+      bool          pending = false;
+      
+      for (uint8_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+      {
+        if ( (serverProbeStarted & (1UL << i)) == 0 )
+        {
+          if (elapsed < (unsigned long) i * BLYNK_SERVER_PROBE_STAGGER_MS)
           {
-            // Actual size of pdata is [maxlen + 1]
-            memset(myMenuItems[i].pdata, 0, myMenuItems[i].maxlen + 1);
-            strncpy(myMenuItems[i].pdata, NO_CONFIG, myMenuItems[i].maxlen);
+            pending = true;
+            continue;
           }
-#endif
+          
+          serverProbeStarted |= (1UL << i);
+          beginServerProbe(i);
         }
-    
-        strcpy(Blynk8266_WM_config.header, BLYNK_BOARD_TYPE);
         
-        #if ( USE_DYNAMIC_PARAMETERS && ( BLYNK_WM_DEBUG > 2) )   
-        for (uint16_t i = 0; i < NUM_MENU_ITEMS; i++)
+        if (serverProbes[i].result >= 0)
         {
-          BLYNK_LOG4(BLYNK_F("g:myMenuItems["), i, BLYNK_F("]="), myMenuItems[i].pdata );
+          // First connected wins
+          finishServerProbe();
+          
+          return true;
         }
-        #endif
         
-        // Don't need
-        Blynk8266_WM_config.checkSum = 0;
-
-        saveAllConfigData();
-
-        return false;
+        if (serverProbes[i].result == BLYNK_WM_PROBE_PENDING)
+          pending = true;
       }
-      else if ( !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[0].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid,       NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.WiFi_Creds[1].wifi_pw,         NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[0].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_server,   NO_CONFIG, strlen(NO_CONFIG) )  ||
-                !strncmp(Blynk8266_WM_config.Blynk_Creds[1].blynk_token,    NO_CONFIG, strlen(NO_CONFIG) ) )
-      {
-        // If SSID, PW, Server,Token ="nothing", stay in config mode forever until having config Data.
+      
+      if (pending && (elapsed < TIMEOUT_BLYNK_SERVER_PROBE))
         return false;
-      }
-      else
-      {
-        displayConfigData(Blynk8266_WM_config);
-      }
-
-      return true;
-    }
-    
-    //////////////////////////////////////
-
-    void saveConfigData()
-    {
-      int calChecksum = calcChecksum();
-      Blynk8266_WM_config.checkSum = calChecksum;
-      BLYNK_LOG4(BLYNK_F("SaveEEPROM,sz="), EEPROM_SIZE, BLYNK_F(",CSum=0x"), String(calChecksum, HEX))
-
-      EEPROM.put(BLYNK_EEPROM_START, Blynk8266_WM_config);
+        
+      finishServerProbe();
       
-      EEPROM.commit();
+      return true;
     }
     
     //////////////////////////////////////
     
-    void saveAllConfigData()
+    // Blocking race, used by connectMultiBlynk()
+    void probeBlynkServers()
     {
-      int calChecksum = calcChecksum();
-      Blynk8266_WM_config.checkSum = calChecksum;
-      BLYNK_LOG4(BLYNK_F("SaveEEPROM,sz="), EEPROM_SIZE, BLYNK_F(",CSum=0x"), String(calChecksum, HEX))
-
-      EEPROM.put(BLYNK_EEPROM_START, Blynk8266_WM_config);   
-
-#if USE_DYNAMIC_PARAMETERS         
-      EEPROM_putDynamicData();
-#endif
-      
-      EEPROM.commit();
+      if (!startServerProbe())
+        return;
+        
+      while (!runServerProbe())
+      {
+        delay(10);
+      }
     }
     
     //////////////////////////////////////
-
+    
 #endif
 
-    //////////////////////////////////////
-
     bool connectMultiBlynk()
     {
 #define BLYNK_CONNECT_TIMEOUT_MS      20000L
 
-      for (uint16_t i = 0; i < NUM_BLYNK_CREDENTIALS; i++)
+#if USE_BLYNK_SERVER_PROBE
+      // Race TCP connections to all servers, then try the fastest first
+      probeBlynkServers();
+#endif
+
+      for (uint16_t n = 0; n < NUM_BLYNK_CREDENTIALS; n++)
       {
+#if USE_BLYNK_SERVER_PROBE
+        uint16_t i = serverOrder[n];
+#else
+        uint16_t i = n;
+#endif
+
         config(Blynk8266_WM_config.Blynk_Creds[i].blynk_token,
                Blynk8266_WM_config.Blynk_Creds[i].blynk_server, Blynk8266_WM_config.blynk_port);
 
@@ -2158,11 +6144,24 @@ class BlynkWifi
         {
           BLYNK_LOG4(BLYNK_F("Connected to Blynk Server = "), Blynk8266_WM_config.Blynk_Creds[i].blynk_server,
                      BLYNK_F(", Token = "), Blynk8266_WM_config.Blynk_Creds[i].blynk_token);
+
+#if USE_RTC_CONFIG_CACHE
+          connectedBlynkIndex = i;
+#endif
+
           return true;
         }
       }
 
       BLYNK_LOG1(BLYNK_F("Blynk not connected"));
+      
+#if USE_DHCP_LEASE_CACHE
+      // Connect again with DHCP
+      if (dropDHCPLease())
+      {
+        connectMultiWiFi();
+      }
+#endif
 
       return false;
 
@@ -2183,21 +6182,60 @@ class BlynkWifi
       setHostname();
       
       int i = 0;
-      status = wifiMulti.run();
-      delay(WIFI_MULTI_CONNECT_WAITING_MS);
-
-      while ( ( i++ < 10 ) && ( status != WL_CONNECTED ) )
+      
+#if USE_WIFI_AP_CACHE
+      // Try last connected AP first, without scanning all channels
+      if (connectAPCache())
+      {
+        status = WL_CONNECTED;
+      }
+      else
+#endif
+#if USE_WIFI_SCAN_RANK
+      if (connectRankedWiFi())
+      {
+        status = WL_CONNECTED;
+      }
+      else
+#endif
       {
+#if USE_DHCP_LEASE_CACHE
+        // WiFi to connect is chosen by WiFiMulti
+        endDHCPLease();
+#endif
+
         status = wifiMulti.run();
+        delay(WIFI_MULTI_CONNECT_WAITING_MS);
 
-        if ( status == WL_CONNECTED )
-          break;
-        else
-          delay(WIFI_MULTI_CONNECT_WAITING_MS);
+        while ( ( i++ < 10 ) && ( status != WL_CONNECTED ) )
+        {
+          status = wifiMulti.run();
+
+          if ( status == WL_CONNECTED )
+            break;
+          else
+            delay(WIFI_MULTI_CONNECT_WAITING_MS);
+        }
       }
 
       if ( status == WL_CONNECTED )
       {
+#if USE_WIFI_AP_CACHE
+        saveAPCache();
+#endif
+
+#if USE_WIFI_SCAN_RANK
+        saveWiFiHistory(getWiFiCredsIndex(WiFi.SSID().c_str()), true);
+#endif
+
+#if USE_DHCP_LEASE_CACHE
+        saveDHCPLease();
+#endif
+
+#if USE_BOOT_TIMING
+        setBootPhase(bootTiming.wifi);
+#endif
+
         BLYNK_LOG2(BLYNK_F("WiFi connected after time: "), i);
         BLYNK_LOG4(BLYNK_F("SSID: "), WiFi.SSID(), BLYNK_F(", RSSI = "), WiFi.RSSI());
         BLYNK_LOG4(BLYNK_F("Channel: "), WiFi.channel(), BLYNK_F(", IP address: "), WiFi.localIP() );
@@ -2577,8 +6615,194 @@ class BlynkWifi
   #define CONFIG_TIMEOUT			60000L
 #endif
 
+    //////////////////////////////////////////////
+    
+    // Max size of the export data
+    uint16_t getExportMaxSize()
+    {
+#if USE_DYNAMIC_PARAMETERS
+      return sizeof(BlynkWM_Export_Header) + sizeof(Blynk8266_WM_config) + TLV_getMaxDataSize() + sizeof(uint32_t);
+#else
+      return sizeof(BlynkWM_Export_Header) + sizeof(Blynk8266_WM_config) + sizeof(uint32_t);
+#endif
+    }
+    
+    //////////////////////////////////////////////
+
+    // Download stored Config Data and Dynamic Params as one binary blob
+    void handleExport(AsyncWebServerRequest *request)
+    {
+      uint8_t* exportBuffer = new uint8_t[getExportMaxSize()];
+      
+      if (exportBuffer == NULL)
+      {
+        request->send(500, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Out of memory");
+        return;
+      }
+      
+      BlynkWM_Export_Header header;
+      uint8_t* _pointer = exportBuffer + sizeof(header);
+      
+      header.magic            = BLYNK_WM_EXPORT_MAGIC;
+      header.version          = BLYNK_WM_EXPORT_VERSION;
+      header.configSize       = sizeof(Blynk8266_WM_config);
+      header.reserved         = 0;
+      
+      // Same checkSum as stored
+      Blynk8266_WM_config.checkSum = calcChecksum();
+      memcpy(_pointer, &Blynk8266_WM_config, sizeof(Blynk8266_WM_config));
+      _pointer += sizeof(Blynk8266_WM_config);
+      
+#if USE_DYNAMIC_PARAMETERS
+      header.dynamicDataSize  = TLV_serialize(_pointer);
+#else
+      header.dynamicDataSize  = 0;
+#endif
+      _pointer += header.dynamicDataSize;
+      
+      memcpy(exportBuffer, &header, sizeof(header));
+      
+      uint32_t crc = calcCRC32(exportBuffer, _pointer - exportBuffer);
+      memcpy(_pointer, &crc, sizeof(crc));
+      _pointer += sizeof(crc);
+
+      BLYNK_LOG2(BLYNK_F("h:Export,sz="), _pointer - exportBuffer);
+      
+      AsyncResponseStream *response = request->beginResponseStream("application/octet-stream");
+      
+      response->addHeader("Content-Disposition", "attachment; filename=\"blynk_wm.bin\"");
+      response->addHeader(FPSTR(WM_HTTP_CACHE_CONTROL), FPSTR(WM_HTTP_NO_STORE));
+      response->write(exportBuffer, _pointer - exportBuffer);
+      
+      delete [] exportBuffer;
+      
+      request->send(response);
+    }
+    
+    //////////////////////////////////////////////
+    
+    typedef struct
+    {
+      uint16_t size;
+      uint16_t capacity;
+      uint8_t  data[];
+    } BlynkWM_Import_Buffer;
+    
+    // Accumulate uploaded data (raw body or multipart file) into request->_tempObject, freed by AsyncWebServer
+    void handleImportData(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index)
+    {
+      BlynkWM_Import_Buffer* importBuffer = (BlynkWM_Import_Buffer*) request->_tempObject;
+      
+      if ( (index == 0) && (importBuffer == NULL) )
+      {
+        uint16_t capacity = getExportMaxSize();
+        
+        importBuffer = (BlynkWM_Import_Buffer*) malloc(sizeof(BlynkWM_Import_Buffer) + capacity);
+        
+        if (importBuffer)
+        {
+          importBuffer->size      = 0;
+          importBuffer->capacity  = capacity;
+        }
+        
+        request->_tempObject = importBuffer;
+      }
+      
+      if ( importBuffer && (index == importBuffer->size) && (importBuffer->size + len <= importBuffer->capacity) )
+      {
+        memcpy(importBuffer->data + importBuffer->size, data, len);
+        importBuffer->size += len;
+      }
+      else if (importBuffer)
+      {
+        // Too large or out of order => invalid
+        importBuffer->capacity = 0;
+      }
+    }
+    
+    //////////////////////////////////////////////
+    
+    // Validate the uploaded blob, then save it with one write and reset
+    void handleImport(AsyncWebServerRequest *request)
+    {
+      BlynkWM_Import_Buffer* importBuffer = (BlynkWM_Import_Buffer*) request->_tempObject;
+      BlynkWM_Export_Header header;
+      
+      if ( (importBuffer == NULL) || (importBuffer->capacity == 0) || (importBuffer->size < sizeof(header) + sizeof(uint32_t)) )
+      {
+        request->send(400, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Invalid size");
+        return;
+      }
+      
+      uint8_t* _pointer = importBuffer->data;
+      uint32_t crc;
+      
+      memcpy(&header, _pointer, sizeof(header));
+      memcpy(&crc, _pointer + importBuffer->size - sizeof(crc), sizeof(crc));
+      
+      if ( (header.magic != BLYNK_WM_EXPORT_MAGIC) || (header.version != BLYNK_WM_EXPORT_VERSION) || 
+           (header.configSize != sizeof(Blynk8266_WM_config)) ||
+           (importBuffer->size != sizeof(header) + header.configSize + header.dynamicDataSize + sizeof(crc)) ||
+           (crc != calcCRC32(_pointer, importBuffer->size - sizeof(crc))) )
+      {
+        BLYNK_LOG1(BLYNK_F("h:Import invalid"));
+        request->send(400, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Invalid data");
+        return;
+      }
+      
+      _pointer += sizeof(header);
+      
+      Blynk_WM_Configuration importConfig;
+      
+      memcpy(&importConfig, _pointer, sizeof(importConfig));
+      _pointer += sizeof(importConfig);
+      
+      // Must be data of the same board type
+      if (strncmp(importConfig.header, BLYNK_BOARD_TYPE, sizeof(importConfig.header)) != 0)
+      {
+        BLYNK_LOG1(BLYNK_F("h:Import wrong board type"));
+        request->send(400, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Wrong board type");
+        return;
+      }
+      
+#if USE_DYNAMIC_PARAMETERS
+      // myMenuItems[] is untouched if TLV data is invalid
+      if ( (header.dynamicDataSize > 0) && !TLV_deserialize(_pointer, header.dynamicDataSize) )
+      {
+        request->send(400, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Invalid Dynamic Data");
+        return;
+      }
+#endif
+      
+      memcpy(&Blynk8266_WM_config, &importConfig, sizeof(Blynk8266_WM_config));
+      
+      BLYNK_LOG1(BLYNK_F("h:Import OK"));
+      
+      saveAllConfigData();
+      
+      // Done with CP, Clear CP Flag here if forced
+      if (isForcedConfigPortal)
+      {
+        clearForcedCP();
+      }
+      
+      request->send(200, FPSTR(WM_HTTP_HEAD_TEXT_PLAIN), "Imported. Reset");
+
+      BLYNK_LOG1(BLYNK_F("h:Rst"));
+
+      // Delay then reset the board after save data
+      delay(1000);
+      ESP.reset();
+    }
+    
+    //////////////////////////////////////////////
+
     void startConfigurationMode()
     {
+#if USE_RTC_CONFIG_CACHE
+      beginStorage();
+#endif
+
       // turn the LED_BUILTIN ON to tell us we are in configuration mode.
       digitalWrite(LED_BUILTIN, LED_ON);
 
@@ -2623,7 +6847,16 @@ class BlynkWifi
       //See https://stackoverflow.com/questions/39803135/c-unresolved-overloaded-function-type?rq=1
       if (server)
       {
-        server->on("/", HTTP_GET, [this](AsyncWebServerRequest * request)  { handleRequest(request); });        
+        server->on("/", HTTP_GET, [this](AsyncWebServerRequest * request)  { handleRequest(request); });
+        
+        // Cloning : download / upload all stored data as one binary blob
+        server->on("/export", HTTP_GET, [this](AsyncWebServerRequest * request)  { handleExport(request); });
+        server->on("/import", HTTP_POST, [this](AsyncWebServerRequest * request)  { handleImport(request); },
+                   [this](AsyncWebServerRequest * request, const String& filename, size_t index, uint8_t *data, size_t len, bool final)
+                   { (void) filename; (void) final; handleImportData(request, data, len, index); },
+                   [this](AsyncWebServerRequest * request, uint8_t *data, size_t len, size_t index, size_t total)
+                   { (void) total; handleImportData(request, data, len, index); });
+        
         server->begin();
       }
 
@@ -2646,6 +6879,11 @@ class BlynkWifi
       } 
 
       configuration_mode = true;
+      
+      if (portalCallback)
+      {
+        portalCallback();
+      }
     }
 };
 
@@ -0,0 +1,27 @@
+// Minimal test runner for the host tests of Blynk_Async_WM. Include after the library header
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int hostTestFailures = 0;
+
+#define CHECK(cond)                                                                   \
+  do                                                                                  \
+  {                                                                                   \
+    if (!(cond))                                                                      \
+    {                                                                                 \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                 \
+      hostTestFailures++;                                                             \
+    }                                                                                 \
+  } while (0)
+
+#define RUN_TEST(test)                                                                \
+  do                                                                                  \
+  {                                                                                   \
+    int failuresBefore = hostTestFailures;                                            \
+    test();                                                                           \
+    printf("%s %s\n", (hostTestFailures == failuresBefore) ? "PASS" : "FAIL", #test); \
+  } while (0)
+
+#define TEST_RESULT()   ( hostTestFailures ? EXIT_FAILURE : EXIT_SUCCESS )
@@ -0,0 +1,17 @@
+// Stand-in for BlynkArduinoClientGen of Blynk library. Like the library, connect() connects the client
+#pragma once
+#include <Client.h>
+
+template <typename Client>
+class BlynkArduinoClientGen {
+public:
+  BlynkArduinoClientGen(Client& c) : client(&c), domain(NULL), port(0), isConn(false) {}
+  void begin(IPAddress a, uint16_t p) { domain = NULL; port = p; addr = a; }
+  void begin(const char* d, uint16_t p) { domain = d; port = p; }
+  bool connect() { isConn = (1 == (domain ? client->connect(domain, port) : client->connect(addr, port))); return isConn; }
+  void disconnect() { isConn = false; }
+  bool connected() { return isConn; }
+protected:
+  Client* client; IPAddress addr; const char* domain; uint16_t port; bool isConn;
+};
+typedef BlynkArduinoClientGen<Client> BlynkArduinoClient;
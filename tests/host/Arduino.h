@@ -0,0 +1,99 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+#include <string>
+typedef uint8_t byte;
+#define PROGMEM
+#define PGM_P const char*
+#define F(x) (x)
+#define FPSTR(x) (x)
+#define HEX 16
+#define DEC 10
+#define LOW 0
+#define HIGH 1
+#define OUTPUT 1
+#define INPUT 0
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+typedef const char __FlashStringHelper;
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void yield();
+void pinMode(int,int);
+void digitalWrite(int,int);
+long random(long);
+long random(long, long);
+void configTime(long, int, const char*, const char* = NULL, const char* = NULL);
+class String {
+public:
+  std::string s;
+  String(const char* c = "") : s(c ? c : "") {}
+  String(const std::string& x) : s(x) {}
+  String(char c) : s(1, c) {}
+  String(int v, int base = 10);
+  String(unsigned int v, int base = 10);
+  String(long v, int base = 10);
+  String(unsigned long v, int base = 10);
+  String(float v, int d = 2);
+  String(double v, int d = 2);
+  const char* c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.size(); }
+  void replace(const String&, const String&);
+  void toUpperCase();
+  void trim();
+  long toInt() const;
+  bool reserve(unsigned int);
+  char operator[](unsigned int i) const { return s[i]; }
+  String& operator+=(const String& o) { s += o.s; return *this; }
+  String& operator+=(const char* o) { s += o; return *this; }
+  String& operator+=(char o) { s += o; return *this; }
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator==(const char* o) const { return s == o; }
+  bool operator!=(const String& o) const { return s != o.s; }
+  bool equals(const String& o) const { return s == o.s; }
+  bool startsWith(const String& o) const;
+  int indexOf(char) const;
+  String substring(unsigned int, unsigned int) const;
+};
+String operator+(const String&, const String&);
+String operator+(const char*, const String&);
+class Print {
+public:
+  size_t print(const String&); size_t print(const char*); size_t print(int, int = 10); size_t print(unsigned long, int = 10);
+  size_t println(const String& = ""); size_t println(const char*); size_t println(int, int = 10); size_t println(unsigned long, int = 10);
+  size_t printf(const char*, ...);
+  size_t write(const uint8_t*, size_t);
+};
+class Stream : public Print {
+public:
+  int available(); int read(); size_t readBytes(char*, size_t); size_t readBytes(uint8_t* b, size_t n) { return readBytes((char*)b, n); }
+};
+class HardwareSerial : public Stream { public: void begin(unsigned long); };
+extern HardwareSerial Serial;
+class IPAddress {
+public:
+  uint8_t b[4];
+  IPAddress() { memset(b, 0, 4); }
+  IPAddress(uint8_t a, uint8_t c, uint8_t d, uint8_t e) { b[0]=a; b[1]=c; b[2]=d; b[3]=e; }
+  IPAddress(uint32_t v) { memcpy(b, &v, 4); }
+  operator uint32_t() const { uint32_t v; memcpy(&v, b, 4); return v; }
+  bool operator==(const IPAddress& o) const { return memcmp(b, o.b, 4) == 0; }
+  bool operator!=(const IPAddress& o) const { return !(*this == o); }
+  uint8_t operator[](int i) const { return b[i]; }
+  uint8_t& operator[](int i) { return b[i]; }
+  String toString() const;
+  bool fromString(const char*);
+  bool isSet() const;
+};
+extern const IPAddress INADDR_NONE;
+typedef enum { ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT, ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP, ESP_RST_BROWNOUT, ESP_RST_SDIO } esp_reset_reason_t;
+esp_reset_reason_t esp_reset_reason();
@@ -0,0 +1,116 @@
+// Stand-in for BlynkProtocol of Blynk library, talking to the simulated Blynk server of HostFakes
+#pragma once
+#include <BlynkApiArduino.h>
+#include <HostFakes.h>
+#include <WiFi.h>
+
+enum { BLYNK_CMD_RESPONSE = 0, BLYNK_CMD_PING = 6 };
+typedef unsigned long millis_time_t;
+
+template <class Transp>
+class BlynkProtocol {
+public:
+  BlynkProtocol(Transp& t) : conn(t), lastActivityIn(0), state(DISCONNECTED), connectStart(0), pingPending(false) {}
+  
+  void begin(const char*) {}
+  
+  bool connect(uint32_t timeout = BLYNK_TIMEOUT_MS*3)
+  {
+    state         = CONNECTING;
+    connectStart  = millis();
+    
+    unsigned long started = millis();
+    
+    while ( (state != CONNECTED) && (millis() - started < timeout) )
+    {
+      run();
+      delay(1);
+    }
+    
+    return (state == CONNECTED);
+  }
+  
+  bool connected() { return (state == CONNECTED); }
+  
+  void disconnect()
+  {
+    state = DISCONNECTED;
+    conn.disconnect();
+  }
+  
+  bool run(bool = false)
+  {
+    bool linkUp = HostFakes::serverUp && (WiFi.status() == WL_CONNECTED);
+    
+    if (state == CONNECTING)
+    {
+      if (!linkUp)
+      {
+        // Connection refused
+        conn.disconnect();
+        connectStart = millis();
+      }
+      else if (conn.connected() || conn.connect())
+      {
+        if (millis() - connectStart >= HostFakes::loginTime)
+        {
+          state           = CONNECTED;
+          lastActivityIn  = millis();
+        }
+      }
+      else
+      {
+        // TLS handshake or certificate check failed. Like the library, disconnect before next try
+        conn.disconnect();
+        connectStart = millis();
+      }
+    }
+    else if (state == CONNECTED)
+    {
+      if (!linkUp)
+      {
+        state = DISCONNECTED;
+        conn.disconnect();
+      }
+      else if (pingPending && HostFakes::serverAcks)
+      {
+        pingPending     = false;
+        lastActivityIn  = millis();
+      }
+    }
+    
+    return true;
+  }
+  
+  template <typename T>
+  void virtualWrite(int pin, const T& value)
+  {
+    if (state == CONNECTED)
+    {
+      HostFakes::Write write = { pin, String(value).c_str() };
+      HostFakes::writes.push_back(write);
+    }
+  }
+  
+  template <typename... Args> void syncVirtual(Args...) {}
+  
+  void sendCmd(uint8_t cmd, uint16_t id = 0, const void* data = NULL, size_t length = 0, const void* data2 = NULL, size_t length2 = 0)
+  {
+    (void) id; (void) data; (void) length; (void) data2; (void) length2;
+    
+    if ( (state == CONNECTED) && (cmd == BLYNK_CMD_PING) )
+    {
+      pingPending = true;
+      HostFakes::pings++;
+    }
+  }
+  
+protected:
+  enum { DISCONNECTED, CONNECTING, CONNECTED };
+  
+  Transp&       conn;
+  millis_time_t lastActivityIn;
+  int           state;
+  unsigned long connectStart;
+  bool          pingPending;
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include <Arduino.h>
+#include <Esp.h>
+#define BLYNK_F(x) (x)
+template <typename... Args> void blynk_log_stub(const Args&...) {}
+#define BLYNK_LOG1(a) { blynk_log_stub(a); }
+#define BLYNK_LOG2(a,b) { blynk_log_stub(a,b); }
+#define BLYNK_LOG3(a,b,c) { blynk_log_stub(a,b,c); }
+#define BLYNK_LOG4(a,b,c,d) { blynk_log_stub(a,b,c,d); }
+#define BLYNK_LOG6(a,b,c,d,e,f) { blynk_log_stub(a,b,c,d,e,f); }
+#define BLYNK_DEFAULT_DOMAIN "blynk-cloud.com"
+#define BLYNK_DEFAULT_PORT 80
+#define BLYNK_DEFAULT_PORT_SSL 443
+#define BLYNK_TIMEOUT_MS 2000UL
+#define BLYNK_UNUSED(x) (void)(x)
+void BlynkDelay(unsigned long);
+unsigned long BlynkMillis();
+#define BLYNK_INFO_CONNECTION "stub"
@@ -0,0 +1,12 @@
+#pragma once
+#include <Arduino.h>
+class Client : public Stream {
+public:
+  virtual int connect(IPAddress, uint16_t) { return 0; }
+  virtual int connect(const char*, uint16_t) { return 0; }
+  virtual int connect(const char*, uint16_t, int32_t) { return 0; }
+  virtual int connect(IPAddress, uint16_t, int32_t) { return 0; }
+  void stop(); uint8_t connected(); void setTimeout(unsigned long); void flush();
+  size_t write(const uint8_t*, size_t); int read(uint8_t*, size_t); int available();
+  operator bool();
+};
@@ -0,0 +1,10 @@
+#pragma once
+#include <Arduino.h>
+class EEPROMClass {
+public:
+  bool begin(size_t); uint8_t read(int); void write(int, uint8_t); bool commit(); void end();
+  template<typename T> T& get(int a, T& t) { (void)a; return t; }
+  template<typename T> const T& put(int a, const T& t) { (void)a; return t; }
+  uint8_t* getDataPtr(); const uint8_t* getConstDataPtr() const; size_t length();
+};
+extern EEPROMClass EEPROM;
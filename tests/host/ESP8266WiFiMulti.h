@@ -0,0 +1 @@
+#include <WiFiMulti.h>
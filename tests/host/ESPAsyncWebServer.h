@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+class AsyncClient {
+public:
+  typedef std::function<void(void*, AsyncClient*)> AcConnectHandler;
+  typedef std::function<void(void*, AsyncClient*, int8_t)> AcErrorHandler;
+  AsyncClient(); ~AsyncClient();
+  bool connect(const char*, uint16_t); bool connect(IPAddress, uint16_t);
+  void close(bool = false); bool connected();
+  void onConnect(AcConnectHandler, void* = 0); void onDisconnect(AcConnectHandler, void* = 0); void onError(AcErrorHandler, void* = 0);
+};
+#define HTTP_GET 1
+#define HTTP_POST 2
+#define HTTP_ANY 0xff
+class AsyncWebServerResponse { public: void addHeader(const String&, const String&); void setCode(int); };
+class AsyncResponseStream : public AsyncWebServerResponse { public: size_t write(const uint8_t*, size_t); size_t write(uint8_t); };
+class AsyncWebServerRequest {
+public:
+  String arg(const char*); bool hasArg(const char*); void send(int, const String&, const String& = String());
+  void send(AsyncWebServerResponse*);
+  AsyncWebServerResponse* beginResponse(int, const String&, const String& = String());
+  AsyncWebServerResponse* beginResponse_P(int, const String&, const uint8_t*, size_t);
+  AsyncWebServerResponse* beginResponse(const String&, size_t, std::function<size_t(uint8_t*, size_t, size_t)>);
+  AsyncResponseStream* beginResponseStream(const String&, size_t = 1460);
+  size_t contentLength(); void* _tempObject;
+  void onDisconnect(std::function<void()>);
+};
+typedef std::function<void(AsyncWebServerRequest*)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, const String&, size_t, uint8_t*, size_t, bool)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, uint8_t*, size_t, size_t, size_t)> ArBodyHandlerFunction;
+class AsyncWebServer {
+public:
+  AsyncWebServer(uint16_t); void begin(); void end();
+  void on(const char*, int, ArRequestHandlerFunction);
+  void on(const char*, int, ArRequestHandlerFunction, ArUploadHandlerFunction, ArBodyHandlerFunction = nullptr);
+};
@@ -0,0 +1,9 @@
+#pragma once
+#include <Arduino.h>
+#ifndef FLAG_DATA_SIZE
+#define FLAG_DATA_SIZE 4
+#endif
+#ifndef MRD_ADDRESS
+#define MRD_ADDRESS 0
+#endif
+class MultiResetDetector { public: MultiResetDetector(int, int); bool detectMultiReset(); void loop(); void stop(); };
@@ -0,0 +1,11 @@
+#pragma once
+#include <Arduino.h>
+struct rst_info;
+class EspClass { public: rst_info* getResetInfoPtr(); void restart(); void reset(); uint64_t getEfuseMac(); uint32_t getChipId(); uint32_t getFreeHeap();
+  bool rtcUserMemoryRead(uint32_t, uint32_t*, size_t); bool rtcUserMemoryWrite(uint32_t, uint32_t*, size_t);
+  void deepSleep(uint64_t, int = 0); String getResetReason(); uint32_t getFlashChipSize(); const char* getSketchMD5();
+  String getSketchMD5String(); uint32_t getSketchSize();
+  bool flashEraseSector(uint32_t); bool flashWrite(uint32_t, uint32_t*, size_t); bool flashRead(uint32_t, uint32_t*, size_t); };
+extern EspClass ESP;
+struct rst_info { uint32_t reason; uint32_t exccause; };
+enum { REASON_DEFAULT_RST = 0, REASON_WDT_RST, REASON_EXCEPTION_RST, REASON_SOFT_WDT_RST, REASON_SOFT_RESTART, REASON_DEEP_SLEEP_AWAKE, REASON_EXT_SYS_RST };
@@ -0,0 +1,14 @@
+#pragma once
+#include <Arduino.h>
+namespace fs {
+// In-memory file, see HostFakes::files
+class File : public Stream {
+public:
+  File(const std::string& p = "", bool w = false, bool v = false) : path(p), writable(w), valid(v), pos(0) {}
+  size_t write(const uint8_t*, size_t); size_t write(uint8_t); size_t readBytes(char*, size_t); void close(); operator bool() const; size_t size() const; bool seek(uint32_t); size_t position() const;
+private:
+  std::string path; bool writable; bool valid; size_t pos;
+};
+class FS { public: bool begin(bool = false); bool format(); File open(const char*, const char* = "r"); File open(const String&, const char* = "r"); bool exists(const char*); bool exists(const String&); bool remove(const char*); bool rename(const char*, const char*); void end(); };
+}
+using fs::File; using fs::FS;
@@ -0,0 +1,73 @@
+// State of the host stand-ins for the Arduino cores, WiFi and Blynk server, shared by the tests
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace HostFakes
+{
+  // Simulated clock in ms. delay() and yield() advance it
+  extern unsigned long now;
+  
+  // WiFi.begin() connects after wifiConnectTime ms, if apAvailable
+  extern bool           apAvailable;
+  extern unsigned long  wifiConnectTime;
+  
+  // Blynk stand-in server. Login completes loginTime ms after TCP connect. A ping is answered if serverAcks
+  extern bool           serverUp;
+  extern unsigned long  loginTime;
+  extern bool           serverAcks;
+  
+  struct Write
+  {
+    int         pin;
+    std::string value;
+  };
+  
+  extern std::vector<Write> writes;
+  extern int                pings;
+  
+  // TLS stand-in of the Blynk SSL server. A full handshake takes tlsFullTime ms and adds the new session ID to
+  // tlsServerSessions. Offering one of those IDs resumes it in tlsResumeTime ms. Certificates are valid if tlsCertValid
+  extern unsigned long  tlsFullTime;
+  extern unsigned long  tlsResumeTime;
+  extern bool           tlsCertValid;
+  
+  extern std::vector<std::string> tlsServerSessions;
+  extern int                      tlsFullHandshakes;
+  extern int                      tlsResumedHandshakes;
+  
+  // Reset reason of this boot, REASON_* for ESP8266, esp_reset_reason_t for ESP32
+  extern uint32_t resetReason;
+  
+  // ESP8266 RTC user memory, 128 4-byte blocks
+  extern uint32_t rtcUserMemory[128];
+  
+  // ESP32 NVS, key => blob
+  extern std::map<std::string, std::vector<uint8_t> > nvs;
+  extern int nvsWrites;
+  
+  // LittleFS / SPIFFS, path => contents
+  extern std::map<std::string, std::vector<uint8_t> > files;
+  extern int fileWrites;
+  
+  // Set by begin() until reset. Files can't be opened before
+  extern bool fsMounted;
+  
+  // Files opened to read since reset, path => count
+  extern std::map<std::string, int> fileReads;
+  
+  // DRD / MRD calls. Like the libraries, the flag in flash is set at boot, and cleared by loop() at timeout or stop().
+  // A boot finding it set is a double reset
+  extern int  resetDetectorCreated;
+  extern int  resetDetectorStopped;
+  extern bool resetDetectorFlag;
+  
+  // Power on : clear RTC memory, NVS, files, clock, TLS server sessions and all stand-ins
+  void powerOn();
+  
+  // Reset of the chip, keeping RTC memory, NVS and files
+  void reset(uint32_t reason);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <Arduino.h>
+#include <Client.h>
+#define WL_CONNECTED 3
+#define WL_IDLE_STATUS 0
+#define WL_DISCONNECTED 6
+#define WL_CONNECT_FAILED 4
+#define WL_NO_SSID_AVAIL 1
+#define WIFI_STA 1
+#define WIFI_AP 2
+#define WIFI_AP_STA 3
+#define WIFI_OFF 0
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+typedef int wl_status_t;
+typedef int WiFiMode_t;
+typedef int WiFiEvent_t;
+class WiFiClass {
+public:
+  bool mode(int); int getMode();
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress(), IPAddress = IPAddress());
+  int begin(const char*, const char* = NULL, int32_t = 0, const uint8_t* = NULL, bool = true);
+  int status(); String SSID(); String SSID(uint8_t); int32_t RSSI(); int32_t RSSI(uint8_t); int32_t channel(); int32_t channel(uint8_t);
+  uint8_t* BSSID(); uint8_t* BSSID(uint8_t); String BSSIDstr();
+  IPAddress localIP(); IPAddress gatewayIP(); IPAddress subnetMask(); IPAddress dnsIP(uint8_t = 0);
+  bool softAP(const char*, const char* = NULL, int = 1); bool softAPConfig(IPAddress, IPAddress, IPAddress);
+  bool setHostname(const char*); bool hostname(const char*); bool disconnect(bool = false); bool setAutoReconnect(bool);
+  bool persistent(bool);
+  int hostByName(const char*, IPAddress&); int hostByName(const char*, IPAddress&, uint32_t);
+  int16_t scanNetworks(bool = false, bool = false); int16_t scanComplete(); void scanDelete();
+  bool isConnected();
+};
+extern WiFiClass WiFi;
+#ifdef ESP8266
+#define LED_BUILTIN 2
+#endif
+// TCP connect to the Blynk stand-in server
+class WiFiClient : public Client
+{
+public:
+  WiFiClient();
+  int connect(IPAddress, uint16_t) override;
+  int connect(const char*, uint16_t) override;
+};
@@ -0,0 +1,4 @@
+#pragma once
+#include <WiFi.h>
+class WiFiMulti { public: bool addAP(const char*, const char* = NULL); uint8_t run(uint32_t = 5000); };
+typedef WiFiMulti ESP8266WiFiMulti;
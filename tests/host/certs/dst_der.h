@@ -0,0 +1 @@
+{ 0x30, 0x82, 0x00, 0x00 };
@@ -0,0 +1,3 @@
+#pragma once
+#include <Arduino.h>
+void esp_deep_sleep(uint64_t);
@@ -0,0 +1,4 @@
+#pragma once
+#include <Arduino.h>
+typedef int esp_err_t;
+#define ESP_OK 0
@@ -0,0 +1,592 @@
+// Host implementations of the Arduino, ESP8266/ESP32 core and library stand-ins, driven by HostFakes state
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include <Arduino.h>
+#include <Esp.h>
+#include <EEPROM.h>
+#include <WiFi.h>
+#include <WiFiMulti.h>
+#include <WiFiClientSecure.h>
+#include <Preferences.h>
+#include <ESPAsyncWebServer.h>
+#include <ESP_DoubleResetDetector.h>
+#include <ESP_MultiResetDetector.h>
+#include <LittleFS.h>
+#include <LITTLEFS.h>
+#include <esp_sleep.h>
+#include <lwip/dns.h>
+#include <BlynkApiArduino.h>
+#include <HostFakes.h>
+
+namespace HostFakes
+{
+  unsigned long  now              = 0;
+  
+  bool           apAvailable      = true;
+  unsigned long  wifiConnectTime  = 1000;
+  
+  bool           serverUp         = true;
+  unsigned long  loginTime        = 300;
+  bool           serverAcks       = true;
+  
+  std::vector<Write> writes;
+  int                pings = 0;
+  
+  unsigned long  tlsFullTime      = 2000;
+  unsigned long  tlsResumeTime    = 150;
+  bool           tlsCertValid     = true;
+  
+  std::vector<std::string> tlsServerSessions;
+  int                      tlsFullHandshakes    = 0;
+  int                      tlsResumedHandshakes = 0;
+  
+  uint32_t resetReason = 0;
+  
+  uint32_t rtcUserMemory[128];
+  
+  std::map<std::string, std::vector<uint8_t> > nvs;
+  int nvsWrites = 0;
+  
+  std::map<std::string, std::vector<uint8_t> > files;
+  int fileWrites = 0;
+  
+  bool fsMounted = false;
+  std::map<std::string, int> fileReads;
+  
+  int  resetDetectorCreated = 0;
+  int  resetDetectorStopped = 0;
+  bool resetDetectorFlag    = false;
+  
+  static int            wifiStatus    = WL_IDLE_STATUS;
+  static unsigned long  wifiBeginTime = 0;
+  
+  void reset(uint32_t reason)
+  {
+    now                   = 0;
+    resetReason           = reason;
+    wifiStatus            = WL_IDLE_STATUS;
+    writes.clear();
+    pings                 = 0;
+    tlsFullHandshakes     = 0;
+    tlsResumedHandshakes  = 0;
+    resetDetectorCreated  = 0;
+    resetDetectorStopped  = 0;
+    fsMounted             = false;
+    fileReads.clear();
+  }
+  
+  void powerOn()
+  {
+    memset(rtcUserMemory, 0xA5, sizeof(rtcUserMemory));
+    nvs.clear();
+    nvsWrites   = 0;
+    files.clear();
+    fileWrites  = 0;
+    resetDetectorFlag = false;
+    tlsServerSessions.clear();
+    
+    reset(REASON_DEFAULT_RST);
+  }
+  
+  static void updateWiFi()
+  {
+    if ( (wifiStatus == WL_DISCONNECTED) && apAvailable && (now - wifiBeginTime >= wifiConnectTime) )
+      wifiStatus = WL_CONNECTED;
+    else if ( (wifiStatus == WL_CONNECTED) && !apAvailable )
+      wifiStatus = WL_DISCONNECTED;
+  }
+}
+
+using namespace HostFakes;
+
+////////////////////////////////////////
+// Arduino core
+
+HardwareSerial Serial;
+EspClass ESP;
+EEPROMClass EEPROM;
+WiFiClass WiFi;
+fs::FS LittleFS, SPIFFS, LITTLEFS;
+const IPAddress INADDR_NONE(0, 0, 0, 0);
+
+unsigned long millis() { return now; }
+unsigned long micros() { return now * 1000; }
+void delay(unsigned long ms) { now += ms; }
+void yield() {}
+void pinMode(int, int) {}
+void digitalWrite(int, int) {}
+long random(long howbig) { return howbig ? (rand() % howbig) : 0; }
+long random(long howsmall, long howbig) { return howsmall + random(howbig - howsmall); }
+void configTime(long, int, const char*, const char*, const char*) {}
+void BlynkDelay(unsigned long ms) { delay(ms); }
+unsigned long BlynkMillis() { return millis(); }
+
+String::String(int v, int base)           { char b[24]; snprintf(b, sizeof(b), base == 16 ? "%x" : "%d", v); s = b; }
+String::String(unsigned int v, int base)  { char b[24]; snprintf(b, sizeof(b), base == 16 ? "%x" : "%u", v); s = b; }
+String::String(long v, int base)          { char b[24]; snprintf(b, sizeof(b), base == 16 ? "%lx" : "%ld", v); s = b; }
+String::String(unsigned long v, int base) { char b[24]; snprintf(b, sizeof(b), base == 16 ? "%lx" : "%lu", v); s = b; }
+String::String(float v, int d)            { char b[40]; snprintf(b, sizeof(b), "%.*f", d, v); s = b; }
+String::String(double v, int d)           { char b[40]; snprintf(b, sizeof(b), "%.*f", d, v); s = b; }
+
+void String::replace(const String& from, const String& to)
+{
+  if (from.s.empty())
+    return;
+    
+  for (size_t pos = s.find(from.s); pos != std::string::npos; pos = s.find(from.s, pos + to.s.size()))
+    s.replace(pos, from.s.size(), to.s);
+}
+
+void String::toUpperCase() { for (size_t i = 0; i < s.size(); i++) s[i] = toupper(s[i]); }
+
+void String::trim()
+{
+  size_t first = s.find_first_not_of(" \t\r\n");
+  size_t last  = s.find_last_not_of(" \t\r\n");
+  s = (first == std::string::npos) ? "" : s.substr(first, last - first + 1);
+}
+
+long String::toInt() const { return atol(s.c_str()); }
+bool String::reserve(unsigned int n) { s.reserve(n); return true; }
+bool String::startsWith(const String& o) const { return s.compare(0, o.s.size(), o.s) == 0; }
+int String::indexOf(char c) const { size_t p = s.find(c); return (p == std::string::npos) ? -1 : (int) p; }
+String String::substring(unsigned int a, unsigned int b) const { return (a >= s.size()) ? String() : String(s.substr(a, b - a)); }
+String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+String operator+(const char* a, const String& b) { return String(std::string(a) + b.s); }
+
+size_t Print::print(const String& v) { return v.length(); }
+size_t Print::print(const char* v) { return strlen(v); }
+size_t Print::print(int, int) { return 0; }
+size_t Print::print(unsigned long, int) { return 0; }
+size_t Print::println(const String& v) { return v.length(); }
+size_t Print::println(const char* v) { return strlen(v); }
+size_t Print::println(int, int) { return 0; }
+size_t Print::println(unsigned long, int) { return 0; }
+size_t Print::printf(const char*, ...) { return 0; }
+size_t Print::write(const uint8_t*, size_t n) { return n; }
+int Stream::available() { return 0; }
+int Stream::read() { return -1; }
+size_t Stream::readBytes(char*, size_t) { return 0; }
+void HardwareSerial::begin(unsigned long) {}
+
+String IPAddress::toString() const { char buf[16]; snprintf(buf, sizeof(buf), "%u.%u.%u.%u", b[0], b[1], b[2], b[3]); return String(buf); }
+bool IPAddress::isSet() const { return (uint32_t) *this != 0; }
+
+bool IPAddress::fromString(const char* str)
+{
+  unsigned a, c, d, e;
+  
+  if (sscanf(str, "%u.%u.%u.%u", &a, &c, &d, &e) != 4)
+    return false;
+    
+  b[0] = a; b[1] = c; b[2] = d; b[3] = e;
+  return true;
+}
+
+////////////////////////////////////////
+// ESP8266 / ESP32 core
+
+static rst_info resetInfo;
+
+rst_info* EspClass::getResetInfoPtr() { resetInfo.reason = resetReason; return &resetInfo; }
+esp_reset_reason_t esp_reset_reason() { return (esp_reset_reason_t) resetReason; }
+void EspClass::restart() {}
+void EspClass::reset() {}
+uint64_t EspClass::getEfuseMac() { return 0x123456789ABCULL; }
+uint32_t EspClass::getChipId() { return 0x9ABCDE; }
+uint32_t EspClass::getFreeHeap() { return 40000; }
+String EspClass::getResetReason() { return String("host"); }
+uint32_t EspClass::getFlashChipSize() { return 4 * 1024 * 1024; }
+uint32_t EspClass::getSketchSize() { return 400000; }
+String EspClass::getSketchMD5String() { return String("host"); }
+const char* EspClass::getSketchMD5() { return "host"; }
+bool EspClass::flashEraseSector(uint32_t) { return true; }
+bool EspClass::flashWrite(uint32_t, uint32_t*, size_t) { return true; }
+bool EspClass::flashRead(uint32_t, uint32_t*, size_t) { return true; }
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size)
+{
+  if ( (offset * 4 + size) > sizeof(rtcUserMemory) )
+    return false;
+    
+  memcpy(data, &rtcUserMemory[offset], size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size)
+{
+  if ( (offset * 4 + size) > sizeof(rtcUserMemory) )
+    return false;
+    
+  memcpy(&rtcUserMemory[offset], data, size);
+  return true;
+}
+
+// Tests redefine BLYNK_WM_DEEP_SLEEP to catch the sleep, so these are never reached there
+void EspClass::deepSleep(uint64_t, int) { abort(); }
+void esp_deep_sleep(uint64_t) { abort(); }
+
+////////////////////////////////////////
+// EEPROM, not backing data, and LittleFS / SPIFFS in memory
+
+static uint8_t eepromData[4096];
+
+bool EEPROMClass::begin(size_t) { return true; }
+uint8_t EEPROMClass::read(int a) { return eepromData[a]; }
+void EEPROMClass::write(int a, uint8_t v) { eepromData[a] = v; }
+bool EEPROMClass::commit() { return true; }
+void EEPROMClass::end() {}
+uint8_t* EEPROMClass::getDataPtr() { return eepromData; }
+const uint8_t* EEPROMClass::getConstDataPtr() const { return eepromData; }
+size_t EEPROMClass::length() { return sizeof(eepromData); }
+
+namespace fs
+{
+  size_t File::write(const uint8_t* data, size_t n)
+  {
+    if (!valid || !writable)
+      return 0;
+      
+    files[path].insert(files[path].end(), data, data + n);
+    
+    return n;
+  }
+  
+  size_t File::write(uint8_t data) { return write(&data, 1); }
+  
+  size_t File::readBytes(char* buffer, size_t n)
+  {
+    if (!valid || writable)
+      return 0;
+      
+    const std::vector<uint8_t>& data = files[path];
+    
+    n = std::min(n, data.size() - pos);
+    memcpy(buffer, data.data() + pos, n);
+    pos += n;
+    
+    return n;
+  }
+  
+  void File::close() { valid = false; }
+  File::operator bool() const { return valid; }
+  size_t File::size() const { return valid ? files[path].size() : 0; }
+  bool File::seek(uint32_t p) { pos = p; return true; }
+  size_t File::position() const { return pos; }
+  
+  bool FS::begin(bool) { fsMounted = true; return true; }
+  bool FS::format() { files.clear(); return true; }
+  
+  File FS::open(const char* path, const char* mode)
+  {
+    if (!fsMounted)
+      return File(path, false, false);
+    
+    if (mode[0] == 'w')
+    {
+      files[path].clear();
+      fileWrites++;
+      
+      return File(path, true, true);
+    }
+    
+    fileReads[path]++;
+    
+    return File(path, false, files.count(path) > 0);
+  }
+  
+  File FS::open(const String& path, const char* mode) { return open(path.c_str(), mode); }
+  bool FS::exists(const char* path) { return fsMounted && (files.count(path) > 0); }
+  bool FS::exists(const String& path) { return exists(path.c_str()); }
+  bool FS::remove(const char* path) { return files.erase(path) > 0; }
+  
+  bool FS::rename(const char* from, const char* to)
+  {
+    if (!files.count(from))
+      return false;
+      
+    files[to] = files[from];
+    files.erase(from);
+    
+    return true;
+  }
+  
+  void FS::end() {}
+}
+
+////////////////////////////////////////
+// ESP32 Preferences over the NVS map, with the size semantics of the ESP32 core
+
+bool Preferences::begin(const char*, bool) { return true; }
+void Preferences::end() {}
+bool Preferences::clear() { nvs.clear(); return true; }
+bool Preferences::remove(const char* key) { return nvs.erase(key) > 0; }
+bool Preferences::isKey(const char* key) { return nvs.count(key) > 0; }
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len)
+{
+  // nvs_set_blob() is not called for an empty value
+  if (!key || !value || !len)
+    return 0;
+    
+  nvs[key].assign((const uint8_t*) value, (const uint8_t*) value + len);
+  nvsWrites++;
+  
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char* key)
+{
+  return nvs.count(key) ? nvs[key].size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen)
+{
+  size_t len = getBytesLength(key);
+  
+  if (!len || !buf || !maxLen || (len > maxLen))
+    return 0;
+    
+  memcpy(buf, nvs[key].data(), len);
+  
+  return len;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue)
+{
+  uint32_t value = defaultValue;
+  
+  if (getBytesLength(key) == sizeof(value))
+    getBytes(key, &value, sizeof(value));
+    
+  return value;
+}
+
+size_t Preferences::putString(const char* key, const char* value) { return putBytes(key, value, strlen(value) + 1); }
+size_t Preferences::getString(const char* key, char* value, size_t maxLen) { return getBytes(key, value, maxLen); }
+
+////////////////////////////////////////
+// WiFi
+
+bool WiFiClass::mode(int) { return true; }
+int WiFiClass::getMode() { return WIFI_STA; }
+bool WiFiClass::config(IPAddress, IPAddress, IPAddress, IPAddress, IPAddress) { return true; }
+
+int WiFiClass::begin(const char*, const char*, int32_t, const uint8_t*, bool)
+{
+  HostFakes::wifiStatus     = WL_DISCONNECTED;
+  HostFakes::wifiBeginTime  = now;
+  
+  return HostFakes::wifiStatus;
+}
+
+int WiFiClass::status() { HostFakes::updateWiFi(); return HostFakes::wifiStatus; }
+bool WiFiClass::isConnected() { return status() == WL_CONNECTED; }
+String WiFiClass::SSID() { return String("HostAP"); }
+String WiFiClass::SSID(uint8_t) { return String("HostAP"); }
+int32_t WiFiClass::RSSI() { return -60; }
+int32_t WiFiClass::RSSI(uint8_t) { return -60; }
+int32_t WiFiClass::channel() { return 6; }
+int32_t WiFiClass::channel(uint8_t) { return 6; }
+static uint8_t bssid[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 };
+uint8_t* WiFiClass::BSSID() { return bssid; }
+uint8_t* WiFiClass::BSSID(uint8_t) { return bssid; }
+String WiFiClass::BSSIDstr() { return String("02:11:22:33:44:55"); }
+IPAddress WiFiClass::localIP() { return IPAddress(192, 168, 2, 50); }
+IPAddress WiFiClass::gatewayIP() { return IPAddress(192, 168, 2, 1); }
+IPAddress WiFiClass::subnetMask() { return IPAddress(255, 255, 255, 0); }
+IPAddress WiFiClass::dnsIP(uint8_t) { return IPAddress(192, 168, 2, 1); }
+bool WiFiClass::softAP(const char*, const char*, int) { return true; }
+bool WiFiClass::softAPConfig(IPAddress, IPAddress, IPAddress) { return true; }
+bool WiFiClass::setHostname(const char*) { return true; }
+bool WiFiClass::hostname(const char*) { return true; }
+bool WiFiClass::disconnect(bool) { HostFakes::wifiStatus = WL_DISCONNECTED; HostFakes::wifiBeginTime = now; return true; }
+bool WiFiClass::setAutoReconnect(bool) { return true; }
+bool WiFiClass::persistent(bool) { return true; }
+int WiFiClass::hostByName(const char*, IPAddress& ip) { ip = IPAddress(10, 0, 0, 1); return 1; }
+int WiFiClass::hostByName(const char*, IPAddress& ip, uint32_t) { ip = IPAddress(10, 0, 0, 1); return 1; }
+int16_t WiFiClass::scanNetworks(bool, bool) { return 0; }
+int16_t WiFiClass::scanComplete() { return 0; }
+void WiFiClass::scanDelete() {}
+
+// Like the cores, WiFiMulti::run() blocks until connected or timeout
+bool WiFiMulti::addAP(const char*, const char*) { return true; }
+
+uint8_t WiFiMulti::run(uint32_t timeout)
+{
+  if (WiFi.status() != WL_CONNECTED)
+  {
+    WiFi.begin("HostAP");
+    
+    unsigned long started = now;
+    
+    while ( (WiFi.status() != WL_CONNECTED) && (now - started < timeout) )
+      delay(10);
+  }
+  
+  return WiFi.status();
+}
+
+err_t dns_gethostbyname(const char*, ip_addr_t* addr, dns_found_callback, void*)
+{
+  addr->addr = (uint32_t) IPAddress(10, 0, 0, 1);
+  return ERR_OK;
+}
+
+////////////////////////////////////////
+// Client
+
+WiFiClient::WiFiClient() {}
+int WiFiClient::connect(IPAddress, uint16_t) { return serverUp ? 1 : 0; }
+int WiFiClient::connect(const char*, uint16_t) { return serverUp ? 1 : 0; }
+void Client::stop() {}
+uint8_t Client::connected() { return 0; }
+void Client::setTimeout(unsigned long) {}
+void Client::flush() {}
+size_t Client::write(const uint8_t*, size_t n) { return n; }
+int Client::read(uint8_t*, size_t) { return 0; }
+int Client::available() { return 0; }
+Client::operator bool() { return false; }
+
+////////////////////////////////////////
+// WiFiClientSecure and the TLS stand-in server
+
+// The server resumes an offered session it still has, else makes a new one and fills the client session with it
+static void tlsHandshake(BearSSL::Session* session)
+{
+  static uint32_t sessionCount = 0;
+  
+  if (session && session->_session.session_id_len)
+  {
+    std::string id((const char*) session->_session.session_id, session->_session.session_id_len);
+    
+    if (std::find(tlsServerSessions.begin(), tlsServerSessions.end(), id) != tlsServerSessions.end())
+    {
+      delay(tlsResumeTime);
+      tlsResumedHandshakes++;
+      
+      return;
+    }
+  }
+  
+  delay(tlsFullTime);
+  tlsFullHandshakes++;
+  
+  sessionCount++;
+  
+  if (session)
+  {
+    *session = BearSSL::Session();
+    
+    for (size_t i = 0; i < sizeof(session->_session.session_id); i++)
+      session->_session.session_id[i] = (uint8_t) (sessionCount + i);
+      
+    for (size_t i = 0; i < sizeof(session->_session.master_secret); i++)
+      session->_session.master_secret[i] = (uint8_t) (sessionCount * 7 + i);
+      
+    session->_session.session_id_len  = sizeof(session->_session.session_id);
+    session->_session.version         = 0x0303;
+    session->_session.cipher_suite    = 0xC02F;
+    
+    tlsServerSessions.push_back(std::string((const char*) session->_session.session_id, session->_session.session_id_len));
+  }
+}
+
+int WiFiClientSecure::connect(IPAddress addr, uint16_t port)
+{
+  if (!WiFiClient::connect(addr, port))
+    return 0;
+    
+  tlsHandshake(session);
+  return 1;
+}
+
+int WiFiClientSecure::connect(const char* host, uint16_t port)
+{
+  if (!WiFiClient::connect(host, port))
+    return 0;
+    
+  tlsHandshake(session);
+  return 1;
+}
+
+bool WiFiClientSecure::verify(const char*, const char*) { return tlsCertValid; }
+bool WiFiClientSecure::verifyCertChain(const char*) { return tlsCertValid; }
+
+////////////////////////////////////////
+// AsyncClient, AsyncWebServer, DRD / MRD
+
+AsyncClient::AsyncClient() {}
+AsyncClient::~AsyncClient() {}
+bool AsyncClient::connect(const char*, uint16_t) { return false; }
+bool AsyncClient::connect(IPAddress, uint16_t) { return false; }
+void AsyncClient::close(bool) {}
+bool AsyncClient::connected() { return false; }
+void AsyncClient::onConnect(AcConnectHandler, void*) {}
+void AsyncClient::onDisconnect(AcConnectHandler, void*) {}
+void AsyncClient::onError(AcErrorHandler, void*) {}
+
+void AsyncWebServerResponse::addHeader(const String&, const String&) {}
+void AsyncWebServerResponse::setCode(int) {}
+size_t AsyncResponseStream::write(const uint8_t*, size_t n) { return n; }
+size_t AsyncResponseStream::write(uint8_t) { return 1; }
+String AsyncWebServerRequest::arg(const char*) { return String(); }
+bool AsyncWebServerRequest::hasArg(const char*) { return false; }
+void AsyncWebServerRequest::send(int, const String&, const String&) {}
+void AsyncWebServerRequest::send(AsyncWebServerResponse*) {}
+static AsyncResponseStream response;
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int, const String&, const String&) { return &response; }
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int, const String&, const uint8_t*, size_t) { return &response; }
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(const String&, size_t, std::function<size_t(uint8_t*, size_t, size_t)>) { return &response; }
+AsyncResponseStream* AsyncWebServerRequest::beginResponseStream(const String&, size_t) { return &response; }
+size_t AsyncWebServerRequest::contentLength() { return 0; }
+void AsyncWebServerRequest::onDisconnect(std::function<void()>) {}
+AsyncWebServer::AsyncWebServer(uint16_t) {}
+void AsyncWebServer::begin() {}
+void AsyncWebServer::end() {}
+void AsyncWebServer::on(const char*, int, ArRequestHandlerFunction) {}
+void AsyncWebServer::on(const char*, int, ArRequestHandlerFunction, ArUploadHandlerFunction, ArBodyHandlerFunction) {}
+
+static unsigned long resetDetectorTimeout = 0;
+
+static void createResetDetector(int timeout)
+{
+  resetDetectorCreated++;
+  resetDetectorTimeout = timeout * 1000UL;
+}
+
+// Cleared when detected, so that the next reset starts a new count
+static bool detectReset()
+{
+  bool detected = resetDetectorFlag;
+  
+  resetDetectorFlag = !detected;
+  
+  return detected;
+}
+
+static void loopResetDetector()
+{
+  if (millis() >= resetDetectorTimeout)
+    resetDetectorFlag = false;
+}
+
+static void stopResetDetector()
+{
+  resetDetectorStopped++;
+  resetDetectorFlag = false;
+}
+
+DoubleResetDetector::DoubleResetDetector(int timeout, int) { createResetDetector(timeout); }
+bool DoubleResetDetector::detectDoubleReset() { return detectReset(); }
+void DoubleResetDetector::loop() { loopResetDetector(); }
+void DoubleResetDetector::stop() { stopResetDetector(); }
+MultiResetDetector::MultiResetDetector(int timeout, int) { createResetDetector(timeout); }
+bool MultiResetDetector::detectMultiReset() { return detectReset(); }
+void MultiResetDetector::loop() { loopResetDetector(); }
+void MultiResetDetector::stop() { stopResetDetector(); }
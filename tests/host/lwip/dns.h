@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+typedef int8_t err_t;
+typedef struct { uint32_t addr; } ip_addr_t;
+#define ERR_OK 0
+#define ERR_INPROGRESS (-5)
+#define ERR_ARG (-16)
+#define ip_addr_get_ip4_u32(a) ((a)->addr)
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *callback_arg);
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg);
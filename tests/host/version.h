@@ -0,0 +1,2 @@
+#pragma once
+#define ESP_SDK_VERSION_NUMBER 0x030000
@@ -0,0 +1,175 @@
+// Duty cycle (USE_DUTY_CYCLE) with the default DRD in flash : deep sleep wakes aren't resets, and a failed
+// connection sleeps instead of starting Config Portal
+
+#include <string>
+#include <map>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+// Deep sleep ends the simulated boot
+struct DeepSleep
+{
+  uint64_t us;
+};
+
+#define BLYNK_WM_DEEP_SLEEP(us)     throw DeepSleep { us }
+
+// Reach the private members of BlynkWifi
+#define private   public
+#define protected public
+
+#include <BlynkSimpleEsp8266_Async_WM.h>
+
+#include "HostTest.h"
+
+#define SLEEP_SECONDS     60
+
+bool LOAD_DEFAULT_CONFIG_DATA = true;
+
+Blynk_WM_Configuration defaultConfig =
+{
+  //char header[16], dummy, not used
+  "ESP8266",
+  // WiFi_Credentials  WiFi_Creds  [NUM_WIFI_CREDENTIALS];
+  "HostAP", "password0",  "OtherAP", "password1",
+  // Blynk_Credentials Blynk_Creds [NUM_BLYNK_CREDENTIALS];
+  "blynk.example.com", "token0",  "blynk2.example.com", "token1",
+  //int  blynk_port;
+  8080,
+  //char board_name     [24];
+  "Host-Board",
+  // terminate the list
+  0
+};
+
+//////////////////////////////////////////////
+
+static BlynkWifi* boot(uint32_t resetReason)
+{
+  HostFakes::reset(resetReason);
+
+  BlynkWifi* blynk = new BlynkWifi(_blynkTransport);
+
+  blynk->begin("host");
+
+  return blynk;
+}
+
+// true if runDutyCycle() went to deep sleep for SLEEP_SECONDS
+static bool cycleSleeps(BlynkWifi* blynk)
+{
+  try
+  {
+    blynk->runDutyCycle(SLEEP_SECONDS);
+  }
+  catch (const DeepSleep& sleep)
+  {
+    return (sleep.us == SLEEP_SECONDS * 1000000ULL);
+  }
+
+  return false;
+}
+
+//////////////////////////////////////////////
+
+static void test_wakes_are_not_resets()
+{
+  HostFakes::powerOn();
+  HostFakes::apAvailable = true;
+
+  BlynkWifi* blynk = boot(REASON_DEFAULT_RST);
+
+  CHECK(HostFakes::resetDetectorCreated == 1);
+  CHECK(HostFakes::resetDetectorFlag);
+
+  blynk->queueVirtualWrite(1, 21.5);
+
+  CHECK(cycleSleeps(blynk));
+
+  // Awake for less than DRD_TIMEOUT, so the flag was cleared by stop() before sleeping
+  CHECK(HostFakes::now < DRD_TIMEOUT * 1000UL);
+  CHECK(HostFakes::resetDetectorStopped == 1);
+  CHECK(!HostFakes::resetDetectorFlag);
+  CHECK(HostFakes::writes.size() == 1);
+  CHECK(blynk->getDutyCycleStats().failCount == 0);
+
+  for (int cycle = 0; cycle < 3; cycle++)
+  {
+    blynk = boot(REASON_DEEP_SLEEP_AWAKE);
+
+    CHECK(HostFakes::resetDetectorCreated == 0);
+    CHECK(!blynk->configuration_mode);
+
+    blynk->queueVirtualWrite(1, cycle);
+
+    CHECK(cycleSleeps(blynk));
+    CHECK(HostFakes::writes.size() == 1);
+  }
+
+  CHECK(blynk->getDutyCycleStats().cycleCount == 4);
+
+  // Next user reset is a single reset
+  blynk = boot(REASON_EXT_SYS_RST);
+
+  CHECK(HostFakes::resetDetectorCreated == 1);
+  CHECK(!blynk->configuration_mode);
+  CHECK(cycleSleeps(blynk));
+}
+
+static void test_double_reset_starts_config_portal()
+{
+  HostFakes::powerOn();
+  HostFakes::apAvailable = true;
+
+  boot(REASON_EXT_SYS_RST);
+  BlynkWifi* blynk = boot(REASON_EXT_SYS_RST);
+
+  CHECK(blynk->configuration_mode);
+
+  // Returns to let loop() run Config Portal
+  CHECK(!cycleSleeps(blynk));
+}
+
+static void test_connect_failure_sleeps()
+{
+  HostFakes::powerOn();
+  HostFakes::apAvailable = true;
+
+  BlynkWifi* blynk = boot(REASON_DEFAULT_RST);
+
+  CHECK(cycleSleeps(blynk));
+
+  HostFakes::apAvailable = false;
+
+  blynk = boot(REASON_DEEP_SLEEP_AWAKE);
+
+  CHECK(!blynk->configuration_mode);
+
+  blynk->queueVirtualWrite(2, 1.0);
+
+  CHECK(cycleSleeps(blynk));
+  CHECK(!blynk->configuration_mode);
+  CHECK(HostFakes::writes.empty());
+  CHECK(blynk->getDutyCycleStats().failCount == 1);
+
+  // Reading kept for the next cycle
+  HostFakes::apAvailable = true;
+
+  blynk = boot(REASON_DEEP_SLEEP_AWAKE);
+
+  CHECK(cycleSleeps(blynk));
+  CHECK(HostFakes::writes.size() == 1);
+  CHECK(blynk->getDutyCycleStats().failCount == 1);
+}
+
+//////////////////////////////////////////////
+
+int main()
+{
+  RUN_TEST(test_wakes_are_not_resets);
+  RUN_TEST(test_double_reset_starts_config_portal);
+  RUN_TEST(test_connect_failure_sleeps);
+
+  return TEST_RESULT();
+}
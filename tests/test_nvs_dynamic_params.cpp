@@ -0,0 +1,139 @@
+// Dynamic Params saved to and loaded back from NVS (ESP32, USE_NVS), including empty and full-length items
+
+#include <string>
+#include <map>
+#include <vector>
+
+// Reach the private load / save functions of BlynkWifi
+#define private   public
+#define protected public
+
+#include <BlynkSimpleEsp32_Async_WM.h>
+
+#include "HostTest.h"
+
+#define MAX_SERVER_LEN    34
+#define MAX_PORT_LEN      6
+
+char Server [MAX_SERVER_LEN + 1];
+char Port   [MAX_PORT_LEN + 1];
+
+MenuItem myMenuItems [] =
+{
+  { "mqtt", "MQTT Server", Server,  MAX_SERVER_LEN },
+  { "mqpt", "Port",        Port,    MAX_PORT_LEN   },
+};
+
+uint16_t NUM_MENU_ITEMS = sizeof(myMenuItems) / sizeof(MenuItem);
+
+bool LOAD_DEFAULT_CONFIG_DATA = false;
+Blynk_WM_Configuration defaultConfig;
+
+//////////////////////////////////////////////
+
+static void setParams(const char* server, const char* port)
+{
+  memset(Server, 0, sizeof(Server));
+  memset(Port,   0, sizeof(Port));
+  strncpy(Server, server, MAX_SERVER_LEN);
+  strncpy(Port,   port,   MAX_PORT_LEN);
+}
+
+// Save, then clear the params and load them back as on next boot
+static bool roundTrip(const char* server, const char* port)
+{
+  setParams(server, port);
+  Blynk.saveDynamicData();
+  
+  setParams("garbage", "0");
+  
+  return Blynk.loadDynamicData();
+}
+
+//////////////////////////////////////////////
+
+static void test_empty_params()
+{
+  HostFakes::powerOn();
+  
+  CHECK(roundTrip("", ""));
+  CHECK(strcmp(Server, "") == 0);
+  CHECK(strcmp(Port,   "") == 0);
+}
+
+static void test_full_length_params()
+{
+  HostFakes::powerOn();
+  
+  const char* server = "0123456789012345678901234567890123";
+  const char* port   = "654321";
+  
+  CHECK(strlen(server) == MAX_SERVER_LEN);
+  CHECK(roundTrip(server, port));
+  CHECK(strcmp(Server, server) == 0);
+  CHECK(strcmp(Port,   port)   == 0);
+}
+
+static void test_emptied_param()
+{
+  HostFakes::powerOn();
+  
+  CHECK(roundTrip("mqtt.example.com", "1883"));
+  CHECK(roundTrip("mqtt.example.com", ""));
+  CHECK(strcmp(Server, "mqtt.example.com") == 0);
+  CHECK(strcmp(Port,   "") == 0);
+}
+
+static void test_unchanged_params_not_rewritten()
+{
+  HostFakes::powerOn();
+  
+  CHECK(roundTrip("mqtt.example.com", ""));
+  
+  int nvsWrites = HostFakes::nvsWrites;
+  
+  setParams("mqtt.example.com", "");
+  Blynk.saveDynamicData();
+  
+  CHECK(HostFakes::nvsWrites == nvsWrites);
+}
+
+static void test_missing_param_invalid()
+{
+  HostFakes::powerOn();
+  
+  CHECK(roundTrip("mqtt.example.com", "1883"));
+  
+  HostFakes::nvs.erase("d_mqpt");
+  
+  CHECK(!Blynk.loadDynamicData());
+}
+
+static void test_legacy_params_without_null()
+{
+  HostFakes::powerOn();
+  
+  // As stored by earlier versions, without the terminating NULL
+  HostFakes::nvs["d_mqtt"].assign((const uint8_t*) "legacy", (const uint8_t*) "legacy" + 6);
+  HostFakes::nvs["d_mqpt"].assign((const uint8_t*) "8080", (const uint8_t*) "8080" + 4);
+  
+  setParams("garbage", "0");
+  
+  CHECK(Blynk.loadDynamicData());
+  CHECK(strcmp(Server, "legacy") == 0);
+  CHECK(strcmp(Port,   "8080")   == 0);
+}
+
+//////////////////////////////////////////////
+
+int main()
+{
+  RUN_TEST(test_empty_params);
+  RUN_TEST(test_full_length_params);
+  RUN_TEST(test_emptied_param);
+  RUN_TEST(test_unchanged_params_not_rewritten);
+  RUN_TEST(test_missing_param_invalid);
+  RUN_TEST(test_legacy_params_without_null);
+  
+  return TEST_RESULT();
+}
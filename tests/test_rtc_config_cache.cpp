@@ -0,0 +1,226 @@
+// Config cache in ESP8266 RTC user memory (USE_RTC_CONFIG_CACHE), saved when connected and loaded at deep sleep wake
+
+#include <string>
+#include <map>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+// Reach the private members of BlynkWifi
+#define private   public
+#define protected public
+
+#include <BlynkSimpleEsp8266_Async_WM.h>
+
+#include "HostTest.h"
+
+#define MAX_SERVER_LEN    34
+#define MAX_TOPIC_LEN     ( BLYNK_WM_RTC_FREE_SIZE + 1 )
+
+char Server [MAX_SERVER_LEN + 1];
+char Topic  [MAX_TOPIC_LEN + 1];
+
+MenuItem myMenuItems [] =
+{
+  { "mqtt", "MQTT Server", Server,  MAX_SERVER_LEN },
+  { "subs", "Subs Topic",  Topic,   MAX_TOPIC_LEN  },
+};
+
+uint16_t NUM_MENU_ITEMS = sizeof(myMenuItems) / sizeof(MenuItem);
+
+bool LOAD_DEFAULT_CONFIG_DATA = true;
+
+Blynk_WM_Configuration defaultConfig =
+{
+  //char header[16], dummy, not used
+  "ESP8266",
+  // WiFi_Credentials  WiFi_Creds  [NUM_WIFI_CREDENTIALS];
+  "OtherAP", "password0",  "HostAP", "password1",
+  // Blynk_Credentials Blynk_Creds [NUM_BLYNK_CREDENTIALS];
+  "blynk.example.com", "token0",  "blynk2.example.com", "token1",
+  //int  blynk_port;
+  8080,
+  //char board_name     [24];
+  "Host-Board",
+  // terminate the list
+  0
+};
+
+//////////////////////////////////////////////
+
+// Values in RAM after reset, as initialized by the sketch
+static void setParams(const char* server, const char* topic)
+{
+  memset(Server, 0, sizeof(Server));
+  memset(Topic,  0, sizeof(Topic));
+  strncpy(Server, server, MAX_SERVER_LEN);
+  strncpy(Topic,  topic,  MAX_TOPIC_LEN);
+}
+
+static BlynkWifi* boot(uint32_t resetReason)
+{
+  HostFakes::reset(resetReason);
+  
+  BlynkWifi* blynk = new BlynkWifi(_blynkTransport);
+  
+  blynk->begin("host");
+  blynk->run();
+  
+  return blynk;
+}
+
+static bool rtcUnusedBlocksIntact()
+{
+  for (int i = 0; i < BLYNK_WM_RTC_OFFSET; i++)
+  {
+    if (HostFakes::rtcUserMemory[i] != 0xA5A5A5A5)
+      return false;
+  }
+  
+  return true;
+}
+
+//////////////////////////////////////////////
+
+static void test_layout_fits()
+{
+  CHECK(BLYNK_WM_RTC_OFFSET == 32);
+  CHECK(BLYNK_WM_RTC_CONFIG_CACHE_OFFSET + BLYNK_WM_RTC_CONFIG_CACHE_SIZE <= BLYNK_WM_RTC_SIZE);
+}
+
+static void test_wake_loads_cache()
+{
+  HostFakes::powerOn();
+  NUM_MENU_ITEMS = 1;
+  setParams("mqtt.example.com", "");
+  
+  BlynkWifi* blynk = boot(REASON_DEFAULT_RST);
+  
+  CHECK(blynk->connected());
+  CHECK(!blynk->configCacheLoaded);
+  
+  setParams("default", "");
+  int fileWrites = HostFakes::fileWrites;
+  
+  blynk = boot(REASON_DEEP_SLEEP_AWAKE);
+  
+  CHECK(blynk->connected());
+  CHECK(blynk->configCacheLoaded);
+  CHECK(HostFakes::fileReads[CONFIG_FILENAME] == 0);
+  CHECK(HostFakes::fileReads[CREDENTIALS_FILENAME] == 0);
+  CHECK(HostFakes::fileWrites == fileWrites);
+  CHECK(strcmp(Server, "mqtt.example.com") == 0);
+  
+  // Credentials of the last connection, in their places
+  CHECK(strcmp(blynk->Blynk8266_WM_config.WiFi_Creds[1].wifi_ssid, "HostAP") == 0);
+  CHECK(strcmp(blynk->Blynk8266_WM_config.WiFi_Creds[1].wifi_pw, "password1") == 0);
+  CHECK(strcmp(blynk->Blynk8266_WM_config.Blynk_Creds[0].blynk_server, "blynk.example.com") == 0);
+  CHECK(strcmp(blynk->Blynk8266_WM_config.Blynk_Creds[0].blynk_token, "token0") == 0);
+  CHECK(blynk->Blynk8266_WM_config.blynk_port == 8080);
+  CHECK(blynk->Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid[0] == 0);
+  
+  CHECK(rtcUnusedBlocksIntact());
+}
+
+static void test_large_params_from_storage()
+{
+  HostFakes::powerOn();
+  NUM_MENU_ITEMS = 2;
+  
+  std::string topic(MAX_TOPIC_LEN, 't');
+  
+  setParams("mqtt.example.com", topic.c_str());
+  
+  BlynkWifi* blynk = boot(REASON_DEFAULT_RST);
+  
+  CHECK(blynk->connected());
+  
+  setParams("default", "default");
+  
+  blynk = boot(REASON_DEEP_SLEEP_AWAKE);
+  
+  CHECK(blynk->connected());
+  CHECK(blynk->configCacheLoaded);
+  
+  // Dynamic Params didn't fit in RTC memory
+  CHECK(HostFakes::fileReads[CONFIG_FILENAME] == 0);
+  CHECK(HostFakes::fileReads[CREDENTIALS_FILENAME] == 1);
+  CHECK(strcmp(Server, "mqtt.example.com") == 0);
+  CHECK(topic == Topic);
+  
+  CHECK(rtcUnusedBlocksIntact());
+}
+
+static void test_storage_reloads_full_config()
+{
+  HostFakes::powerOn();
+  NUM_MENU_ITEMS = 1;
+  setParams("mqtt.example.com", "");
+  
+  boot(REASON_DEFAULT_RST);
+  BlynkWifi* blynk = boot(REASON_DEEP_SLEEP_AWAKE);
+  
+  CHECK(blynk->configCacheLoaded);
+  
+  // As before entering Config Portal or writing to storage
+  blynk->beginStorage();
+  
+  CHECK(!blynk->configCacheLoaded);
+  CHECK(strcmp(blynk->Blynk8266_WM_config.WiFi_Creds[0].wifi_ssid, "OtherAP") == 0);
+  CHECK(strcmp(blynk->Blynk8266_WM_config.Blynk_Creds[1].blynk_server, "blynk2.example.com") == 0);
+}
+
+static void test_cold_boot_ignores_cache()
+{
+  HostFakes::powerOn();
+  NUM_MENU_ITEMS = 1;
+  setParams("mqtt.example.com", "");
+  
+  BlynkWifi* blynk = boot(REASON_DEFAULT_RST);
+  
+  // Not a double reset
+  HostFakes::now += DRD_TIMEOUT * 1000UL;
+  blynk->run();
+  
+  blynk = boot(REASON_EXT_SYS_RST);
+  
+  CHECK(!blynk->configCacheLoaded);
+  CHECK(blynk->connected());
+}
+
+static void test_wake_keeps_forced_config_portal()
+{
+  HostFakes::powerOn();
+  NUM_MENU_ITEMS = 1;
+  setParams("mqtt.example.com", "");
+  
+  BlynkWifi* blynk = boot(REASON_DEFAULT_RST);
+  
+  CHECK(blynk->connected());
+  
+  // Persistent forced CP flag in flash
+  blynk->setForcedCP(true);
+  
+  for (int wake = 0; wake < 2; wake++)
+  {
+    blynk = boot(REASON_DEEP_SLEEP_AWAKE);
+    
+    CHECK(blynk->isForcedConfigPortal);
+    CHECK(blynk->persForcedConfigPortal);
+    CHECK(blynk->configuration_mode);
+  }
+}
+
+//////////////////////////////////////////////
+
+int main()
+{
+  RUN_TEST(test_layout_fits);
+  RUN_TEST(test_wake_loads_cache);
+  RUN_TEST(test_large_params_from_storage);
+  RUN_TEST(test_storage_reloads_full_config);
+  RUN_TEST(test_cold_boot_ignores_cache);
+  RUN_TEST(test_wake_keeps_forced_config_portal);
+  
+  return TEST_RESULT();
+}
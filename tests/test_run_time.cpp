@@ -0,0 +1,147 @@
+// run() duration with USE_ASYNC_CONNECT and USE_RUN_TIME_CHECK, on the simulated clock : connecting at boot and
+// reconnecting after WiFi or Blynk server loss never blocks loop()
+
+#include <string>
+#include <map>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+// Reach the private members of BlynkWifi
+#define private   public
+#define protected public
+
+#include <BlynkSimpleEsp8266_Async_WM.h>
+
+#include "HostTest.h"
+
+bool LOAD_DEFAULT_CONFIG_DATA = true;
+
+Blynk_WM_Configuration defaultConfig =
+{
+  //char header[16], dummy, not used
+  "ESP8266",
+  // WiFi_Credentials  WiFi_Creds  [NUM_WIFI_CREDENTIALS];
+  "HostAP", "password0",  "OtherAP", "password1",
+  // Blynk_Credentials Blynk_Creds [NUM_BLYNK_CREDENTIALS];
+  "blynk.example.com", "token0",  "blynk2.example.com", "token1",
+  //int  blynk_port;
+  8080,
+  //char board_name     [24];
+  "Host-Board",
+  // terminate the list
+  0
+};
+
+// Longest run() seen by the test, measured on the simulated clock
+static unsigned long longestRun = 0;
+
+//////////////////////////////////////////////
+
+// Call run() as loop() would, for duration ms or until connected if untilConnected
+static bool loopFor(BlynkWifi* blynk, unsigned long duration, bool untilConnected)
+{
+  unsigned long started = millis();
+
+  while (millis() - started < duration)
+  {
+    unsigned long runStart = millis();
+
+    blynk->run();
+
+    longestRun = std::max(longestRun, millis() - runStart);
+
+    if (untilConnected && blynk->connected())
+      return true;
+
+    delay(1);
+  }
+
+  return blynk->connected();
+}
+
+static BlynkWifi* boot()
+{
+  HostFakes::reset(REASON_DEFAULT_RST);
+
+  longestRun = 0;
+
+  BlynkWifi* blynk = new BlynkWifi(_blynkTransport);
+
+  blynk->begin("host");
+
+  return blynk;
+}
+
+//////////////////////////////////////////////
+
+static void test_connect_in_short_runs()
+{
+  HostFakes::powerOn();
+
+  unsigned long beginStart = millis();
+
+  BlynkWifi* blynk = boot();
+
+  // begin() only starts connecting
+  CHECK(millis() - beginStart < RUN_TIME_BUDGET);
+  CHECK(!blynk->connected());
+
+  CHECK(loopFor(blynk, 60000L, true));
+
+  CHECK(longestRun <= RUN_TIME_BUDGET);
+  CHECK(blynk->getMaxRunTime() <= RUN_TIME_BUDGET);
+  CHECK(blynk->getRunOverruns() == 0);
+}
+
+static void test_reconnect_wifi_in_short_runs()
+{
+  HostFakes::powerOn();
+
+  BlynkWifi* blynk = boot();
+
+  CHECK(loopFor(blynk, 60000L, true));
+
+  // Longer than the blocking connectMultiWiFi() with its 11 waits of 3s
+  HostFakes::apAvailable = false;
+
+  CHECK(!loopFor(blynk, 40000L, false));
+
+  HostFakes::apAvailable = true;
+
+  CHECK(loopFor(blynk, 120000L, true));
+
+  CHECK(longestRun <= RUN_TIME_BUDGET);
+  CHECK(blynk->getRunOverruns() == 0);
+}
+
+static void test_reconnect_blynk_in_short_runs()
+{
+  HostFakes::powerOn();
+
+  BlynkWifi* blynk = boot();
+
+  CHECK(loopFor(blynk, 60000L, true));
+
+  HostFakes::serverUp = false;
+
+  CHECK(!loopFor(blynk, 40000L, false));
+
+  HostFakes::serverUp = true;
+
+  CHECK(loopFor(blynk, 120000L, true));
+
+  CHECK(longestRun <= RUN_TIME_BUDGET);
+  CHECK(blynk->getRunOverruns() == 0);
+}
+
+//////////////////////////////////////////////
+
+int main()
+{
+  RUN_TEST(test_connect_in_short_runs);
+  RUN_TEST(test_reconnect_wifi_in_short_runs);
+  RUN_TEST(test_reconnect_blynk_in_short_runs);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,265 @@
+// TLS session resumption (USE_TLS_SESSION, TLS_SESSION_USE_RTC) against the TLS stand-in server : reconnects and
+// deep sleep wakes resume the session with an abbreviated handshake, a failed certificate check drops it
+
+#include <string>
+#include <map>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+// Included first by the Arduino IDE, the certificates are in PROGMEM
+#include <Arduino.h>
+
+// Reach the private members of BlynkWifi and BlynkArduinoClientSecure
+#define private   public
+#define protected public
+
+#include <BlynkSimpleEsp8266_SSL_Async_WM.h>
+
+#include "HostTest.h"
+
+typedef BlynkArduinoClientSecure<WiFiClientSecure>  BlynkTransport;
+typedef BlynkWifi<BlynkTransport>                   BlynkWifiSSL;
+
+bool LOAD_DEFAULT_CONFIG_DATA = true;
+
+Blynk_WM_Configuration defaultConfig =
+{
+  //char header[16], dummy, not used
+  "SSL",
+  // WiFi_Credentials  WiFi_Creds  [NUM_WIFI_CREDENTIALS];
+  "HostAP", "password0",  "OtherAP", "password1",
+  // Blynk_Credentials Blynk_Creds [NUM_BLYNK_CREDENTIALS];
+  "blynk.example.com", "token0",  "blynk2.example.com", "token1",
+  //int  blynk_port;
+  9443,
+  //char board_name     [24];
+  "Host-Board",
+  // terminate the list
+  0
+};
+
+// RAM of the transport, with its session, is lost at each simulated boot
+static BlynkTransport* transport = NULL;
+
+//////////////////////////////////////////////
+
+static BlynkWifiSSL* boot(uint32_t resetReason)
+{
+  HostFakes::reset(resetReason);
+
+  transport = new BlynkTransport(_blynkWifiClient);
+
+  BlynkWifiSSL* blynk = new BlynkWifiSSL(*transport);
+
+  blynk->begin("host");
+
+  return blynk;
+}
+
+// Call run() as loop() would, until connected or disconnected
+static bool loopUntil(BlynkWifiSSL* blynk, bool connected)
+{
+  unsigned long started = millis();
+
+  while ( (blynk->connected() != connected) && (millis() - started < 120000L) )
+  {
+    blynk->run();
+    delay(10);
+  }
+
+  // Connection events, saving the session to RTC, are handled by next run()
+  blynk->run();
+
+  return (blynk->connected() == connected);
+}
+
+static bool reconnect(BlynkWifiSSL* blynk)
+{
+  HostFakes::serverUp = false;
+
+  if (!loopUntil(blynk, false))
+    return false;
+
+  HostFakes::serverUp = true;
+
+  return loopUntil(blynk, true);
+}
+
+static bool sameSession(const BearSSL::Session& a, const BearSSL::Session& b)
+{
+  return (memcmp(&a, &b, sizeof(a)) == 0);
+}
+
+//////////////////////////////////////////////
+
+static void test_reconnect_resumes()
+{
+  HostFakes::powerOn();
+
+  BlynkWifiSSL* blynk = boot(REASON_DEFAULT_RST);
+
+  CHECK(loopUntil(blynk, true));
+
+  // Nothing to offer at first connection
+  CHECK(HostFakes::tlsFullHandshakes == 1);
+  CHECK(!blynk->isTLSResumed());
+  CHECK(blynk->getTLSHandshakeTime() == HostFakes::tlsFullTime);
+
+  BearSSL::Session first;
+
+  CHECK(transport->getTLSSession(first));
+
+  CHECK(reconnect(blynk));
+
+  CHECK(HostFakes::tlsFullHandshakes == 1);
+  CHECK(HostFakes::tlsResumedHandshakes == 1);
+  CHECK(blynk->isTLSResumed());
+  CHECK(blynk->getTLSHandshakeTime() == HostFakes::tlsResumeTime);
+
+  BearSSL::Session resumed;
+
+  CHECK(transport->getTLSSession(resumed));
+  CHECK(sameSession(first, resumed));
+
+  printf("  full handshake %lu ms, resumed %lu ms\n", HostFakes::tlsFullTime, blynk->getTLSHandshakeTime());
+}
+
+static void test_server_forgot_session()
+{
+  HostFakes::powerOn();
+
+  BlynkWifiSSL* blynk = boot(REASON_DEFAULT_RST);
+
+  CHECK(loopUntil(blynk, true));
+
+  BearSSL::Session first;
+
+  transport->getTLSSession(first);
+
+  // Server restarted, or its cache evicted the session
+  HostFakes::tlsServerSessions.clear();
+
+  CHECK(reconnect(blynk));
+
+  CHECK(HostFakes::tlsFullHandshakes == 2);
+  CHECK(!blynk->isTLSResumed());
+  CHECK(blynk->getTLSHandshakeTime() == HostFakes::tlsFullTime);
+
+  // The new session is kept and resumed next time
+  BearSSL::Session second;
+
+  CHECK(transport->getTLSSession(second));
+  CHECK(!sameSession(first, second));
+
+  CHECK(reconnect(blynk));
+
+  CHECK(blynk->isTLSResumed());
+  CHECK(HostFakes::tlsFullHandshakes == 2);
+}
+
+static void test_failed_certificate_drops_session()
+{
+  HostFakes::powerOn();
+
+  BlynkWifiSSL* blynk = boot(REASON_DEFAULT_RST);
+
+  CHECK(loopUntil(blynk, true));
+
+  HostFakes::tlsCertValid = false;
+  HostFakes::serverUp     = false;
+
+  CHECK(loopUntil(blynk, false));
+
+  HostFakes::serverUp = true;
+
+  // Handshakes complete, but the certificate check fails
+  CHECK(!loopUntil(blynk, true));
+  CHECK(HostFakes::tlsFullHandshakes + HostFakes::tlsResumedHandshakes > 2);
+
+  BearSSL::Session session;
+
+  CHECK(!transport->getTLSSession(session));
+  CHECK(sameSession(session, BearSSL::Session()));
+
+  HostFakes::tlsCertValid = true;
+
+  // The server still has the sessions, but none is offered
+  int fullHandshakes = HostFakes::tlsFullHandshakes;
+
+  CHECK(loopUntil(blynk, true));
+
+  CHECK(!blynk->isTLSResumed());
+  CHECK(HostFakes::tlsFullHandshakes == fullHandshakes + 1);
+  CHECK(blynk->getTLSHandshakeTime() == HostFakes::tlsFullTime);
+}
+
+static void test_deep_sleep_resumes_from_rtc()
+{
+  HostFakes::powerOn();
+
+  BlynkWifiSSL* blynk = boot(REASON_DEFAULT_RST);
+
+  CHECK(loopUntil(blynk, true));
+
+  BearSSL::Session saved;
+
+  transport->getTLSSession(saved);
+
+  // RAM is lost, the session comes back from RTC memory
+  blynk = boot(REASON_DEEP_SLEEP_AWAKE);
+
+  BearSSL::Session loaded;
+
+  CHECK(transport->getTLSSession(loaded));
+  CHECK(sameSession(saved, loaded));
+
+  CHECK(loopUntil(blynk, true));
+
+  CHECK(blynk->isTLSResumed());
+  CHECK(HostFakes::tlsFullHandshakes == 0);
+  CHECK(HostFakes::tlsResumedHandshakes == 1);
+  CHECK(blynk->getTLSHandshakeTime() == HostFakes::tlsResumeTime);
+
+  // Also after a soft reset
+  blynk = boot(REASON_SOFT_RESTART);
+
+  CHECK(loopUntil(blynk, true));
+  CHECK(blynk->isTLSResumed());
+}
+
+static void test_power_on_does_full_handshake()
+{
+  HostFakes::powerOn();
+
+  BlynkWifiSSL* blynk = boot(REASON_DEFAULT_RST);
+
+  CHECK(loopUntil(blynk, true));
+
+  // RTC memory lost, while the server still has the session
+  memset(HostFakes::rtcUserMemory, 0xA5, sizeof(HostFakes::rtcUserMemory));
+
+  blynk = boot(REASON_DEFAULT_RST);
+
+  BearSSL::Session session;
+
+  CHECK(!transport->getTLSSession(session));
+
+  CHECK(loopUntil(blynk, true));
+
+  CHECK(!blynk->isTLSResumed());
+  CHECK(HostFakes::tlsFullHandshakes == 1);
+}
+
+//////////////////////////////////////////////
+
+int main()
+{
+  RUN_TEST(test_reconnect_resumes);
+  RUN_TEST(test_server_forgot_session);
+  RUN_TEST(test_failed_certificate_drops_session);
+  RUN_TEST(test_deep_sleep_resumes_from_rtc);
+  RUN_TEST(test_power_on_does_full_handshake);
+
+  return TEST_RESULT();
+}